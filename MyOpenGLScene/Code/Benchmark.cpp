@@ -0,0 +1,190 @@
+//-----------------------------------------------------------------------------
+// Benchmark - frame times of a scripted run, reported as percentiles
+//-----------------------------------------------------------------------------
+#include "Benchmark.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include "MemoryTracker.h"
+
+
+//-----------------------------------------------------------------------------
+// JSON string, the GL strings may hold anything
+//-----------------------------------------------------------------------------
+static std::string quote(const std::string& s)
+{
+	std::string out = "\"";
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		if (s[i] == '"' || s[i] == '\\')
+			out += '\\';
+		if ((unsigned char)s[i] >= 0x20)
+			out += s[i];
+	}
+	return out + "\"";
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+Benchmark::Benchmark()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Times of one measured frame
+//-----------------------------------------------------------------------------
+void Benchmark::addFrame(double frameMs, double buildMs, double submitMs)
+{
+	mFrameMs.push_back(frameMs);
+	mCpuMs.push_back(buildMs + submitMs);
+	mBuildMs.push_back(buildMs);
+	mSubmitMs.push_back(submitMs);
+}
+
+//-----------------------------------------------------------------------------
+// GPU time of one measured frame, once its queries are read back
+//-----------------------------------------------------------------------------
+void Benchmark::addGpuFrame(double gpuMs)
+{
+	mGpuMs.push_back(gpuMs);
+}
+
+//-----------------------------------------------------------------------------
+// GL calls of one measured frame
+//-----------------------------------------------------------------------------
+void Benchmark::addGLFrame(const GLStats::Counters& counters)
+{
+	for (int c = 0; c < GLStats::NUM_COUNTERS; c++)
+		mCounts[c].push_back((double)counters.values[c]);
+}
+
+//-----------------------------------------------------------------------------
+// Frame arena used by one measured frame
+//-----------------------------------------------------------------------------
+void Benchmark::addArenaFrame(double arenaKB)
+{
+	mArenaKB.push_back(arenaKB);
+}
+
+unsigned long long Benchmark::getMaxCount(GLStats::Counter counter) const
+{
+	const std::vector<double>& counts = mCounts[counter];
+	return counts.empty() ? 0 : (unsigned long long)*std::max_element(counts.begin(), counts.end());
+}
+
+//-----------------------------------------------------------------------------
+// Mean and nearest rank percentiles
+//-----------------------------------------------------------------------------
+Benchmark::Stats Benchmark::computeStats(std::vector<double> samples)
+{
+	Stats stats = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+	if (samples.empty())
+		return stats;
+
+	std::sort(samples.begin(), samples.end());
+
+	double sum = 0.0;
+	for (size_t i = 0; i < samples.size(); i++)
+		sum += samples[i];
+	stats.mean = sum / (double)samples.size();
+
+	const double percents[3] = { 50.0, 95.0, 99.0 };
+	double* values[3] = { &stats.p50, &stats.p95, &stats.p99 };
+	for (int p = 0; p < 3; p++)
+	{
+		size_t rank = (size_t)ceil(percents[p] / 100.0 * (double)samples.size());
+		*values[p] = samples[std::max(rank, (size_t)1) - 1];
+	}
+	stats.max = samples.back();
+	return stats;
+}
+
+//-----------------------------------------------------------------------------
+// Writes the statistics of every series as JSON, and a summary to the console
+//-----------------------------------------------------------------------------
+bool Benchmark::writeReport(const std::string& filename, const std::string& renderer, const std::string& version, int width, int height) const
+{
+	const char* names[6] = { "frame_ms", "cpu_ms", "cpu_build_ms", "cpu_submit_ms", "gpu_ms", "frame_arena_kb" };
+	const std::vector<double>* series[6] = { &mFrameMs, &mCpuMs, &mBuildMs, &mSubmitMs, &mGpuMs, &mArenaKB };
+
+	std::ofstream out(filename.c_str());
+	if (!out)
+	{
+		std::cerr << "Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	out.setf(std::ios::fixed);
+	out.precision(3);
+	out << "{\n"
+		<< "  \"renderer\": " << quote(renderer) << ",\n"
+		<< "  \"version\": " << quote(version) << ",\n"
+		<< "  \"width\": " << width << ",\n"
+		<< "  \"height\": " << height << ",\n"
+		<< "  \"warmup_frames\": " << WARMUP_FRAMES << ",\n"
+		<< "  \"frames\": " << mFrameMs.size() << ",\n"
+		<< "  \"gpu_frames\": " << mGpuMs.size();
+
+	for (int s = 0; s < 6; s++)
+	{
+		// No GPU timestamps: null rather than zeros that would look fast
+		if (series[s]->empty())
+		{
+			out << ",\n  \"" << names[s] << "\": null";
+			continue;
+		}
+
+		Stats stats = computeStats(*series[s]);
+		out << ",\n  \"" << names[s] << "\": { \"mean\": " << stats.mean
+			<< ", \"p50\": " << stats.p50 << ", \"p95\": " << stats.p95
+			<< ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max << " }";
+	}
+
+	// GL calls per frame
+	if (mCounts[0].empty())
+		out << ",\n  \"gl\": null";
+	else
+	{
+		out << ",\n  \"gl\": {";
+		for (int c = 0; c < GLStats::NUM_COUNTERS; c++)
+		{
+			Stats stats = computeStats(mCounts[c]);
+			out << (c == 0 ? "\n" : ",\n") << "    \"" << GLStats::getCounterName((GLStats::Counter)c)
+				<< "\": { \"mean\": " << stats.mean << ", \"p50\": " << stats.p50
+				<< ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max << " }";
+		}
+		out << "\n  }";
+	}
+
+	// Bytes per category at the end of the run, and the peaks
+	out << ",\n  \"memory\": {";
+	for (int c = 0; c <= MemoryTracker::NUM_CATEGORIES; c++)
+	{
+		bool total = c == MemoryTracker::NUM_CATEGORIES;
+		MemoryTracker::Totals totals = total ? MemoryTracker::getTotals() : MemoryTracker::getTotals((MemoryTracker::Category)c);
+		out << (c == 0 ? "\n" : ",\n") << "    \"" << (total ? "total" : MemoryTracker::getCategoryName((MemoryTracker::Category)c))
+			<< "\": { \"cpu_bytes\": " << totals.cpuBytes << ", \"cpu_peak_bytes\": " << totals.cpuPeakBytes
+			<< ", \"gpu_bytes\": " << totals.gpuBytes << ", \"gpu_peak_bytes\": " << totals.gpuPeakBytes << " }";
+	}
+	out << "\n  }";
+	out << "\n}\n";
+
+	if (!out)
+	{
+		std::cerr << "Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	Stats frame = computeStats(mFrameMs);
+	Stats gpu = computeStats(mGpuMs);
+	std::cout.setf(std::ios::fixed);
+	std::cout.precision(3);
+	std::cout << "Benchmark: " << mFrameMs.size() << " frames on " << renderer << std::endl
+		<< "  frame mean " << frame.mean << " p50 " << frame.p50 << " p95 " << frame.p95 << " p99 " << frame.p99 << " (ms)" << std::endl;
+	if (!mGpuMs.empty())
+		std::cout << "  gpu   mean " << gpu.mean << " p50 " << gpu.p50 << " p95 " << gpu.p95 << " p99 " << gpu.p99 << " (ms)" << std::endl;
+	std::cout << "Report written to " << filename << std::endl;
+	return true;
+}
@@ -0,0 +1,64 @@
+//-----------------------------------------------------------------------------
+// Benchmark - frame times of a scripted run, reported as percentiles
+//
+// The main loop adds the times of every measured frame: the whole frame, and
+// the CPU side split in build (culling, draw lists) and submit (GL calls).
+// GPU times come from the profiler's timestamp queries, a few frames late, and
+// are missing when the driver has none, and so are the GL call counts when
+// GLStats is compiled out.  writeReport() writes the mean, p50, p95, p99 and
+// max of each as JSON, for CI scripts to compare between runs, with the
+// memory per category of the MemoryTracker and the KB of frame arena each
+// frame used.
+//-----------------------------------------------------------------------------
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+#include "GLStats.h"
+
+
+class Benchmark
+{
+public:
+
+	// Frames rendered before measuring: shader compilation, first uploads,
+	// shadow cache
+	static const int WARMUP_FRAMES = 30;
+
+	Benchmark();
+
+	// All in milliseconds
+	void addFrame(double frameMs, double buildMs, double submitMs);
+	void addGpuFrame(double gpuMs);
+	void addGLFrame(const GLStats::Counters& counters);
+	void addArenaFrame(double arenaKB);
+
+	int getNumFrames() const { return (int)mFrameMs.size(); }
+
+	// Highest count of a frame, 0 without GL stats
+	unsigned long long getMaxCount(GLStats::Counter counter) const;
+
+	// Writes the report, false on failure.  renderer and version are the GL
+	// strings of the context, the runs of different drivers don't compare.
+	bool writeReport(const std::string& filename, const std::string& renderer, const std::string& version, int width, int height) const;
+
+private:
+
+	struct Stats
+	{
+		double mean, p50, p95, p99, max;
+	};
+
+	static Stats computeStats(std::vector<double> samples);
+
+	std::vector<double> mFrameMs;
+	std::vector<double> mCpuMs;
+	std::vector<double> mBuildMs;
+	std::vector<double> mSubmitMs;
+	std::vector<double> mGpuMs;
+	std::vector<double> mArenaKB;
+	std::vector<double> mCounts[GLStats::NUM_COUNTERS];
+};
+#endif //BENCHMARK_H
@@ -103,6 +103,19 @@ void FPSCamera::rotate(float yaw, float pitch)
 	updateCameraVectors();
 }
 
+//-----------------------------------------------------------------------------
+// FPSCamera - Sets the absolute orientation of the camera
+//-----------------------------------------------------------------------------
+void FPSCamera::setRotation(float yaw, float pitch)
+{
+	mYaw = glm::radians(yaw);
+	mPitch = glm::radians(pitch);
+
+	// Constrain the pitch
+	mPitch = glm::clamp(mPitch, -glm::pi<float>() / 2.0f + 0.1f, glm::pi<float>() / 2.0f - 0.1f);
+	updateCameraVectors();
+}
+
 //-----------------------------------------------------------------------------
 // FPSCamera - Calculates the front vector from the Camera's (updated) Euler Angles
 //-----------------------------------------------------------------------------
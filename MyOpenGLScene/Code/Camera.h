@@ -29,6 +29,9 @@ public:
 	float getFOV() const   { return mFOV; }
 	void setFOV(float fov) { mFOV = fov; }		// in degrees
 
+	float getYaw() const   { return glm::degrees(mYaw); }
+	float getPitch() const { return glm::degrees(mPitch); }
+
 protected:
 	Camera();
 
@@ -62,6 +65,8 @@ public:
 	virtual void rotate(float yaw, float pitch);	// in degrees
 	virtual void move(const glm::vec3& offsetPos);
 
+	void setRotation(float yaw, float pitch);		// absolute, in degrees
+
 private:
 
 	void updateCameraVectors();
@@ -0,0 +1,285 @@
+//-----------------------------------------------------------------------------
+// Camera path - timed keys of an FPS camera, flown by the benchmark and by
+// the replays of recorded sessions
+//-----------------------------------------------------------------------------
+#include "CameraPath.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+
+
+const char RECORDING_MAGIC[4] = { 'C', 'R', 'E', 'C' };
+const unsigned int RECORDING_VERSION = 1;
+
+struct RecordingHeader
+{
+	char magic[4];
+	unsigned int version;
+	float tickSeconds;
+	unsigned int numKeys;
+};
+
+// One tick of a recording, the time is its index times the tick
+struct RecordedKey
+{
+	float position[3];
+	float yaw, pitch, fov;
+};
+
+//-----------------------------------------------------------------------------
+// Keys are found by time
+//-----------------------------------------------------------------------------
+struct KeyTimeLess
+{
+	bool operator()(float time, const CameraPath::Key& key) const { return time < key.time; }
+};
+
+
+static bool pathError(const std::string& filename, int line, const std::string& message)
+{
+	std::cerr << filename << "(" << line << "): " << message << std::endl;
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Uniform Catmull-Rom between p1 and p2
+//-----------------------------------------------------------------------------
+static glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t)
+{
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+CameraPath::CameraPath()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Reads a path file or a recording, false if it is missing or malformed
+//-----------------------------------------------------------------------------
+bool CameraPath::load(const std::string& filename)
+{
+	std::ifstream fin(filename, std::ios::in | std::ios::binary);
+	if (!fin)
+	{
+		std::cerr << "Cannot open " << filename << std::endl;
+		return false;
+	}
+
+	char magic[4] = {};
+	fin.read(magic, sizeof(magic));
+	fin.close();
+	if (memcmp(magic, RECORDING_MAGIC, sizeof(magic)) == 0)
+		return loadBinary(filename);
+	return loadText(filename);
+}
+
+//-----------------------------------------------------------------------------
+// Text keys
+//-----------------------------------------------------------------------------
+bool CameraPath::loadText(const std::string& filename)
+{
+	std::ifstream fin(filename);
+	if (!fin)
+	{
+		std::cerr << "Cannot open " << filename << std::endl;
+		return false;
+	}
+
+	std::vector<Key> keys;
+	std::string lineBuffer;
+	int lineNumber = 0;
+
+	while (std::getline(fin, lineBuffer))
+	{
+		lineNumber++;
+
+		size_t comment = lineBuffer.find('#');
+		if (comment != std::string::npos)
+			lineBuffer.erase(comment);
+
+		std::istringstream ss(lineBuffer);
+		std::string cmd;
+		if (!(ss >> cmd))
+			continue;
+		if (cmd != "key")
+			return pathError(filename, lineNumber, "unknown statement " + cmd);
+
+		Key key;
+		std::string extra;
+		if (!(ss >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch))
+			return pathError(filename, lineNumber, "expected: key <time> <x> <y> <z> <yaw> <pitch> [<fov>]");
+
+		key.fov = 0.0f;
+		if (ss >> extra)
+		{
+			std::istringstream fov(extra);
+			if (!(fov >> key.fov) || key.fov <= 0.0f || (ss >> extra))
+				return pathError(filename, lineNumber, "expected: key <time> <x> <y> <z> <yaw> <pitch> [<fov>]");
+		}
+		if (!keys.empty() && key.time <= keys.back().time)
+			return pathError(filename, lineNumber, "key times must increase");
+		if (!keys.empty() && (key.fov > 0.0f) != (keys.back().fov > 0.0f))
+			return pathError(filename, lineNumber, "the field of view must be on every key or none");
+
+		keys.push_back(key);
+	}
+
+	if (keys.empty())
+	{
+		std::cerr << filename << ": no keys" << std::endl;
+		return false;
+	}
+
+	mKeys.swap(keys);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Recorded ticks, in one read
+//-----------------------------------------------------------------------------
+bool CameraPath::loadBinary(const std::string& filename)
+{
+	std::ifstream fin(filename, std::ios::in | std::ios::binary);
+
+	RecordingHeader header;
+	if (!fin.read((char*)&header, sizeof(header)))
+	{
+		std::cerr << "Cannot read " << filename << std::endl;
+		return false;
+	}
+	if (header.version != RECORDING_VERSION || !(header.tickSeconds > 0.0f) || header.numKeys == 0)
+	{
+		std::cerr << filename << " is not a valid camera recording" << std::endl;
+		return false;
+	}
+
+	std::vector<RecordedKey> recorded(header.numKeys);
+	if (!fin.read((char*)&recorded[0], recorded.size() * sizeof(RecordedKey)))
+	{
+		std::cerr << filename << " is truncated" << std::endl;
+		return false;
+	}
+
+	std::vector<Key> keys(recorded.size());
+	for (size_t i = 0; i < recorded.size(); i++)
+	{
+		keys[i].time = (float)i * header.tickSeconds;
+		keys[i].position = glm::vec3(recorded[i].position[0], recorded[i].position[1], recorded[i].position[2]);
+		keys[i].yaw = recorded[i].yaw;
+		keys[i].pitch = recorded[i].pitch;
+		keys[i].fov = recorded[i].fov;
+	}
+
+	mKeys.swap(keys);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Writes the keys as a recording
+//-----------------------------------------------------------------------------
+bool CameraPath::saveBinary(const std::string& filename, float tickSeconds) const
+{
+	RecordingHeader header;
+	memcpy(header.magic, RECORDING_MAGIC, sizeof(header.magic));
+	header.version = RECORDING_VERSION;
+	header.tickSeconds = tickSeconds;
+	header.numKeys = (unsigned int)mKeys.size();
+
+	std::vector<RecordedKey> recorded(mKeys.size());
+	for (size_t i = 0; i < mKeys.size(); i++)
+	{
+		const Key& key = mKeys[i];
+		recorded[i].position[0] = key.position.x;
+		recorded[i].position[1] = key.position.y;
+		recorded[i].position[2] = key.position.z;
+		recorded[i].yaw = key.yaw;
+		recorded[i].pitch = key.pitch;
+		recorded[i].fov = key.fov;
+	}
+
+	std::ofstream fout(filename, std::ios::out | std::ios::binary);
+	if (!fout || !fout.write((const char*)&header, sizeof(header)) ||
+		(!recorded.empty() && !fout.write((const char*)&recorded[0], recorded.size() * sizeof(RecordedKey))))
+	{
+		std::cerr << "Cannot write " << filename << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Appends a key
+//-----------------------------------------------------------------------------
+void CameraPath::addKey(const Key& key)
+{
+	mKeys.push_back(key);
+}
+
+void CameraPath::clear()
+{
+	mKeys.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Time of the last key (the first key is at its own time, usually 0)
+//-----------------------------------------------------------------------------
+float CameraPath::getDuration() const
+{
+	return mKeys.empty() ? 0.0f : mKeys.back().time;
+}
+
+//-----------------------------------------------------------------------------
+// Camera of the path at the time
+//-----------------------------------------------------------------------------
+CameraPath::Key CameraPath::sample(float time) const
+{
+	if (mKeys.empty())
+	{
+		Key none = {};
+		return none;
+	}
+
+	if (time <= mKeys.front().time || mKeys.size() == 1)
+		return mKeys.front();
+	if (time >= mKeys.back().time)
+		return mKeys.back();
+
+	// Segment [k, k + 1] holding the time, recordings have thousands of keys
+	size_t k = std::upper_bound(mKeys.begin(), mKeys.end(), time, KeyTimeLess()) - mKeys.begin() - 1;
+
+	const Key& k1 = mKeys[k];
+	const Key& k2 = mKeys[k + 1];
+	const Key& k0 = mKeys[k > 0 ? k - 1 : k];
+	const Key& k3 = mKeys[k + 2 < mKeys.size() ? k + 2 : k + 1];
+
+	float t = (time - k1.time) / (k2.time - k1.time);
+	Key key;
+	key.time = time;
+	key.position = catmullRom(k0.position, k1.position, k2.position, k3.position, t);
+	key.yaw = glm::mix(k1.yaw, k2.yaw, t);
+	key.pitch = glm::mix(k1.pitch, k2.pitch, t);
+	key.fov = glm::mix(k1.fov, k2.fov, t);
+	return key;
+}
+
+//-----------------------------------------------------------------------------
+// Moves and turns the camera to the path at the time
+//-----------------------------------------------------------------------------
+void CameraPath::apply(float time, FPSCamera& camera) const
+{
+	if (mKeys.empty())
+		return;
+
+	Key key = sample(time);
+	camera.setPosition(key.position);
+	camera.setRotation(key.yaw, key.pitch);
+	if (key.fov > 0.0f)
+		camera.setFOV(key.fov);
+}
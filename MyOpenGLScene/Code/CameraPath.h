@@ -0,0 +1,68 @@
+//-----------------------------------------------------------------------------
+// Camera path - timed keys of an FPS camera, flown by the benchmark and by
+// the replays of recorded sessions
+//
+// Text file, one key per line, '#' starts a comment:
+//
+//   key <time> <x> <y> <z> <yaw> <pitch> [<fov>]
+//
+// Times are in seconds and increasing, angles in degrees with the FPSCamera
+// conventions (yaw 180 looks down -Z).  Yaws are not wrapped so a path can
+// turn more than half a turn between two keys.  Positions follow a
+// Catmull-Rom spline through the keys, the angles are interpolated linearly.
+// The field of view is on every key or none, without it the camera keeps
+// its own.
+//
+// Recordings (CameraRecorder) are binary: a header with the tick length,
+// then position, yaw, pitch and fov as floats, one key per tick.  load()
+// tells the two formats apart by the header.
+//-----------------------------------------------------------------------------
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+
+#include "Camera.h"
+
+
+class CameraPath
+{
+public:
+
+	struct Key
+	{
+		float time;			// seconds
+		glm::vec3 position;
+		float yaw, pitch;	// degrees
+		float fov;			// degrees, 0 to leave the camera's
+	};
+
+	CameraPath();
+
+	bool load(const std::string& filename);
+
+	// Binary, the keys must be tickSeconds apart starting at 0
+	bool saveBinary(const std::string& filename, float tickSeconds) const;
+
+	// Times must increase
+	void addKey(const Key& key);
+	void clear();
+
+	bool isEmpty() const        { return mKeys.empty(); }
+	int getNumKeys() const      { return (int)mKeys.size(); }
+	float getDuration() const;
+
+	// Camera of the path at the time, clamped to the first and last keys
+	Key sample(float time) const;
+	void apply(float time, FPSCamera& camera) const;
+
+private:
+
+	bool loadText(const std::string& filename);
+	bool loadBinary(const std::string& filename);
+
+	std::vector<Key> mKeys;
+};
+#endif //CAMERA_PATH_H
@@ -0,0 +1,82 @@
+//-----------------------------------------------------------------------------
+// Camera recorder - samples an FPS camera at a fixed tick into a CameraPath
+//-----------------------------------------------------------------------------
+#include "CameraRecorder.h"
+#include <iostream>
+
+
+static CameraPath::Key getKey(float time, const FPSCamera& camera)
+{
+	CameraPath::Key key;
+	key.time = time;
+	key.position = camera.getPosition();
+	key.yaw = camera.getYaw();
+	key.pitch = camera.getPitch();
+	key.fov = camera.getFOV();
+	return key;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+CameraRecorder::CameraRecorder(float tickSeconds)
+	: mTickSeconds(tickSeconds),
+	  mRecording(false),
+	  mNextTick(0.0f)
+{
+	mLast = getKey(0.0f, FPSCamera());
+}
+
+//-----------------------------------------------------------------------------
+// Starts a new recording
+//-----------------------------------------------------------------------------
+void CameraRecorder::start(const FPSCamera& camera)
+{
+	mPath.clear();
+	mLast = getKey(0.0f, camera);
+	mPath.addKey(mLast);
+	mNextTick = mTickSeconds;
+	mRecording = true;
+}
+
+//-----------------------------------------------------------------------------
+// Keys of the ticks between the last frame and this one
+//-----------------------------------------------------------------------------
+void CameraRecorder::update(float elapsedSeconds, const FPSCamera& camera)
+{
+	if (!mRecording || elapsedSeconds <= 0.0f)
+		return;
+
+	CameraPath::Key current = getKey(mLast.time + elapsedSeconds, camera);
+	for (; mNextTick <= current.time; mNextTick = (float)mPath.getNumKeys() * mTickSeconds)
+	{
+		float t = (mNextTick - mLast.time) / elapsedSeconds;
+
+		// Keyed at the tick index so long recordings do not drift
+		CameraPath::Key key;
+		key.time = (float)mPath.getNumKeys() * mTickSeconds;
+		key.position = glm::mix(mLast.position, current.position, t);
+		key.yaw = glm::mix(mLast.yaw, current.yaw, t);
+		key.pitch = glm::mix(mLast.pitch, current.pitch, t);
+		key.fov = glm::mix(mLast.fov, current.fov, t);
+		mPath.addKey(key);
+	}
+	mLast = current;
+}
+
+//-----------------------------------------------------------------------------
+// Ends the recording and writes it
+//-----------------------------------------------------------------------------
+bool CameraRecorder::stop(const std::string& filename)
+{
+	if (!mRecording)
+		return false;
+
+	mRecording = false;
+	if (!mPath.saveBinary(filename, mTickSeconds))
+		return false;
+
+	std::cout << "Recorded " << mPath.getNumKeys() << " camera keys ("
+		<< mPath.getDuration() << " s) to " << filename << std::endl;
+	return true;
+}
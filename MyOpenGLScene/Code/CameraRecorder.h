@@ -0,0 +1,44 @@
+//-----------------------------------------------------------------------------
+// Camera recorder - samples an FPS camera at a fixed tick into a CameraPath
+//
+// update() is called once per frame with the elapsed time; it emits one key
+// per tick that passed since the last frame, interpolated between the camera
+// of the last frame and this one, so the recording does not depend on the
+// frame rate.  stop() writes the keys as a binary recording that
+// CameraPath::load() reads back for replays and benchmarks.
+//-----------------------------------------------------------------------------
+#ifndef CAMERA_RECORDER_H
+#define CAMERA_RECORDER_H
+
+#include <string>
+#include "CameraPath.h"
+
+
+class CameraRecorder
+{
+public:
+
+	explicit CameraRecorder(float tickSeconds = 1.0f / 30.0f);
+
+	// First key, at the camera's current state
+	void start(const FPSCamera& camera);
+	void update(float elapsedSeconds, const FPSCamera& camera);
+
+	// Writes the recording, false if it could not be
+	bool stop(const std::string& filename);
+
+	bool isRecording() const    { return mRecording; }
+	int getNumKeys() const      { return mPath.getNumKeys(); }
+
+private:
+
+	CameraRecorder(const CameraRecorder&);
+	CameraRecorder& operator=(const CameraRecorder&);
+
+	float mTickSeconds;
+	bool mRecording;
+	CameraPath mPath;
+	CameraPath::Key mLast;		// camera of the last frame
+	float mNextTick;			// time of the next key
+};
+#endif //CAMERA_RECORDER_H
@@ -0,0 +1,177 @@
+//-----------------------------------------------------------------------------
+// Deferred shading
+//-----------------------------------------------------------------------------
+#include "DeferredRenderer.h"
+#include <iostream>
+#include "GLContext.h"
+#include "GLStats.h"
+#include "MemoryTracker.h"
+
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+DeferredRenderer::DeferredRenderer()
+	: mFBO(0),
+	  mAlbedoTexture(0), mNormalTexture(0), mDepthTexture(0),
+	  mVAO(0),
+	  mWidth(0), mHeight(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+DeferredRenderer::~DeferredRenderer()
+{
+	destroyTargets();
+	if (mVAO != 0)
+		glDeleteVertexArrays(1, &mVAO);
+}
+
+//-----------------------------------------------------------------------------
+// Loads the shaders
+//-----------------------------------------------------------------------------
+bool DeferredRenderer::init()
+{
+	if (!mGeometryShader.loadShaders("shaders/lighting_instanced.vert", "shaders/gbuffer.frag"))
+		return false;
+	if (!mLightingShader.loadShaders("shaders/deferred_lighting.vert", "shaders/deferred_lighting.frag"))
+		return false;
+
+	glGenVertexArrays(1, &mVAO);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Creates the G-buffer textures and framebuffer
+//-----------------------------------------------------------------------------
+bool DeferredRenderer::createTargets(int width, int height)
+{
+	destroyTargets();
+
+	GLuint textures[3];
+	glGenTextures(3, textures);
+	mAlbedoTexture = textures[0];
+	mNormalTexture = textures[1];
+	mDepthTexture = textures[2];
+
+	const GLenum internalFormats[3] = { GL_RGBA8, GL_RGBA16, GL_DEPTH24_STENCIL8 };
+	const GLenum formats[3] = { GL_RGBA, GL_RGBA, GL_DEPTH_STENCIL };
+	const GLenum types[3] = { GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT_24_8 };
+	for (int i = 0; i < 3; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], width, height, 0, formats[i], types[i], NULL);
+		MemoryTracker::setTexture(MemoryTracker::FRAME_TARGETS, textures[i], MemoryTracker::getTextureBytes(internalFormats[i], width, height, 1, 1));
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &mFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mAlbedoTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, mNormalTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, mDepthTexture, 0);
+
+	const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, GLContext::getDefaultFramebuffer());
+
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "G-buffer framebuffer incomplete (0x" << std::hex << status << std::dec << ")" << std::endl;
+		destroyTargets();
+		return false;
+	}
+
+	mWidth = width;
+	mHeight = height;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Releases the G-buffer
+//-----------------------------------------------------------------------------
+void DeferredRenderer::destroyTargets()
+{
+	if (mFBO != 0)
+		glDeleteFramebuffers(1, &mFBO);
+
+	GLuint textures[3] = { mAlbedoTexture, mNormalTexture, mDepthTexture };
+	MemoryTracker::releaseTextures(3, textures);
+	glDeleteTextures(3, textures);
+
+	mFBO = mAlbedoTexture = mNormalTexture = mDepthTexture = 0;
+	mWidth = mHeight = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Binds and clears the G-buffer
+//-----------------------------------------------------------------------------
+void DeferredRenderer::beginGeometryPass(int width, int height)
+{
+	if (width != mWidth || height != mHeight)
+		createTargets(width, height);
+
+	// Cleared per attachment so the scene's clear color is left alone
+	const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	glClearBufferfv(GL_COLOR, 0, zero);
+	glClearBufferfv(GL_COLOR, 1, zero);
+	glClearBufferfi(GL_DEPTH_STENCIL, 0, 1.0f, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Back to the default framebuffer
+//-----------------------------------------------------------------------------
+void DeferredRenderer::endGeometryPass()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, GLContext::getDefaultFramebuffer());
+}
+
+//-----------------------------------------------------------------------------
+// One full screen triangle lights every covered pixel, then the G-buffer depth
+// replaces the default framebuffer's
+//-----------------------------------------------------------------------------
+void DeferredRenderer::drawLighting(const glm::mat4& view, const glm::mat4& projection)
+{
+	if (mFBO == 0)
+		return;
+
+	mLightingShader.use();
+	mLightingShader.setUniform("invViewProjection", glm::inverse(projection * view));
+	mLightingShader.setUniformSampler("gAlbedoSpecular", 0);
+	mLightingShader.setUniformSampler("gNormalShininess", 1);
+	mLightingShader.setUniformSampler("gDepth", 2);
+
+	const GLuint textures[3] = { mAlbedoTexture, mNormalTexture, mDepthTexture };
+	for (GLuint i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+	}
+
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(mVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glEnable(GL_DEPTH_TEST);
+
+	for (GLuint i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, mFBO);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLContext::getDefaultFramebuffer());
+	glBlitFramebuffer(0, 0, mWidth, mHeight, 0, 0, mWidth, mHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, GLContext::getDefaultFramebuffer());
+}
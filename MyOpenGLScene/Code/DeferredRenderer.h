@@ -0,0 +1,65 @@
+//-----------------------------------------------------------------------------
+// Deferred shading
+//
+// The geometry pass writes a compact G-buffer instead of lighting every
+// fragment:
+//   target 0  RGBA8       albedo, specular intensity
+//   target 1  RGBA16      octahedral normal (xy), shininess / 256 (z)
+//   depth     DEPTH24_STENCIL8 - the world position is rebuilt from it
+// 16 bytes per pixel.  A full screen pass then lights every pixel once with
+// the sun, the flashlight and the point lights of its cluster (the same
+// LightClusterer data the forward shaders use), so the lighting cost follows
+// the screen size instead of the grass overdraw.  The G-buffer depth is
+// copied to the default framebuffer afterwards so forward passes still work.
+//-----------------------------------------------------------------------------
+#ifndef DEFERRED_RENDERER_H
+#define DEFERRED_RENDERER_H
+
+#define GLEW_STATIC
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "ShaderProgram.h"
+
+
+class DeferredRenderer
+{
+public:
+
+	// The lighting pass samples the G-buffer on units 0..2
+	static const GLuint FIRST_FREE_TEX_UNIT = 3;
+
+	 DeferredRenderer();
+	~DeferredRenderer();
+
+	// Loads the shaders
+	bool init();
+
+	// Binds and clears the G-buffer, (re)created when the size changes.  The
+	// geometry shader takes the same inputs as the forward lighting shaders.
+	void beginGeometryPass(int width, int height);
+	void endGeometryPass();
+
+	// Lights the G-buffer into the default framebuffer.  The caller sets the
+	// light uniforms on getLightingShader() first.
+	void drawLighting(const glm::mat4& view, const glm::mat4& projection);
+
+	ShaderProgram& getGeometryShader() { return mGeometryShader; }
+	ShaderProgram& getLightingShader() { return mLightingShader; }
+
+private:
+	DeferredRenderer(const DeferredRenderer& rhs);
+	DeferredRenderer& operator = (const DeferredRenderer& rhs);
+
+	bool createTargets(int width, int height);
+	void destroyTargets();
+
+	GLuint mFBO;
+	GLuint mAlbedoTexture, mNormalTexture, mDepthTexture;
+	GLuint mVAO;		// empty - the full screen triangle comes from gl_VertexID
+	int mWidth, mHeight;
+
+	ShaderProgram mGeometryShader;
+	ShaderProgram mLightingShader;
+};
+#endif //DEFERRED_RENDERER_H
@@ -0,0 +1,195 @@
+//-----------------------------------------------------------------------------
+// Entity store
+//-----------------------------------------------------------------------------
+#include "EntityStore.h"
+#include <algorithm>
+#include "Profiler.h"
+
+
+// Entities per job chunk for the update and cull passes
+const unsigned int ENTITY_GRAIN = 256;
+
+// Instances are sorted by distance in steps of 1 / SORT_STEPS_PER_UNIT
+const float SORT_STEPS_PER_UNIT = 1.0f;
+
+//-----------------------------------------------------------------------------
+// Orders entity ids by mesh, then material
+//-----------------------------------------------------------------------------
+struct BatchOrder
+{
+	BatchOrder(const std::vector<int>& meshes, const std::vector<int>& materials) : meshes(meshes), materials(materials) {}
+
+	bool operator()(int a, int b) const
+	{
+		if (meshes[a] != meshes[b])
+			return meshes[a] < meshes[b];
+		return materials[a] < materials[b];
+	}
+
+	const std::vector<int>& meshes;
+	const std::vector<int>& materials;
+};
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+EntityStore::EntityStore()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Adds an entity.  The bounds are the object space box of its mesh.
+//-----------------------------------------------------------------------------
+int EntityStore::add(int mesh, int material, int transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float drawDistance, unsigned int flags, float minDistance)
+{
+	int id = (int)mMeshes.size();
+
+	mMeshes.push_back(mesh);
+	mMaterials.push_back(material);
+	mTransforms.push_back(transform);
+	mFlags.push_back(flags);
+	mBoundsMin.push_back(boundsMin);
+	mBoundsMax.push_back(boundsMax);
+	mWorldSpheres.push_back(glm::vec4(0.0f));
+	mDrawDistances.push_back(drawDistance);
+	mMinDistances.push_back(minDistance);
+	mTransformStamps.push_back(~0u);		// never built
+	mVisible.push_back(0);
+
+	return id;
+}
+
+//-----------------------------------------------------------------------------
+// Sorts the entities by mesh and material and creates one batch per pair
+//-----------------------------------------------------------------------------
+void EntityStore::build()
+{
+	int count = (int)mMeshes.size();
+
+	mBatchEntities.resize(count);
+	for (int i = 0; i < count; i++)
+		mBatchEntities[i] = i;
+	std::stable_sort(mBatchEntities.begin(), mBatchEntities.end(), BatchOrder(mMeshes, mMaterials));
+
+	mBatches.clear();
+	for (int k = 0; k < count; k++)
+	{
+		int id = mBatchEntities[k];
+		if (mBatches.empty() || mBatches.back().mesh != mMeshes[id] || mBatches.back().material != mMaterials[id])
+		{
+			Batch batch;
+			batch.mesh = mMeshes[id];
+			batch.material = mMaterials[id];
+			batch.firstInstance = k;
+			batch.numInstances = 0;
+			batch.numVisible = 0;
+			batch.nearestDistance = 0.0f;
+			mBatches.push_back(batch);
+		}
+		mBatches.back().numInstances++;
+	}
+
+	mDrawInstances.assign(count, 0);
+	mSortKeys.assign(count, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Rebuilds the world bounding spheres of the entities whose transform changed
+//-----------------------------------------------------------------------------
+void EntityStore::update(const TransformSystem& transforms, JobSystem& jobs)
+{
+	PROFILE_SCOPE("EntityStore::update");
+
+	jobs.parallelFor((unsigned int)mMeshes.size(), ENTITY_GRAIN,
+		[&](unsigned int begin, unsigned int end, unsigned int)
+		{
+			for (unsigned int i = begin; i < end; i++)
+			{
+				unsigned int stamp = transforms.getStamp(mTransforms[i]);
+				if (stamp == mTransformStamps[i])
+					continue;
+
+				const glm::mat4& world = transforms.getWorld(mTransforms[i]);
+				glm::vec3 center = 0.5f * (mBoundsMin[i] + mBoundsMax[i]);
+				float radius = 0.5f * glm::length(mBoundsMax[i] - mBoundsMin[i]);
+				float maxScale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+
+				mWorldSpheres[i] = glm::vec4(glm::vec3(world * glm::vec4(center, 1.0f)), radius * maxScale);
+				mTransformStamps[i] = stamp;
+			}
+		});
+}
+
+//-----------------------------------------------------------------------------
+// Fills the visibility column.  Entities with one of skipFlags are hidden,
+// the occlusion test is skipped when occlusion is NULL.
+//-----------------------------------------------------------------------------
+void EntityStore::cull(const TransformSystem& transforms, const Frustum& frustum, const glm::vec3& viewPos, const OcclusionCuller* occlusion, unsigned int skipFlags, JobSystem& jobs)
+{
+	PROFILE_SCOPE("EntityStore::cull");
+
+	jobs.parallelFor((unsigned int)mMeshes.size(), ENTITY_GRAIN,
+		[&](unsigned int begin, unsigned int end, unsigned int)
+		{
+			for (unsigned int i = begin; i < end; i++)
+			{
+				const glm::vec4& sphere = mWorldSpheres[i];
+				glm::vec3 center(sphere);
+				float distance = glm::length(center - viewPos);
+
+				bool visible = !(mFlags[i] & skipFlags) &&
+					distance - sphere.w <= mDrawDistances[i] &&
+					distance + sphere.w >= mMinDistances[i] &&
+					frustum.intersectsSphere(center, sphere.w);
+
+				if (visible && occlusion != NULL && (mFlags[i] & OCCLUSION_CULLED))
+					visible = occlusion->isVisible(mBoundsMin[i], mBoundsMax[i], transforms.getWorld(mTransforms[i]));
+
+				mVisible[i] = visible ? 1 : 0;
+			}
+		});
+}
+
+//-----------------------------------------------------------------------------
+// Writes the transform ids of the visible entities of each batch at the start
+// of the batch's range, nearest first - batches are independent so they run in
+// parallel.  The RenderQueue orders the batches.
+//-----------------------------------------------------------------------------
+void EntityStore::extract(const glm::vec3& viewPos, JobSystem& jobs)
+{
+	PROFILE_SCOPE("EntityStore::extract");
+
+	jobs.parallelFor((unsigned int)mBatches.size(), 1,
+		[&](unsigned int begin, unsigned int end, unsigned int)
+		{
+			for (unsigned int b = begin; b < end; b++)
+			{
+				Batch& batch = mBatches[b];
+				if (batch.numInstances == 0)
+					continue;
+
+				// Coarse distance in the high bits, the transform id in the low ones
+				unsigned long long* keys = &mSortKeys[batch.firstInstance];
+				int numVisible = 0;
+				for (int k = batch.firstInstance; k < batch.firstInstance + batch.numInstances; k++)
+				{
+					int id = mBatchEntities[k];
+					if (!mVisible[id])
+						continue;
+
+					const glm::vec4& sphere = mWorldSpheres[id];
+					float distance = glm::max(glm::length(glm::vec3(sphere) - viewPos) - sphere.w, 0.0f);
+					unsigned long long step = (unsigned long long)glm::min(distance * SORT_STEPS_PER_UNIT, 65535.0f);
+					keys[numVisible++] = (step << 32) | (GLuint)mTransforms[id];
+				}
+				std::sort(keys, keys + numVisible);
+
+				GLuint* out = &mDrawInstances[batch.firstInstance];
+				for (int i = 0; i < numVisible; i++)
+					out[i] = (GLuint)keys[i];
+
+				batch.numVisible = numVisible;
+				batch.nearestDistance = numVisible > 0 ? (keys[0] >> 32) / SORT_STEPS_PER_UNIT : 0.0f;
+			}
+		});
+}
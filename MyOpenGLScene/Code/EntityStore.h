@@ -0,0 +1,99 @@
+//-----------------------------------------------------------------------------
+// Entity store
+//
+// Everything drawable in the scene is an entity.  Entities are kept as packed
+// columns (structure of arrays) - mesh, material, flags, transform, bounds -
+// and three passes run over the columns with the job system every frame:
+//  - update:  world bounding spheres of the entities whose transform changed
+//  - cull:    frustum, draw distance and occlusion tests
+//  - extract: transform ids of the visible entities, one batch per
+//             mesh/material pair, ready for instanced draws.  Instances are
+//             coarsely sorted front to back so the depth test rejects as
+//             much of the overdraw as possible (the RenderQueue orders the
+//             batches).
+// The position, rotation and scale columns live in the TransformSystem.
+//-----------------------------------------------------------------------------
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include <vector>
+#define GLEW_STATIC
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "JobSystem.h"
+#include "TransformSystem.h"
+#include "Frustum.h"
+#include "OcclusionCuller.h"
+
+
+class EntityStore
+{
+public:
+
+	enum Flags
+	{
+		OCCLUSION_CULLED = 1,	// tested against the software occlusion buffer
+		GPU_DRIVEN = 2			// drawn by the GPU driven path when it is active
+	};
+
+	// Entities sharing a mesh and a material.  The visible transform ids are
+	// written at firstInstance in getDrawInstances().
+	struct Batch
+	{
+		int mesh;
+		int material;
+		int firstInstance;
+		int numInstances;
+		int numVisible;
+		float nearestDistance;	// of the visible instances
+	};
+
+	EntityStore();
+
+	// Entities are drawn between minDistance and drawDistance from the camera
+	// (both tests are conservative, on the bounding sphere)
+	int add(int mesh, int material, int transform, const glm::vec3& boundsMin, const glm::vec3& boundsMax, float drawDistance, unsigned int flags, float minDistance = 0.0f);
+
+	// Groups the entities into batches - call once after the last add()
+	void build();
+
+	// Per frame passes, in this order
+	void update(const TransformSystem& transforms, JobSystem& jobs);
+	void cull(const TransformSystem& transforms, const Frustum& frustum, const glm::vec3& viewPos, const OcclusionCuller* occlusion, unsigned int skipFlags, JobSystem& jobs);
+	void extract(const glm::vec3& viewPos, JobSystem& jobs);
+
+	int getNumEntities() const           { return (int)mMeshes.size(); }
+	int getMesh(int id) const            { return mMeshes[id]; }
+	int getMaterial(int id) const        { return mMaterials[id]; }
+	int getTransform(int id) const       { return mTransforms[id]; }
+	unsigned int getFlags(int id) const  { return mFlags[id]; }
+	const glm::vec4& getWorldSphere(int id) const { return mWorldSpheres[id]; }
+	bool isVisible(int id) const         { return mVisible[id] != 0; }
+
+	const std::vector<Batch>& getBatches() const     { return mBatches; }
+	const std::vector<GLuint>& getDrawInstances() const { return mDrawInstances; }
+
+private:
+	EntityStore(const EntityStore& rhs);
+	EntityStore& operator = (const EntityStore& rhs);
+
+	// Columns
+	std::vector<int> mMeshes;
+	std::vector<int> mMaterials;
+	std::vector<int> mTransforms;
+	std::vector<unsigned int> mFlags;
+	std::vector<glm::vec3> mBoundsMin, mBoundsMax;	// object space
+	std::vector<glm::vec4> mWorldSpheres;			// xyz center, w radius
+	std::vector<float> mDrawDistances;
+	std::vector<float> mMinDistances;
+	std::vector<unsigned int> mTransformStamps;		// transform version the sphere was built from
+	std::vector<unsigned char> mVisible;
+
+	// Entity ids sorted by batch and the per frame output
+	std::vector<int> mBatchEntities;
+	std::vector<Batch> mBatches;
+	std::vector<GLuint> mDrawInstances;
+	std::vector<unsigned long long> mSortKeys;		// distance << 32 | transform, same layout
+};
+#endif //ENTITY_STORE_H
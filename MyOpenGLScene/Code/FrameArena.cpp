@@ -0,0 +1,191 @@
+//-----------------------------------------------------------------------------
+// Frame arena - scratch memory that lives until the end of the frame
+//-----------------------------------------------------------------------------
+#include "FrameArena.h"
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include "MemoryTracker.h"
+
+
+//-----------------------------------------------------------------------------
+// Offset past offset where data + offset is aligned
+//-----------------------------------------------------------------------------
+static size_t alignOffset(const char* data, size_t offset, size_t alignment)
+{
+	uintptr_t address = (uintptr_t)(data + offset);
+	uintptr_t aligned = (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	return offset + (size_t)(aligned - address);
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+FrameArena::FrameArena()
+	: mBlockBytes(DEFAULT_BLOCK_BYTES),
+	  mCapacity(0),
+	  mLastFrameBytes(0),
+	  mPeakBytes(0),
+	  mNumFrames(0),
+	  mNumGrowths(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+FrameArena::~FrameArena()
+{
+	shutdown();
+}
+
+//-----------------------------------------------------------------------------
+// Empty sub-arenas, their blocks come with the first allocations
+//-----------------------------------------------------------------------------
+void FrameArena::init(unsigned int numThreads, size_t blockBytes)
+{
+	shutdown();
+
+	mBlockBytes = std::max(blockBytes, (size_t)1024);
+	mThreads.resize(std::max(numThreads, 1u));
+	for (size_t t = 0; t < mThreads.size(); t++)
+	{
+		mThreads[t].current = 0;
+		mThreads[t].offset = 0;
+		mThreads[t].used = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Frees the blocks
+//-----------------------------------------------------------------------------
+void FrameArena::shutdown()
+{
+	for (size_t t = 0; t < mThreads.size(); t++)
+		for (size_t b = 0; b < mThreads[t].blocks.size(); b++)
+			delete [] mThreads[t].blocks[b].data;
+	mThreads.clear();
+
+	MemoryTracker::addCpu(MemoryTracker::FRAME_ARENA, -(long long)mCapacity);
+	mCapacity = 0;
+	mLastFrameBytes = 0;
+	mPeakBytes = 0;
+	mNumFrames = 0;
+	mNumGrowths = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Bumps the offset in the current block of the thread
+//-----------------------------------------------------------------------------
+void* FrameArena::allocate(unsigned int threadIndex, size_t bytes, size_t alignment)
+{
+	ThreadArena& arena = mThreads[threadIndex];
+	if (arena.current < arena.blocks.size())
+	{
+		const Block& block = arena.blocks[arena.current];
+		size_t start = alignOffset(block.data, arena.offset, alignment);
+		if (start + bytes <= block.size)
+		{
+			arena.used += start + bytes - arena.offset;
+			arena.offset = start + bytes;
+			return block.data + start;
+		}
+	}
+	return allocateFromNextBlock(arena, bytes, alignment);
+}
+
+//-----------------------------------------------------------------------------
+// The current block is full: the next one that fits, or a new one twice the
+// size of the last so a frame that needs more adds few blocks
+//-----------------------------------------------------------------------------
+void* FrameArena::allocateFromNextBlock(ThreadArena& arena, size_t bytes, size_t alignment)
+{
+	size_t needed = bytes + alignment - 1;
+	size_t next = arena.blocks.empty() ? 0 : arena.current + 1;
+	while (next < arena.blocks.size() && arena.blocks[next].size < needed)
+		next++;
+
+	if (next == arena.blocks.size())
+	{
+		Block block;
+		block.size = std::max(needed, arena.blocks.empty() ? mBlockBytes : arena.blocks.back().size * 2);
+		block.data = new char[block.size];
+		arena.blocks.push_back(block);
+
+		MemoryTracker::addCpu(MemoryTracker::FRAME_ARENA, (long long)block.size);
+		mCapacity += block.size;
+		if (mNumFrames > 0)
+			mNumGrowths++;
+	}
+
+	const Block& block = arena.blocks[next];
+	size_t start = alignOffset(block.data, 0, alignment);
+	arena.current = next;
+	arena.offset = start + bytes;
+	arena.used += start + bytes;
+	return block.data + start;
+}
+
+//-----------------------------------------------------------------------------
+// Keeps the usage of the frame and rewinds every sub-arena.  A sub-arena that
+// had to chain blocks gets a single block of their total size instead, the
+// next frames find it in one piece.
+//-----------------------------------------------------------------------------
+void FrameArena::reset()
+{
+	mLastFrameBytes = getUsedBytes();
+	mPeakBytes = std::max(mPeakBytes, mLastFrameBytes);
+	mNumFrames++;
+
+	for (size_t t = 0; t < mThreads.size(); t++)
+	{
+		ThreadArena& arena = mThreads[t];
+		if (arena.blocks.size() > 1)
+		{
+			Block merged;
+			merged.size = 0;
+			for (size_t b = 0; b < arena.blocks.size(); b++)
+			{
+				merged.size += arena.blocks[b].size;
+				delete [] arena.blocks[b].data;
+			}
+			merged.data = new char[merged.size];
+			arena.blocks.assign(1, merged);
+		}
+
+		arena.current = 0;
+		arena.offset = 0;
+		arena.used = 0;
+	}
+}
+
+size_t FrameArena::getUsedBytes() const
+{
+	size_t used = 0;
+	for (size_t t = 0; t < mThreads.size(); t++)
+		used += mThreads[t].used;
+	return used;
+}
+
+//-----------------------------------------------------------------------------
+// Usage and capacity in KB
+//-----------------------------------------------------------------------------
+void FrameArena::dump(std::ostream& out) const
+{
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out.setf(std::ios::fixed);
+	out.precision(1);
+
+	size_t numBlocks = 0;
+	for (size_t t = 0; t < mThreads.size(); t++)
+		numBlocks += mThreads[t].blocks.size();
+
+	out << "Frame arena (KB): last frame " << (double)mLastFrameBytes / 1024.0
+		<< ", peak " << (double)mPeakBytes / 1024.0
+		<< ", capacity " << (double)mCapacity / 1024.0 << " in " << numBlocks << " blocks over " << mThreads.size() << " threads, "
+		<< mNumGrowths << " added after the first frame" << std::endl;
+
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -0,0 +1,154 @@
+//-----------------------------------------------------------------------------
+// Frame arena - scratch memory that lives until the end of the frame
+//
+// One sub-arena per thread of the job system, picked with the thread index a
+// RangeJob receives, so allocating takes no lock: it moves a pointer in the
+// thread's current block, or goes on to its next block.  reset() at the end
+// of the frame rewinds every sub-arena and merges the blocks of one that
+// needed more than one.  Blocks are only added while a frame needs more than
+// the frames before it, after that the frame loop does not touch the heap.
+//
+// FrameAllocator makes STL containers allocate from one sub-arena.  Nothing
+// is freed before the reset: a growing vector leaves its old storage behind,
+// reserve() when the size is known.  Containers must be gone by the reset.
+//
+// The blocks are counted in the FRAME_ARENA category of the MemoryTracker,
+// the bytes handed out per frame and their peak are kept here.
+//-----------------------------------------------------------------------------
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <vector>
+#include <iosfwd>
+
+
+class FrameArena
+{
+public:
+
+	static const size_t DEFAULT_BLOCK_BYTES = 256 * 1024;
+
+	 FrameArena();
+	~FrameArena();
+
+	// numThreads sub-arenas, JobSystem::getThreadCount().  The first block of
+	// each is made when it is first used.
+	void init(unsigned int numThreads, size_t blockBytes = DEFAULT_BLOCK_BYTES);
+	void shutdown();
+
+	unsigned int getThreadCount() const { return (unsigned int)mThreads.size(); }
+
+	// bytes from the sub-arena of threadIndex, only ever called from that
+	// thread.  alignment is a power of two.
+	void* allocate(unsigned int threadIndex, size_t bytes, size_t alignment);
+
+	template <typename T>
+	T* allocateArray(unsigned int threadIndex, size_t count)  { return (T*)allocate(threadIndex, count * sizeof(T), alignof(T)); }
+
+	// Ends the frame, everything allocated is gone.  No job may be running.
+	void reset();
+
+	// Bytes handed out, padding included: in the frame being built, in the
+	// last finished frame, and the most of any frame
+	size_t getUsedBytes() const;
+	size_t getLastFrameBytes() const  { return mLastFrameBytes; }
+	size_t getPeakBytes() const       { return mPeakBytes; }
+
+	// Bytes of all blocks, and how many were added after the first frame
+	size_t getCapacity() const        { return mCapacity; }
+	int getNumGrowths() const         { return mNumGrowths; }
+
+	void dump(std::ostream& out) const;
+
+private:
+	FrameArena(const FrameArena& rhs);
+	FrameArena& operator = (const FrameArena& rhs);
+
+	struct Block
+	{
+		char* data;
+		size_t size;
+	};
+
+	// Padded so two threads never write the same cache line
+	struct ThreadArena
+	{
+		std::vector<Block> blocks;
+		size_t current;			// block being filled
+		size_t offset;			// in the current block
+		size_t used;			// this frame, all blocks
+		char padding[64];
+	};
+
+	void* allocateFromNextBlock(ThreadArena& arena, size_t bytes, size_t alignment);
+
+	std::vector<ThreadArena> mThreads;
+	size_t mBlockBytes;
+	size_t mCapacity;
+	size_t mLastFrameBytes;
+	size_t mPeakBytes;
+	int mNumFrames;
+	int mNumGrowths;
+};
+
+//-----------------------------------------------------------------------------
+// STL allocator on one sub-arena, deallocate() does nothing
+//
+//   FrameVector<int> visible(FrameAllocator<int>(arena, threadIndex));
+//-----------------------------------------------------------------------------
+template <typename T>
+class FrameAllocator
+{
+public:
+
+	typedef T value_type;
+
+	FrameAllocator(FrameArena& arena, unsigned int threadIndex) : mArena(&arena), mThreadIndex(threadIndex) {}
+
+	template <typename U>
+	FrameAllocator(const FrameAllocator<U>& rhs) : mArena(rhs.getArena()), mThreadIndex(rhs.getThreadIndex()) {}
+
+	T* allocate(size_t count)    { return mArena->allocateArray<T>(mThreadIndex, count); }
+	void deallocate(T*, size_t)  {}
+
+	FrameArena* getArena() const         { return mArena; }
+	unsigned int getThreadIndex() const  { return mThreadIndex; }
+
+private:
+	FrameArena* mArena;
+	unsigned int mThreadIndex;
+};
+
+template <typename T, typename U>
+bool operator == (const FrameAllocator<T>& a, const FrameAllocator<U>& b)
+{
+	return a.getArena() == b.getArena() && a.getThreadIndex() == b.getThreadIndex();
+}
+
+template <typename T, typename U>
+bool operator != (const FrameAllocator<T>& a, const FrameAllocator<U>& b)
+{
+	return !(a == b);
+}
+
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator<T> >;
+
+//-----------------------------------------------------------------------------
+// listsPerThread lists for every thread of the arena, list
+// thread * listsPerThread + n allocating from that thread's sub-arena, for
+// the jobs that each fill the lists of the thread running them
+//-----------------------------------------------------------------------------
+template <typename T>
+FrameVector<FrameVector<T> > makeThreadLists(FrameArena& arena, size_t listsPerThread)
+{
+	FrameVector<FrameVector<T> > lists(FrameAllocator<FrameVector<T> >(arena, 0));
+	lists.reserve(arena.getThreadCount() * listsPerThread);
+	for (unsigned int t = 0; t < arena.getThreadCount(); t++)
+		for (size_t n = 0; n < listsPerThread; n++)
+			lists.push_back(FrameVector<T>(FrameAllocator<T>(arena, t)));
+	return lists;
+}
+
+#endif //FRAME_ARENA_H
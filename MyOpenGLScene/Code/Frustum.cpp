@@ -0,0 +1,71 @@
+//-----------------------------------------------------------------------------
+// View frustum - six planes extracted from a view-projection matrix
+//-----------------------------------------------------------------------------
+#include "Frustum.h"
+
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+Frustum::Frustum()
+{
+	update(glm::mat4(1.0f));
+}
+
+//-----------------------------------------------------------------------------
+// Extracts the planes from the rows of the combined matrix (Gribb & Hartmann)
+// http://www.cs.otago.ca/postgrads/gribb/frustum_extraction.pdf
+//-----------------------------------------------------------------------------
+void Frustum::update(const glm::mat4& m)
+{
+	// glm is column major so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	mPlanes[LEFT_PLANE]   = row3 + row0;
+	mPlanes[RIGHT_PLANE]  = row3 - row0;
+	mPlanes[BOTTOM_PLANE] = row3 + row1;
+	mPlanes[TOP_PLANE]    = row3 - row1;
+	mPlanes[NEAR_PLANE]   = row3 + row2;
+	mPlanes[FAR_PLANE]    = row3 - row2;
+
+	for (int i = 0; i < NUM_PLANES; i++)
+	{
+		float length = glm::length(glm::vec3(mPlanes[i]));
+		if (length > 0.0f)
+			mPlanes[i] /= length;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Returns false only if the sphere is completely outside one of the planes
+//-----------------------------------------------------------------------------
+bool Frustum::intersectsSphere(const glm::vec3& center, float radius) const
+{
+	for (int i = 0; i < NUM_PLANES; i++)
+	{
+		if (glm::dot(glm::vec3(mPlanes[i]), center) + mPlanes[i].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Returns false only if the world space box is completely outside one of the
+// planes (tests the box corner furthest along each plane normal)
+//-----------------------------------------------------------------------------
+bool Frustum::intersectsBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	for (int i = 0; i < NUM_PLANES; i++)
+	{
+		glm::vec3 positive(mPlanes[i].x >= 0.0f ? boundsMax.x : boundsMin.x,
+		                   mPlanes[i].y >= 0.0f ? boundsMax.y : boundsMin.y,
+		                   mPlanes[i].z >= 0.0f ? boundsMax.z : boundsMin.z);
+
+		if (glm::dot(glm::vec3(mPlanes[i]), positive) + mPlanes[i].w < 0.0f)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,39 @@
+//-----------------------------------------------------------------------------
+// View frustum - six planes extracted from a view-projection matrix
+//-----------------------------------------------------------------------------
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include "glm/glm.hpp"
+
+
+class Frustum
+{
+public:
+
+	enum Plane
+	{
+		LEFT_PLANE,
+		RIGHT_PLANE,
+		BOTTOM_PLANE,
+		TOP_PLANE,
+		NEAR_PLANE,
+		FAR_PLANE,
+		NUM_PLANES
+	};
+
+	Frustum();
+
+	// Planes point inwards and are normalized so plane distances are in world units
+	void update(const glm::mat4& viewProjection);
+
+	bool intersectsSphere(const glm::vec3& center, float radius) const;
+	bool intersectsBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+	const glm::vec4& getPlane(int plane) const { return mPlanes[plane]; }
+
+private:
+
+	glm::vec4 mPlanes[NUM_PLANES];
+};
+#endif //FRUSTUM_H
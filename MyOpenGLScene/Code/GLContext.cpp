@@ -0,0 +1,483 @@
+//-----------------------------------------------------------------------------
+// OpenGL context - the window, or what stands for it, the scene renders to
+//-----------------------------------------------------------------------------
+#include "GLContext.h"
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include "GLFW/glfw3.h"
+#ifdef GL_CONTEXT_EGL
+#define EGL_NO_X11
+#include "EGL/egl.h"
+#include "EGL/eglext.h"
+#endif
+#ifdef GL_CONTEXT_OSMESA
+#include "GL/osmesa.h"
+#endif
+#include "GLStats.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+
+
+static const char* BACKEND_NAMES[GLContext::NUM_BACKENDS] = { "glfw", "egl", "osmesa" };
+
+// Ask for OpenGL 4.3 first (GPU driven path), fall back to a 3.3 core context
+static const int GL_VERSIONS[][2] = { { 4, 3 }, { 3, 3 } };
+static const int NUM_GL_VERSIONS = 2;
+
+// Offscreen framebuffer of the current context, 0 for a window
+static GLuint gDefaultFramebuffer = 0;
+
+//-----------------------------------------------------------------------------
+// GLFW window
+//-----------------------------------------------------------------------------
+class GlfwContext : public GLContext
+{
+public:
+
+	GlfwContext() : GLContext(GLFW_WINDOW), mWindow(NULL), mInitialized(false) {}
+	~GlfwContext();
+
+	GLFWwindow* getWindow() const  { return mWindow; }
+
+	void swapBuffers()                          { glfwSwapBuffers(mWindow); }
+	void pollEvents()                           { glfwPollEvents(); }
+	void setSwapInterval(int interval)          { glfwSwapInterval(interval); }
+	void setTitle(const std::string& title)     { glfwSetWindowTitle(mWindow, title.c_str()); }
+	void getFramebufferSize(int& width, int& height) const  { glfwGetFramebufferSize(mWindow, &width, &height); }
+	double getTime() const                      { return glfwGetTime(); }
+	bool shouldClose() const                    { return glfwWindowShouldClose(mWindow) || GLContext::shouldClose(); }
+
+protected:
+
+	bool open();
+	bool createContext(int major, int minor, const char* title, bool visible);
+
+private:
+
+	GLFWwindow* mWindow;
+	bool mInitialized;
+};
+
+GlfwContext::~GlfwContext()
+{
+	if (mInitialized)
+		glfwTerminate();
+}
+
+bool GlfwContext::open()
+{
+	// GLFW is configured.  Must be called before calling any GLFW functions
+	if (!glfwInit())
+	{
+		std::cerr << "GLFW initialization failed" << std::endl;
+		return false;
+	}
+	mInitialized = true;
+	return true;
+}
+
+bool GlfwContext::createContext(int major, int minor, const char* title, bool visible)
+{
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);	// forward compatible with newer versions of OpenGL as they become available but not backward compatible (it will not run on devices that do not support OpenGL 3.3
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+
+	mWindow = glfwCreateWindow(mWidth, mHeight, title, NULL, NULL);
+	if (mWindow == NULL)
+		return false;
+
+	// Make the window's context the current one
+	glfwMakeContextCurrent(mWindow);
+	return true;
+}
+
+#ifdef GL_CONTEXT_EGL
+//-----------------------------------------------------------------------------
+// EGL without a surface, rendering to an offscreen framebuffer
+//-----------------------------------------------------------------------------
+class EglContext : public GLContext
+{
+public:
+
+	EglContext();
+	~EglContext();
+
+	// Nothing to present, the flush keeps the GPU busy like a swap would
+	void swapBuffers()  { glFlush(); }
+
+protected:
+
+	bool open();
+	bool createContext(int major, int minor, const char* title, bool visible);
+	bool loadFunctions();
+	bool createFramebuffer();
+
+private:
+
+	EGLDisplay mDisplay;
+	EGLContext mContext;
+	GLuint mFBO;
+	GLuint mRenderbuffers[2];	// color, depth and stencil
+};
+
+static bool hasExtension(const char* extensions, const char* name)
+{
+	if (extensions == NULL)
+		return false;
+
+	size_t length = strlen(name);
+	for (const char* found = strstr(extensions, name); found != NULL; found = strstr(found + length, name))
+	{
+		if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0'))
+			return true;
+	}
+	return false;
+}
+
+EglContext::EglContext()
+	: GLContext(EGL_SURFACELESS),
+	  mDisplay(EGL_NO_DISPLAY),
+	  mContext(EGL_NO_CONTEXT),
+	  mFBO(0)
+{
+	mRenderbuffers[0] = mRenderbuffers[1] = 0;
+}
+
+EglContext::~EglContext()
+{
+	if (mFBO != 0)
+	{
+		glDeleteFramebuffers(1, &mFBO);
+		glDeleteRenderbuffers(2, mRenderbuffers);
+		MemoryTracker::releaseRenderbuffers(2, mRenderbuffers);
+		gDefaultFramebuffer = 0;
+	}
+
+	if (mDisplay != EGL_NO_DISPLAY)
+	{
+		eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (mContext != EGL_NO_CONTEXT)
+			eglDestroyContext(mDisplay, mContext);
+		eglTerminate(mDisplay);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// The Mesa surfaceless platform, software on machines without a GPU, else
+// the first device (NVIDIA headless)
+//-----------------------------------------------------------------------------
+bool EglContext::open()
+{
+	const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay == NULL)
+	{
+		std::cerr << "EGL has no platform displays" << std::endl;
+		return false;
+	}
+
+	EGLint major, minor;
+	if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+	{
+		mDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+		if (mDisplay != EGL_NO_DISPLAY && !eglInitialize(mDisplay, &major, &minor))
+			mDisplay = EGL_NO_DISPLAY;
+	}
+
+	PFNEGLQUERYDEVICESEXTPROC queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+	if (mDisplay == EGL_NO_DISPLAY && queryDevices != NULL && hasExtension(clientExtensions, "EGL_EXT_platform_device"))
+	{
+		EGLDeviceEXT device;
+		EGLint numDevices = 0;
+		if (queryDevices(1, &device, &numDevices) && numDevices > 0)
+		{
+			mDisplay = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, NULL);
+			if (mDisplay != EGL_NO_DISPLAY && !eglInitialize(mDisplay, &major, &minor))
+				mDisplay = EGL_NO_DISPLAY;
+		}
+	}
+
+	if (mDisplay == EGL_NO_DISPLAY)
+	{
+		std::cerr << "No surfaceless EGL display" << std::endl;
+		return false;
+	}
+	if (!hasExtension(eglQueryString(mDisplay, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+	{
+		std::cerr << "EGL display without surfaceless contexts" << std::endl;
+		return false;
+	}
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		std::cerr << "EGL has no desktop OpenGL" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool EglContext::createContext(int major, int minor, const char* title, bool visible)
+{
+	// Any surface type, the context never gets one
+	const EGLint configAttributes[] =
+	{
+		EGL_SURFACE_TYPE, 0,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(mDisplay, configAttributes, &config, 1, &numConfigs) || numConfigs == 0)
+	{
+		std::cerr << "No EGL config for OpenGL" << std::endl;
+		return false;
+	}
+
+	const EGLint contextAttributes[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION_KHR, major,
+		EGL_CONTEXT_MINOR_VERSION_KHR, minor,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+		EGL_CONTEXT_FLAGS_KHR, EGL_CONTEXT_OPENGL_FORWARD_COMPATIBLE_BIT_KHR,
+		EGL_NONE
+	};
+	mContext = eglCreateContext(mDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+	if (mContext == EGL_NO_CONTEXT)
+		return false;
+
+	return eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, mContext) == EGL_TRUE;
+}
+
+//-----------------------------------------------------------------------------
+// A GLX build of GLEW loads the GL entry points, then fails without an X
+// display.  The entry points still reach the EGL context through GLVND.
+//-----------------------------------------------------------------------------
+bool EglContext::loadFunctions()
+{
+	glewExperimental = GL_TRUE;
+	GLenum result = glewInit();
+	if (result != GLEW_OK && result != GLEW_ERROR_NO_GLX_DISPLAY)
+	{
+		std::cerr << "Failed to initialize GLEW: " << glewGetErrorString(result) << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// The framebuffer standing for the window, same formats as GLFW's
+//-----------------------------------------------------------------------------
+bool EglContext::createFramebuffer()
+{
+	glGenRenderbuffers(2, mRenderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, mRenderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, mWidth, mHeight);
+	MemoryTracker::setRenderbuffer(MemoryTracker::FRAME_TARGETS, mRenderbuffers[0], MemoryTracker::getTextureBytes(GL_RGBA8, mWidth, mHeight, 1, 1));
+	glBindRenderbuffer(GL_RENDERBUFFER, mRenderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, mWidth, mHeight);
+	MemoryTracker::setRenderbuffer(MemoryTracker::FRAME_TARGETS, mRenderbuffers[1], MemoryTracker::getTextureBytes(GL_DEPTH24_STENCIL8, mWidth, mHeight, 1, 1));
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &mFBO);
+	glBindFramebuffer(GL_FRAMEBUFFER, mFBO);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mRenderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, mRenderbuffers[1]);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Offscreen framebuffer incomplete" << std::endl;
+		return false;
+	}
+
+	gDefaultFramebuffer = mFBO;
+	return true;
+}
+#endif //GL_CONTEXT_EGL
+
+#ifdef GL_CONTEXT_OSMESA
+//-----------------------------------------------------------------------------
+// OSMesa, rendering with the CPU into mBuffer
+//-----------------------------------------------------------------------------
+class OSMesaContextBackend : public GLContext
+{
+public:
+
+	OSMesaContextBackend() : GLContext(OSMESA_OFFSCREEN), mContext(NULL) {}
+	~OSMesaContextBackend();
+
+	// Rendering is synchronous, finishing makes the frame whole in mBuffer
+	void swapBuffers()  { glFinish(); }
+
+protected:
+
+	bool createContext(int major, int minor, const char* title, bool visible);
+
+private:
+
+	OSMesaContext mContext;
+	std::vector<unsigned char> mBuffer;
+};
+
+OSMesaContextBackend::~OSMesaContextBackend()
+{
+	if (mContext != NULL)
+		OSMesaDestroyContext(mContext);
+}
+
+bool OSMesaContextBackend::createContext(int major, int minor, const char* title, bool visible)
+{
+	const int attributes[] =
+	{
+		OSMESA_FORMAT, OSMESA_RGBA,
+		OSMESA_DEPTH_BITS, 24,
+		OSMESA_STENCIL_BITS, 8,
+		OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+		OSMESA_CONTEXT_MAJOR_VERSION, major,
+		OSMESA_CONTEXT_MINOR_VERSION, minor,
+		0
+	};
+	mContext = OSMesaCreateContextAttribs(attributes, NULL);
+	if (mContext == NULL)
+		return false;
+
+	mBuffer.resize((size_t)mWidth * mHeight * 4);
+	return OSMesaMakeCurrent(mContext, &mBuffer[0], GL_UNSIGNED_BYTE, mWidth, mHeight) == GL_TRUE;
+}
+#endif //GL_CONTEXT_OSMESA
+
+//-----------------------------------------------------------------------------
+// Backends by name
+//-----------------------------------------------------------------------------
+const char* GLContext::getBackendName(Backend backend)
+{
+	return BACKEND_NAMES[backend];
+}
+
+bool GLContext::findBackend(const std::string& name, Backend& backend)
+{
+	for (int b = 0; b < NUM_BACKENDS; b++)
+	{
+		if (name == BACKEND_NAMES[b])
+		{
+			backend = (Backend)b;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool GLContext::isCompiledIn(Backend backend)
+{
+	switch (backend)
+	{
+	case GLFW_WINDOW:
+		return true;
+#ifdef GL_CONTEXT_EGL
+	case EGL_SURFACELESS:
+		return true;
+#endif
+#ifdef GL_CONTEXT_OSMESA
+	case OSMESA_OFFSCREEN:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Context of a backend, to init()
+//-----------------------------------------------------------------------------
+GLContext* GLContext::create(Backend backend)
+{
+	switch (backend)
+	{
+	case GLFW_WINDOW:
+		return new GlfwContext();
+#ifdef GL_CONTEXT_EGL
+	case EGL_SURFACELESS:
+		return new EglContext();
+#endif
+#ifdef GL_CONTEXT_OSMESA
+	case OSMESA_OFFSCREEN:
+		return new OSMesaContextBackend();
+#endif
+	default:
+		return NULL;
+	}
+}
+
+GLuint GLContext::getDefaultFramebuffer()
+{
+	return gDefaultFramebuffer;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+GLContext::GLContext(Backend backend)
+	: mBackend(backend),
+	  mWidth(0), mHeight(0),
+	  mStartNs(Profiler::now()),
+	  mCloseRequested(false)
+{
+}
+
+GLContext::~GLContext()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Creates the context, newest version first, and loads GL
+//-----------------------------------------------------------------------------
+bool GLContext::init(int width, int height, const char* title, bool visible)
+{
+	mWidth = width;
+	mHeight = height;
+	if (!open())
+		return false;
+
+	bool created = false;
+	for (int i = 0; i < NUM_GL_VERSIONS && !created; i++)
+		created = createContext(GL_VERSIONS[i][0], GL_VERSIONS[i][1], title, visible);
+	if (!created)
+	{
+		std::cerr << "Failed to create an OpenGL 3.3 context with " << BACKEND_NAMES[mBackend] << std::endl;
+		return false;
+	}
+
+	if (!loadFunctions() || !createFramebuffer())
+		return false;
+
+	mStartNs = Profiler::now();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Initialize GLEW
+//-----------------------------------------------------------------------------
+bool GLContext::loadFunctions()
+{
+	glewExperimental = GL_TRUE;
+	if (glewInit() != GLEW_OK)
+	{
+		std::cerr << "Failed to initialize GLEW" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Size given to init(), a headless context is never resized
+//-----------------------------------------------------------------------------
+void GLContext::getFramebufferSize(int& width, int& height) const
+{
+	width = mWidth;
+	height = mHeight;
+}
+
+double GLContext::getTime() const
+{
+	return (double)(Profiler::now() - mStartNs) * 1e-9;
+}
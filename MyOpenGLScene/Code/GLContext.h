@@ -0,0 +1,99 @@
+//-----------------------------------------------------------------------------
+// OpenGL context - the window, or what stands for it, the scene renders to
+//
+// Three backends, all giving a 4.3 core context or else a 3.3 one, current on
+// the calling thread with GLEW loaded:
+//
+//   GLFW_WINDOW        a GLFW window, hidden for the benchmark.  The only one
+//                      with input.
+//   EGL_SURFACELESS    no window and no display: the Mesa surfaceless
+//                      platform (llvmpipe on machines without a GPU) or else
+//                      the first EGL device.  There is no default
+//                      framebuffer, the context renders to an offscreen one.
+//   OSMESA_OFFSCREEN   Mesa's software renderer into a buffer in memory.
+//
+// The headless backends are compiled in with GL_CONTEXT_EGL and
+// GL_CONTEXT_OSMESA.  Their clock is the steady clock and they close when
+// asked to with requestClose().
+//
+// Code that would bind framebuffer 0 binds getDefaultFramebuffer().
+//-----------------------------------------------------------------------------
+#ifndef GL_CONTEXT_H
+#define GL_CONTEXT_H
+
+#include <string>
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+struct GLFWwindow;
+
+
+class GLContext
+{
+public:
+
+	enum Backend
+	{
+		GLFW_WINDOW,
+		EGL_SURFACELESS,
+		OSMESA_OFFSCREEN,
+		NUM_BACKENDS
+	};
+
+	// Names on the command line: glfw, egl, osmesa
+	static const char* getBackendName(Backend backend);
+	static bool findBackend(const std::string& name, Backend& backend);
+	static bool isCompiledIn(Backend backend);
+
+	// NULL if the backend is not compiled in
+	static GLContext* create(Backend backend);
+
+	// Framebuffer standing for the window of the current context
+	static GLuint getDefaultFramebuffer();
+
+	virtual ~GLContext();
+
+	bool init(int width, int height, const char* title, bool visible);
+
+	Backend getBackend() const  { return mBackend; }
+
+	// NULL without a window, then there is no input
+	virtual GLFWwindow* getWindow() const  { return NULL; }
+
+	virtual void swapBuffers() = 0;
+	virtual void pollEvents() {}
+	virtual void setSwapInterval(int interval) {}
+	virtual void setTitle(const std::string& title) {}
+	virtual void getFramebufferSize(int& width, int& height) const;
+
+	// Seconds since init()
+	virtual double getTime() const;
+
+	void requestClose()         { mCloseRequested = true; }
+	virtual bool shouldClose() const  { return mCloseRequested; }
+
+protected:
+
+	explicit GLContext(Backend backend);
+
+	// Library or display, before the first context
+	virtual bool open()  { return true; }
+
+	// Context of that version, current, false if the driver has none
+	virtual bool createContext(int major, int minor, const char* title, bool visible) = 0;
+
+	// GL entry points and the offscreen framebuffer, context current
+	virtual bool loadFunctions();
+	virtual bool createFramebuffer()  { return true; }
+
+	Backend mBackend;
+	int mWidth, mHeight;
+	long long mStartNs;
+	bool mCloseRequested;
+
+private:
+
+	GLContext(const GLContext&);
+	GLContext& operator=(const GLContext&);
+};
+#endif //GL_CONTEXT_H
@@ -0,0 +1,172 @@
+//-----------------------------------------------------------------------------
+// GL call statistics - draw calls, binds, state changes, uniforms and upload
+// traffic per frame
+//-----------------------------------------------------------------------------
+#include "GLStats.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+
+static const char* COUNTER_NAMES[GLStats::NUM_COUNTERS] =
+{
+	"draw_calls", "instances", "dispatches", "binds", "state_changes",
+	"uniforms", "buffer_uploads", "buffer_bytes", "texture_uploads", "texture_bytes"
+};
+
+//-----------------------------------------------------------------------------
+// Name of a counter, as written in the reports
+//-----------------------------------------------------------------------------
+const char* GLStats::getCounterName(Counter counter)
+{
+	return COUNTER_NAMES[counter];
+}
+
+#ifdef GL_STATS
+
+struct StatsScope
+{
+	const char* name;
+	GLStats::Counters counters;
+};
+
+struct StatsFrame
+{
+	GLStats::Counters counters;
+	std::vector<StatsScope> scopes;		// in the order they were opened
+};
+
+static StatsFrame gCurrent = {};
+static StatsFrame gLast = {};
+static int gScopeStack[GLStats::MAX_SCOPE_DEPTH];
+static int gStackDepth = 0;
+static int gStackOverflow = 0;		// scopes nested past MAX_SCOPE_DEPTH
+
+//-----------------------------------------------------------------------------
+// Counts to the frame and to every open scope
+//-----------------------------------------------------------------------------
+void GLStats::add(Counter counter, unsigned long long count)
+{
+	gCurrent.counters.values[counter] += count;
+	for (int i = 0; i < gStackDepth; i++)
+		gCurrent.scopes[gScopeStack[i]].counters.values[counter] += count;
+}
+
+//-----------------------------------------------------------------------------
+// Opens a scope, a scope opened again in the same frame adds to its counts
+//-----------------------------------------------------------------------------
+void GLStats::pushScope(const char* name)
+{
+	if (gStackDepth >= MAX_SCOPE_DEPTH)
+	{
+		gStackOverflow++;
+		return;
+	}
+
+	int scope = 0;
+	while (scope < (int)gCurrent.scopes.size() && strcmp(gCurrent.scopes[scope].name, name) != 0)
+		scope++;
+
+	if (scope == (int)gCurrent.scopes.size())
+	{
+		StatsScope newScope = {};
+		newScope.name = name;
+		gCurrent.scopes.push_back(newScope);
+	}
+	gScopeStack[gStackDepth++] = scope;
+}
+
+//-----------------------------------------------------------------------------
+// Closes the innermost scope
+//-----------------------------------------------------------------------------
+void GLStats::popScope()
+{
+	if (gStackOverflow > 0)
+		gStackOverflow--;
+	else if (gStackDepth > 0)
+		gStackDepth--;
+}
+
+//-----------------------------------------------------------------------------
+// Keeps the frame for the queries and starts counting the next one
+//-----------------------------------------------------------------------------
+void GLStats::endFrame()
+{
+	std::swap(gLast, gCurrent);
+	memset(&gCurrent.counters, 0, sizeof(gCurrent.counters));
+	gCurrent.scopes.clear();
+	gStackDepth = 0;
+	gStackOverflow = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Counts of the last finished frame
+//-----------------------------------------------------------------------------
+const GLStats::Counters& GLStats::getFrame()
+{
+	return gLast.counters;
+}
+
+bool GLStats::getScope(const char* name, Counters& counters)
+{
+	for (size_t i = 0; i < gLast.scopes.size(); i++)
+	{
+		if (strcmp(gLast.scopes[i].name, name) == 0)
+		{
+			counters = gLast.scopes[i].counters;
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// The last finished frame as a table, one row for the frame and per scope
+//-----------------------------------------------------------------------------
+void GLStats::print(std::ostream& out)
+{
+	out << std::left << std::setw(20) << "GL stats";
+	for (int c = 0; c < NUM_COUNTERS; c++)
+		out << std::right << std::setw(16) << COUNTER_NAMES[c];
+	out << std::endl;
+
+	out << std::left << std::setw(20) << "Frame";
+	for (int c = 0; c < NUM_COUNTERS; c++)
+		out << std::right << std::setw(16) << gLast.counters.values[c];
+	out << std::endl;
+
+	for (size_t i = 0; i < gLast.scopes.size(); i++)
+	{
+		out << std::left << std::setw(20) << gLast.scopes[i].name;
+		for (int c = 0; c < NUM_COUNTERS; c++)
+			out << std::right << std::setw(16) << gLast.scopes[i].counters.values[c];
+		out << std::endl;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Bytes of a texture upload, without row padding
+//-----------------------------------------------------------------------------
+unsigned long long GLStats::getTextureBytes(GLenum format, GLenum type, GLsizei width, GLsizei height, GLsizei depth)
+{
+	unsigned long long components = 4;
+	switch (format)
+	{
+	case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT:	components = 1; break;
+	case GL_RG: case GL_RG_INTEGER:								components = 2; break;
+	case GL_RGB: case GL_BGR:									components = 3; break;
+	}
+
+	unsigned long long componentBytes = 4;
+	switch (type)
+	{
+	case GL_UNSIGNED_BYTE: case GL_BYTE:							componentBytes = 1; break;
+	case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT:		componentBytes = 2; break;
+	}
+
+	return components * componentBytes * (unsigned long long)width * (unsigned long long)height * (unsigned long long)depth;
+}
+
+#endif
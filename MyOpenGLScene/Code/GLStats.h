@@ -0,0 +1,326 @@
+//-----------------------------------------------------------------------------
+// GL call statistics - draw calls, binds, state changes, uniforms and upload
+// traffic per frame
+//
+// Included after GL/glew.h by the files that call GL, it replaces the entry
+// points below with wrappers that count the call (and the bytes of uploads)
+// before making it.  The counts go to the frame and to every open scope; the
+// profiler's GPU scopes open one each, so the passes and object families are
+// counted without marking them twice.  endFrame() keeps the finished frame
+// for getFrame(), getScope() and print().
+//
+// Compiled in debug builds, or anywhere with GL_STATS defined.  Without it
+// the GL names are left alone and the functions below do nothing, so release
+// builds call GL directly.  GL thread only.
+//-----------------------------------------------------------------------------
+#ifndef GL_STATS_H
+#define GL_STATS_H
+
+#include <iosfwd>
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+#if defined(_DEBUG) && !defined(GL_STATS)
+#define GL_STATS
+#endif
+
+
+class GLStats
+{
+public:
+
+	enum Counter
+	{
+		DRAW_CALLS,			// glDraw*, one per indirect draw
+		INSTANCES,			// instances of the instanced draws
+		DISPATCHES,			// compute
+		BINDS,				// buffers, textures, vertex arrays, framebuffers, programs
+		STATE_CHANGES,		// enable/disable, depth, color mask, viewport...
+		UNIFORMS,
+		BUFFER_UPLOADS,		// glBufferData/SubData/Storage with data
+		BUFFER_BYTES,		// also the bytes written to persistent mappings
+		TEXTURE_UPLOADS,
+		TEXTURE_BYTES,
+		NUM_COUNTERS
+	};
+
+	struct Counters
+	{
+		unsigned long long values[NUM_COUNTERS];
+	};
+
+	static const int MAX_SCOPE_DEPTH = 16;
+
+	static const char* getCounterName(Counter counter);
+
+#ifdef GL_STATS
+	static bool isEnabled() { return true; }
+
+	static void add(Counter counter, unsigned long long count = 1);
+	static void pushScope(const char* name);
+	static void popScope();
+
+	// Ends the frame being counted, it is the one reported until the next
+	static void endFrame();
+
+	static const Counters& getFrame();
+	static bool getScope(const char* name, Counters& counters);
+	static void print(std::ostream& out);
+
+	// Bytes of a texture upload, without row padding
+	static unsigned long long getTextureBytes(GLenum format, GLenum type, GLsizei width, GLsizei height, GLsizei depth);
+
+	// Counting wrappers of the GL entry points
+	static void drawArrays(GLenum mode, GLint first, GLsizei count)
+	{
+		add(DRAW_CALLS);
+		::glDrawArrays(mode, first, count);
+	}
+	static void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+	{
+		add(DRAW_CALLS);
+		add(INSTANCES, instances);
+		GLEW_GET_FUN(__glewDrawArraysInstanced)(mode, first, count, instances);
+	}
+	static void drawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+	{
+		add(DRAW_CALLS);
+		::glDrawElements(mode, count, type, indices);
+	}
+	static void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances)
+	{
+		add(DRAW_CALLS);
+		add(INSTANCES, instances);
+		GLEW_GET_FUN(__glewDrawElementsInstanced)(mode, count, type, indices, instances);
+	}
+	static void multiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride)
+	{
+		add(DRAW_CALLS);
+		GLEW_GET_FUN(__glewMultiDrawElementsIndirect)(mode, type, indirect, drawCount, stride);
+	}
+	static void dispatchCompute(GLuint x, GLuint y, GLuint z)
+	{
+		add(DISPATCHES);
+		GLEW_GET_FUN(__glewDispatchCompute)(x, y, z);
+	}
+
+	static void bindBuffer(GLenum target, GLuint buffer)
+	{
+		add(BINDS);
+		GLEW_GET_FUN(__glewBindBuffer)(target, buffer);
+	}
+	static void bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+	{
+		add(BINDS);
+		GLEW_GET_FUN(__glewBindBufferBase)(target, index, buffer);
+	}
+	static void bindTexture(GLenum target, GLuint texture)
+	{
+		add(BINDS);
+		::glBindTexture(target, texture);
+	}
+	static void bindVertexArray(GLuint vertexArray)
+	{
+		add(BINDS);
+		GLEW_GET_FUN(__glewBindVertexArray)(vertexArray);
+	}
+	static void bindFramebuffer(GLenum target, GLuint framebuffer)
+	{
+		add(BINDS);
+		GLEW_GET_FUN(__glewBindFramebuffer)(target, framebuffer);
+	}
+	static void useProgram(GLuint program)
+	{
+		add(BINDS);
+		GLEW_GET_FUN(__glewUseProgram)(program);
+	}
+
+	static void activeTexture(GLenum unit)
+	{
+		add(STATE_CHANGES);
+		GLEW_GET_FUN(__glewActiveTexture)(unit);
+	}
+	static void enable(GLenum cap)
+	{
+		add(STATE_CHANGES);
+		::glEnable(cap);
+	}
+	static void disable(GLenum cap)
+	{
+		add(STATE_CHANGES);
+		::glDisable(cap);
+	}
+	static void depthFunc(GLenum func)
+	{
+		add(STATE_CHANGES);
+		::glDepthFunc(func);
+	}
+	static void depthMask(GLboolean flag)
+	{
+		add(STATE_CHANGES);
+		::glDepthMask(flag);
+	}
+	static void colorMask(GLboolean r, GLboolean g, GLboolean b, GLboolean a)
+	{
+		add(STATE_CHANGES);
+		::glColorMask(r, g, b, a);
+	}
+	static void polygonOffset(GLfloat factor, GLfloat units)
+	{
+		add(STATE_CHANGES);
+		::glPolygonOffset(factor, units);
+	}
+	static void viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+	{
+		add(STATE_CHANGES);
+		::glViewport(x, y, width, height);
+	}
+
+	static void uniform1i(GLint location, GLint v0)
+	{
+		add(UNIFORMS);
+		GLEW_GET_FUN(__glewUniform1i)(location, v0);
+	}
+	static void uniform1f(GLint location, GLfloat v0)
+	{
+		add(UNIFORMS);
+		GLEW_GET_FUN(__glewUniform1f)(location, v0);
+	}
+	static void uniform2f(GLint location, GLfloat v0, GLfloat v1)
+	{
+		add(UNIFORMS);
+		GLEW_GET_FUN(__glewUniform2f)(location, v0, v1);
+	}
+	static void uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+	{
+		add(UNIFORMS);
+		GLEW_GET_FUN(__glewUniform3f)(location, v0, v1, v2);
+	}
+	static void uniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+	{
+		add(UNIFORMS);
+		GLEW_GET_FUN(__glewUniform4f)(location, v0, v1, v2, v3);
+	}
+	static void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+	{
+		add(UNIFORMS);
+		GLEW_GET_FUN(__glewUniformMatrix4fv)(location, count, transpose, value);
+	}
+
+	static void bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+	{
+		if (data != NULL)
+		{
+			add(BUFFER_UPLOADS);
+			add(BUFFER_BYTES, (unsigned long long)size);
+		}
+		GLEW_GET_FUN(__glewBufferData)(target, size, data, usage);
+	}
+	static void bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+	{
+		add(BUFFER_UPLOADS);
+		add(BUFFER_BYTES, (unsigned long long)size);
+		GLEW_GET_FUN(__glewBufferSubData)(target, offset, size, data);
+	}
+	static void bufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags)
+	{
+		if (data != NULL)
+		{
+			add(BUFFER_UPLOADS);
+			add(BUFFER_BYTES, (unsigned long long)size);
+		}
+		GLEW_GET_FUN(__glewBufferStorage)(target, size, data, flags);
+	}
+
+	static void texImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+	{
+		if (pixels != NULL)
+		{
+			add(TEXTURE_UPLOADS);
+			add(TEXTURE_BYTES, getTextureBytes(format, type, width, height, 1));
+		}
+		::glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+	}
+	static void texImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels)
+	{
+		if (pixels != NULL)
+		{
+			add(TEXTURE_UPLOADS);
+			add(TEXTURE_BYTES, getTextureBytes(format, type, width, height, depth));
+		}
+		GLEW_GET_FUN(__glewTexImage3D)(target, level, internalFormat, width, height, depth, border, format, type, pixels);
+	}
+#else
+	static bool isEnabled() { return false; }
+
+	static void add(Counter counter, unsigned long long count = 1) {}
+	static void pushScope(const char* name) {}
+	static void popScope() {}
+	static void endFrame() {}
+
+	static const Counters& getFrame()
+	{
+		static const Counters none = {};
+		return none;
+	}
+	static bool getScope(const char* name, Counters& counters) { return false; }
+	static void print(std::ostream& out) {}
+#endif
+};
+
+#ifdef GL_STATS
+#undef glDrawArraysInstanced
+#undef glDrawElementsInstanced
+#undef glMultiDrawElementsIndirect
+#undef glDispatchCompute
+#undef glBindBuffer
+#undef glBindBufferBase
+#undef glBindVertexArray
+#undef glBindFramebuffer
+#undef glUseProgram
+#undef glActiveTexture
+#undef glUniform1i
+#undef glUniform1f
+#undef glUniform2f
+#undef glUniform3f
+#undef glUniform4f
+#undef glUniformMatrix4fv
+#undef glBufferData
+#undef glBufferSubData
+#undef glBufferStorage
+#undef glTexImage3D
+
+#define glDrawArrays				GLStats::drawArrays
+#define glDrawArraysInstanced		GLStats::drawArraysInstanced
+#define glDrawElements				GLStats::drawElements
+#define glDrawElementsInstanced		GLStats::drawElementsInstanced
+#define glMultiDrawElementsIndirect	GLStats::multiDrawElementsIndirect
+#define glDispatchCompute			GLStats::dispatchCompute
+#define glBindBuffer				GLStats::bindBuffer
+#define glBindBufferBase			GLStats::bindBufferBase
+#define glBindTexture				GLStats::bindTexture
+#define glBindVertexArray			GLStats::bindVertexArray
+#define glBindFramebuffer			GLStats::bindFramebuffer
+#define glUseProgram				GLStats::useProgram
+#define glActiveTexture				GLStats::activeTexture
+#define glEnable					GLStats::enable
+#define glDisable					GLStats::disable
+#define glDepthFunc					GLStats::depthFunc
+#define glDepthMask					GLStats::depthMask
+#define glColorMask					GLStats::colorMask
+#define glPolygonOffset				GLStats::polygonOffset
+#define glViewport					GLStats::viewport
+#define glUniform1i					GLStats::uniform1i
+#define glUniform1f					GLStats::uniform1f
+#define glUniform2f					GLStats::uniform2f
+#define glUniform3f					GLStats::uniform3f
+#define glUniform4f					GLStats::uniform4f
+#define glUniformMatrix4fv			GLStats::uniformMatrix4fv
+#define glBufferData				GLStats::bufferData
+#define glBufferSubData				GLStats::bufferSubData
+#define glBufferStorage				GLStats::bufferStorage
+#define glTexImage2D				GLStats::texImage2D
+#define glTexImage3D				GLStats::texImage3D
+#endif
+
+#endif //GL_STATS_H
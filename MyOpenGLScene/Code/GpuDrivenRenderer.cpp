@@ -0,0 +1,490 @@
+//-----------------------------------------------------------------------------
+// GPU driven renderer (OpenGL 4.3+)
+//-----------------------------------------------------------------------------
+#include "GpuDrivenRenderer.h"
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <unordered_map>
+#include "GLContext.h"
+#include "GLStats.h"
+#include "MemoryTracker.h"
+
+// Every texture is resampled to this size in the texture array
+const int TEXTURE_ARRAY_SIZE = 512;
+const int CULL_GROUP_SIZE = 64;		// local_size_x in cull_instances.comp
+
+// Shader storage buffer binding points shared with the shaders
+const GLuint INSTANCE_BINDING = 0;
+const GLuint MODEL_BINDING = 1;
+const GLuint COMMAND_BINDING = 2;
+const GLuint VISIBLE_BINDING = 3;
+const GLuint MESH_LAYER_BINDING = 4;
+
+
+//-----------------------------------------------------------------------------
+// Hashing a Vertex by its bytes so identical vertices can be merged
+//-----------------------------------------------------------------------------
+struct VertexHash
+{
+	size_t operator()(const Vertex& v) const
+	{
+		// FNV-1a
+		const unsigned char* bytes = (const unsigned char*)&v;
+		size_t hash = 2166136261u;
+		for (size_t i = 0; i < sizeof(Vertex); i++)
+		{
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+};
+
+struct VertexEqual
+{
+	bool operator()(const Vertex& a, const Vertex& b) const
+	{
+		return memcmp(&a, &b, sizeof(Vertex)) == 0;
+	}
+};
+
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+GpuDrivenRenderer::GpuDrivenRenderer()
+	: mVAO(0), mVBO(0), mIBO(0),
+	  mInstanceBuffer(0), mModelBuffer(0), mMeshLayerBuffer(0),
+	  mCommandBuffer(0), mCommandTemplateBuffer(0), mVisibleBuffer(0),
+	  mTextureArray(0),
+	  mBuilt(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+GpuDrivenRenderer::~GpuDrivenRenderer()
+{
+	if (!mBuilt)
+		return;
+
+	GLuint buffers[] = { mVBO, mIBO, mInstanceBuffer, mModelBuffer, mMeshLayerBuffer,
+	                     mCommandBuffer, mCommandTemplateBuffer, mVisibleBuffer };
+	MemoryTracker::releaseBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
+	MemoryTracker::releaseTextures(1, &mTextureArray);
+	glDeleteBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
+	glDeleteVertexArrays(1, &mVAO);
+	glDeleteTextures(1, &mTextureArray);
+}
+
+//-----------------------------------------------------------------------------
+// Needs compute shaders, shader storage buffers and multi draw indirect
+//-----------------------------------------------------------------------------
+bool GpuDrivenRenderer::isSupported()
+{
+	return GLEW_VERSION_4_3 != 0;
+}
+
+//-----------------------------------------------------------------------------
+// Appends a mesh to the shared vertex/index buffers.  OBJ meshes are not
+// indexed so duplicate vertices are merged here.
+//-----------------------------------------------------------------------------
+int GpuDrivenRenderer::addMesh(const Mesh& mesh, const Texture2D& texture)
+{
+	const std::vector<Vertex>& vertices = mesh.getVertices();
+
+	MeshRange range;
+	range.firstIndex = (GLuint)mIndices.size();
+	range.indexCount = (GLuint)vertices.size();
+	range.baseVertex = (GLint)mVertices.size();
+	range.boundsMin = mesh.getBoundsMin();
+	range.boundsMax = mesh.getBoundsMax();
+
+	std::unordered_map<Vertex, GLuint, VertexHash, VertexEqual> unique;
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		std::unordered_map<Vertex, GLuint, VertexHash, VertexEqual>::iterator it = unique.find(vertices[i]);
+		if (it == unique.end())
+		{
+			GLuint index = (GLuint)(mVertices.size() - range.baseVertex);
+			unique[vertices[i]] = index;
+			mVertices.push_back(vertices[i]);
+			mIndices.push_back(index);
+		}
+		else
+		{
+			mIndices.push_back(it->second);
+		}
+	}
+
+	// One texture array layer per distinct texture
+	range.textureLayer = (GLuint)mTextures.size();
+	for (size_t i = 0; i < mTextures.size(); i++)
+	{
+		if (mTextures[i] == &texture)
+		{
+			range.textureLayer = (GLuint)i;
+			break;
+		}
+	}
+	if (range.textureLayer == mTextures.size())
+		mTextures.push_back(&texture);
+
+	mMeshes.push_back(range);
+	return (int)mMeshes.size() - 1;
+}
+
+//-----------------------------------------------------------------------------
+// Groups LOD meshes.  lodDistances[i] is the distance up to which
+// lodMeshes[i] is used.
+//-----------------------------------------------------------------------------
+int GpuDrivenRenderer::addModel(const int* lodMeshes, const float* lodDistances, int numLods, const glm::vec3& specular, float shininess)
+{
+	GpuModel model = GpuModel();
+
+	model.numLods = (GLuint)glm::clamp(numLods, 1, MAX_LODS);
+	for (GLuint i = 0; i < model.numLods; i++)
+	{
+		model.lodMeshes[i] = (GLuint)lodMeshes[i];
+		model.lodDistances[i] = lodDistances[i];
+	}
+	model.material = glm::vec4(specular, shininess);
+
+	mModels.push_back(model);
+	return (int)mModels.size() - 1;
+}
+
+//-----------------------------------------------------------------------------
+// Adds an instance of a model.  The bounding sphere is computed from the
+// first LOD's bounds.
+//-----------------------------------------------------------------------------
+void GpuDrivenRenderer::addInstance(int modelId, const glm::mat4& model)
+{
+	const MeshRange& mesh = mMeshes[mModels[modelId].lodMeshes[0]];
+
+	glm::vec3 center = 0.5f * (mesh.boundsMin + mesh.boundsMax);
+	float radius = 0.5f * glm::length(mesh.boundsMax - mesh.boundsMin);
+	float maxScale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+
+	GpuInstance instance;
+	instance.pad[0] = instance.pad[1] = instance.pad[2] = 0;
+	instance.model = model;
+	instance.sphere = glm::vec4(glm::vec3(model * glm::vec4(center, 1.0f)), radius * maxScale);
+	instance.modelId = (GLuint)modelId;
+
+	mInstances.push_back(instance);
+}
+
+//-----------------------------------------------------------------------------
+// Creates all GPU buffers and loads the shaders
+//-----------------------------------------------------------------------------
+bool GpuDrivenRenderer::build()
+{
+	if (!isSupported())
+	{
+		std::cerr << "GPU driven rendering requires OpenGL 4.3" << std::endl;
+		return false;
+	}
+
+	if (mMeshes.empty() || mInstances.empty())
+		return false;
+
+	if (!mCullShader.loadComputeShader("shaders/cull_instances.comp"))
+		return false;
+	if (!mDrawShader.loadShaders("shaders/gpu_driven.vert", "shaders/gpu_driven.frag"))
+		return false;
+	if (!mGBufferShader.loadShaders("shaders/gpu_driven.vert", "shaders/gpu_driven_gbuffer.frag"))
+		return false;
+	if (!mDepthShader.loadShaders("shaders/gpu_driven.vert", "shaders/depth_only.frag"))
+		return false;
+
+	// Each mesh gets a range of the visible instance buffer big enough for every
+	// instance that could pick it.  The range start becomes the command's
+	// baseInstance so the per-instance attribute reads the right entries.
+	std::vector<GLuint> capacity(mMeshes.size(), 0);
+	for (size_t i = 0; i < mInstances.size(); i++)
+	{
+		const GpuModel& model = mModels[mInstances[i].modelId];
+		for (GLuint lod = 0; lod < model.numLods; lod++)
+			capacity[model.lodMeshes[lod]]++;
+	}
+
+	GLuint totalCapacity = 0;
+	mCommandTemplate.resize(mMeshes.size());
+	for (size_t i = 0; i < mMeshes.size(); i++)
+	{
+		mCommandTemplate[i].count = mMeshes[i].indexCount;
+		mCommandTemplate[i].instanceCount = 0;
+		mCommandTemplate[i].firstIndex = mMeshes[i].firstIndex;
+		mCommandTemplate[i].baseVertex = mMeshes[i].baseVertex;
+		mCommandTemplate[i].baseInstance = totalCapacity;
+		totalCapacity += capacity[i];
+	}
+
+	std::vector<GLuint> meshLayers(mMeshes.size());
+	for (size_t i = 0; i < mMeshes.size(); i++)
+		meshLayers[i] = mMeshes[i].textureLayer;
+
+	// Storage buffers
+	GLuint buffers[6];
+	glGenBuffers(6, buffers);
+	mInstanceBuffer = buffers[0];
+	mModelBuffer = buffers[1];
+	mMeshLayerBuffer = buffers[2];
+	mCommandBuffer = buffers[3];
+	mCommandTemplateBuffer = buffers[4];
+	mVisibleBuffer = buffers[5];
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mInstanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, mInstances.size() * sizeof(GpuInstance), &mInstances[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mModelBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, mModels.size() * sizeof(GpuModel), &mModels[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMeshLayerBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, meshLayers.size() * sizeof(GLuint), &meshLayers[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCommandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, mCommandTemplate.size() * sizeof(DrawElementsIndirectCommand), &mCommandTemplate[0], GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCommandTemplateBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, mCommandTemplate.size() * sizeof(DrawElementsIndirectCommand), &mCommandTemplate[0], GL_STATIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mVisibleBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, totalCapacity * 2 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	MemoryTracker::setBuffer(MemoryTracker::GPU_DRIVEN, mInstanceBuffer, mInstances.size() * sizeof(GpuInstance));
+	MemoryTracker::setBuffer(MemoryTracker::GPU_DRIVEN, mModelBuffer, mModels.size() * sizeof(GpuModel));
+	MemoryTracker::setBuffer(MemoryTracker::GPU_DRIVEN, mMeshLayerBuffer, meshLayers.size() * sizeof(GLuint));
+	MemoryTracker::setBuffer(MemoryTracker::GPU_DRIVEN, mCommandBuffer, mCommandTemplate.size() * sizeof(DrawElementsIndirectCommand));
+	MemoryTracker::setBuffer(MemoryTracker::GPU_DRIVEN, mCommandTemplateBuffer, mCommandTemplate.size() * sizeof(DrawElementsIndirectCommand));
+	MemoryTracker::setBuffer(MemoryTracker::GPU_DRIVEN, mVisibleBuffer, totalCapacity * 2 * sizeof(GLuint));
+
+	// Mega vertex/index buffer with the same layout as Mesh plus the visible
+	// instance entry (instance index, texture layer) as a per-instance attribute
+	glGenVertexArrays(1, &mVAO);
+	glGenBuffers(1, &mVBO);
+	glGenBuffers(1, &mIBO);
+
+	glBindVertexArray(mVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(Vertex), &mVertices[0], GL_STATIC_DRAW);
+	MemoryTracker::setBuffer(MemoryTracker::GPU_DRIVEN, mVBO, mVertices.size() * sizeof(Vertex));
+
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(3 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(6 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(2);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mVisibleBuffer);
+	glVertexAttribIPointer(3, 2, GL_UNSIGNED_INT, 2 * sizeof(GLuint), (GLvoid*)0);
+	glVertexAttribDivisor(3, 1);
+	glEnableVertexAttribArray(3);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * sizeof(GLuint), &mIndices[0], GL_STATIC_DRAW);
+	MemoryTracker::setBuffer(MemoryTracker::GPU_DRIVEN, mIBO, mIndices.size() * sizeof(GLuint));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	buildTextureArray();
+
+	// The geometry lives on the GPU from now on
+	std::vector<Vertex>().swap(mVertices);
+	std::vector<GLuint>().swap(mIndices);
+
+	return (mBuilt = true);
+}
+
+//-----------------------------------------------------------------------------
+// Copies every texture into a layer of a single texture array so the whole
+// scene can be drawn without rebinding textures
+//-----------------------------------------------------------------------------
+void GpuDrivenRenderer::buildTextureArray()
+{
+	GLsizei layers = (GLsizei)mTextures.size();
+	GLsizei levels = 1 + (GLsizei)std::floor(std::log2((float)TEXTURE_ARRAY_SIZE));
+
+	glGenTextures(1, &mTextureArray);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mTextureArray);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, TEXTURE_ARRAY_SIZE, TEXTURE_ARRAY_SIZE, layers);
+	MemoryTracker::setTexture(MemoryTracker::GPU_DRIVEN, mTextureArray, MemoryTracker::getTextureBytes(GL_RGBA8, TEXTURE_ARRAY_SIZE, TEXTURE_ARRAY_SIZE, layers, levels));
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	GLuint fbos[2];
+	glGenFramebuffers(2, fbos);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbos[0]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbos[1]);
+
+	for (GLsizei layer = 0; layer < layers; layer++)
+	{
+		const Texture2D* texture = mTextures[layer];
+		glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mTextureArray, 0, layer);
+
+		// Textures that failed to load end up white
+		if (texture->getHandle() == 0 || texture->getWidth() == 0)
+		{
+			const GLfloat white[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			glClearBufferfv(GL_COLOR, 0, white);
+			continue;
+		}
+
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->getHandle(), 0);
+		glBlitFramebuffer(0, 0, texture->getWidth(), texture->getHeight(),
+		                  0, 0, TEXTURE_ARRAY_SIZE, TEXTURE_ARRAY_SIZE,
+		                  GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, GLContext::getDefaultFramebuffer());
+	glDeleteFramebuffers(2, fbos);
+
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Resets the draw commands and runs the culling compute shader
+//-----------------------------------------------------------------------------
+void GpuDrivenRenderer::cull(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos)
+{
+	if (!mBuilt)
+		return;
+
+	Frustum frustum;
+	frustum.update(projection * view);
+
+	// Instance counts back to 0 without a CPU round trip
+	glBindBuffer(GL_COPY_READ_BUFFER, mCommandTemplateBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, mCommandBuffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, mCommandTemplate.size() * sizeof(DrawElementsIndirectCommand));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	mCullShader.use();
+	mCullShader.setUniform("viewPos", viewPos);
+	mCullShader.setUniform("instanceCount", (GLint)mInstances.size());
+	mCullShader.setUniform("frustumPlanes[0]", frustum.getPlane(0));
+	mCullShader.setUniform("frustumPlanes[1]", frustum.getPlane(1));
+	mCullShader.setUniform("frustumPlanes[2]", frustum.getPlane(2));
+	mCullShader.setUniform("frustumPlanes[3]", frustum.getPlane(3));
+	mCullShader.setUniform("frustumPlanes[4]", frustum.getPlane(4));
+	mCullShader.setUniform("frustumPlanes[5]", frustum.getPlane(5));
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, mInstanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MODEL_BINDING, mModelBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, mCommandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, mVisibleBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_LAYER_BINDING, mMeshLayerBuffer);
+
+	GLuint numGroups = ((GLuint)mInstances.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE;
+	glDispatchCompute(numGroups, 1, 1);
+
+	// Commands are read by the indirect draw, visible entries as vertex attributes
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+//-----------------------------------------------------------------------------
+// Draws every visible instance of every mesh with one call
+//-----------------------------------------------------------------------------
+void GpuDrivenRenderer::draw(const glm::mat4& view, const glm::mat4& projection, DrawPass pass)
+{
+	if (!mBuilt)
+		return;
+
+	ShaderProgram& shader = pass == GBUFFER_PASS ? mGBufferShader : (pass == DEPTH_PASS ? mDepthShader : mDrawShader);
+	shader.use();
+	shader.setUniform("view", view);
+	shader.setUniform("projection", projection);
+	shader.setUniformSampler("material.diffuseMap", 0);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mTextureArray);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, mInstanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MODEL_BINDING, mModelBuffer);
+
+	glBindVertexArray(mVAO);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (GLvoid*)0, (GLsizei)mCommandTemplate.size(), 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	glBindVertexArray(0);
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+//-----------------------------------------------------------------------------
+// CPU version of the compute shader test.  Returns the selected mesh or -1
+// if the instance is culled.
+//-----------------------------------------------------------------------------
+int GpuDrivenRenderer::selectMesh(const GpuInstance& instance, const Frustum& frustum, const glm::vec3& viewPos) const
+{
+	glm::vec3 center(instance.sphere);
+	float radius = instance.sphere.w;
+
+	if (!frustum.intersectsSphere(center, radius))
+		return -1;
+
+	const GpuModel& model = mModels[instance.modelId];
+	float distance = glm::max(glm::length(center - viewPos) - radius, 0.0f);
+
+	GLuint lod = 0;
+	while (lod < model.numLods && distance > model.lodDistances[lod])
+		lod++;
+
+	if (lod >= model.numLods)
+		return -1;
+
+	return (int)model.lodMeshes[lod];
+}
+
+//-----------------------------------------------------------------------------
+// Runs the culling pass, reads back the draw commands and compares the instance
+// counts with a CPU reference.  Instances sitting exactly on a plane can go
+// either way with float differences so a tiny mismatch is tolerated.
+//-----------------------------------------------------------------------------
+bool GpuDrivenRenderer::validate(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos)
+{
+	if (!mBuilt)
+		return false;
+
+	cull(view, projection, viewPos);
+
+	std::vector<DrawElementsIndirectCommand> commands(mCommandTemplate.size());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCommandBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), &commands[0]);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	Frustum frustum;
+	frustum.update(projection * view);
+
+	std::vector<GLuint> expected(mMeshes.size(), 0);
+	for (size_t i = 0; i < mInstances.size(); i++)
+	{
+		int mesh = selectMesh(mInstances[i], frustum, viewPos);
+		if (mesh >= 0)
+			expected[mesh]++;
+	}
+
+	GLuint gpuTotal = 0, cpuTotal = 0, mismatch = 0;
+	for (size_t i = 0; i < mMeshes.size(); i++)
+	{
+		gpuTotal += commands[i].instanceCount;
+		cpuTotal += expected[i];
+		mismatch += (GLuint)std::abs((int)commands[i].instanceCount - (int)expected[i]);
+
+		if (commands[i].baseInstance != mCommandTemplate[i].baseInstance || commands[i].count != mCommandTemplate[i].count)
+		{
+			std::cerr << "GPU driven validation: command " << i << " was corrupted" << std::endl;
+			return false;
+		}
+	}
+
+	bool ok = mismatch <= glm::max(1u, cpuTotal / 1000);
+	std::cout << "GPU driven validation: " << gpuTotal << " instances drawn on the GPU, "
+	          << cpuTotal << " expected by the CPU - " << (ok ? "OK" : "FAILED") << std::endl;
+
+	return ok;
+}
@@ -0,0 +1,128 @@
+//-----------------------------------------------------------------------------
+// GPU driven renderer (OpenGL 4.3+)
+//
+// All meshes share one big vertex and index buffer and all their textures are
+// copied into one texture array.  Instances live in a shader storage buffer.
+// Every frame a compute shader frustum/distance culls the instances, picks
+// their LOD and fills DrawElementsIndirectCommand records which are then
+// submitted with a single glMultiDrawElementsIndirect call.
+//-----------------------------------------------------------------------------
+#ifndef GPU_DRIVEN_RENDERER_H
+#define GPU_DRIVEN_RENDERER_H
+
+#include <vector>
+#define GLEW_STATIC
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "Mesh.h"
+#include "Texture2D.h"
+#include "ShaderProgram.h"
+#include "Frustum.h"
+
+
+class GpuDrivenRenderer
+{
+public:
+
+	static const int MAX_LODS = 4;
+
+	enum DrawPass
+	{
+		LIT_PASS,		// forward lighting
+		GBUFFER_PASS,	// into the bound G-buffer of the deferred path
+		DEPTH_PASS		// depth only, for the pre-pass
+	};
+
+	 GpuDrivenRenderer();
+	~GpuDrivenRenderer();
+
+	// True if the current context can run this path
+	static bool isSupported();
+
+	// Scene setup.  Meshes are LOD levels, models group up to MAX_LODS meshes
+	// with the distance each one is used up to (beyond the last one the
+	// instance is culled) and the specular material they are drawn with.
+	int addMesh(const Mesh& mesh, const Texture2D& texture);
+	int addModel(const int* lodMeshes, const float* lodDistances, int numLods, const glm::vec3& specular, float shininess);
+	void addInstance(int modelId, const glm::mat4& model);
+
+	// Uploads everything added so far and loads the shaders
+	bool build();
+
+	// Per frame
+	void cull(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos);
+	void draw(const glm::mat4& view, const glm::mat4& projection, DrawPass pass = LIT_PASS);
+
+	// Lighting uniforms are set by the caller on this program
+	ShaderProgram& getShader() { return mDrawShader; }
+
+	// Reads the GPU results back and compares them with the same culling done on
+	// the CPU.  Slow - meant for debugging and for checking software drivers.
+	bool validate(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos);
+
+	int getNumInstances() const { return (int)mInstances.size(); }
+
+private:
+	GpuDrivenRenderer(const GpuDrivenRenderer& rhs);
+	GpuDrivenRenderer& operator = (const GpuDrivenRenderer& rhs);
+
+	// std430 layouts - must match shaders/cull_instances.comp and gpu_driven.vert
+	struct GpuInstance
+	{
+		glm::mat4 model;
+		glm::vec4 sphere;	// world space bounding sphere (xyz center, w radius)
+		GLuint modelId;
+		GLuint pad[3];
+	};
+
+	struct GpuModel
+	{
+		GLuint lodMeshes[MAX_LODS];
+		float lodDistances[MAX_LODS];
+		GLuint numLods;
+		GLuint pad[3];
+		glm::vec4 material;	// specular rgb, shininess
+	};
+
+	struct DrawElementsIndirectCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint  baseVertex;
+		GLuint baseInstance;
+	};
+
+	struct MeshRange
+	{
+		GLuint firstIndex;
+		GLuint indexCount;
+		GLint baseVertex;
+		GLuint textureLayer;
+		glm::vec3 boundsMin, boundsMax;
+	};
+
+	void buildTextureArray();
+	int selectMesh(const GpuInstance& instance, const Frustum& frustum, const glm::vec3& viewPos) const;
+
+	std::vector<Vertex> mVertices;
+	std::vector<GLuint> mIndices;
+	std::vector<MeshRange> mMeshes;
+	std::vector<const Texture2D*> mTextures;
+	std::vector<GpuModel> mModels;
+	std::vector<GpuInstance> mInstances;
+	std::vector<DrawElementsIndirectCommand> mCommandTemplate;
+
+	GLuint mVAO, mVBO, mIBO;
+	GLuint mInstanceBuffer, mModelBuffer, mMeshLayerBuffer;
+	GLuint mCommandBuffer, mCommandTemplateBuffer, mVisibleBuffer;
+	GLuint mTextureArray;
+
+	ShaderProgram mCullShader;
+	ShaderProgram mDrawShader;
+	ShaderProgram mGBufferShader;
+	ShaderProgram mDepthShader;
+	bool mBuilt;
+};
+#endif //GPU_DRIVEN_RENDERER_H
@@ -0,0 +1,196 @@
+//-----------------------------------------------------------------------------
+// Ring buffer for the data streamed to the GPU every frame
+//-----------------------------------------------------------------------------
+#include "GpuRingBuffer.h"
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include "GLStats.h"
+#include "MemoryTracker.h"
+
+
+// Offsets are at least vec4 aligned (instance attributes)
+const GLsizeiptr MIN_ALIGNMENT = 16;
+
+// Fence waits are retried every millisecond
+const GLuint64 FENCE_TIMEOUT = 1000000;
+
+// The buffer is bound here while filling it: no vertex or index binding
+// of the caller is disturbed
+const GLenum WRITE_TARGET = GL_COPY_WRITE_BUFFER;
+
+const GLbitfield STORAGE_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+GpuRingBuffer::GpuRingBuffer()
+	: mBuffer(0),
+	  mFrameBytes(0),
+	  mAlignment(MIN_ALIGNMENT),
+	  mUseStorage(false),
+	  mFrame(0),
+	  mOffset(0),
+	  mMapped(NULL)
+{
+	for (int i = 0; i < NUM_FRAMES; i++)
+		mFences[i] = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+GpuRingBuffer::~GpuRingBuffer()
+{
+	release();
+}
+
+//-----------------------------------------------------------------------------
+// Persistent mapping when the driver has it, orphaning otherwise
+//-----------------------------------------------------------------------------
+bool GpuRingBuffer::init(GLsizeiptr frameBytes)
+{
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	mAlignment = std::max(MIN_ALIGNMENT, (GLsizeiptr)alignment);
+	if (GLEW_ARB_texture_buffer_range)
+	{
+		glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		mAlignment = std::max(mAlignment, (GLsizeiptr)alignment);
+	}
+
+	mUseStorage = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+	return allocate(frameBytes);
+}
+
+//-----------------------------------------------------------------------------
+// (Re)creates the buffer with frameBytes per region
+//-----------------------------------------------------------------------------
+bool GpuRingBuffer::allocate(GLsizeiptr frameBytes)
+{
+	release();
+
+	mFrameBytes = (std::max(frameBytes, mAlignment) + mAlignment - 1) / mAlignment * mAlignment;
+	mFrame = 0;
+	mOffset = 0;
+
+	glGenBuffers(1, &mBuffer);
+	glBindBuffer(WRITE_TARGET, mBuffer);
+
+	if (mUseStorage)
+	{
+		glBufferStorage(WRITE_TARGET, NUM_FRAMES * mFrameBytes, NULL, STORAGE_FLAGS);
+		MemoryTracker::setBuffer(MemoryTracker::STREAMING, mBuffer, NUM_FRAMES * mFrameBytes);
+		mMapped = (char*)glMapBufferRange(WRITE_TARGET, 0, NUM_FRAMES * mFrameBytes, STORAGE_FLAGS);
+		if (mMapped == NULL)
+		{
+			// Immutable storage can not be orphaned, start over with a new buffer
+			std::cerr << "Persistent buffer mapping failed, falling back to orphaning" << std::endl;
+			glBindBuffer(WRITE_TARGET, 0);
+			mUseStorage = false;
+			return allocate(frameBytes);
+		}
+	}
+	else
+	{
+		glBufferData(WRITE_TARGET, mFrameBytes, NULL, GL_STREAM_DRAW);
+		MemoryTracker::setBuffer(MemoryTracker::STREAMING, mBuffer, mFrameBytes);
+	}
+
+	glBindBuffer(WRITE_TARGET, 0);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Deletes the buffer and fences.  Draws already submitted keep their storage.
+//-----------------------------------------------------------------------------
+void GpuRingBuffer::release()
+{
+	for (int i = 0; i < NUM_FRAMES; i++)
+	{
+		if (mFences[i] != 0)
+			glDeleteSync(mFences[i]);
+		mFences[i] = 0;
+	}
+
+	if (mBuffer == 0)
+		return;
+
+	if (mMapped != NULL)
+	{
+		glBindBuffer(WRITE_TARGET, mBuffer);
+		glUnmapBuffer(WRITE_TARGET);
+		glBindBuffer(WRITE_TARGET, 0);
+		mMapped = NULL;
+	}
+	MemoryTracker::releaseBuffers(1, &mBuffer);
+	glDeleteBuffers(1, &mBuffer);
+	mBuffer = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Fences the region of the last frame and waits until the GPU is done with
+// the next one, or orphans the buffer
+//-----------------------------------------------------------------------------
+void GpuRingBuffer::beginFrame()
+{
+	mOffset = 0;
+
+	if (mMapped == NULL)
+	{
+		glBindBuffer(WRITE_TARGET, mBuffer);
+		glBufferData(WRITE_TARGET, mFrameBytes, NULL, GL_STREAM_DRAW);
+		glBindBuffer(WRITE_TARGET, 0);
+		return;
+	}
+
+	if (mFences[mFrame] != 0)
+		glDeleteSync(mFences[mFrame]);
+	mFences[mFrame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	mFrame = (mFrame + 1) % NUM_FRAMES;
+	GLsync fence = mFences[mFrame];
+	if (fence == 0)
+		return;
+
+	GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT);
+	while (result == GL_TIMEOUT_EXPIRED)
+		result = glClientWaitSync(fence, 0, FENCE_TIMEOUT);
+
+	glDeleteSync(fence);
+	mFences[mFrame] = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Appends to the region of this frame, growing the buffer if it is full
+//-----------------------------------------------------------------------------
+GLintptr GpuRingBuffer::write(const void* data, GLsizeiptr bytes)
+{
+	GLsizeiptr offset = (mOffset + mAlignment - 1) / mAlignment * mAlignment;
+	if (offset + bytes > mFrameBytes)
+	{
+		allocate(std::max(2 * mFrameBytes, bytes));
+		offset = 0;
+	}
+	mOffset = offset + bytes;
+
+	if (mMapped != NULL)
+	{
+		GLintptr start = mFrame * mFrameBytes + offset;
+		if (data != NULL && bytes > 0)
+		{
+			memcpy(mMapped + start, data, (size_t)bytes);
+			GLStats::add(GLStats::BUFFER_UPLOADS);
+			GLStats::add(GLStats::BUFFER_BYTES, (unsigned long long)bytes);
+		}
+		return start;
+	}
+
+	if (data != NULL && bytes > 0)
+	{
+		glBindBuffer(WRITE_TARGET, mBuffer);
+		glBufferSubData(WRITE_TARGET, offset, bytes, data);
+		glBindBuffer(WRITE_TARGET, 0);
+	}
+	return offset;
+}
@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// Ring buffer for the data streamed to the GPU every frame
+//
+// The buffer holds NUM_FRAMES regions, one per frame in flight.  With
+// ARB_buffer_storage (GL 4.4) it is mapped once, persistent and coherent:
+// write() is a memcpy, and beginFrame() fences the region the last frame
+// used before moving on to the next one, waiting only if the GPU is still
+// reading it from NUM_FRAMES frames ago.  Older GL orphans the buffer in
+// beginFrame() and writes with glBufferSubData: the driver hands out fresh
+// storage instead of waiting for the draws of the last frame.
+//
+// A write that does not fit re-creates the buffer larger, so getBuffer()
+// must be read after the write() it draws from.
+//-----------------------------------------------------------------------------
+#ifndef GPU_RING_BUFFER_H
+#define GPU_RING_BUFFER_H
+
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+
+class GpuRingBuffer
+{
+public:
+
+	// Frames the CPU may be ahead of the GPU
+	static const int NUM_FRAMES = 3;
+
+	 GpuRingBuffer();
+	~GpuRingBuffer();
+
+	// Room for frameBytes every frame, more is allocated when needed
+	bool init(GLsizeiptr frameBytes);
+
+	// Starts the region of a new frame, call once per frame before writing
+	void beginFrame();
+
+	// Copies bytes (data may be NULL to only reserve them) and returns their
+	// offset in getBuffer().  Offsets are aligned for vertex attributes,
+	// uniform blocks and texture buffer ranges.
+	GLintptr write(const void* data, GLsizeiptr bytes);
+
+	GLuint getBuffer() const { return mBuffer; }
+	bool isPersistent() const { return mMapped != NULL; }
+
+private:
+	GpuRingBuffer(const GpuRingBuffer& rhs);
+	GpuRingBuffer& operator = (const GpuRingBuffer& rhs);
+
+	bool allocate(GLsizeiptr frameBytes);
+	void release();
+
+	GLuint mBuffer;
+	GLsizeiptr mFrameBytes;
+	GLsizeiptr mAlignment;
+	bool mUseStorage;
+
+	int mFrame;				// region being written
+	GLsizeiptr mOffset;		// in the region
+	char* mMapped;			// persistent mapping, NULL when orphaning
+	GLsync mFences[NUM_FRAMES];
+};
+#endif //GPU_RING_BUFFER_H
@@ -0,0 +1,266 @@
+//-----------------------------------------------------------------------------
+// Procedural grass
+//-----------------------------------------------------------------------------
+#include "GrassRenderer.h"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include "Profiler.h"
+#include "GLStats.h"
+
+
+// The density reaches 0 over the last part of the draw distance
+const float FADE_OUT_PART = 0.2f;
+
+// Chunks per job chunk of the cull
+const unsigned int CHUNK_GRAIN = 16;
+
+//-----------------------------------------------------------------------------
+// Distance from a point to a box, 0 inside
+//-----------------------------------------------------------------------------
+static float distanceToBox(const glm::vec3& p, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	return glm::length(p - glm::clamp(p, boundsMin, boundsMax));
+}
+
+//-----------------------------------------------------------------------------
+// Lowest and highest ground under a patch
+//-----------------------------------------------------------------------------
+static glm::vec2 groundRange(const Heightfield& ground, const glm::vec4& patch, float patchSize)
+{
+	if (ground.isEmpty())
+		return glm::vec2(0.0f);
+
+	glm::vec2 cellMin = (glm::vec2(patch) - ground.getOrigin()) / ground.getCellSize();
+	glm::vec2 cellMax = cellMin + patchSize / ground.getCellSize();
+
+	glm::vec2 range;
+	ground.getRange((int)floorf(cellMin.x), (int)floorf(cellMin.y), (int)ceilf(cellMax.x), (int)ceilf(cellMax.y), range.x, range.y);
+	return range;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+GrassRenderer::GrassRenderer()
+	: mNumVisibleBlades(0),
+	  mVAO(0),
+	  mPatchOffset(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+GrassRenderer::~GrassRenderer()
+{
+	if (mVAO != 0)
+		glDeleteVertexArrays(1, &mVAO);
+}
+
+//-----------------------------------------------------------------------------
+// Roughly the same number of blades per pixel up to the lod distance, then
+// a fade out to the draw distance
+//-----------------------------------------------------------------------------
+float GrassRenderer::density(const SceneFile::GrassField& field, float distance)
+{
+	float falloff = distance > field.lodDistance ? (field.lodDistance * field.lodDistance) / (distance * distance) : 1.0f;
+	float fadeOut = glm::clamp((field.drawDistance - distance) / (FADE_OUT_PART * field.drawDistance), 0.0f, 1.0f);
+	return falloff * fadeOut;
+}
+
+//-----------------------------------------------------------------------------
+// Sorts the patches of every field in chunks
+//-----------------------------------------------------------------------------
+bool GrassRenderer::init(const SceneFile& scene, const Heightfield& ground)
+{
+	if (scene.getNumGrassFields() == 0)
+		return false;
+
+	if (!mShader.loadShaders("shaders/grass.vert", "shaders/grass.frag"))
+		return false;
+	if (!mGBufferShader.loadShaders("shaders/grass.vert", "shaders/grass_gbuffer.frag"))
+		return false;
+
+	const glm::vec4* patches = scene.getGrassPatches();
+	for (int f = 0; f < scene.getNumGrassFields(); f++)
+	{
+		const SceneFile::GrassField& field = scene.getGrassField(f);
+		mFields.push_back(field);
+		if (field.numPatches == 0)
+			continue;
+
+		// Chunk of every patch, from the corner of the field
+		glm::vec2 fieldMin(patches[field.firstPatch]);
+		for (GLuint i = field.firstPatch; i < field.firstPatch + field.numPatches; i++)
+			fieldMin = glm::min(fieldMin, glm::vec2(patches[i]));
+
+		float chunkSize = field.patchSize * CHUNK_PATCHES;
+		std::vector<std::pair<GLuint, GLuint> > keys(field.numPatches);
+		for (GLuint i = 0; i < field.numPatches; i++)
+		{
+			glm::vec2 cell = (glm::vec2(patches[field.firstPatch + i]) - fieldMin) / chunkSize + 0.5f / CHUNK_PATCHES;
+			keys[i] = std::make_pair(((GLuint)cell.y << 16) | (GLuint)cell.x, field.firstPatch + i);
+		}
+		std::sort(keys.begin(), keys.end());
+
+		GLuint firstPatch = (GLuint)mPatches.size();
+		for (size_t i = 0; i < keys.size(); i++)
+		{
+			const glm::vec4& patch = patches[keys[i].second];
+			glm::vec2 heights = groundRange(ground, patch, field.patchSize);
+			glm::vec3 patchMin(patch.x, field.height + heights.x, patch.y);
+			glm::vec3 patchMax(patch.x + field.patchSize, field.height + heights.y + field.maxBladeHeight, patch.y + field.patchSize);
+
+			if (i == 0 || keys[i].first != keys[i - 1].first)
+			{
+				Chunk chunk;
+				chunk.field = f;
+				chunk.boundsMin = patchMin;
+				chunk.boundsMax = patchMax;
+				chunk.firstPatch = firstPatch + (GLuint)i;
+				chunk.numPatches = 0;
+				mChunks.push_back(chunk);
+			}
+
+			Chunk& chunk = mChunks.back();
+			chunk.boundsMin = glm::min(chunk.boundsMin, patchMin);
+			chunk.boundsMax = glm::max(chunk.boundsMax, patchMax);
+			chunk.numPatches++;
+			mPatches.push_back(patch);
+			mPatchHeights.push_back(heights);
+		}
+	}
+
+	// Blades lean and bend in the wind, up to about their height
+	for (size_t c = 0; c < mChunks.size(); c++)
+	{
+		float bend = mFields[mChunks[c].field].maxBladeHeight;
+		mChunks[c].boundsMin -= glm::vec3(bend, 0.0f, bend);
+		mChunks[c].boundsMax += glm::vec3(bend, 0.0f, bend);
+	}
+
+	mDrawRanges.resize(mFields.size() * NUM_LEVELS * 2);
+
+	// One vec4 per instance, the blades come from gl_VertexID.  The ring
+	// starts with room for every patch.
+	glGenVertexArrays(1, &mVAO);
+	glBindVertexArray(mVAO);
+	glVertexAttribDivisor(0, 1);
+	glEnableVertexAttribArray(0);
+	glBindVertexArray(0);
+
+	mPatchRing.init(mPatches.size() * sizeof(glm::vec4));
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Keeps the patches of the visible chunks, each one in the smallest level
+// that still has the blades its nearest point needs.  Every thread fills its
+// own lists in the frame arena, they are appended one after the other
+// afterwards.
+//-----------------------------------------------------------------------------
+void GrassRenderer::cull(const Frustum& frustum, const glm::vec3& viewPos, JobSystem& jobs, FrameArena& arena)
+{
+	PROFILE_SCOPE("GrassRenderer::cull");
+
+	size_t numLists = mFields.size() * NUM_LEVELS;
+	unsigned int numThreads = jobs.getThreadCount();
+	FrameVector<FrameVector<glm::vec4> > threadPatches = makeThreadLists<glm::vec4>(arena, numLists);
+
+	jobs.parallelFor((unsigned int)mChunks.size(), CHUNK_GRAIN,
+		[&](unsigned int begin, unsigned int end, unsigned int threadIndex)
+		{
+			FrameVector<glm::vec4>* lists = &threadPatches[threadIndex * numLists];
+			for (unsigned int c = begin; c < end; c++)
+			{
+				const Chunk& chunk = mChunks[c];
+				const SceneFile::GrassField& field = mFields[chunk.field];
+				if (distanceToBox(viewPos, chunk.boundsMin, chunk.boundsMax) > field.drawDistance || !frustum.intersectsBox(chunk.boundsMin, chunk.boundsMax))
+					continue;
+
+				for (GLuint i = chunk.firstPatch; i < chunk.firstPatch + chunk.numPatches; i++)
+				{
+					const glm::vec4& patch = mPatches[i];
+					glm::vec3 patchMin(patch.x, field.height + mPatchHeights[i].x, patch.y);
+					glm::vec3 patchMax(patch.x + field.patchSize, field.height + mPatchHeights[i].y + field.maxBladeHeight, patch.y + field.patchSize);
+
+					float needed = field.bladesPerPatch * patch.w * density(field, distanceToBox(viewPos, patchMin, patchMax));
+					if (needed <= 0.0f)
+						continue;
+
+					int level = 0;
+					while (level + 1 < NUM_LEVELS && (float)(field.bladesPerPatch >> (level + 1)) >= needed)
+						level++;
+
+					lists[chunk.field * NUM_LEVELS + level].push_back(patch);
+				}
+			}
+		});
+
+	mDrawPatches.clear();
+	mNumVisibleBlades = 0;
+	for (size_t f = 0; f < mFields.size(); f++)
+	{
+		for (int level = 0; level < NUM_LEVELS; level++)
+		{
+			GLuint* range = &mDrawRanges[(f * NUM_LEVELS + level) * 2];
+			range[0] = (GLuint)mDrawPatches.size();
+			for (unsigned int t = 0; t < numThreads; t++)
+			{
+				const FrameVector<glm::vec4>& list = threadPatches[t * numLists + f * NUM_LEVELS + level];
+				mDrawPatches.insert(mDrawPatches.end(), list.begin(), list.end());
+			}
+			range[1] = (GLuint)mDrawPatches.size() - range[0];
+			mNumVisibleBlades += (int)range[1] * (int)std::max(mFields[f].bladesPerPatch >> level, 1u);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Streams the visible patches to this frame's region of the ring
+//-----------------------------------------------------------------------------
+void GrassRenderer::upload()
+{
+	mPatchRing.beginFrame();
+	mPatchOffset = mPatchRing.write(mDrawPatches.empty() ? NULL : &mDrawPatches[0], mDrawPatches.size() * sizeof(glm::vec4));
+}
+
+//-----------------------------------------------------------------------------
+// One instanced draw per field and level, one instance per patch
+//-----------------------------------------------------------------------------
+void GrassRenderer::draw(ShaderProgram& shader)
+{
+	if (mDrawPatches.empty())
+		return;
+
+	glBindVertexArray(mVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, mPatchRing.getBuffer());
+
+	for (size_t f = 0; f < mFields.size(); f++)
+	{
+		const SceneFile::GrassField& field = mFields[f];
+		shader.setUniform("patchSize", field.patchSize);
+		shader.setUniform("groundHeight", field.height);
+		shader.setUniform("bladesPerPatch", (GLint)field.bladesPerPatch);
+		shader.setUniform("bladeShape", glm::vec3(field.minBladeHeight, field.maxBladeHeight, field.bladeWidth));
+		shader.setUniform("densityDistances", glm::vec3(field.lodDistance, field.drawDistance, FADE_OUT_PART * field.drawDistance));
+		shader.setUniform("baseColor", field.baseColor);
+		shader.setUniform("tipColor", field.tipColor);
+
+		for (int level = 0; level < NUM_LEVELS; level++)
+		{
+			const GLuint* range = &mDrawRanges[(f * NUM_LEVELS + level) * 2];
+			if (range[1] == 0)
+				continue;
+
+			GLsizei blades = (GLsizei)std::max(field.bladesPerPatch >> level, 1u);
+			glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (GLvoid*)(mPatchOffset + range[0] * sizeof(glm::vec4)));
+			glDrawArraysInstanced(GL_TRIANGLES, 0, blades * VERTICES_PER_BLADE, (GLsizei)range[1]);
+		}
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
@@ -0,0 +1,102 @@
+//-----------------------------------------------------------------------------
+// Procedural grass
+//
+// The grass fields of the scene file are cut in square patches, each one a
+// single vec4 (corner x, z, seed, density).  No blade is stored: the vertex
+// shader derives the blade and vertex from gl_VertexID, places and shapes the
+// blade from a hash of the patch seed and bends it in the wind.
+//
+// On a terrain the blades are set on its height texture (see
+// Terrain::setHeightUniforms) and the patch bounds follow the ground.
+//
+// Patches are grouped in chunks that are frustum and distance culled on the
+// CPU, on every core.  The blade density falls off with the distance, so each visible patch
+// goes to one of NUM_LEVELS draws with 1, 1/2, 1/4 or 1/8 of the blades (one
+// instance per patch).  Within that count the shader fades the blades in and
+// out smoothly and widens the remaining ones to keep the coverage.
+//-----------------------------------------------------------------------------
+#ifndef GRASS_RENDERER_H
+#define GRASS_RENDERER_H
+
+#include <vector>
+#define GLEW_STATIC
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "SceneFile.h"
+#include "Heightfield.h"
+#include "ShaderProgram.h"
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "GpuRingBuffer.h"
+
+
+class GrassRenderer
+{
+public:
+
+	static const int NUM_LEVELS = 4;		// level n draws 1 / 2^n of the blades
+	static const int CHUNK_PATCHES = 8;		// patches per chunk side
+
+	// Must match grass.vert
+	static const int VERTICES_PER_BLADE = 15;
+
+	 GrassRenderer();
+	~GrassRenderer();
+
+	// Builds the chunks of every grass field of the scene and loads the shaders.
+	// The ground is the scene's heightfield, empty for flat ground at 0.
+	bool init(const SceneFile& scene, const Heightfield& ground);
+
+	// Culls the chunks and picks the level of the visible patches, in
+	// per-thread lists merged at the end - no GL call
+	void cull(const Frustum& frustum, const glm::vec3& viewPos, JobSystem& jobs, FrameArena& arena);
+
+	// Streams the patches kept by cull() to the GPU
+	void upload();
+
+	// Draws the patches sent by upload().  The caller sets view, projection,
+	// viewPos, time, wind, the terrain heights and the lighting on getShader() (or
+	// getGBufferShader()) first.
+	void draw(ShaderProgram& shader);
+
+	ShaderProgram& getShader()        { return mShader; }
+	ShaderProgram& getGBufferShader() { return mGBufferShader; }
+
+	int getNumFields() const        { return (int)mFields.size(); }
+	int getNumVisibleBlades() const { return mNumVisibleBlades; }
+
+	// Part of the blades kept at this distance - same as grassDensity in grass.vert
+	static float density(const SceneFile::GrassField& field, float distance);
+
+private:
+	GrassRenderer(const GrassRenderer& rhs);
+	GrassRenderer& operator = (const GrassRenderer& rhs);
+
+	struct Chunk
+	{
+		int field;
+		glm::vec3 boundsMin, boundsMax;
+		GLuint firstPatch, numPatches;
+	};
+
+	std::vector<SceneFile::GrassField> mFields;
+	std::vector<glm::vec4> mPatches;		// sorted by chunk
+	std::vector<glm::vec2> mPatchHeights;	// lowest and highest ground under each patch
+	std::vector<Chunk> mChunks;
+
+	// Visible patches of the frame merged by field then level, from per
+	// thread lists in the frame arena
+	std::vector<glm::vec4> mDrawPatches;
+	std::vector<GLuint> mDrawRanges;		// first, count per field and level
+	int mNumVisibleBlades;
+
+	GLuint mVAO;
+	GpuRingBuffer mPatchRing;
+	GLintptr mPatchOffset;		// of this frame's patches in the ring
+
+	ShaderProgram mShader;
+	ShaderProgram mGBufferShader;
+};
+#endif //GRASS_RENDERER_H
@@ -0,0 +1,193 @@
+//-----------------------------------------------------------------------------
+// Heightfield
+//-----------------------------------------------------------------------------
+#include "Heightfield.h"
+#include <iostream>
+#include <cmath>
+#include "MemoryTracker.h"
+#define STB_PERLIN_IMPLEMENTATION
+#include "stb/stb_perlin.h"
+#include "stb/stb_image.h"
+
+
+//-----------------------------------------------------------------------------
+// Constructor - empty until create()
+//-----------------------------------------------------------------------------
+Heightfield::Heightfield()
+	: mCells(0),
+	  mSize(0.0f)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+Heightfield::~Heightfield()
+{
+	MemoryTracker::addCpu(MemoryTracker::TERRAIN, -(long long)(mHeights.capacity() * sizeof(float)));
+}
+
+//-----------------------------------------------------------------------------
+// Allocates a flat grid
+//-----------------------------------------------------------------------------
+void Heightfield::create(float size, int cells)
+{
+	mSize = size;
+	mCells = glm::max(cells, 1);
+
+	long long oldBytes = (long long)(mHeights.capacity() * sizeof(float));
+	mHeights.assign((size_t)(mCells + 1) * (mCells + 1), 0.0f);
+	MemoryTracker::addCpu(MemoryTracker::TERRAIN, (long long)(mHeights.capacity() * sizeof(float)) - oldBytes);
+}
+
+//-----------------------------------------------------------------------------
+// Frees the grid
+//-----------------------------------------------------------------------------
+void Heightfield::clear()
+{
+	MemoryTracker::addCpu(MemoryTracker::TERRAIN, -(long long)(mHeights.capacity() * sizeof(float)));
+	std::vector<float>().swap(mHeights);
+	mCells = 0;
+	mSize = 0.0f;
+}
+
+//-----------------------------------------------------------------------------
+// Sum of octaves of seeded Perlin noise, each one twice the frequency and
+// half the weight of the previous one
+//-----------------------------------------------------------------------------
+void Heightfield::addNoise(float amplitude, float wavelength, int octaves, int seed)
+{
+	float totalWeight = 0.0f, weight = 1.0f;
+	for (int o = 0; o < octaves; o++, weight *= 0.5f)
+		totalWeight += weight;
+	if (totalWeight <= 0.0f || wavelength <= 0.0f)
+		return;
+
+	float cellSize = getCellSize();
+	glm::vec2 origin = getOrigin();
+	for (int z = 0; z <= mCells; z++)
+	{
+		for (int x = 0; x <= mCells; x++)
+		{
+			float px = (origin.x + x * cellSize) / wavelength;
+			float pz = (origin.y + z * cellSize) / wavelength;
+
+			float h = 0.0f, frequency = 1.0f;
+			weight = 1.0f;
+			for (int o = 0; o < octaves; o++, frequency *= 2.0f, weight *= 0.5f)
+				h += weight * stb_perlin_noise3_seed(px * frequency, 0.5f + o, pz * frequency, 0, 0, 0, seed + o);
+
+			mHeights[z * (mCells + 1) + x] += amplitude * h / totalWeight;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Bilinear resampling of a grayscale image (8 or 16 bits) over the grid
+//-----------------------------------------------------------------------------
+bool Heightfield::addImage(const std::string& filename, float amplitude)
+{
+	int width, height, components;
+	unsigned short* image = stbi_load_16(filename.c_str(), &width, &height, &components, 1);
+	if (image == NULL)
+	{
+		std::cerr << "Error loading heightmap " << filename << std::endl;
+		return false;
+	}
+
+	for (int z = 0; z <= mCells; z++)
+	{
+		for (int x = 0; x <= mCells; x++)
+		{
+			float u = (float)x / mCells * (width - 1);
+			float v = (float)z / mCells * (height - 1);
+			int u0 = glm::min((int)u, glm::max(width - 2, 0));
+			int v0 = glm::min((int)v, glm::max(height - 2, 0));
+			int u1 = glm::min(u0 + 1, width - 1);
+			int v1 = glm::min(v0 + 1, height - 1);
+			float fu = u - u0, fv = v - v0;
+
+			float top = glm::mix((float)image[v0 * width + u0], (float)image[v0 * width + u1], fu);
+			float bottom = glm::mix((float)image[v1 * width + u0], (float)image[v1 * width + u1], fu);
+			mHeights[z * (mCells + 1) + x] += amplitude * glm::mix(top, bottom, fv) / 65535.0f;
+		}
+	}
+
+	stbi_image_free(image);
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Smooth blend towards a level inside a ring
+//-----------------------------------------------------------------------------
+void Heightfield::flatten(const glm::vec2& center, float innerRadius, float outerRadius, float height)
+{
+	float cellSize = getCellSize();
+	glm::vec2 origin = getOrigin();
+
+	int x0 = glm::clamp((int)floorf((center.x - outerRadius - origin.x) / cellSize), 0, mCells);
+	int x1 = glm::clamp((int)ceilf((center.x + outerRadius - origin.x) / cellSize), 0, mCells);
+	int z0 = glm::clamp((int)floorf((center.y - outerRadius - origin.y) / cellSize), 0, mCells);
+	int z1 = glm::clamp((int)ceilf((center.y + outerRadius - origin.y) / cellSize), 0, mCells);
+	for (int z = z0; z <= z1; z++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			float d = glm::length(origin + glm::vec2((float)x, (float)z) * cellSize - center);
+			float keep = outerRadius > innerRadius ? glm::smoothstep(innerRadius, outerRadius, d) : (d < innerRadius ? 0.0f : 1.0f);
+
+			float& h = mHeights[z * (mCells + 1) + x];
+			h = glm::mix(height, h, keep);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Bilinear height
+//-----------------------------------------------------------------------------
+float Heightfield::getHeight(float x, float z) const
+{
+	if (mHeights.empty())
+		return 0.0f;
+
+	glm::vec2 origin = getOrigin();
+	float u = glm::clamp((x - origin.x) / getCellSize(), 0.0f, (float)mCells);
+	float v = glm::clamp((z - origin.y) / getCellSize(), 0.0f, (float)mCells);
+	int u0 = glm::min((int)u, mCells - 1);
+	int v0 = glm::min((int)v, mCells - 1);
+	float fu = u - u0, fv = v - v0;
+
+	float top = glm::mix(at(u0, v0), at(u0 + 1, v0), fu);
+	float bottom = glm::mix(at(u0, v0 + 1), at(u0 + 1, v0 + 1), fu);
+	return glm::mix(top, bottom, fv);
+}
+
+//-----------------------------------------------------------------------------
+// Normal from central differences, one cell apart
+//-----------------------------------------------------------------------------
+glm::vec3 Heightfield::getNormal(float x, float z) const
+{
+	float d = getCellSize();
+	float dx = getHeight(x + d, z) - getHeight(x - d, z);
+	float dz = getHeight(x, z + d) - getHeight(x, z - d);
+	return glm::normalize(glm::vec3(-dx, 2.0f * d, -dz));
+}
+
+//-----------------------------------------------------------------------------
+// Min/max over a block of grid points, clamped to the grid
+//-----------------------------------------------------------------------------
+void Heightfield::getRange(int x0, int z0, int x1, int z1, float& minHeight, float& maxHeight) const
+{
+	x0 = glm::clamp(x0, 0, mCells);  x1 = glm::clamp(x1, 0, mCells);
+	z0 = glm::clamp(z0, 0, mCells);  z1 = glm::clamp(z1, 0, mCells);
+
+	minHeight = maxHeight = mHeights.empty() ? 0.0f : at(x0, z0);
+	for (int z = z0; z <= z1 && !mHeights.empty(); z++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			minHeight = glm::min(minHeight, at(x, z));
+			maxHeight = glm::max(maxHeight, at(x, z));
+		}
+	}
+}
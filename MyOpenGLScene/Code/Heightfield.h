@@ -0,0 +1,65 @@
+//-----------------------------------------------------------------------------
+// Heightfield
+//
+// A square grid of (cells + 1)^2 heights centered on the origin, generated
+// with fractal Perlin noise (stb_perlin) and/or loaded from a grayscale
+// image.  Heights are queried with bilinear filtering, which is what the
+// terrain's height texture gives on the GPU, so objects placed with
+// getHeight() sit on the rendered ground.
+//-----------------------------------------------------------------------------
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+
+
+class Heightfield
+{
+public:
+
+	 Heightfield();
+	~Heightfield();
+
+	// Flat grid covering [-size / 2, size / 2] on x and z
+	void create(float size, int cells);
+
+	// Back to empty, the heights are freed
+	void clear();
+
+	// Adds fractal noise, amplitude is the highest possible deviation
+	void addNoise(float amplitude, float wavelength, int octaves, int seed);
+
+	// Adds a grayscale image stretched over the whole grid (0..amplitude)
+	bool addImage(const std::string& filename, float amplitude);
+
+	// Blends the heights to a level: flat inside the inner radius, untouched
+	// beyond the outer one
+	void flatten(const glm::vec2& center, float innerRadius, float outerRadius, float height);
+
+	// Queries - positions outside of the grid are clamped to its border
+	float getHeight(float x, float z) const;
+	glm::vec3 getNormal(float x, float z) const;
+
+	// Lowest and highest height over a rectangle of cells (inclusive corners)
+	void getRange(int x0, int z0, int x1, int z1, float& minHeight, float& maxHeight) const;
+
+	bool isEmpty() const          { return mHeights.empty(); }
+	int getCells() const          { return mCells; }
+	float getSize() const         { return mSize; }
+	float getCellSize() const     { return mSize / mCells; }
+	glm::vec2 getOrigin() const   { return glm::vec2(-0.5f * mSize); }
+	const float* getData() const  { return mHeights.empty() ? NULL : &mHeights[0]; }
+
+private:
+	Heightfield(const Heightfield& rhs);
+	Heightfield& operator = (const Heightfield& rhs);
+
+	float at(int x, int z) const { return mHeights[z * (mCells + 1) + x]; }
+
+	std::vector<float> mHeights;
+	int mCells;
+	float mSize;
+};
+#endif //HEIGHTFIELD_H
@@ -0,0 +1,222 @@
+//-----------------------------------------------------------------------------
+// Octahedral impostors
+//-----------------------------------------------------------------------------
+#include "ImpostorAtlas.h"
+#include <iostream>
+#include <cmath>
+#include "glm/gtc/matrix_transform.hpp"
+#include "GLContext.h"
+#include "GLStats.h"
+#include "MemoryTracker.h"
+
+
+const int ATLAS_SIZE = ImpostorAtlas::GRID * ImpostorAtlas::TILE_SIZE;
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+ImpostorAtlas::ImpostorAtlas()
+	: mAlbedoArray(0),
+	  mNormalArray(0),
+	  mVAO(0),
+	  mBaked(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+ImpostorAtlas::~ImpostorAtlas()
+{
+	GLuint arrays[2] = { mAlbedoArray, mNormalArray };
+	MemoryTracker::releaseTextures(2, arrays);
+
+	if (mAlbedoArray != 0)
+		glDeleteTextures(1, &mAlbedoArray);
+	if (mNormalArray != 0)
+		glDeleteTextures(1, &mNormalArray);
+	if (mVAO != 0)
+		glDeleteVertexArrays(1, &mVAO);
+}
+
+//-----------------------------------------------------------------------------
+// Registers a mesh to bake
+//-----------------------------------------------------------------------------
+int ImpostorAtlas::add(Mesh& mesh, const Texture2D& texture)
+{
+	Entry entry;
+	entry.mesh = &mesh;
+	entry.texture = &texture;
+	entry.center = 0.5f * (mesh.getBoundsMin() + mesh.getBoundsMax());
+	entry.radius = 0.5f * glm::length(mesh.getBoundsMax() - mesh.getBoundsMin());
+
+	mEntries.push_back(entry);
+	return (int)mEntries.size() - 1;
+}
+
+//-----------------------------------------------------------------------------
+// Hemi-octahedral mapping: the upper hemisphere folded on a square in [-1, 1]
+// (same as decodeDirection in impostor.vert)
+//-----------------------------------------------------------------------------
+glm::vec3 ImpostorAtlas::tileDirection(int x, int y)
+{
+	glm::vec2 e = (glm::vec2((float)x, (float)y) + 0.5f) / (float)GRID * 2.0f - 1.0f;
+
+	glm::vec3 d;
+	d.x = (e.x + e.y) * 0.5f;
+	d.z = (e.x - e.y) * 0.5f;
+	d.y = 1.0f - fabsf(d.x) - fabsf(d.z);
+	return glm::normalize(d);
+}
+
+//-----------------------------------------------------------------------------
+// Renders the GRID * GRID views of every mesh, one texture array layer each
+//-----------------------------------------------------------------------------
+bool ImpostorAtlas::bake()
+{
+	if (mEntries.empty())
+		return false;
+
+	if (!mBakeShader.loadShaders("shaders/impostor_bake.vert", "shaders/impostor_bake.frag"))
+		return false;
+	if (!mShader.loadShaders("shaders/impostor.vert", "shaders/impostor.frag"))
+		return false;
+	if (!mGBufferShader.loadShaders("shaders/impostor.vert", "shaders/impostor_gbuffer.frag"))
+		return false;
+
+	GLsizei numLayers = (GLsizei)mEntries.size();
+	GLuint arrays[2];
+	glGenTextures(2, arrays);
+	mAlbedoArray = arrays[0];
+	mNormalArray = arrays[1];
+	for (int i = 0; i < 2; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[i]);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, ATLAS_SIZE, ATLAS_SIZE, numLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		MemoryTracker::setTexture(MemoryTracker::IMPOSTORS, arrays[i], MemoryTracker::getTextureBytes(GL_RGBA8, ATLAS_SIZE, ATLAS_SIZE, numLayers, 0));
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	GLuint fbo, depthBuffer;
+	glGenFramebuffers(1, &fbo);
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, ATLAS_SIZE, ATLAS_SIZE);
+	MemoryTracker::setRenderbuffer(MemoryTracker::IMPOSTORS, depthBuffer, MemoryTracker::getTextureBytes(GL_DEPTH_COMPONENT24, ATLAS_SIZE, ATLAS_SIZE, 1, 1));
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, drawBuffers);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	mBakeShader.use();
+	mBakeShader.setUniformSampler("diffuseMap", 0);
+
+	bool ok = true;
+	for (GLint layer = 0; layer < numLayers && ok; layer++)
+	{
+		const Entry& entry = mEntries[layer];
+
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, mAlbedoArray, 0, layer);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, mNormalArray, 0, layer);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cerr << "Impostor framebuffer incomplete" << std::endl;
+			ok = false;
+			break;
+		}
+
+		// Transparent background - the impostor shaders discard it
+		const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		glViewport(0, 0, ATLAS_SIZE, ATLAS_SIZE);
+		glClearBufferfv(GL_COLOR, 0, zero);
+		glClearBufferfv(GL_COLOR, 1, zero);
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, entry.texture->getHandle());
+
+		// Orthographic view of the bounding sphere from every tile direction
+		glm::mat4 projection = glm::ortho(-entry.radius, entry.radius, -entry.radius, entry.radius, 0.0f, 4.0f * entry.radius);
+		for (int y = 0; y < GRID; y++)
+		{
+			for (int x = 0; x < GRID; x++)
+			{
+				glm::vec3 dir = tileDirection(x, y);
+				glm::vec3 up = fabsf(dir.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+				glm::vec3 right = glm::normalize(glm::cross(up, dir));
+				up = glm::cross(dir, right);
+
+				glm::mat4 view = glm::lookAt(entry.center + dir * (2.0f * entry.radius), entry.center, up);
+
+				glViewport(x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+				mBakeShader.setUniform("viewProjection", projection * view);
+				entry.mesh->draw();
+			}
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, GLContext::getDefaultFramebuffer());
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glDeleteFramebuffers(1, &fbo);
+	MemoryTracker::releaseRenderbuffers(1, &depthBuffer);
+	glDeleteRenderbuffers(1, &depthBuffer);
+
+	if (!ok)
+		return false;
+
+	for (int i = 0; i < 2; i++)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[i]);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenVertexArrays(1, &mVAO);
+
+	mBaked = true;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// One quad (4 vertex strip) per instance
+//-----------------------------------------------------------------------------
+void ImpostorAtlas::draw(ShaderProgram& shader, int impostor, GLuint instanceBuffer, GLuint first, GLsizei count)
+{
+	if (!mBaked || count <= 0)
+		return;
+
+	const Entry& entry = mEntries[impostor];
+	shader.setUniform("impostorCenter", entry.center);
+	shader.setUniform("impostorRadius", entry.radius);
+	shader.setUniform("impostorLayer", (GLint)impostor);
+	shader.setUniformSampler("albedoAtlas", ALBEDO_TEX_UNIT);
+	shader.setUniformSampler("normalAtlas", NORMAL_TEX_UNIT);
+
+	glActiveTexture(GL_TEXTURE0 + ALBEDO_TEX_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mAlbedoArray);
+	glActiveTexture(GL_TEXTURE0 + NORMAL_TEX_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mNormalArray);
+
+	glBindVertexArray(mVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid*)(first * sizeof(GLuint)));
+	glVertexAttribDivisor(3, 1);
+	glEnableVertexAttribArray(3);
+
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+	glBindVertexArray(0);
+
+	glActiveTexture(GL_TEXTURE0 + NORMAL_TEX_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glActiveTexture(GL_TEXTURE0 + ALBEDO_TEX_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
@@ -0,0 +1,87 @@
+//-----------------------------------------------------------------------------
+// Octahedral impostors
+//
+// Every registered mesh is rendered offscreen from GRID * GRID directions
+// spread over the upper hemisphere with a hemi-octahedral mapping, into one
+// layer of an albedo and a normal texture array.  Far away instances are
+// then drawn as a single quad: the vertex shader turns the view direction
+// into the mesh's object space, picks the nearest baked direction and places
+// the quad the way that view was captured.
+//
+// Meshes and impostors overlap over a fade band where both are drawn with
+// complementary dither patterns (see lodFade in lighting_instanced.vert and
+// impostor.vert), so the switch does not pop.
+//-----------------------------------------------------------------------------
+#ifndef IMPOSTOR_ATLAS_H
+#define IMPOSTOR_ATLAS_H
+
+#include <vector>
+#define GLEW_STATIC
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "Mesh.h"
+#include "Texture2D.h"
+#include "ShaderProgram.h"
+
+
+class ImpostorAtlas
+{
+public:
+
+	// Must match impostor.vert
+	static const int GRID = 8;			// views per side
+	static const int TILE_SIZE = 128;	// pixels per view
+
+	// Texture units of the atlases when drawing - 1 to 4 hold the transforms
+	// and the light clusters
+	static const GLuint ALBEDO_TEX_UNIT = 0;
+	static const GLuint NORMAL_TEX_UNIT = 5;
+
+	 ImpostorAtlas();
+	~ImpostorAtlas();
+
+	// Registers a mesh, returns its impostor id.  Both must live until bake().
+	int add(Mesh& mesh, const Texture2D& texture);
+
+	// Renders every view of every mesh and loads the shaders
+	bool bake();
+
+	// Draws count impostors of one mesh.  The per-instance attribute is the
+	// transform id, like Mesh::drawInstanced.  The caller sets view,
+	// projection, viewPos, lodFade and the lighting on getShader() (or
+	// getGBufferShader()) first.
+	void draw(ShaderProgram& shader, int impostor, GLuint instanceBuffer, GLuint first, GLsizei count);
+
+	ShaderProgram& getShader()        { return mShader; }
+	ShaderProgram& getGBufferShader() { return mGBufferShader; }
+
+	int getNumImpostors() const { return (int)mEntries.size(); }
+
+	// Object space direction the tile's view was captured from (hemi-octahedral,
+	// only views from above the horizon are baked)
+	static glm::vec3 tileDirection(int x, int y);
+
+private:
+	ImpostorAtlas(const ImpostorAtlas& rhs);
+	ImpostorAtlas& operator = (const ImpostorAtlas& rhs);
+
+	struct Entry
+	{
+		Mesh* mesh;
+		const Texture2D* texture;
+		glm::vec3 center;		// object space bounding sphere
+		float radius;
+	};
+
+	std::vector<Entry> mEntries;
+
+	GLuint mAlbedoArray, mNormalArray;
+	GLuint mVAO;		// the quad corners come from gl_VertexID
+
+	ShaderProgram mBakeShader;
+	ShaderProgram mShader;
+	ShaderProgram mGBufferShader;
+	bool mBaked;
+};
+#endif //IMPOSTOR_ATLAS_H
@@ -0,0 +1,154 @@
+//-----------------------------------------------------------------------------
+// Minimal job system - a pool of persistent worker threads that split
+// parallel-for style jobs between them (and the calling thread)
+//-----------------------------------------------------------------------------
+#include "JobSystem.h"
+#include <sstream>
+#include "Profiler.h"
+
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+JobSystem::JobSystem()
+	: mJob(NULL),
+	  mCount(0),
+	  mGrain(1),
+	  mGeneration(0),
+	  mNextItem(0),
+	  mBusyWorkers(0),
+	  mQuit(false)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+JobSystem::~JobSystem()
+{
+	shutdown();
+}
+
+//-----------------------------------------------------------------------------
+// Spawns the worker threads.  The calling thread counts as one of numThreads
+// since it always helps out while waiting for a job to finish.
+//-----------------------------------------------------------------------------
+void JobSystem::init(unsigned int numThreads)
+{
+	shutdown();
+
+	if (numThreads == 0)
+		numThreads = std::thread::hardware_concurrency();
+	if (numThreads == 0)
+		numThreads = 1;
+
+	mQuit = false;
+	for (unsigned int i = 1; i < numThreads; i++)
+		mWorkers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+//-----------------------------------------------------------------------------
+// Stops and joins all worker threads
+//-----------------------------------------------------------------------------
+void JobSystem::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeCondition.notify_all();
+
+	for (size_t i = 0; i < mWorkers.size(); i++)
+		mWorkers[i].join();
+	mWorkers.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Runs job over [0, count) split into chunks of grain items.  Chunks are
+// handed out through an atomic counter so fast threads pick up more work.
+//-----------------------------------------------------------------------------
+void JobSystem::parallelFor(unsigned int count, unsigned int grain, const RangeJob& job)
+{
+	if (count == 0)
+		return;
+	if (grain == 0)
+		grain = 1;
+
+	// Not worth waking anybody up
+	if (mWorkers.empty() || count <= grain)
+	{
+		job(0, count, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJob = &job;
+		mCount = count;
+		mGrain = grain;
+		mNextItem = 0;
+		mBusyWorkers = (unsigned int)mWorkers.size();
+		mGeneration++;
+	}
+	mWakeCondition.notify_all();
+
+	// Help out on the calling thread
+	runChunks(0);
+
+	// Wait for the workers to drain their last chunks
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDoneCondition.wait(lock, [this] { return mBusyWorkers == 0; });
+	mJob = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Grabs chunks of the current job until there are none left
+//-----------------------------------------------------------------------------
+void JobSystem::runChunks(unsigned int threadIndex)
+{
+	PROFILE_SCOPE("Job");
+
+	while (true)
+	{
+		unsigned int begin = mNextItem.fetch_add(mGrain);
+		if (begin >= mCount)
+			break;
+
+		unsigned int end = begin + mGrain;
+		if (end > mCount)
+			end = mCount;
+
+		(*mJob)(begin, end, threadIndex);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Worker thread body - sleeps until a new job generation is published
+//-----------------------------------------------------------------------------
+void JobSystem::workerLoop(unsigned int threadIndex)
+{
+	unsigned int seenGeneration = 0;
+
+	std::ostringstream name;
+	name << "Worker " << threadIndex;
+	Profiler::setThreadName(name.str());
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeCondition.wait(lock, [&] { return mQuit || mGeneration != seenGeneration; });
+			if (mQuit)
+				return;
+			seenGeneration = mGeneration;
+		}
+
+		runChunks(threadIndex);
+
+		if (mBusyWorkers.fetch_sub(1) == 1)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mDoneCondition.notify_one();
+		}
+	}
+}
@@ -0,0 +1,58 @@
+//-----------------------------------------------------------------------------
+// Minimal job system - a pool of persistent worker threads that split
+// parallel-for style jobs between them (and the calling thread)
+//-----------------------------------------------------------------------------
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+
+class JobSystem
+{
+public:
+
+	// Job callback receives a [begin, end) range and the index of the thread
+	// running it (0 is always the calling thread, workers are 1..N-1)
+	typedef std::function<void(unsigned int begin, unsigned int end, unsigned int threadIndex)> RangeJob;
+
+	 JobSystem();
+	~JobSystem();
+
+	// numThreads includes the calling thread. 0 = one per hardware thread.
+	void init(unsigned int numThreads = 0);
+	void shutdown();
+
+	unsigned int getThreadCount() const { return (unsigned int)mWorkers.size() + 1; }
+
+	// Runs job over [0, count) in chunks of 'grain' items and blocks until done.
+	// Only one parallelFor can be in flight at a time.
+	void parallelFor(unsigned int count, unsigned int grain, const RangeJob& job);
+
+private:
+	JobSystem(const JobSystem& rhs);
+	JobSystem& operator = (const JobSystem& rhs);
+
+	void workerLoop(unsigned int threadIndex);
+	void runChunks(unsigned int threadIndex);
+
+	std::vector<std::thread> mWorkers;
+	std::mutex mMutex;
+	std::condition_variable mWakeCondition;
+	std::condition_variable mDoneCondition;
+
+	// Current job
+	const RangeJob* mJob;
+	unsigned int mCount;
+	unsigned int mGrain;
+	unsigned int mGeneration;
+	std::atomic<unsigned int> mNextItem;
+	std::atomic<unsigned int> mBusyWorkers;
+	bool mQuit;
+};
+#endif //JOB_SYSTEM_H
@@ -0,0 +1,340 @@
+//-----------------------------------------------------------------------------
+// Clustered forward lighting
+//-----------------------------------------------------------------------------
+#include "LightClusterer.h"
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include "Profiler.h"
+#include "GLStats.h"
+#include "MemoryTracker.h"
+
+
+const int NUM_CLUSTERS = LightClusterer::CLUSTERS_X * LightClusterer::CLUSTERS_Y * LightClusterer::CLUSTERS_Z;
+
+// The first depth slice covers everything closer than this, the exponential
+// slicing would otherwise waste most slices right in front of the camera
+const float CLUSTER_NEAR = 1.0f;
+
+// Lights are cut off once they are dimmer than one 8 bit step
+const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+// Texels per light in the light texture buffer
+const int LIGHT_TEXELS = 3;
+
+// Light indices per cluster the ring has room for at first, it grows if needed
+const int RING_LIGHTS_PER_CLUSTER = 8;
+
+//-----------------------------------------------------------------------------
+// (Re)fills a texture buffer - never with a zero sized store
+//-----------------------------------------------------------------------------
+static void uploadTextureBuffer(GLuint buffer, const void* data, size_t bytes)
+{
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, std::max(bytes, (size_t)16), NULL, GL_STREAM_DRAW);
+	MemoryTracker::setBuffer(MemoryTracker::LIGHTS, buffer, std::max(bytes, (size_t)16));
+	if (bytes > 0)
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Points a texture buffer at a range of a buffer
+//-----------------------------------------------------------------------------
+static void bindTextureRange(GLuint texture, GLenum format, GLuint buffer, GLintptr offset, GLsizeiptr bytes)
+{
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBufferRange(GL_TEXTURE_BUFFER, format, buffer, offset, bytes);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+LightClusterer::LightClusterer()
+	: mClusterProjection(0.0f),
+	  mSliceScale(0.0f),
+	  mSliceBias(0.0f),
+	  mNear(0.0f),
+	  mFar(0.0f),
+	  mTileSize(1.0f)
+{
+	mClusterMin.resize(NUM_CLUSTERS);
+	mClusterMax.resize(NUM_CLUSTERS);
+	mClusterLights.resize(NUM_CLUSTERS * MAX_LIGHTS_PER_CLUSTER);
+	mClusterCounts.resize(NUM_CLUSTERS);
+	mGrid.resize(NUM_CLUSTERS * 2);
+
+	GLuint buffers[3], textures[3];
+	glGenBuffers(3, buffers);
+	glGenTextures(3, textures);
+	mLightBuffer = buffers[0];  mLightTexture = textures[0];
+	mGridBuffer = buffers[1];   mGridTexture = textures[1];
+	mIndexBuffer = buffers[2];  mIndexTexture = textures[2];
+
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+	for (int i = 0; i < 3; i++)
+	{
+		uploadTextureBuffer(buffers[i], NULL, 0);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	if (GLEW_ARB_texture_buffer_range)
+		mClusterRing.init(NUM_CLUSTERS * (2 + RING_LIGHTS_PER_CLUSTER) * sizeof(GLuint));
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+LightClusterer::~LightClusterer()
+{
+	GLuint buffers[3] = { mLightBuffer, mGridBuffer, mIndexBuffer };
+	GLuint textures[3] = { mLightTexture, mGridTexture, mIndexTexture };
+	MemoryTracker::releaseBuffers(3, buffers);
+	glDeleteTextures(3, textures);
+	glDeleteBuffers(3, buffers);
+}
+
+//-----------------------------------------------------------------------------
+// Solves intensity / (constant + linear * d + exponent * d^2) = LIGHT_CUTOFF
+//-----------------------------------------------------------------------------
+float LightClusterer::computeRadius(const PointLight& light)
+{
+	glm::vec3 color = glm::max(light.diffuse, light.specular);
+	float intensity = std::max(color.r, std::max(color.g, color.b));
+
+	float c = light.constant - intensity / LIGHT_CUTOFF;
+	if (c >= 0.0f)
+		return 0.0f;		// never bright enough to show
+
+	if (light.exponent > 0.0f)
+		return (-light.linear + sqrtf(light.linear * light.linear - 4.0f * light.exponent * c)) / (2.0f * light.exponent);
+	if (light.linear > 0.0f)
+		return -c / light.linear;
+
+	return FLT_MAX;
+}
+
+//-----------------------------------------------------------------------------
+// Stores the lights and uploads their data:
+// (position, constant) (diffuse, linear) (specular, exponent)
+//-----------------------------------------------------------------------------
+void LightClusterer::setLights(const std::vector<PointLight>& lights)
+{
+	mLights = lights;
+	mRadii.resize(lights.size());
+
+	std::vector<glm::vec4> texels(lights.size() * LIGHT_TEXELS);
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		mRadii[i] = computeRadius(lights[i]);
+
+		texels[i * LIGHT_TEXELS + 0] = glm::vec4(lights[i].position, lights[i].constant);
+		texels[i * LIGHT_TEXELS + 1] = glm::vec4(lights[i].diffuse, lights[i].linear);
+		texels[i * LIGHT_TEXELS + 2] = glm::vec4(lights[i].specular, lights[i].exponent);
+	}
+
+	uploadTextureBuffer(mLightBuffer, texels.empty() ? NULL : &texels[0], texels.size() * sizeof(glm::vec4));
+}
+
+//-----------------------------------------------------------------------------
+// Depth slice of a positive view space depth
+//-----------------------------------------------------------------------------
+int LightClusterer::depthSlice(float viewDepth) const
+{
+	float slice = logf(std::max(viewDepth, 1e-6f)) * mSliceScale + mSliceBias;
+	return glm::clamp((int)floorf(slice), 0, CLUSTERS_Z - 1);
+}
+
+//-----------------------------------------------------------------------------
+// View space bounding box of every cluster
+//-----------------------------------------------------------------------------
+void LightClusterer::buildClusterBounds(const glm::mat4& projection, float zNear, float zFar)
+{
+	float clusterNear = std::max(zNear, CLUSTER_NEAR);
+	mSliceScale = CLUSTERS_Z / logf(zFar / clusterNear);
+	mSliceBias = -CLUSTERS_Z * logf(clusterNear) / logf(zFar / clusterNear);
+	mNear = zNear;
+	mFar = zFar;
+	mClusterProjection = projection;
+
+	glm::mat4 invProjection = glm::inverse(projection);
+
+	for (int z = 0; z < CLUSTERS_Z; z++)
+	{
+		float depth0 = z == 0 ? zNear : clusterNear * powf(zFar / clusterNear, (float)z / CLUSTERS_Z);
+		float depth1 = clusterNear * powf(zFar / clusterNear, (float)(z + 1) / CLUSTERS_Z);
+
+		for (int y = 0; y < CLUSTERS_Y; y++)
+		{
+			for (int x = 0; x < CLUSTERS_X; x++)
+			{
+				glm::vec3 bmin(FLT_MAX), bmax(-FLT_MAX);
+				for (int corner = 0; corner < 4; corner++)
+				{
+					// ray through the tile corner, scaled to both slice depths
+					float ndcX = -1.0f + 2.0f * (x + (corner & 1)) / CLUSTERS_X;
+					float ndcY = -1.0f + 2.0f * (y + (corner >> 1)) / CLUSTERS_Y;
+					glm::vec4 p = invProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+					glm::vec3 ray = glm::vec3(p) / p.w;
+					ray /= -ray.z;
+
+					bmin = glm::min(bmin, glm::min(ray * depth0, ray * depth1));
+					bmax = glm::max(bmax, glm::max(ray * depth0, ray * depth1));
+				}
+
+				int cluster = x + CLUSTERS_X * (y + CLUSTERS_Y * z);
+				mClusterMin[cluster] = bmin;
+				mClusterMax[cluster] = bmax;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Bins the lights in the clusters of this view
+//-----------------------------------------------------------------------------
+void LightClusterer::update(const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar, int viewportWidth, int viewportHeight, JobSystem& jobs)
+{
+	PROFILE_SCOPE("LightClusterer::update");
+
+	if (projection != mClusterProjection || zNear != mNear || zFar != mFar)
+		buildClusterBounds(projection, zNear, zFar);
+
+	mTileSize = glm::vec2((float)viewportWidth / CLUSTERS_X, (float)viewportHeight / CLUSTERS_Y);
+
+	// Range of clusters covered by each light's view space bounding box
+	mRanges.clear();
+	for (size_t i = 0; i < mLights.size(); i++)
+	{
+		float radius = mRadii[i];
+		glm::vec3 center = glm::vec3(view * glm::vec4(mLights[i].position, 1.0f));
+		float nearDepth = -center.z - radius;
+		float farDepth = -center.z + radius;
+		if (radius <= 0.0f || farDepth < zNear || nearDepth > zFar)
+			continue;
+
+		LightRange range;
+		range.center = center;
+		range.radius = radius;
+		range.light = (int)i;
+		range.minZ = depthSlice(std::max(nearDepth, zNear));
+		range.maxZ = depthSlice(std::min(farDepth, zFar));
+		range.minX = range.minY = 0;
+		range.maxX = CLUSTERS_X - 1;
+		range.maxY = CLUSTERS_Y - 1;
+
+		// Project the box when it is completely in front of the camera
+		if (nearDepth > zNear)
+		{
+			glm::vec2 ndcMin(FLT_MAX), ndcMax(-FLT_MAX);
+			for (int corner = 0; corner < 8; corner++)
+			{
+				glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+				glm::vec4 clip = projection * glm::vec4(center + offset, 1.0f);
+				glm::vec2 ndc = glm::vec2(clip) / clip.w;
+				ndcMin = glm::min(ndcMin, ndc);
+				ndcMax = glm::max(ndcMax, ndc);
+			}
+
+			range.minX = glm::clamp((int)floorf((ndcMin.x * 0.5f + 0.5f) * CLUSTERS_X), 0, CLUSTERS_X - 1);
+			range.maxX = glm::clamp((int)floorf((ndcMax.x * 0.5f + 0.5f) * CLUSTERS_X), 0, CLUSTERS_X - 1);
+			range.minY = glm::clamp((int)floorf((ndcMin.y * 0.5f + 0.5f) * CLUSTERS_Y), 0, CLUSTERS_Y - 1);
+			range.maxY = glm::clamp((int)floorf((ndcMax.y * 0.5f + 0.5f) * CLUSTERS_Y), 0, CLUSTERS_Y - 1);
+			if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+				continue;
+		}
+
+		mRanges.push_back(range);
+	}
+
+	// Each cluster tests the lights whose range covers it against its box
+	jobs.parallelFor(NUM_CLUSTERS, 32,
+		[this](unsigned int begin, unsigned int end, unsigned int)
+		{
+			for (unsigned int cluster = begin; cluster < end; cluster++)
+			{
+				int x = cluster % CLUSTERS_X;
+				int y = (cluster / CLUSTERS_X) % CLUSTERS_Y;
+				int z = cluster / (CLUSTERS_X * CLUSTERS_Y);
+
+				GLuint* slots = &mClusterLights[cluster * MAX_LIGHTS_PER_CLUSTER];
+				GLuint count = 0;
+				for (size_t r = 0; r < mRanges.size() && count < MAX_LIGHTS_PER_CLUSTER; r++)
+				{
+					const LightRange& range = mRanges[r];
+					if (x < range.minX || x > range.maxX || y < range.minY || y > range.maxY || z < range.minZ || z > range.maxZ)
+						continue;
+
+					glm::vec3 d = glm::clamp(range.center, mClusterMin[cluster], mClusterMax[cluster]) - range.center;
+					if (glm::dot(d, d) <= range.radius * range.radius)
+						slots[count++] = (GLuint)range.light;
+				}
+				mClusterCounts[cluster] = count;
+			}
+		});
+
+	// Pack the lists one after the other
+	mLightIndices.clear();
+	for (int cluster = 0; cluster < NUM_CLUSTERS; cluster++)
+	{
+		mGrid[cluster * 2 + 0] = (GLuint)mLightIndices.size();
+		mGrid[cluster * 2 + 1] = mClusterCounts[cluster];
+
+		const GLuint* slots = &mClusterLights[cluster * MAX_LIGHTS_PER_CLUSTER];
+		mLightIndices.insert(mLightIndices.end(), slots, slots + mClusterCounts[cluster]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Sends the cluster grid and light lists to their texture buffers
+//-----------------------------------------------------------------------------
+void LightClusterer::upload()
+{
+	if (mClusterRing.getBuffer() == 0)
+	{
+		uploadTextureBuffer(mGridBuffer, &mGrid[0], mGrid.size() * sizeof(GLuint));
+		uploadTextureBuffer(mIndexBuffer, mLightIndices.empty() ? NULL : &mLightIndices[0], mLightIndices.size() * sizeof(GLuint));
+		return;
+	}
+
+	// A texture buffer range is never empty
+	static const GLuint NO_LIGHT = 0;
+	const GLuint* indices = mLightIndices.empty() ? &NO_LIGHT : &mLightIndices[0];
+	GLsizeiptr gridBytes = mGrid.size() * sizeof(GLuint);
+	GLsizeiptr indexBytes = std::max(mLightIndices.size(), (size_t)1) * sizeof(GLuint);
+
+	mClusterRing.beginFrame();
+	GLintptr gridOffset = mClusterRing.write(&mGrid[0], gridBytes);
+	GLintptr indexOffset = mClusterRing.write(indices, indexBytes);
+
+	// If the index write grew the ring, the grid must go to the new buffer too
+	if (indexOffset < gridOffset + gridBytes)
+		gridOffset = mClusterRing.write(&mGrid[0], gridBytes);
+	bindTextureRange(mGridTexture, GL_RG32UI, mClusterRing.getBuffer(), gridOffset, gridBytes);
+	bindTextureRange(mIndexTexture, GL_R32UI, mClusterRing.getBuffer(), indexOffset, indexBytes);
+}
+
+//-----------------------------------------------------------------------------
+// Binds the cluster data for the lighting shaders
+//-----------------------------------------------------------------------------
+void LightClusterer::setUniforms(ShaderProgram& shader, GLuint firstTexUnit) const
+{
+	const GLuint textures[3] = { mLightTexture, mGridTexture, mIndexTexture };
+	for (GLuint i = 0; i < 3; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + firstTexUnit + i);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+	}
+
+	shader.setUniformSampler("pointLightData", firstTexUnit);
+	shader.setUniformSampler("clusterGrid", firstTexUnit + 1);
+	shader.setUniformSampler("clusterLightIndices", firstTexUnit + 2);
+
+	shader.setUniform("clusterDepth", glm::vec2(mNear, mFar));
+	shader.setUniform("clusterSliceScale", mSliceScale);
+	shader.setUniform("clusterSliceBias", mSliceBias);
+	shader.setUniform("clusterTileSize", mTileSize);
+}
@@ -0,0 +1,103 @@
+//-----------------------------------------------------------------------------
+// Clustered forward lighting
+//
+// The view frustum is split in CLUSTERS_X * CLUSTERS_Y screen tiles and
+// CLUSTERS_Z exponential depth slices (froxels).  Every frame each point light
+// is binned in the froxels its sphere of influence touches, on the CPU with
+// the job system.  The lights, the per cluster (offset, count) grid and the
+// light index lists go to texture buffers so the fragment shader only
+// evaluates the lights of its own cluster (see lighting_clustered.frag).
+// With ARB_texture_buffer_range the grid and lists are streamed through a
+// ring buffer and the textures point at this frame's ranges.
+//-----------------------------------------------------------------------------
+#ifndef LIGHT_CLUSTERER_H
+#define LIGHT_CLUSTERER_H
+
+#include <vector>
+#define GLEW_STATIC
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "JobSystem.h"
+#include "ShaderProgram.h"
+#include "GpuRingBuffer.h"
+
+
+class LightClusterer
+{
+public:
+
+	// Must match the defines in lighting_clustered.frag and gpu_driven.frag
+	static const int CLUSTERS_X = 16;
+	static const int CLUSTERS_Y = 9;
+	static const int CLUSTERS_Z = 24;
+	static const int MAX_LIGHTS_PER_CLUSTER = 64;
+
+	struct PointLight
+	{
+		glm::vec3 position;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+		float constant, linear, exponent;
+	};
+
+	 LightClusterer();
+	~LightClusterer();
+
+	// Distance at which the attenuated light drops below what a 8 bit
+	// framebuffer can show
+	static float computeRadius(const PointLight& light);
+
+	// Replaces the lights - their data is uploaded here, not every frame
+	void setLights(const std::vector<PointLight>& lights);
+
+	// Bins the lights for this view - no GL call
+	void update(const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar, int viewportWidth, int viewportHeight, JobSystem& jobs);
+
+	// Sends the clusters built by update() to the GPU
+	void upload();
+
+	// Binds the three texture buffers to firstTexUnit.. and sets the cluster
+	// uniforms of the active shader
+	void setUniforms(ShaderProgram& shader, GLuint firstTexUnit) const;
+
+	int getNumLights() const { return (int)mLights.size(); }
+
+private:
+	LightClusterer(const LightClusterer& rhs);
+	LightClusterer& operator = (const LightClusterer& rhs);
+
+	// Light in view space and the clusters its bounding box covers
+	struct LightRange
+	{
+		glm::vec3 center;
+		float radius;
+		int light;
+		int minX, maxX, minY, maxY, minZ, maxZ;
+	};
+
+	void buildClusterBounds(const glm::mat4& projection, float zNear, float zFar);
+	int depthSlice(float viewDepth) const;
+
+	std::vector<PointLight> mLights;
+	std::vector<float> mRadii;
+
+	// View space boxes of the clusters, rebuilt when the projection changes
+	std::vector<glm::vec3> mClusterMin, mClusterMax;
+	glm::mat4 mClusterProjection;
+	float mSliceScale, mSliceBias;
+	float mNear, mFar;
+	glm::vec2 mTileSize;
+
+	// Per frame binning
+	std::vector<LightRange> mRanges;
+	std::vector<GLuint> mClusterLights;		// MAX_LIGHTS_PER_CLUSTER slots per cluster
+	std::vector<GLuint> mClusterCounts;
+	std::vector<GLuint> mGrid;				// offset, count per cluster
+	std::vector<GLuint> mLightIndices;
+
+	GLuint mLightBuffer, mGridBuffer, mIndexBuffer;
+	GLuint mLightTexture, mGridTexture, mIndexTexture;
+	GpuRingBuffer mClusterRing;		// empty without texture buffer ranges
+};
+#endif //LIGHT_CLUSTERER_H
@@ -0,0 +1,158 @@
+//-----------------------------------------------------------------------------
+// Asset load statistics - where the startup time goes, per asset
+//-----------------------------------------------------------------------------
+#include "LoadStats.h"
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include "Profiler.h"
+
+
+static std::mutex gRecordsMutex;
+static std::vector<LoadStats::Record> gRecords;
+
+static long long getTotalNs(const LoadStats::Record& record)
+{
+	long long total = 0;
+	for (int s = 0; s < LoadStats::NUM_STAGES; s++)
+		total += record.stageNs[s];
+	return total;
+}
+
+//-----------------------------------------------------------------------------
+// Slowest first
+//-----------------------------------------------------------------------------
+struct SlowestFirst
+{
+	bool operator()(const LoadStats::Record& a, const LoadStats::Record& b) const
+	{
+		return getTotalNs(a) > getTotalNs(b);
+	}
+};
+
+static void printRow(std::ostream& out, const std::string& name, const long long stageNs[LoadStats::NUM_STAGES], unsigned long long bytesIn, unsigned long long bytesOut)
+{
+	out << "  " << std::left << std::setw(40) << name << std::right;
+
+	long long total = 0;
+	for (int s = 0; s < LoadStats::NUM_STAGES; s++)
+	{
+		out << std::setw(10) << (double)stageNs[s] * 1e-6;
+		total += stageNs[s];
+	}
+	out << std::setw(10) << (double)total * 1e-6
+		<< std::setw(12) << (double)bytesIn / 1024.0
+		<< std::setw(12) << (double)bytesOut / 1024.0 << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+// Records a finished load, from any thread
+//-----------------------------------------------------------------------------
+void LoadStats::add(const Record& record)
+{
+	std::lock_guard<std::mutex> lock(gRecordsMutex);
+	gRecords.push_back(record);
+}
+
+void LoadStats::clear()
+{
+	std::lock_guard<std::mutex> lock(gRecordsMutex);
+	gRecords.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Prints the loads slowest first, times in ms and sizes in KB
+//-----------------------------------------------------------------------------
+void LoadStats::report(std::ostream& out)
+{
+	std::vector<Record> records;
+	{
+		std::lock_guard<std::mutex> lock(gRecordsMutex);
+		records = gRecords;
+	}
+	std::stable_sort(records.begin(), records.end(), SlowestFirst());
+
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out.setf(std::ios::fixed);
+	out.precision(1);
+
+	out << "Asset loading (ms, KB), slowest first" << std::endl
+		<< "  " << std::left << std::setw(40) << "asset" << std::right
+		<< std::setw(10) << "read" << std::setw(10) << "parse" << std::setw(10) << "post"
+		<< std::setw(10) << "upload" << std::setw(10) << "total"
+		<< std::setw(12) << "in" << std::setw(12) << "out" << std::endl;
+
+	// Totals per kind, in the order the kinds first appear
+	std::vector<std::string> kinds;
+	std::map<std::string, Record> totals;
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const Record& record = records[i];
+		printRow(out, std::string(record.kind) + " " + record.name + (record.failed ? " (failed)" : ""),
+			record.stageNs, record.bytesIn, record.bytesOut);
+
+		if (totals.find(record.kind) == totals.end())
+		{
+			Record total = {};
+			totals[record.kind] = total;
+			kinds.push_back(record.kind);
+		}
+		Record& total = totals[record.kind];
+		for (int s = 0; s < NUM_STAGES; s++)
+			total.stageNs[s] += record.stageNs[s];
+		total.bytesIn += record.bytesIn;
+		total.bytesOut += record.bytesOut;
+	}
+
+	Record all = {};
+	for (size_t k = 0; k < kinds.size(); k++)
+	{
+		const Record& total = totals[kinds[k]];
+		printRow(out, kinds[k] + " total", total.stageNs, total.bytesIn, total.bytesOut);
+		for (int s = 0; s < NUM_STAGES; s++)
+			all.stageNs[s] += total.stageNs[s];
+		all.bytesIn += total.bytesIn;
+		all.bytesOut += total.bytesOut;
+	}
+	printRow(out, "total", all.stageNs, all.bytesIn, all.bytesOut);
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+//-----------------------------------------------------------------------------
+// Starts timing a load
+//-----------------------------------------------------------------------------
+LoadTimer::LoadTimer(const char* kind, const std::string& name)
+	: mLast(Profiler::now())
+{
+	mRecord.kind = kind;
+	mRecord.name = name;
+	for (int s = 0; s < LoadStats::NUM_STAGES; s++)
+		mRecord.stageNs[s] = 0;
+	mRecord.bytesIn = 0;
+	mRecord.bytesOut = 0;
+	mRecord.failed = true;
+}
+
+//-----------------------------------------------------------------------------
+// Records the load
+//-----------------------------------------------------------------------------
+LoadTimer::~LoadTimer()
+{
+	LoadStats::add(mRecord);
+}
+
+//-----------------------------------------------------------------------------
+// Charges the time since the last stage to this one
+//-----------------------------------------------------------------------------
+void LoadTimer::endStage(LoadStats::Stage stage)
+{
+	long long now = Profiler::now();
+	mRecord.stageNs[stage] += now - mLast;
+	mLast = now;
+}
@@ -0,0 +1,75 @@
+//-----------------------------------------------------------------------------
+// Asset load statistics - where the startup time goes, per asset
+//
+// Every loader times its stages with a LoadTimer and records them here with
+// the bytes it read and the bytes it produced:
+//
+//            read          parse           post              upload
+//   mesh     file          OBJ parse       vertices, bounds  vertex buffers
+//   texture  file          image decode    vertical flip     glTexImage2D, mipmaps
+//   shader   source files  compile         -                 link
+//
+// GL stages are timed on the CPU: what the driver takes before returning,
+// not the GPU work it queues.  report() prints the assets slowest first with
+// the totals of every kind, to tell which ones to convert or cache first.
+//-----------------------------------------------------------------------------
+#ifndef LOAD_STATS_H
+#define LOAD_STATS_H
+
+#include <string>
+#include <iosfwd>
+
+
+class LoadStats
+{
+public:
+
+	enum Stage
+	{
+		READ,
+		PARSE,			// parse, decode or compile
+		POST_PROCESS,
+		UPLOAD,
+		NUM_STAGES
+	};
+
+	struct Record
+	{
+		const char* kind;			// "mesh", "texture", "shader"
+		std::string name;
+		long long stageNs[NUM_STAGES];
+		unsigned long long bytesIn, bytesOut;
+		bool failed;
+	};
+
+	static void add(const Record& record);
+	static void clear();
+
+	// Slowest first, then the totals per kind
+	static void report(std::ostream& out);
+};
+
+//-----------------------------------------------------------------------------
+// Times the stages of one load: endStage() charges the time since the last
+// call (or the construction) to a stage.  Records on destruction, so early
+// returns are reported too, as failed unless setSucceeded() was called.
+//-----------------------------------------------------------------------------
+class LoadTimer
+{
+public:
+	 LoadTimer(const char* kind, const std::string& name);
+	~LoadTimer();
+
+	void endStage(LoadStats::Stage stage);
+	void addBytesIn(unsigned long long bytes)  { mRecord.bytesIn += bytes; }
+	void addBytesOut(unsigned long long bytes) { mRecord.bytesOut += bytes; }
+	void setSucceeded()                        { mRecord.failed = false; }
+
+private:
+	LoadTimer(const LoadTimer& rhs);
+	LoadTimer& operator = (const LoadTimer& rhs);
+
+	LoadStats::Record mRecord;
+	long long mLast;
+};
+#endif //LOAD_STATS_H
@@ -0,0 +1,248 @@
+//-----------------------------------------------------------------------------
+// Batched matrix kernels - the matrices of many instances at once
+//-----------------------------------------------------------------------------
+#include "MatrixBatch.h"
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATRIX_BATCH_USE_SSE
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#define MATRIX_BATCH_USE_AVX
+#include <immintrin.h>
+#endif
+
+// Instances per job, a multiple of the lanes so only the last job has a tail
+const unsigned int MATRIX_GRAIN = 16384;
+
+const float DEGREES_TO_RADIANS = 0.017453292519943295f;
+const float INV_QUARTER_TURN = 1.0f / 90.0f;
+
+// Minimax polynomials on [-pi/4, pi/4] (Cephes sinf and cosf)
+const float SIN_P0 = -1.9515295891e-4f, SIN_P1 = 8.3321608736e-3f, SIN_P2 = -1.6666654611e-1f;
+const float COS_P0 = 2.443315711809948e-5f, COS_P1 = -1.388731625493765e-3f, COS_P2 = 4.166664568298827e-2f;
+
+
+//-----------------------------------------------------------------------------
+// Sine and cosine of an angle in degrees: a whole number of quarter turns
+// is taken out, the rest is within 45 degrees
+//-----------------------------------------------------------------------------
+static void sinCosDegrees(float degrees, float& sine, float& cosine)
+{
+	float quarters = std::nearbyint(degrees * INV_QUARTER_TURN);
+	float x = (degrees - quarters * 90.0f) * DEGREES_TO_RADIANS;
+	float z = x * x;
+
+	float s = ((SIN_P0 * z + SIN_P1) * z + SIN_P2) * z * x + x;
+	float c = ((COS_P0 * z + COS_P1) * z + COS_P2) * z * z - 0.5f * z + 1.0f;
+
+	// Quarter turns 1 and 3 swap them, 2 and 3 negate the sine, 1 and 2 the cosine
+	int quadrant = (int)quarters & 3;
+	sine = (quadrant & 1) ? c : s;
+	cosine = (quadrant & 1) ? s : c;
+	if (quadrant & 2)
+		sine = -sine;
+	if ((quadrant + 1) & 2)
+		cosine = -cosine;
+}
+
+//-----------------------------------------------------------------------------
+// One translate * scale * rotate about Y
+//-----------------------------------------------------------------------------
+static void buildTRS(const MatrixBatch::TRSArrays& instances, int i, glm::mat4& matrix)
+{
+	float s, c;
+	sinCosDegrees(instances.yaw[i], s, c);
+
+	float sx = instances.scaleX[i], sy = instances.scaleY[i], sz = instances.scaleZ[i];
+	matrix[0] = glm::vec4(sx * c, 0.0f, -sz * s, 0.0f);
+	matrix[1] = glm::vec4(0.0f, sy, 0.0f, 0.0f);
+	matrix[2] = glm::vec4(sx * s, 0.0f, sz * c, 0.0f);
+	matrix[3] = glm::vec4(instances.positionX[i], instances.positionY[i], instances.positionZ[i], 1.0f);
+}
+
+#ifdef MATRIX_BATCH_USE_SSE
+//-----------------------------------------------------------------------------
+// SSE2 - four lanes
+//-----------------------------------------------------------------------------
+static void sinCosDegrees(__m128 degrees, __m128& sine, __m128& cosine)
+{
+	__m128i quarters = _mm_cvtps_epi32(_mm_mul_ps(degrees, _mm_set1_ps(INV_QUARTER_TURN)));
+	__m128 x = _mm_mul_ps(_mm_sub_ps(degrees, _mm_mul_ps(_mm_cvtepi32_ps(quarters), _mm_set1_ps(90.0f))), _mm_set1_ps(DEGREES_TO_RADIANS));
+	__m128 z = _mm_mul_ps(x, x);
+
+	__m128 s = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_P0), z), _mm_set1_ps(SIN_P1)), z), _mm_set1_ps(SIN_P2)), z);
+	s = _mm_add_ps(_mm_mul_ps(s, x), x);
+	__m128 c = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_P0), z), _mm_set1_ps(COS_P1)), z), _mm_set1_ps(COS_P2)), z);
+	c = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c, z), _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_set1_ps(1.0f));
+
+	// Bit 1 of the quadrant moved to the sign bit negates
+	const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quarters, one), one));
+	__m128 sineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quarters, two), 30));
+	__m128 cosineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quarters, one), two), 30));
+	sine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s)), sineSign);
+	cosine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c)), cosineSign);
+}
+
+// Column col of four matrices from its rows, one instance per lane
+static void storeColumn(__m128 x, __m128 y, __m128 z, __m128 w, glm::mat4* matrices, int col)
+{
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_storeu_ps(&matrices[0][col][0], x);
+	_mm_storeu_ps(&matrices[1][col][0], y);
+	_mm_storeu_ps(&matrices[2][col][0], z);
+	_mm_storeu_ps(&matrices[3][col][0], w);
+}
+
+static int buildTRSBatch(const MatrixBatch::TRSArrays& instances, int count, glm::mat4* matrices)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 s, c;
+		sinCosDegrees(_mm_loadu_ps(instances.yaw + i), s, c);
+
+		__m128 sx = _mm_loadu_ps(instances.scaleX + i);
+		__m128 sy = _mm_loadu_ps(instances.scaleY + i);
+		__m128 sz = _mm_loadu_ps(instances.scaleZ + i);
+
+		storeColumn(_mm_mul_ps(sx, c), zero, _mm_xor_ps(_mm_mul_ps(sz, s), signBit), zero, matrices + i, 0);
+		storeColumn(zero, sy, zero, zero, matrices + i, 1);
+		storeColumn(_mm_mul_ps(sx, s), zero, _mm_mul_ps(sz, c), zero, matrices + i, 2);
+		storeColumn(_mm_loadu_ps(instances.positionX + i), _mm_loadu_ps(instances.positionY + i), _mm_loadu_ps(instances.positionZ + i), one, matrices + i, 3);
+	}
+	return i;
+}
+
+#ifndef MATRIX_BATCH_USE_AVX
+static void multiplyBatch(const glm::mat4& shared, const glm::mat4* matrices, int count, glm::mat4* results)
+{
+	const __m128 s0 = _mm_loadu_ps(&shared[0][0]);
+	const __m128 s1 = _mm_loadu_ps(&shared[1][0]);
+	const __m128 s2 = _mm_loadu_ps(&shared[2][0]);
+	const __m128 s3 = _mm_loadu_ps(&shared[3][0]);
+
+	for (int i = 0; i < count; i++)
+	{
+		for (int col = 0; col < 4; col++)
+		{
+			__m128 b = _mm_loadu_ps(&matrices[i][col][0]);
+			__m128 r = _mm_mul_ps(s0, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 0, 0, 0)));
+			r = _mm_add_ps(r, _mm_mul_ps(s1, _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 1, 1))));
+			r = _mm_add_ps(r, _mm_mul_ps(s2, _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 2, 2))));
+			r = _mm_add_ps(r, _mm_mul_ps(s3, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 3, 3))));
+			_mm_storeu_ps(&results[i][col][0], r);
+		}
+	}
+}
+#endif //MATRIX_BATCH_USE_AVX
+#endif //MATRIX_BATCH_USE_SSE
+
+#ifdef MATRIX_BATCH_USE_AVX
+//-----------------------------------------------------------------------------
+// AVX - the product only.  Eight lanes of translate * scale * rotate were
+// slower than four: without AVX2 the quadrant is float work and the
+// transposes cost more than they save.
+//-----------------------------------------------------------------------------
+// Two columns per register, the shared columns repeated in both halves
+static void multiplyBatch(const glm::mat4& shared, const glm::mat4* matrices, int count, glm::mat4* results)
+{
+	const __m256 s0 = _mm256_broadcast_ps((const __m128*)&shared[0][0]);
+	const __m256 s1 = _mm256_broadcast_ps((const __m128*)&shared[1][0]);
+	const __m256 s2 = _mm256_broadcast_ps((const __m128*)&shared[2][0]);
+	const __m256 s3 = _mm256_broadcast_ps((const __m128*)&shared[3][0]);
+
+	for (int i = 0; i < count; i++)
+	{
+		for (int col = 0; col < 4; col += 2)
+		{
+			__m256 b = _mm256_loadu_ps(&matrices[i][col][0]);
+			__m256 r = _mm256_mul_ps(s0, _mm256_shuffle_ps(b, b, _MM_SHUFFLE(0, 0, 0, 0)));
+			r = _mm256_add_ps(r, _mm256_mul_ps(s1, _mm256_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 1, 1))));
+			r = _mm256_add_ps(r, _mm256_mul_ps(s2, _mm256_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 2, 2))));
+			r = _mm256_add_ps(r, _mm256_mul_ps(s3, _mm256_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 3, 3))));
+			_mm256_storeu_ps(&results[i][col][0], r);
+		}
+	}
+}
+#endif //MATRIX_BATCH_USE_AVX
+
+//-----------------------------------------------------------------------------
+// Whole range on the calling thread without a job system
+//-----------------------------------------------------------------------------
+static void runJob(JobSystem* jobs, int count, const JobSystem::RangeJob& job)
+{
+	if (jobs != NULL)
+		jobs->parallelFor((unsigned int)count, MATRIX_GRAIN, job);
+	else if (count > 0)
+		job(0, (unsigned int)count, 0);
+}
+
+static void buildTRSRange(const MatrixBatch::TRSArrays& instances, int begin, int end, glm::mat4* matrices)
+{
+	MatrixBatch::TRSArrays range =
+	{
+		instances.positionX + begin, instances.positionY + begin, instances.positionZ + begin,
+		instances.yaw + begin,
+		instances.scaleX + begin, instances.scaleY + begin, instances.scaleZ + begin
+	};
+	int count = end - begin;
+
+	int i = 0;
+#ifdef MATRIX_BATCH_USE_SSE
+	i = buildTRSBatch(range, count, matrices + begin);
+#endif
+	for (; i < count; i++)
+		buildTRS(range, i, matrices[begin + i]);
+}
+
+static void multiplyRange(const glm::mat4& shared, const glm::mat4* matrices, int begin, int end, glm::mat4* results)
+{
+#if defined(MATRIX_BATCH_USE_AVX) || defined(MATRIX_BATCH_USE_SSE)
+	multiplyBatch(shared, matrices + begin, end - begin, results + begin);
+#else
+	for (int i = begin; i < end; i++)
+		results[i] = shared * matrices[i];
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// translate * scale * rotate about Y for count instances
+//-----------------------------------------------------------------------------
+void MatrixBatch::buildTRS(const TRSArrays& instances, int count, glm::mat4* matrices, JobSystem* jobs)
+{
+	runJob(jobs, count,
+		[&](unsigned int begin, unsigned int end, unsigned int)
+		{
+			buildTRSRange(instances, (int)begin, (int)end, matrices);
+		});
+}
+
+//-----------------------------------------------------------------------------
+// shared * matrices[i] for count matrices
+//-----------------------------------------------------------------------------
+void MatrixBatch::multiply(const glm::mat4& shared, const glm::mat4* matrices, int count, glm::mat4* results, JobSystem* jobs)
+{
+	runJob(jobs, count,
+		[&](unsigned int begin, unsigned int end, unsigned int)
+		{
+			multiplyRange(shared, matrices, (int)begin, (int)end, results);
+		});
+}
+
+const char* MatrixBatch::getInstructionSet()
+{
+#if defined(MATRIX_BATCH_USE_AVX)
+	return "avx";
+#elif defined(MATRIX_BATCH_USE_SSE)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,46 @@
+//-----------------------------------------------------------------------------
+// Batched matrix kernels - the matrices of many instances at once
+//
+// buildTRS() makes translate * scale * rotate about Y, the same matrix as
+// glm::translate * glm::scale * glm::rotate, from SoA arrays.  The yaw is in
+// degrees; it is reduced to a quarter turn in degrees, so whole angles stay
+// exact, and sine and cosine are polynomials within 2e-7 of sinf/cosf.
+//
+// multiply() computes shared * matrices[i] with the products in glm's order,
+// for premultiplying by a view-projection.  The output may be the input.
+//
+// Four instances per step with SSE2; with AVX at compile time (/arch:AVX,
+// -mavx) the product does two columns per instruction.  The last few
+// instances of an array go through the scalar code, which builds the same
+// results.  Given a job system, the arrays are split between its threads.
+//-----------------------------------------------------------------------------
+#ifndef MATRIX_BATCH_H
+#define MATRIX_BATCH_H
+
+#include "glm/glm.hpp"
+#include "JobSystem.h"
+
+
+class MatrixBatch
+{
+public:
+
+	// SoA arrays of count instances
+	struct TRSArrays
+	{
+		const float* positionX;
+		const float* positionY;
+		const float* positionZ;
+		const float* yaw;			// degrees
+		const float* scaleX;
+		const float* scaleY;
+		const float* scaleZ;
+	};
+
+	static void buildTRS(const TRSArrays& instances, int count, glm::mat4* matrices, JobSystem* jobs = NULL);
+	static void multiply(const glm::mat4& shared, const glm::mat4* matrices, int count, glm::mat4* results, JobSystem* jobs = NULL);
+
+	// "avx", "sse2" or "scalar"
+	static const char* getInstructionSet();
+};
+#endif //MATRIX_BATCH_H
@@ -0,0 +1,347 @@
+//-----------------------------------------------------------------------------
+// Memory accounting - CPU and GPU bytes per category
+//-----------------------------------------------------------------------------
+#include "MemoryTracker.h"
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+
+static const char* CATEGORY_NAMES[MemoryTracker::NUM_CATEGORIES] =
+{
+	"meshes", "textures", "scene", "terrain", "impostors",
+	"shadows", "lights", "gpu_driven", "frame_targets", "streaming",
+	"frame_arena"
+};
+
+// Assets listed by dump()
+static const size_t NUM_DUMPED_ASSETS = 10;
+
+// In front of every tagged block, keeps the block aligned like malloc's
+union BlockHeader
+{
+	size_t bytes;
+	std::max_align_t alignment;
+};
+
+struct GpuObject
+{
+	MemoryTracker::Category category;
+	long long bytes;
+	std::string asset;
+};
+
+struct AssetBytes
+{
+	MemoryTracker::Category category;
+	long long cpuBytes, gpuBytes;
+};
+
+typedef std::unordered_map<GLuint, GpuObject> GpuObjects;
+typedef std::unordered_map<std::string, AssetBytes> Assets;
+
+static std::mutex gMutex;
+static long long gCpuBytes[MemoryTracker::NUM_CATEGORIES];
+static long long gCpuPeakBytes[MemoryTracker::NUM_CATEGORIES];
+static long long gGpuBytes[MemoryTracker::NUM_CATEGORIES];
+static long long gGpuPeakBytes[MemoryTracker::NUM_CATEGORIES];
+static long long gCpuTotal = 0, gCpuPeakTotal = 0;
+static long long gGpuTotal = 0, gGpuPeakTotal = 0;
+static GpuObjects gBuffers;
+static GpuObjects gTextures;
+static GpuObjects gRenderbuffers;
+static Assets gAssets;
+
+//-----------------------------------------------------------------------------
+// Counters, with gMutex held
+//-----------------------------------------------------------------------------
+static void addCpuLocked(MemoryTracker::Category category, long long bytes)
+{
+	gCpuBytes[category] += bytes;
+	gCpuPeakBytes[category] = std::max(gCpuPeakBytes[category], gCpuBytes[category]);
+	gCpuTotal += bytes;
+	gCpuPeakTotal = std::max(gCpuPeakTotal, gCpuTotal);
+}
+
+static void addGpuLocked(MemoryTracker::Category category, long long bytes)
+{
+	gGpuBytes[category] += bytes;
+	gGpuPeakBytes[category] = std::max(gGpuPeakBytes[category], gGpuBytes[category]);
+	gGpuTotal += bytes;
+	gGpuPeakTotal = std::max(gGpuPeakTotal, gGpuTotal);
+}
+
+// An asset goes away when nothing is charged to it any more
+static void addAssetLocked(MemoryTracker::Category category, const std::string& asset, long long cpuBytes, long long gpuBytes)
+{
+	if (asset.empty())
+		return;
+
+	Assets::iterator it = gAssets.find(asset);
+	if (it == gAssets.end())
+	{
+		AssetBytes bytes = { category, 0, 0 };
+		it = gAssets.insert(std::make_pair(asset, bytes)).first;
+	}
+
+	it->second.cpuBytes += cpuBytes;
+	it->second.gpuBytes += gpuBytes;
+	if (it->second.cpuBytes == 0 && it->second.gpuBytes == 0)
+		gAssets.erase(it);
+}
+
+static void setObject(GpuObjects& objects, MemoryTracker::Category category, GLuint name, long long bytes, const char* asset)
+{
+	if (name == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(gMutex);
+	GpuObjects::iterator it = objects.find(name);
+	if (it != objects.end())
+	{
+		addGpuLocked(it->second.category, -it->second.bytes);
+		addAssetLocked(it->second.category, it->second.asset, 0, -it->second.bytes);
+		objects.erase(it);
+	}
+
+	GpuObject object = { category, bytes, asset != NULL ? asset : "" };
+	addGpuLocked(category, bytes);
+	addAssetLocked(category, object.asset, 0, bytes);
+	objects[name] = object;
+}
+
+static void releaseObjects(GpuObjects& objects, GLsizei count, const GLuint* names)
+{
+	std::lock_guard<std::mutex> lock(gMutex);
+	for (GLsizei i = 0; i < count; i++)
+	{
+		GpuObjects::iterator it = objects.find(names[i]);
+		if (it == objects.end())
+			continue;
+
+		addGpuLocked(it->second.category, -it->second.bytes);
+		addAssetLocked(it->second.category, it->second.asset, 0, -it->second.bytes);
+		objects.erase(it);
+	}
+}
+
+static void printRow(std::ostream& out, const char* name, long long cpuBytes, long long cpuPeakBytes, long long gpuBytes, long long gpuPeakBytes)
+{
+	out << "  " << std::left << std::setw(16) << name << std::right
+		<< std::setw(12) << (double)cpuBytes / 1024.0
+		<< std::setw(12) << (double)cpuPeakBytes / 1024.0
+		<< std::setw(12) << (double)gpuBytes / 1024.0
+		<< std::setw(12) << (double)gpuPeakBytes / 1024.0 << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+// Name of a category, as printed
+//-----------------------------------------------------------------------------
+const char* MemoryTracker::getCategoryName(Category category)
+{
+	return CATEGORY_NAMES[category];
+}
+
+//-----------------------------------------------------------------------------
+// CPU bytes kept or freed by a category, and by an asset
+//-----------------------------------------------------------------------------
+void MemoryTracker::addCpu(Category category, long long bytes, const char* asset)
+{
+	std::lock_guard<std::mutex> lock(gMutex);
+	addCpuLocked(category, bytes);
+	if (asset != NULL)
+		addAssetLocked(category, asset, bytes, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Tagged heap blocks: the size lives in a header in front of the block
+//-----------------------------------------------------------------------------
+void* MemoryTracker::allocate(Category category, size_t bytes)
+{
+	BlockHeader* header = (BlockHeader*)malloc(sizeof(BlockHeader) + bytes);
+	if (header == NULL)
+		return NULL;
+
+	header->bytes = bytes;
+	addCpu(category, (long long)bytes);
+	return header + 1;
+}
+
+void* MemoryTracker::reallocate(Category category, void* block, size_t bytes)
+{
+	if (block == NULL)
+		return allocate(category, bytes);
+
+	BlockHeader* header = (BlockHeader*)block - 1;
+	size_t oldBytes = header->bytes;
+	BlockHeader* newHeader = (BlockHeader*)realloc(header, sizeof(BlockHeader) + bytes);
+	if (newHeader == NULL)
+		return NULL;
+
+	newHeader->bytes = bytes;
+	addCpu(category, (long long)bytes - (long long)oldBytes);
+	return newHeader + 1;
+}
+
+void MemoryTracker::release(Category category, void* block)
+{
+	if (block == NULL)
+		return;
+
+	BlockHeader* header = (BlockHeader*)block - 1;
+	addCpu(category, -(long long)header->bytes);
+	free(header);
+}
+
+//-----------------------------------------------------------------------------
+// GPU objects, by name
+//-----------------------------------------------------------------------------
+void MemoryTracker::setBuffer(Category category, GLuint buffer, long long bytes, const char* asset)
+{
+	setObject(gBuffers, category, buffer, bytes, asset);
+}
+
+void MemoryTracker::setTexture(Category category, GLuint texture, long long bytes, const char* asset)
+{
+	setObject(gTextures, category, texture, bytes, asset);
+}
+
+void MemoryTracker::setRenderbuffer(Category category, GLuint renderbuffer, long long bytes, const char* asset)
+{
+	setObject(gRenderbuffers, category, renderbuffer, bytes, asset);
+}
+
+void MemoryTracker::releaseBuffers(GLsizei count, const GLuint* buffers)
+{
+	releaseObjects(gBuffers, count, buffers);
+}
+
+void MemoryTracker::releaseTextures(GLsizei count, const GLuint* textures)
+{
+	releaseObjects(gTextures, count, textures);
+}
+
+void MemoryTracker::releaseRenderbuffers(GLsizei count, const GLuint* renderbuffers)
+{
+	releaseObjects(gRenderbuffers, count, renderbuffers);
+}
+
+//-----------------------------------------------------------------------------
+// Bytes of a texture, the sum of its mip levels
+//-----------------------------------------------------------------------------
+long long MemoryTracker::getTextureBytes(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth, int levels)
+{
+	long long texelBytes = 4;
+	switch (internalFormat)
+	{
+	case GL_R8: case GL_RED:												texelBytes = 1; break;
+	case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16:					texelBytes = 2; break;
+	case GL_RGBA16: case GL_RGBA16F: case GL_RG32F: case GL_RG32UI:			texelBytes = 8; break;
+	case GL_RGBA32F: case GL_RGBA32UI:										texelBytes = 16; break;
+	}
+
+	if (levels <= 0)
+	{
+		levels = 1;
+		for (GLsizei size = std::max(width, height); size > 1; size /= 2)
+			levels++;
+	}
+
+	// Array layers are not halved with the levels
+	long long bytes = 0;
+	for (int level = 0; level < levels; level++)
+	{
+		bytes += texelBytes * width * height * depth;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	return bytes;
+}
+
+//-----------------------------------------------------------------------------
+// Totals of a category, or of everything
+//-----------------------------------------------------------------------------
+MemoryTracker::Totals MemoryTracker::getTotals(Category category)
+{
+	std::lock_guard<std::mutex> lock(gMutex);
+	Totals totals = { gCpuBytes[category], gCpuPeakBytes[category], gGpuBytes[category], gGpuPeakBytes[category] };
+	return totals;
+}
+
+MemoryTracker::Totals MemoryTracker::getTotals()
+{
+	std::lock_guard<std::mutex> lock(gMutex);
+	Totals totals = { gCpuTotal, gCpuPeakTotal, gGpuTotal, gGpuPeakTotal };
+	return totals;
+}
+
+//-----------------------------------------------------------------------------
+// Compares the GPU total to a budget
+//-----------------------------------------------------------------------------
+bool MemoryTracker::checkBudget(long long budgetBytes)
+{
+	Totals totals = getTotals();
+	if (totals.gpuBytes <= budgetBytes)
+		return true;
+
+	std::cerr << "GPU memory over budget: " << (double)totals.gpuBytes / (1024.0 * 1024.0) << " MB of "
+		<< (double)budgetBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Prints the categories, the totals then the NUM_DUMPED_ASSETS assets with
+// the most bytes, sizes in KB
+//-----------------------------------------------------------------------------
+void MemoryTracker::dump(std::ostream& out)
+{
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out.setf(std::ios::fixed);
+	out.precision(1);
+
+	out << "Memory (KB)" << std::endl
+		<< "  " << std::left << std::setw(16) << "category" << std::right
+		<< std::setw(12) << "cpu" << std::setw(12) << "cpu peak"
+		<< std::setw(12) << "gpu" << std::setw(12) << "gpu peak" << std::endl;
+
+	for (int c = 0; c < NUM_CATEGORIES; c++)
+	{
+		Totals totals = getTotals((Category)c);
+		printRow(out, CATEGORY_NAMES[c], totals.cpuBytes, totals.cpuPeakBytes, totals.gpuBytes, totals.gpuPeakBytes);
+	}
+
+	Totals totals = getTotals();
+	printRow(out, "total", totals.cpuBytes, totals.cpuPeakBytes, totals.gpuBytes, totals.gpuPeakBytes);
+
+	std::vector<std::pair<std::string, AssetBytes> > assets;
+	{
+		std::lock_guard<std::mutex> lock(gMutex);
+		assets.assign(gAssets.begin(), gAssets.end());
+	}
+	size_t numDumped = std::min(assets.size(), NUM_DUMPED_ASSETS);
+	std::partial_sort(assets.begin(), assets.begin() + numDumped, assets.end(),
+		[](const std::pair<std::string, AssetBytes>& a, const std::pair<std::string, AssetBytes>& b)
+		{ return a.second.cpuBytes + a.second.gpuBytes > b.second.cpuBytes + b.second.gpuBytes; });
+
+	if (numDumped > 0)
+	{
+		out << "Largest assets (KB)" << std::endl
+			<< "  " << std::left << std::setw(16) << "category" << std::right
+			<< std::setw(12) << "cpu" << std::setw(12) << "gpu" << "  asset" << std::endl;
+		for (size_t i = 0; i < numDumped; i++)
+		{
+			out << "  " << std::left << std::setw(16) << CATEGORY_NAMES[assets[i].second.category] << std::right
+				<< std::setw(12) << (double)assets[i].second.cpuBytes / 1024.0
+				<< std::setw(12) << (double)assets[i].second.gpuBytes / 1024.0 << "  " << assets[i].first << std::endl;
+		}
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
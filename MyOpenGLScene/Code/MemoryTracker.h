@@ -0,0 +1,89 @@
+//-----------------------------------------------------------------------------
+// Memory accounting - CPU and GPU bytes per category
+//
+// CPU: the loaders and subsystems add what they keep resident (and take it
+// back when they free it), and the transient buffers of a load while they
+// live, so the peak shows what loading costs on top.  stb_image allocates
+// through allocate()/reallocate()/release(), which put the size in a header
+// in front of the block.
+//
+// GPU: every buffer, texture and renderbuffer is registered by name with the
+// bytes of its storage when it is (re)specified, and removed when deleted.
+// Sizes are computed from the formats, with mipmap chains, without what the
+// driver adds for alignment or compression.
+//
+// Bytes can also be tagged with the asset they belong to, the file a mesh or
+// a texture was loaded from, to find the few that weigh the most.
+//
+// dump() prints the current and peak bytes per category and the largest
+// assets, checkBudget() tells whether the GPU total fits a budget.  Thread
+// safe.
+//-----------------------------------------------------------------------------
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <iosfwd>
+#include <cstddef>
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+
+class MemoryTracker
+{
+public:
+
+	enum Category
+	{
+		MESHES,
+		TEXTURES,
+		SCENE,				// scene file, transforms
+		TERRAIN,
+		IMPOSTORS,
+		SHADOWS,
+		LIGHTS,
+		GPU_DRIVEN,
+		FRAME_TARGETS,		// G-buffer
+		STREAMING,			// ring buffers: grass, instances, clusters
+		FRAME_ARENA,		// blocks of the per-frame scratch memory
+		NUM_CATEGORIES
+	};
+
+	struct Totals
+	{
+		long long cpuBytes, cpuPeakBytes;
+		long long gpuBytes, gpuPeakBytes;
+	};
+
+	static const char* getCategoryName(Category category);
+
+	// CPU, bytes may be negative to release.  asset, when given, is also
+	// charged: release with the same name.
+	static void addCpu(Category category, long long bytes, const char* asset = NULL);
+
+	// Tagged heap blocks, for the libraries that take allocation hooks
+	static void* allocate(Category category, size_t bytes);
+	static void* reallocate(Category category, void* block, size_t bytes);
+	static void release(Category category, void* block);
+
+	// GPU, setting an object again replaces its previous size and asset.  The
+	// asset is charged until the object is released.
+	static void setBuffer(Category category, GLuint buffer, long long bytes, const char* asset = NULL);
+	static void setTexture(Category category, GLuint texture, long long bytes, const char* asset = NULL);
+	static void setRenderbuffer(Category category, GLuint renderbuffer, long long bytes, const char* asset = NULL);
+	static void releaseBuffers(GLsizei count, const GLuint* buffers);
+	static void releaseTextures(GLsizei count, const GLuint* textures);
+	static void releaseRenderbuffers(GLsizei count, const GLuint* renderbuffers);
+
+	// Bytes of a texture of levels mip levels, 0 for the full chain
+	static long long getTextureBytes(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth, int levels);
+
+	static Totals getTotals(Category category);
+	static Totals getTotals();
+
+	// False, with a message, if the GPU total is over budgetBytes
+	static bool checkBudget(long long budgetBytes);
+
+	// Current and peak per category then the largest assets, in KB
+	static void dump(std::ostream& out);
+};
+#endif //MEMORY_TRACKER_H
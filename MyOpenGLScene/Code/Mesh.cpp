@@ -5,6 +5,10 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <cstdlib>
+#include "GLStats.h"
+#include "LoadStats.h"
+#include "MemoryTracker.h"
 
 
 //-----------------------------------------------------------------------------
@@ -37,7 +41,13 @@ std::vector<std::string> split(std::string s, std::string t)
 // Constructor
 //-----------------------------------------------------------------------------
 Mesh::Mesh()
-	:mLoaded(false)
+	:mLoaded(false),
+	 mVBO(0),
+	 mVAO(0),
+	 mPositionVBO(0),
+	 mPositionVAO(0),
+	 mBoundsMin(0.0f),
+	 mBoundsMax(0.0f)
 {
 }
 
@@ -46,8 +56,15 @@ Mesh::Mesh()
 //-----------------------------------------------------------------------------
 Mesh::~Mesh()
 {
+	if (mLoaded)
+		MemoryTracker::addCpu(MemoryTracker::MESHES, -(long long)(mVertices.capacity() * sizeof(Vertex)), mFilename.c_str());
+	MemoryTracker::releaseBuffers(1, &mVBO);
+	MemoryTracker::releaseBuffers(1, &mPositionVBO);
+
 	glDeleteVertexArrays(1, &mVAO);
 	glDeleteBuffers(1, &mVBO);
+	glDeleteVertexArrays(1, &mPositionVAO);
+	glDeleteBuffers(1, &mPositionVBO);
 }
 
 //-----------------------------------------------------------------------------
@@ -62,137 +79,181 @@ Mesh::~Mesh()
 //  - only commands "v", "vt" and "f" are supported
 //-----------------------------------------------------------------------------
 bool Mesh::loadOBJ(const std::string& filename)
+{
+	if (filename.find(".obj") == std::string::npos)
+		return false;
+
+	LoadTimer timer("mesh", filename);
+	mFilename = filename;
+
+	// The whole file first, so reading and parsing are timed apart
+	std::ifstream file(filename, std::ios::in);
+	if (!file)
+	{
+		std::cerr << "Cannot open " << filename << std::endl;
+		return false;
+	}
+
+	std::cout << "Loading OBJ file " << filename << " ..." << std::endl;
+
+	std::stringstream fin;
+	fin << file.rdbuf();
+	file.close();
+	long long textBytes = (long long)fin.tellp();
+	timer.addBytesIn((unsigned long long)textBytes);
+	timer.endStage(LoadStats::READ);
+
+	// The text lives until the vertices are built
+	MemoryTracker::addCpu(MemoryTracker::MESHES, textBytes);
+	bool parsed = parseOBJ(fin, mVertices, &timer);
+	MemoryTracker::addCpu(MemoryTracker::MESHES, -textBytes);
+	if (!parsed)
+	{
+		std::cerr << filename << " has no triangles" << std::endl;
+		return false;
+	}
+
+	computeBounds();
+	timer.endStage(LoadStats::POST_PROCESS);
+
+	// Create and initialize the buffers (interleaved, then positions only)
+	initBuffers();
+	timer.addBytesOut(mVertices.size() * (sizeof(Vertex) + sizeof(glm::vec3)));
+	timer.endStage(LoadStats::UPLOAD);
+
+	// The vertices stay for the bounds, occluders and impostor baking
+	MemoryTracker::addCpu(MemoryTracker::MESHES, (long long)(mVertices.capacity() * sizeof(Vertex)), mFilename.c_str());
+
+	timer.setSucceeded();
+	return (mLoaded = true);
+}
+
+//-----------------------------------------------------------------------------
+// Parses OBJ text into one vertex per triangle corner, appended to vertices.
+// No GL: the microbenchmarks run it without a context.  With a timer, the
+// parsing and the vertex expansion are charged to their stages.
+//-----------------------------------------------------------------------------
+bool Mesh::parseOBJ(std::istream& in, std::vector<Vertex>& vertices, LoadTimer* timer)
 {
 	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
 	std::vector<glm::vec3> tempVertices;
 	std::vector<glm::vec2> tempUVs;
 	std::vector<glm::vec3> tempNormals;
 
-
-	if (filename.find(".obj") != std::string::npos)
+	std::string lineBuffer;
+	while (std::getline(in, lineBuffer))
 	{
-		std::ifstream fin(filename, std::ios::in);
-		if (!fin)
-		{
-			std::cerr << "Cannot open " << filename << std::endl;
-			return false;
-		}
-
-		std::cout << "Loading OBJ file " << filename << " ..." << std::endl;
+		std::stringstream ss(lineBuffer);
+		std::string cmd;
+		ss >> cmd;
 
-		std::string lineBuffer;
-		while (std::getline(fin, lineBuffer))
+		if (cmd == "v")
 		{
-			std::stringstream ss(lineBuffer);
-			std::string cmd;
-			ss >> cmd;
+			glm::vec3 vertex;
+			int dim = 0;
+			while (dim < 3 && ss >> vertex[dim])
+				dim++;
 
-			if (cmd == "v")
-			{
-				glm::vec3 vertex;
-				int dim = 0;
-				while (dim < 3 && ss >> vertex[dim])
-					dim++;
+			tempVertices.push_back(vertex);
+		}
+		else if (cmd == "vt")
+		{
+			glm::vec2 uv;
+			int dim = 0;
+			while (dim < 2 && ss >> uv[dim])
+				dim++;
+			
+			tempUVs.push_back(uv);
+		}
+		else if (cmd == "vn")
+		{
+			glm::vec3 normal;
+			int dim = 0;
+			while (dim < 3 && ss >> normal[dim])
+				dim++;
+			normal = glm::normalize(normal);
+			tempNormals.push_back(normal);
+		}
+		else if (cmd == "f")
+		{
+			std::string faceData;
+			int vertexIndex, uvIndex, normalIndex;
 
-				tempVertices.push_back(vertex);
-			}
-			else if (cmd == "vt")
-			{
-				glm::vec2 uv;
-				int dim = 0;
-				while (dim < 2 && ss >> uv[dim])
-					dim++;
-				
-				tempUVs.push_back(uv);
-			}
-			else if (cmd == "vn")
+			while (ss>>faceData)
 			{
-				glm::vec3 normal;
-				int dim = 0;
-				while (dim < 3 && ss >> normal[dim])
-					dim++;
-				normal = glm::normalize(normal);
-				tempNormals.push_back(normal);
-			}
-			else if (cmd == "f")
-			{
-				std::string faceData;
-				int vertexIndex, uvIndex, normalIndex;
+				std::vector<std::string> data = split(faceData, "/");
 
-				while (ss>>faceData)
+				if (data[0].size() > 0)
 				{
-					std::vector<std::string> data = split(faceData, "/");
-
-					if (data[0].size() > 0)
-					{
-						sscanf_s(data[0].c_str(), "%d", &vertexIndex);
-						vertexIndices.push_back(vertexIndex);
-					}
+					vertexIndex = atoi(data[0].c_str());
+					vertexIndices.push_back(vertexIndex);
+				}
 
-					if (data.size() >= 1)
+				if (data.size() >= 1)
+				{
+					// Is face format v//vn?  If data[1] is empty string then
+					// this vertex has no texture coordinate
+					if (data[1].size() > 0)
 					{
-						// Is face format v//vn?  If data[1] is empty string then
-						// this vertex has no texture coordinate
-						if (data[1].size() > 0)
-						{
-							sscanf_s(data[1].c_str(), "%d", &uvIndex);
-							uvIndices.push_back(uvIndex);
-						}
+						uvIndex = atoi(data[1].c_str());
+						uvIndices.push_back(uvIndex);
 					}
-					
-					if (data.size() >= 2)
+				}
+				
+				if (data.size() >= 2)
+				{
+					// Does this vertex have a normal?
+					if (data[2].size() > 0)
 					{
-						// Does this vertex have a normal?
-						if (data[2].size() > 0)
-						{
-							sscanf_s(data[2].c_str(), "%d", &normalIndex);
-							normalIndices.push_back(normalIndex);
-						}
+						normalIndex = atoi(data[2].c_str());
+						normalIndices.push_back(normalIndex);
 					}
 				}
 			}
 		}
+	}
 
-		// Close the file
-		fin.close();
-
-
-		// For each vertex of each triangle
-		for (unsigned int i = 0; i < vertexIndices.size(); i++)
-		{
-			Vertex meshVertex;
-
-			// Get the attributes using the indices
+	if (timer != NULL)
+		timer->endStage(LoadStats::PARSE);
 
-			if (tempVertices.size() > 0)
-			{
-				glm::vec3 vertex = tempVertices[vertexIndices[i] - 1];
-				meshVertex.position = vertex;
-			}
+	// For each vertex of each triangle
+	for (unsigned int i = 0; i < vertexIndices.size(); i++)
+	{
+		Vertex meshVertex;
 
-			if (tempNormals.size() > 0)
-			{
-				glm::vec3 normal = tempNormals[normalIndices[i] - 1];
-				meshVertex.normal = normal;
-			}
+		// Get the attributes using the indices
 
-			if (tempUVs.size() > 0)
-			{
-				glm::vec2 uv = tempUVs[uvIndices[i] - 1];
-				meshVertex.texCoords = uv;
-			}
+		if (tempVertices.size() > 0)
+		{
+			glm::vec3 vertex = tempVertices[vertexIndices[i] - 1];
+			meshVertex.position = vertex;
+		}
 
-			mVertices.push_back(meshVertex);
+		if (tempNormals.size() > 0)
+		{
+			glm::vec3 normal = tempNormals[normalIndices[i] - 1];
+			meshVertex.normal = normal;
 		}
 
-		// Create and initialize the buffers
-		initBuffers();
+		if (tempUVs.size() > 0)
+		{
+			glm::vec2 uv = tempUVs[uvIndices[i] - 1];
+			meshVertex.texCoords = uv;
+		}
 
-		return (mLoaded = true);
+		vertices.push_back(meshVertex);
 	}
 
-	// We shouldn't get here so return failure
-	return false;
+	// The OBJ arrays are freed on return: they count for the peak only, the
+	// caller counts the vertices it keeps
+	long long transientBytes = (long long)((vertexIndices.capacity() + uvIndices.capacity() + normalIndices.capacity()) * sizeof(unsigned int))
+		+ (long long)((tempVertices.capacity() + tempNormals.capacity()) * sizeof(glm::vec3))
+		+ (long long)(tempUVs.capacity() * sizeof(glm::vec2))
+		+ (long long)(vertices.capacity() * sizeof(Vertex));
+	MemoryTracker::addCpu(MemoryTracker::MESHES, transientBytes);
+	MemoryTracker::addCpu(MemoryTracker::MESHES, -transientBytes);
+
+	return !vertices.empty();
 }
 
 //-----------------------------------------------------------------------------
@@ -207,6 +268,7 @@ void Mesh::initBuffers()
 	glBindVertexArray(mVAO);
 	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
 	glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(Vertex), &mVertices[0], GL_STATIC_DRAW);
+	MemoryTracker::setBuffer(MemoryTracker::MESHES, mVBO, mVertices.size() * sizeof(Vertex), mFilename.c_str());
 
 	// Vertex Positions
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
@@ -219,11 +281,42 @@ void Mesh::initBuffers()
 	// Vertex Texture Coords
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(6 * sizeof(GLfloat)));
 	glEnableVertexAttribArray(2);
+
+	// Position only stream for depth passes - a third of the vertex fetch
+	std::vector<glm::vec3> positions(mVertices.size());
+	for (size_t i = 0; i < mVertices.size(); i++)
+		positions[i] = mVertices[i].position;
+
+	glGenVertexArrays(1, &mPositionVAO);
+	glGenBuffers(1, &mPositionVBO);
+
+	glBindVertexArray(mPositionVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, mPositionVBO);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+	MemoryTracker::setBuffer(MemoryTracker::MESHES, mPositionVBO, positions.size() * sizeof(glm::vec3), mFilename.c_str());
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (GLvoid*)0);
+	glEnableVertexAttribArray(0);
 	
 	// unbind to make sure other code does not change it somewhere else
 	glBindVertexArray(0);
 }
 
+//-----------------------------------------------------------------------------
+// Computes the object space bounding box of the loaded vertices
+//-----------------------------------------------------------------------------
+void Mesh::computeBounds()
+{
+	if (mVertices.empty())
+		return;
+
+	mBoundsMin = mBoundsMax = mVertices[0].position;
+	for (size_t i = 1; i < mVertices.size(); i++)
+	{
+		mBoundsMin = glm::min(mBoundsMin, mVertices[i].position);
+		mBoundsMax = glm::max(mBoundsMax, mVertices[i].position);
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Render the mesh
 //-----------------------------------------------------------------------------
@@ -236,3 +329,36 @@ void Mesh::draw()
 	glBindVertexArray(0);
 }
 
+//-----------------------------------------------------------------------------
+// Render several instances of the mesh in one call
+//-----------------------------------------------------------------------------
+void Mesh::drawInstanced(GLuint instanceBuffer, GLuint first, GLsizei count)
+{
+	drawInstances(mVAO, instanceBuffer, first, count);
+}
+
+//-----------------------------------------------------------------------------
+// Render several instances of the mesh, positions only
+//-----------------------------------------------------------------------------
+void Mesh::drawDepthInstanced(GLuint instanceBuffer, GLuint first, GLsizei count)
+{
+	drawInstances(mPositionVAO, instanceBuffer, first, count);
+}
+
+//-----------------------------------------------------------------------------
+// Instanced draw with the given vertex array
+//-----------------------------------------------------------------------------
+void Mesh::drawInstances(GLuint vao, GLuint instanceBuffer, GLuint first, GLsizei count)
+{
+	if (!mLoaded || count <= 0) return;
+
+	glBindVertexArray(vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid*)(first * sizeof(GLuint)));
+	glVertexAttribDivisor(3, 1);
+	glEnableVertexAttribArray(3);
+
+	glDrawArraysInstanced(GL_TRIANGLES, 0, mVertices.size(), count);
+	glBindVertexArray(0);
+}
@@ -6,12 +6,18 @@
 
 #include <vector>
 #include <string>
+#include <iosfwd>
 
 #define GLEW_STATIC
 #include "GL/glew.h"	// Important - this header must come before glfw3 header
 #include "glm/glm.hpp"
 
 
+class LoadTimer;
+
+// Splits s at every occurrence of t (the OBJ face tokenizer)
+std::vector<std::string> split(std::string s, std::string t);
+
 struct Vertex
 {
 	glm::vec3 position;
@@ -27,14 +33,36 @@ public:
 	~Mesh();
 
 	bool loadOBJ(const std::string& filename);
+
+	// The CPU half of loadOBJ, false if there are no triangles
+	static bool parseOBJ(std::istream& in, std::vector<Vertex>& vertices, LoadTimer* timer = NULL);
+
 	void draw();
 
+	// Draws count instances whose per-instance attribute (location 3, one
+	// GLuint each) starts at element first of instanceBuffer
+	void drawInstanced(GLuint instanceBuffer, GLuint first, GLsizei count);
+
+	// Same with only the positions (location 0) - for depth only passes
+	void drawDepthInstanced(GLuint instanceBuffer, GLuint first, GLsizei count);
+
+	const std::vector<Vertex>& getVertices() const { return mVertices; }
+
+	// Object space axis aligned bounding box
+	const glm::vec3& getBoundsMin() const { return mBoundsMin; }
+	const glm::vec3& getBoundsMax() const { return mBoundsMax; }
+
 private:
 
 	void initBuffers();
+	void computeBounds();
+	void drawInstances(GLuint vao, GLuint instanceBuffer, GLuint first, GLsizei count);
 
 	bool mLoaded;
+	std::string mFilename;		// the asset its memory is charged to
 	std::vector<Vertex> mVertices;
 	GLuint mVBO, mVAO;
+	GLuint mPositionVBO, mPositionVAO;	// tightly packed positions
+	glm::vec3 mBoundsMin, mBoundsMax;
 };
 #endif //MESH_H
@@ -0,0 +1,656 @@
+//-----------------------------------------------------------------------------
+// MicroBench - timing loops for the CPU hot paths, no GL context needed
+//
+// Every case is calibrated first: the iterations of one sample are doubled
+// until a sample takes TARGET_SAMPLE_MS.  Then WARMUP_SAMPLES are thrown away
+// and the samples are timed.  Results are ns per operation (an operation is
+// one parse, one lookup, one matrix...): median, mean, min, standard
+// deviation and median absolute deviation.  Compare medians between commits,
+// a MAD above a few percent of the median means the machine was busy.
+//
+//   MicroBench [--filter text] [--samples n] [--json file]
+//
+// --json writes the results for scripts to track between commits.
+//-----------------------------------------------------------------------------
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "Mesh.h"
+#include "Texture2D.h"
+#include "ShaderProgram.h"
+#include "Frustum.h"
+#include "TransformSystem.h"
+#include "MatrixBatch.h"
+#include "JobSystem.h"
+#include "OcclusionCuller.h"
+
+
+const double TARGET_SAMPLE_MS = 20.0;
+const int WARMUP_SAMPLES = 2;
+const int DEFAULT_SAMPLES = 15;
+
+// Instances of the matrix and culling cases
+const int NUM_OBJECTS = 10000;
+
+// Instances of the batched matrix cases, a scene's worth of scattered ones
+const int NUM_BATCH_INSTANCES = 262144;
+
+// Largest difference to glm the batched matrices may have
+const float MATRIX_BATCH_EPSILON = 1e-4f;
+
+// Results go here so the loops can not be optimized away
+static volatile unsigned long long gSink = 0;
+
+//-----------------------------------------------------------------------------
+// A case runs its operation iterations times, operations counts the work of
+// one iteration
+//-----------------------------------------------------------------------------
+struct BenchCase
+{
+	std::string name;
+	long long operations;
+	std::function<void(long long iterations)> run;
+};
+
+struct BenchResult
+{
+	std::string name;
+	long long iterations;
+	double median, mean, min, stddev, mad;		// ns per operation
+};
+
+static double nowNs()
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	size_t n = values.size();
+	return n % 2 == 1 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+//-----------------------------------------------------------------------------
+// Calibrates, warms up and times one case
+//-----------------------------------------------------------------------------
+static BenchResult runCase(const BenchCase& bench, int samples)
+{
+	long long iterations = 1;
+	for (;;)
+	{
+		double start = nowNs();
+		bench.run(iterations);
+		double ms = (nowNs() - start) * 1e-6;
+		if (ms >= TARGET_SAMPLE_MS || iterations >= (1LL << 40))
+			break;
+
+		// Straight to the target once the timer is reliable
+		iterations = ms > 1.0 ? (long long)std::ceil(iterations * TARGET_SAMPLE_MS / ms) : iterations * 2;
+	}
+
+	for (int i = 0; i < WARMUP_SAMPLES; i++)
+		bench.run(iterations);
+
+	std::vector<double> times;
+	double operations = (double)iterations * (double)bench.operations;
+	for (int i = 0; i < samples; i++)
+	{
+		double start = nowNs();
+		bench.run(iterations);
+		times.push_back((nowNs() - start) / operations);
+	}
+
+	BenchResult result;
+	result.name = bench.name;
+	result.iterations = iterations;
+	result.median = median(times);
+	result.min = *std::min_element(times.begin(), times.end());
+
+	double sum = 0.0;
+	for (size_t i = 0; i < times.size(); i++)
+		sum += times[i];
+	result.mean = sum / times.size();
+
+	double squares = 0.0;
+	std::vector<double> deviations;
+	for (size_t i = 0; i < times.size(); i++)
+	{
+		squares += (times[i] - result.mean) * (times[i] - result.mean);
+		deviations.push_back(fabs(times[i] - result.median));
+	}
+	result.stddev = times.size() > 1 ? sqrt(squares / (times.size() - 1)) : 0.0;
+	result.mad = median(deviations);
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// A square grid as OBJ text, 2 * quads * quads triangles in v/vt/vn faces
+//-----------------------------------------------------------------------------
+static std::string makeGridOBJ(int quads)
+{
+	std::ostringstream out;
+	out << "# " << 2 * quads * quads << " triangles\n";
+	for (int z = 0; z <= quads; z++)
+		for (int x = 0; x <= quads; x++)
+			out << "v " << x * 0.5f << " " << sinf(x * 0.3f) * cosf(z * 0.2f) << " " << z * 0.5f << "\n";
+	for (int z = 0; z <= quads; z++)
+		for (int x = 0; x <= quads; x++)
+			out << "vt " << (float)x / quads << " " << (float)z / quads << "\n";
+	out << "vn 0 1 0\n";
+
+	for (int z = 0; z < quads; z++)
+	{
+		for (int x = 0; x < quads; x++)
+		{
+			int i0 = z * (quads + 1) + x + 1;
+			int i1 = i0 + 1;
+			int i2 = i0 + quads + 1;
+			int i3 = i2 + 1;
+			out << "f " << i0 << "/" << i0 << "/1 " << i2 << "/" << i2 << "/1 " << i1 << "/" << i1 << "/1\n";
+			out << "f " << i1 << "/" << i1 << "/1 " << i2 << "/" << i2 << "/1 " << i3 << "/" << i3 << "/1\n";
+		}
+	}
+	return out.str();
+}
+
+//-----------------------------------------------------------------------------
+// Same seed every run: the cases see the same data on every machine
+//-----------------------------------------------------------------------------
+static float random01(unsigned int& state)
+{
+	state = state * 1664525u + 1013904223u;
+	return (float)(state >> 8) / 16777216.0f;
+}
+
+//-----------------------------------------------------------------------------
+// Instances for the batched matrices, yaws over two turns either way
+//-----------------------------------------------------------------------------
+struct BatchInstances
+{
+	std::vector<float> x, y, z, yaw, scaleX, scaleY, scaleZ;
+
+	explicit BatchInstances(int count) : x(count), y(count), z(count), yaw(count), scaleX(count), scaleY(count), scaleZ(count)
+	{
+		unsigned int state = 3;
+		for (int i = 0; i < count; i++)
+		{
+			x[i] = random01(state) * 400.0f - 200.0f;
+			y[i] = random01(state) * 10.0f;
+			z[i] = random01(state) * 400.0f - 200.0f;
+			yaw[i] = random01(state) * 1440.0f - 720.0f;
+			scaleX[i] = 0.5f + random01(state);
+			scaleY[i] = 0.5f + random01(state);
+			scaleZ[i] = 0.5f + random01(state);
+		}
+	}
+
+	MatrixBatch::TRSArrays getArrays() const
+	{
+		MatrixBatch::TRSArrays arrays = { &x[0], &y[0], &z[0], &yaw[0], &scaleX[0], &scaleY[0], &scaleZ[0] };
+		return arrays;
+	}
+
+	glm::mat4 getGlmMatrix(int i) const
+	{
+		return glm::translate(glm::mat4(1.0f), glm::vec3(x[i], y[i], z[i])) *
+			glm::scale(glm::mat4(1.0f), glm::vec3(scaleX[i], scaleY[i], scaleZ[i])) *
+			glm::rotate(glm::mat4(1.0f), glm::radians(yaw[i]), glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+};
+
+static glm::mat4 getBenchViewProjection()
+{
+	return glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 600.0f) *
+		glm::lookAt(glm::vec3(-80.0f, 50.0f, 80.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+static float maxDifference(const glm::mat4& a, const glm::mat4& b)
+{
+	float difference = 0.0f;
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 4; r++)
+			difference = std::max(difference, fabsf(a[c][r] - b[c][r]));
+	return difference;
+}
+
+//-----------------------------------------------------------------------------
+// The batched matrices against glm, false if they differ by more than
+// MATRIX_BATCH_EPSILON
+//-----------------------------------------------------------------------------
+static bool checkMatrixBatch()
+{
+	BatchInstances instances(NUM_BATCH_INSTANCES);
+	std::vector<glm::mat4> matrices(NUM_BATCH_INSTANCES), results(NUM_BATCH_INSTANCES);
+	MatrixBatch::buildTRS(instances.getArrays(), NUM_BATCH_INSTANCES, &matrices[0]);
+
+	glm::mat4 viewProjection = getBenchViewProjection();
+	MatrixBatch::multiply(viewProjection, &matrices[0], NUM_BATCH_INSTANCES, &results[0]);
+
+	float trsError = 0.0f, productError = 0.0f;
+	for (int i = 0; i < NUM_BATCH_INSTANCES; i++)
+	{
+		trsError = std::max(trsError, maxDifference(matrices[i], instances.getGlmMatrix(i)));
+		productError = std::max(productError, maxDifference(results[i], viewProjection * matrices[i]));
+	}
+
+	std::cout << "MatrixBatch (" << MatrixBatch::getInstructionSet() << "): largest difference to glm "
+		<< trsError << " for translate * scale * rotate, " << productError << " for the product" << std::endl;
+	if (trsError > MATRIX_BATCH_EPSILON || productError > MATRIX_BATCH_EPSILON)
+	{
+		std::cerr << "MatrixBatch differs from glm by more than " << MATRIX_BATCH_EPSILON << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// A 20 x 20 wall at z = 0 split in 2 x 2 cells, seen from z = 30: a box
+// behind it must be culled, one in front of it and one beside it not
+//-----------------------------------------------------------------------------
+static bool checkOcclusionCuller()
+{
+	std::vector<Vertex> wall;
+	for (int cy = 0; cy < 2; cy++)
+	{
+		for (int cx = 0; cx < 2; cx++)
+		{
+			glm::vec3 a(-10.0f + cx * 10.0f, -10.0f + cy * 10.0f, 0.0f);
+			glm::vec3 corners[6] = { a, a + glm::vec3(10.0f, 0.0f, 0.0f), a + glm::vec3(10.0f, 10.0f, 0.0f),
+			                         a, a + glm::vec3(10.0f, 10.0f, 0.0f), a + glm::vec3(0.0f, 10.0f, 0.0f) };
+			for (int v = 0; v < 6; v++)
+			{
+				Vertex vertex;
+				vertex.position = corners[v];
+				vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+				vertex.texCoords = glm::vec2(0.0f);
+				wall.push_back(vertex);
+			}
+		}
+	}
+
+	JobSystem jobs;
+	jobs.init();
+	OcclusionCuller culler;
+	int wallId = culler.addOccluderMesh(wall);
+	culler.beginFrame(glm::perspective(glm::radians(45.0f), 2.0f, 0.1f, 100.0f) *
+		glm::lookAt(glm::vec3(0.0f, 0.0f, 30.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+	culler.addOccluder(wallId, glm::mat4(1.0f));
+	culler.rasterize(jobs);
+
+	glm::vec3 boxMin(-1.0f), boxMax(1.0f);
+	bool behind = culler.isVisible(boxMin, boxMax, glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 1.0f, -5.0f)));
+	bool inFront = culler.isVisible(boxMin, boxMax, glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 1.0f, 5.0f)));
+	bool beside = culler.isVisible(boxMin, boxMax, glm::translate(glm::mat4(1.0f), glm::vec3(16.0f, 0.0f, -5.0f)));
+
+	std::cout << "OcclusionCuller: box behind the wall " << (behind ? "visible" : "culled")
+		<< ", in front " << (inFront ? "visible" : "culled") << ", beside " << (beside ? "visible" : "culled") << std::endl;
+	if (behind || !inFront || !beside)
+	{
+		std::cerr << "OcclusionCuller should only cull the box behind the wall" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// The cases
+//-----------------------------------------------------------------------------
+static void addMeshCases(std::vector<BenchCase>& cases)
+{
+	const int sizes[3] = { 22, 71, 224 };		// about 1k, 10k and 100k triangles
+	for (int s = 0; s < 3; s++)
+	{
+		std::string text = makeGridOBJ(sizes[s]);
+		BenchCase bench;
+		bench.name = "mesh/parseOBJ/" + std::to_string(2 * sizes[s] * sizes[s]) + "_triangles";
+		bench.operations = 1;
+		bench.run = [text](long long iterations)
+		{
+			std::vector<Vertex> vertices;
+			for (long long i = 0; i < iterations; i++)
+			{
+				std::istringstream in(text);
+				vertices.clear();
+				Mesh::parseOBJ(in, vertices);
+				gSink += vertices.size();
+			}
+		};
+		cases.push_back(bench);
+	}
+
+	BenchCase bench;
+	bench.name = "mesh/split/face_corner";
+	bench.operations = 1;
+	bench.run = [](long long iterations)
+	{
+		for (long long i = 0; i < iterations; i++)
+			gSink += split("10423/10424/187", "/").size();
+	};
+	cases.push_back(bench);
+}
+
+static void addTextureCases(std::vector<BenchCase>& cases)
+{
+	const int sizes[2] = { 1024, 2048 };
+	for (int s = 0; s < 2; s++)
+	{
+		int size = sizes[s];
+		std::shared_ptr<std::vector<unsigned char> > image(new std::vector<unsigned char>((size_t)size * size * 4));
+		for (size_t i = 0; i < image->size(); i++)
+			(*image)[i] = (unsigned char)(i * 31);
+
+		BenchCase bench;
+		bench.name = "texture/flipRows/" + std::to_string(size) + "x" + std::to_string(size);
+		bench.operations = 1;
+		bench.run = [image, size](long long iterations)
+		{
+			for (long long i = 0; i < iterations; i++)
+				Texture2D::flipRows(&(*image)[0], size * 4, size);
+			gSink += (*image)[0];
+		};
+		cases.push_back(bench);
+	}
+}
+
+static void addShaderCases(std::vector<BenchCase>& cases)
+{
+	// Names like the ones the scene sets every frame.  Without a program the
+	// locations are -1, the lookups are the same.
+	static const char* NAMES[] =
+	{
+		"model", "view", "projection", "viewPos", "time",
+		"material.ambient", "material.diffuseMap", "material.specular", "material.shininess",
+		"sunLight.direction", "sunLight.ambient", "sunLight.diffuse", "sunLight.specular",
+		"spotLight.position", "spotLight.direction", "spotLight.cosInnerCone", "spotLight.cosOuterCone", "spotLight.on",
+		"shadowMap", "cascadeMatrices[0]", "cascadeSplits", "clusterGrid", "clusterIndices", "lights"
+	};
+	const int numNames = sizeof(NAMES) / sizeof(NAMES[0]);
+
+	std::shared_ptr<ShaderProgram> shader(new ShaderProgram());
+	for (int i = 0; i < numNames; i++)
+		shader->getUniformLocation(NAMES[i]);
+
+	BenchCase bench;
+	bench.name = "shader/getUniformLocation/cached";
+	bench.operations = numNames;
+	bench.run = [shader, numNames](long long iterations)
+	{
+		for (long long i = 0; i < iterations; i++)
+			for (int n = 0; n < numNames; n++)
+				gSink += (unsigned long long)shader->getUniformLocation(NAMES[n]);
+	};
+	cases.push_back(bench);
+}
+
+static void addMatrixCases(std::vector<BenchCase>& cases)
+{
+	unsigned int state = 1;
+	std::shared_ptr<std::vector<glm::vec4> > objects(new std::vector<glm::vec4>(NUM_OBJECTS));	// x, y, z, yaw
+	for (int i = 0; i < NUM_OBJECTS; i++)
+		(*objects)[i] = glm::vec4(random01(state) * 400.0f - 200.0f, random01(state) * 10.0f, random01(state) * 400.0f - 200.0f, random01(state) * 360.0f);
+
+	BenchCase chained;
+	chained.name = "math/model_matrix/glm_chained";
+	chained.operations = NUM_OBJECTS;
+	chained.run = [objects](long long iterations)
+	{
+		float sum = 0.0f;
+		for (long long i = 0; i < iterations; i++)
+		{
+			for (int o = 0; o < NUM_OBJECTS; o++)
+			{
+				const glm::vec4& object = (*objects)[o];
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(object)) *
+					glm::scale(glm::mat4(1.0f), glm::vec3(1.5f)) *
+					glm::rotate(glm::mat4(1.0f), glm::radians(object.w), glm::vec3(0.0f, 1.0f, 0.0f));
+				sum += model[3][0];
+			}
+		}
+		gSink += (unsigned long long)sum;
+	};
+	cases.push_back(chained);
+
+	// Every transform dirty: the worst frame of the transform system
+	std::shared_ptr<TransformSystem> transforms(new TransformSystem());
+	for (int i = 0; i < NUM_OBJECTS; i++)
+	{
+		const glm::vec4& object = (*objects)[i];
+		transforms->add(glm::vec3(object), glm::angleAxis(glm::radians(object.w), glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(1.5f));
+	}
+
+	BenchCase system;
+	system.name = "math/model_matrix/transform_system";
+	system.operations = NUM_OBJECTS;
+	system.run = [transforms, objects](long long iterations)
+	{
+		for (long long i = 0; i < iterations; i++)
+		{
+			for (int o = 0; o < NUM_OBJECTS; o++)
+				transforms->setPosition(o, glm::vec3((*objects)[o]));
+			transforms->update();
+		}
+		gSink += (unsigned long long)transforms->getWorld(NUM_OBJECTS - 1)[3][0];
+	};
+	cases.push_back(system);
+
+	std::shared_ptr<BatchInstances> instances(new BatchInstances(NUM_BATCH_INSTANCES));
+	std::shared_ptr<std::vector<glm::mat4> > matrices(new std::vector<glm::mat4>(NUM_BATCH_INSTANCES));
+	std::shared_ptr<std::vector<glm::mat4> > results(new std::vector<glm::mat4>(NUM_BATCH_INSTANCES));
+	MatrixBatch::buildTRS(instances->getArrays(), NUM_BATCH_INSTANCES, &(*matrices)[0]);
+
+	BenchCase glmTRS;
+	glmTRS.name = "math/model_matrix/glm_chained_soa";
+	glmTRS.operations = NUM_BATCH_INSTANCES;
+	glmTRS.run = [instances, results](long long iterations)
+	{
+		for (long long i = 0; i < iterations; i++)
+			for (int o = 0; o < NUM_BATCH_INSTANCES; o++)
+				(*results)[o] = instances->getGlmMatrix(o);
+		gSink += (unsigned long long)(*results)[NUM_BATCH_INSTANCES - 1][3][0];
+	};
+	cases.push_back(glmTRS);
+
+	BenchCase batchTRS;
+	batchTRS.name = "math/model_matrix/batch_trs";
+	batchTRS.operations = NUM_BATCH_INSTANCES;
+	batchTRS.run = [instances, results](long long iterations)
+	{
+		for (long long i = 0; i < iterations; i++)
+			MatrixBatch::buildTRS(instances->getArrays(), NUM_BATCH_INSTANCES, &(*results)[0]);
+		gSink += (unsigned long long)(*results)[NUM_BATCH_INSTANCES - 1][3][0];
+	};
+	cases.push_back(batchTRS);
+
+	const glm::mat4 viewProjection = getBenchViewProjection();
+
+	BenchCase glmProduct;
+	glmProduct.name = "math/view_projection/glm";
+	glmProduct.operations = NUM_BATCH_INSTANCES;
+	glmProduct.run = [matrices, results, viewProjection](long long iterations)
+	{
+		for (long long i = 0; i < iterations; i++)
+			for (int o = 0; o < NUM_BATCH_INSTANCES; o++)
+				(*results)[o] = viewProjection * (*matrices)[o];
+		gSink += (unsigned long long)(*results)[NUM_BATCH_INSTANCES - 1][3][0];
+	};
+	cases.push_back(glmProduct);
+
+	BenchCase batchProduct;
+	batchProduct.name = "math/view_projection/batch";
+	batchProduct.operations = NUM_BATCH_INSTANCES;
+	batchProduct.run = [matrices, results, viewProjection](long long iterations)
+	{
+		for (long long i = 0; i < iterations; i++)
+			MatrixBatch::multiply(viewProjection, &(*matrices)[0], NUM_BATCH_INSTANCES, &(*results)[0]);
+		gSink += (unsigned long long)(*results)[NUM_BATCH_INSTANCES - 1][3][0];
+	};
+	cases.push_back(batchProduct);
+
+	// Both over all hardware threads, the way the scene file builds them
+	std::shared_ptr<JobSystem> jobs(new JobSystem());
+	jobs->init();
+
+	BenchCase jobsTRS;
+	jobsTRS.name = "math/model_matrix/batch_trs_jobs";
+	jobsTRS.operations = NUM_BATCH_INSTANCES;
+	jobsTRS.run = [instances, results, jobs](long long iterations)
+	{
+		for (long long i = 0; i < iterations; i++)
+			MatrixBatch::buildTRS(instances->getArrays(), NUM_BATCH_INSTANCES, &(*results)[0], jobs.get());
+		gSink += (unsigned long long)(*results)[NUM_BATCH_INSTANCES - 1][3][0];
+	};
+	cases.push_back(jobsTRS);
+
+	BenchCase jobsProduct;
+	jobsProduct.name = "math/view_projection/batch_jobs";
+	jobsProduct.operations = NUM_BATCH_INSTANCES;
+	jobsProduct.run = [matrices, results, viewProjection, jobs](long long iterations)
+	{
+		for (long long i = 0; i < iterations; i++)
+			MatrixBatch::multiply(viewProjection, &(*matrices)[0], NUM_BATCH_INSTANCES, &(*results)[0], jobs.get());
+		gSink += (unsigned long long)(*results)[NUM_BATCH_INSTANCES - 1][3][0];
+	};
+	cases.push_back(jobsProduct);
+}
+
+static void addCullingCases(std::vector<BenchCase>& cases)
+{
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 600.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(-80.0f, 50.0f, 80.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	std::shared_ptr<Frustum> frustum(new Frustum());
+	frustum->update(projection * view);
+
+	unsigned int state = 2;
+	std::shared_ptr<std::vector<glm::vec4> > spheres(new std::vector<glm::vec4>(NUM_OBJECTS));
+	for (int i = 0; i < NUM_OBJECTS; i++)
+		(*spheres)[i] = glm::vec4(random01(state) * 800.0f - 400.0f, random01(state) * 20.0f, random01(state) * 800.0f - 400.0f, 0.5f + random01(state) * 4.0f);
+
+	BenchCase sphere;
+	sphere.name = "culling/frustum/sphere";
+	sphere.operations = NUM_OBJECTS;
+	sphere.run = [frustum, spheres](long long iterations)
+	{
+		unsigned long long visible = 0;
+		for (long long i = 0; i < iterations; i++)
+			for (int o = 0; o < NUM_OBJECTS; o++)
+				visible += frustum->intersectsSphere(glm::vec3((*spheres)[o]), (*spheres)[o].w) ? 1 : 0;
+		gSink += visible;
+	};
+	cases.push_back(sphere);
+
+	BenchCase box;
+	box.name = "culling/frustum/box";
+	box.operations = NUM_OBJECTS;
+	box.run = [frustum, spheres](long long iterations)
+	{
+		unsigned long long visible = 0;
+		for (long long i = 0; i < iterations; i++)
+		{
+			for (int o = 0; o < NUM_OBJECTS; o++)
+			{
+				glm::vec3 center((*spheres)[o]);
+				glm::vec3 extent((*spheres)[o].w);
+				visible += frustum->intersectsBox(center - extent, center + extent) ? 1 : 0;
+			}
+		}
+		gSink += visible;
+	};
+	cases.push_back(box);
+}
+
+//-----------------------------------------------------------------------------
+// Results as JSON
+//-----------------------------------------------------------------------------
+static bool writeJson(const std::string& filename, const std::vector<BenchResult>& results, int samples)
+{
+	std::ofstream out(filename.c_str());
+	if (!out)
+	{
+		std::cerr << "Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	out.setf(std::ios::fixed);
+	out.precision(3);
+	out << "{\n  \"samples\": " << samples << ",\n  \"unit\": \"ns_per_op\",\n  \"results\": [";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchResult& r = results[i];
+		out << (i == 0 ? "\n" : ",\n") << "    { \"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+			<< ", \"median\": " << r.median << ", \"mean\": " << r.mean << ", \"min\": " << r.min
+			<< ", \"stddev\": " << r.stddev << ", \"mad\": " << r.mad << " }";
+	}
+	out << "\n  ]\n}\n";
+	return (bool)out;
+}
+
+//-----------------------------------------------------------------------------
+// Main
+//-----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	std::string filter, jsonFile;
+	int samples = DEFAULT_SAMPLES;
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--filter") == 0 && hasValue)
+			filter = argv[++i];
+		else if (strcmp(argv[i], "--json") == 0 && hasValue)
+			jsonFile = argv[++i];
+		else if (strcmp(argv[i], "--samples") == 0 && hasValue && atoi(argv[i + 1]) > 0)
+			samples = atoi(argv[++i]);
+		else
+		{
+			std::cerr << "Unknown argument " << argv[i] << std::endl
+				<< "Usage: " << argv[0] << " [--filter text] [--samples n] [--json file]" << std::endl;
+			return -1;
+		}
+	}
+
+	if (!checkMatrixBatch() || !checkOcclusionCuller())
+		return -1;
+
+	std::vector<BenchCase> cases;
+	addMeshCases(cases);
+	addTextureCases(cases);
+	addShaderCases(cases);
+	addMatrixCases(cases);
+	addCullingCases(cases);
+
+	std::cout.setf(std::ios::fixed);
+	std::cout.precision(2);
+	std::cout << std::left << std::setw(44) << "case" << std::right << std::setw(14) << "median ns"
+		<< std::setw(14) << "mean" << std::setw(14) << "min" << std::setw(10) << "mad %" << std::endl;
+
+	std::vector<BenchResult> results;
+	for (size_t i = 0; i < cases.size(); i++)
+	{
+		if (!filter.empty() && cases[i].name.find(filter) == std::string::npos)
+			continue;
+
+		BenchResult result = runCase(cases[i], samples);
+		results.push_back(result);
+		std::cout << std::left << std::setw(44) << result.name << std::right << std::setw(14) << result.median
+			<< std::setw(14) << result.mean << std::setw(14) << result.min
+			<< std::setw(10) << (result.median > 0.0 ? 100.0 * result.mad / result.median : 0.0) << std::endl;
+	}
+
+	if (!jsonFile.empty() && !writeJson(jsonFile, results, samples))
+		return -1;
+	return 0;
+}
@@ -0,0 +1,519 @@
+//-----------------------------------------------------------------------------
+// Software occlusion culler
+//-----------------------------------------------------------------------------
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cmath>
+#include "Profiler.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_USE_SSE
+#include <emmintrin.h>
+#endif
+
+// Triangles with a vertex closer than this (clip w) are skipped rather than
+// clipped.  Dropping an occluder is always safe, it only culls less.
+const float NEAR_W = 1e-3f;
+
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+OcclusionCuller::OcclusionCuller(int width, int height)
+	: mWidth(width),
+	  mHeight(height),
+	  mTilesX(width / TILE_WIDTH),
+	  mTilesY(height / TILE_HEIGHT),
+	  mBlocksX(width / BLOCK_SIZE),
+	  mBlocksY(height / BLOCK_SIZE),
+	  mViewProjection(1.0f)
+{
+	mDepth.assign(mWidth * mHeight, 1.0f);
+	mHiZ.assign(mBlocksX * mBlocksY, 1.0f);
+}
+
+//-----------------------------------------------------------------------------
+// Copies the triangle positions of a (non-indexed) mesh into padded SoA streams
+//-----------------------------------------------------------------------------
+int OcclusionCuller::addOccluderMesh(const std::vector<Vertex>& vertices)
+{
+	mMeshes.push_back(OccluderMesh());
+	setOccluderMesh((int)mMeshes.size() - 1, vertices);
+	return (int)mMeshes.size() - 1;
+}
+
+void OcclusionCuller::setOccluderMesh(int meshId, const std::vector<Vertex>& vertices)
+{
+	if (meshId < 0 || meshId >= (int)mMeshes.size())
+		return;
+
+	OccluderMesh& mesh = mMeshes[meshId];
+	mesh.numVertices = (int)vertices.size() - (int)vertices.size() % 3;
+
+	int padded = (mesh.numVertices + 3) & ~3;
+	mesh.x.assign(padded, 0.0f);
+	mesh.y.assign(padded, 0.0f);
+	mesh.z.assign(padded, 0.0f);
+
+	for (int i = 0; i < mesh.numVertices; i++)
+	{
+		mesh.x[i] = vertices[i].position.x;
+		mesh.y[i] = vertices[i].position.y;
+		mesh.z[i] = vertices[i].position.z;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Starts a new frame.  Occluders from the previous frame are discarded.
+//-----------------------------------------------------------------------------
+void OcclusionCuller::beginFrame(const glm::mat4& viewProjection)
+{
+	mViewProjection = viewProjection;
+	mInstances.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Queues an instance of a registered occluder mesh for this frame
+//-----------------------------------------------------------------------------
+void OcclusionCuller::addOccluder(int meshId, const glm::mat4& model)
+{
+	if (meshId < 0 || meshId >= (int)mMeshes.size())
+		return;
+
+	OccluderInstance instance;
+	instance.meshId = meshId;
+	instance.mvp = mViewProjection * model;
+	instance.firstVertex = 0;
+	instance.firstTriangle = 0;
+	mInstances.push_back(instance);
+}
+
+//-----------------------------------------------------------------------------
+// Transforms all occluders, sets up their triangles and fills the depth
+// buffer.  Vertex work is split per instance, rasterization per screen tile
+// so no two threads ever write the same pixel.
+//-----------------------------------------------------------------------------
+void OcclusionCuller::rasterize(JobSystem& jobs)
+{
+	PROFILE_SCOPE("OcclusionCuller::rasterize");
+
+	int numVertices = 0;
+	int numTriangles = 0;
+	for (size_t i = 0; i < mInstances.size(); i++)
+	{
+		const OccluderMesh& mesh = mMeshes[mInstances[i].meshId];
+		mInstances[i].firstVertex = numVertices;
+		mInstances[i].firstTriangle = numTriangles;
+		numVertices += (int)mesh.x.size();
+		numTriangles += mesh.numVertices / 3;
+	}
+
+	mScreenX.resize(numVertices);
+	mScreenY.resize(numVertices);
+	mScreenZ.resize(numVertices);
+	mClipW.resize(numVertices);
+	mTriangles.resize(numTriangles);
+
+	jobs.parallelFor((unsigned int)mInstances.size(), 1,
+		[this](unsigned int begin, unsigned int end, unsigned int)
+		{
+			for (unsigned int i = begin; i < end; i++)
+				transformInstance(mInstances[i]);
+		});
+
+	jobs.parallelFor((unsigned int)(mTilesX * mTilesY), 1,
+		[this](unsigned int begin, unsigned int end, unsigned int)
+		{
+			for (unsigned int i = begin; i < end; i++)
+				rasterizeTile((int)i);
+		});
+}
+
+//-----------------------------------------------------------------------------
+// Projects the vertices of one occluder instance to screen space (4 at a time
+// when SSE is available) then builds its triangles' edge equations
+//-----------------------------------------------------------------------------
+void OcclusionCuller::transformInstance(OccluderInstance& instance)
+{
+	const OccluderMesh& mesh = mMeshes[instance.meshId];
+	const glm::mat4& m = instance.mvp;
+
+	if (mesh.numVertices == 0)
+		return;
+
+	float halfW = mWidth * 0.5f;
+	float halfH = mHeight * 0.5f;
+
+	float* outX = &mScreenX[instance.firstVertex];
+	float* outY = &mScreenY[instance.firstVertex];
+	float* outZ = &mScreenZ[instance.firstVertex];
+	float* outW = &mClipW[instance.firstVertex];
+	int count = (int)mesh.x.size();
+
+#ifdef OCCLUSION_USE_SSE
+	const __m128 m00 = _mm_set1_ps(m[0][0]), m10 = _mm_set1_ps(m[1][0]), m20 = _mm_set1_ps(m[2][0]), m30 = _mm_set1_ps(m[3][0]);
+	const __m128 m01 = _mm_set1_ps(m[0][1]), m11 = _mm_set1_ps(m[1][1]), m21 = _mm_set1_ps(m[2][1]), m31 = _mm_set1_ps(m[3][1]);
+	const __m128 m02 = _mm_set1_ps(m[0][2]), m12 = _mm_set1_ps(m[1][2]), m22 = _mm_set1_ps(m[2][2]), m32 = _mm_set1_ps(m[3][2]);
+	const __m128 m03 = _mm_set1_ps(m[0][3]), m13 = _mm_set1_ps(m[1][3]), m23 = _mm_set1_ps(m[2][3]), m33 = _mm_set1_ps(m[3][3]);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 vHalfW = _mm_set1_ps(halfW);
+	const __m128 vHalfH = _mm_set1_ps(halfH);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (int i = 0; i < count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&mesh.x[i]);
+		__m128 y = _mm_loadu_ps(&mesh.y[i]);
+		__m128 z = _mm_loadu_ps(&mesh.z[i]);
+
+		__m128 cx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, x), _mm_mul_ps(m10, y)), _mm_add_ps(_mm_mul_ps(m20, z), m30));
+		__m128 cy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m01, x), _mm_mul_ps(m11, y)), _mm_add_ps(_mm_mul_ps(m21, z), m31));
+		__m128 cz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m02, x), _mm_mul_ps(m12, y)), _mm_add_ps(_mm_mul_ps(m22, z), m32));
+		__m128 cw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m03, x), _mm_mul_ps(m13, y)), _mm_add_ps(_mm_mul_ps(m23, z), m33));
+
+		// Vertices behind the camera produce garbage here but their
+		// triangles are rejected in setupTriangle() using w
+		__m128 invW = _mm_div_ps(one, cw);
+
+		_mm_storeu_ps(outX + i, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(cx, invW), vHalfW), vHalfW));
+		_mm_storeu_ps(outY + i, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(cy, invW), vHalfH), vHalfH));
+		_mm_storeu_ps(outZ + i, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(cz, invW), half), half));
+		_mm_storeu_ps(outW + i, cw);
+	}
+#else
+	for (int i = 0; i < count; i++)
+	{
+		glm::vec4 clip = m * glm::vec4(mesh.x[i], mesh.y[i], mesh.z[i], 1.0f);
+		float invW = 1.0f / clip.w;
+
+		outX[i] = clip.x * invW * halfW + halfW;
+		outY[i] = clip.y * invW * halfH + halfH;
+		outZ[i] = clip.z * invW * 0.5f + 0.5f;
+		outW[i] = clip.w;
+	}
+#endif
+
+	int numTriangles = mesh.numVertices / 3;
+	int t = 0;
+	for (; t + 4 <= numTriangles; t += 4)
+		setupTriangles4(instance.firstVertex + t * 3, &mTriangles[instance.firstTriangle + t]);
+	for (; t < numTriangles; t++)
+	{
+		int v0 = instance.firstVertex + t * 3;
+		setupTriangle(v0, v0 + 1, v0 + 2, mTriangles[instance.firstTriangle + t]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Computes edge functions, depth plane and screen bounds of a triangle.
+// Both windings are accepted, occluders don't need consistent facing.
+//-----------------------------------------------------------------------------
+void OcclusionCuller::setupTriangle(int v0, int v1, int v2, ScreenTriangle& tri) const
+{
+	tri.valid = false;
+
+	if (mClipW[v0] < NEAR_W || mClipW[v1] < NEAR_W || mClipW[v2] < NEAR_W)
+		return;
+
+	float x0 = mScreenX[v0], y0 = mScreenY[v0], z0 = mScreenZ[v0];
+	float x1 = mScreenX[v1], y1 = mScreenY[v1], z1 = mScreenZ[v1];
+	float x2 = mScreenX[v2], y2 = mScreenY[v2], z2 = mScreenZ[v2];
+
+	float area = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+	if (std::fabs(area) < 1e-6f)
+		return;
+
+	// Make it counter clockwise so inside is always E >= 0
+	if (area < 0.0f)
+	{
+		std::swap(x1, x2);
+		std::swap(y1, y2);
+		std::swap(z1, z2);
+		area = -area;
+	}
+
+	tri.minX = std::max(0, (int)std::floor(std::min(x0, std::min(x1, x2))));
+	tri.maxX = std::min(mWidth - 1, (int)std::ceil(std::max(x0, std::max(x1, x2))));
+	tri.minY = std::max(0, (int)std::floor(std::min(y0, std::min(y1, y2))));
+	tri.maxY = std::min(mHeight - 1, (int)std::ceil(std::max(y0, std::max(y1, y2))));
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+		return;
+
+	// Edge i is opposite vertex i: E12, E20, E01
+	float xs[3] = { x0, x1, x2 };
+	float ys[3] = { y0, y1, y2 };
+	for (int e = 0; e < 3; e++)
+	{
+		int i = (e + 1) % 3;
+		int j = (e + 2) % 3;
+		tri.edgeA[e] = ys[i] - ys[j];
+		tri.edgeB[e] = xs[j] - xs[i];
+		tri.edgeC[e] = xs[i] * ys[j] - xs[j] * ys[i];
+	}
+
+	// Depth is linear in screen space: z = (E12 * z0 + E20 * z1 + E01 * z2) / area
+	float invArea = 1.0f / area;
+	tri.zA = (tri.edgeA[0] * z0 + tri.edgeA[1] * z1 + tri.edgeA[2] * z2) * invArea;
+	tri.zB = (tri.edgeB[0] * z0 + tri.edgeB[1] * z1 + tri.edgeB[2] * z2) * invArea;
+	tri.zC = (tri.edgeC[0] * z0 + tri.edgeC[1] * z1 + tri.edgeC[2] * z2) * invArea;
+
+	tri.valid = true;
+}
+
+#ifdef OCCLUSION_USE_SSE
+//-----------------------------------------------------------------------------
+// Vertices 0, 1 and 2 of four consecutive triangles from 12 packed values
+//-----------------------------------------------------------------------------
+static void loadTriangles4(const float* p, __m128& v0, __m128& v1, __m128& v2)
+{
+	__m128 a = _mm_loadu_ps(p);
+	__m128 b = _mm_loadu_ps(p + 4);
+	__m128 c = _mm_loadu_ps(p + 8);
+
+	v0 = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+	v1 = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	v2 = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+static __m128 blend(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+//-----------------------------------------------------------------------------
+// setupTriangle() for the four triangles from firstVertex, one per lane: the
+// same edge functions and depth planes, the pixel bounds per triangle
+//-----------------------------------------------------------------------------
+void OcclusionCuller::setupTriangles4(int firstVertex, ScreenTriangle* tris) const
+{
+	__m128 x0, x1, x2, y0, y1, y2, z0, z1, z2, w0, w1, w2;
+	loadTriangles4(&mScreenX[firstVertex], x0, x1, x2);
+	loadTriangles4(&mScreenY[firstVertex], y0, y1, y2);
+	loadTriangles4(&mScreenZ[firstVertex], z0, z1, z2);
+	loadTriangles4(&mClipW[firstVertex], w0, w1, w2);
+
+	const __m128 nearW = _mm_set1_ps(NEAR_W);
+	__m128 valid = _mm_and_ps(_mm_cmpge_ps(w0, nearW), _mm_and_ps(_mm_cmpge_ps(w1, nearW), _mm_cmpge_ps(w2, nearW)));
+
+	__m128 area = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(x1, x0), _mm_sub_ps(y2, y0)), _mm_mul_ps(_mm_sub_ps(x2, x0), _mm_sub_ps(y1, y0)));
+	__m128 absArea = _mm_andnot_ps(_mm_set1_ps(-0.0f), area);
+	valid = _mm_and_ps(valid, _mm_cmpge_ps(absArea, _mm_set1_ps(1e-6f)));
+	int validMask = _mm_movemask_ps(valid);
+	if (validMask == 0)
+	{
+		for (int t = 0; t < 4; t++)
+			tris[t].valid = false;
+		return;
+	}
+
+	// Make them counter clockwise so inside is always E >= 0
+	__m128 clockwise = _mm_cmplt_ps(area, _mm_setzero_ps());
+	__m128 sx1 = blend(clockwise, x2, x1), sx2 = blend(clockwise, x1, x2);
+	__m128 sy1 = blend(clockwise, y2, y1), sy2 = blend(clockwise, y1, y2);
+	__m128 sz1 = blend(clockwise, z2, z1), sz2 = blend(clockwise, z1, z2);
+
+	// Edge i is opposite vertex i: E12, E20, E01
+	__m128 edgeA[3], edgeB[3], edgeC[3];
+	edgeA[0] = _mm_sub_ps(sy1, sy2);
+	edgeB[0] = _mm_sub_ps(sx2, sx1);
+	edgeC[0] = _mm_sub_ps(_mm_mul_ps(sx1, sy2), _mm_mul_ps(sx2, sy1));
+	edgeA[1] = _mm_sub_ps(sy2, y0);
+	edgeB[1] = _mm_sub_ps(x0, sx2);
+	edgeC[1] = _mm_sub_ps(_mm_mul_ps(sx2, y0), _mm_mul_ps(x0, sy2));
+	edgeA[2] = _mm_sub_ps(y0, sy1);
+	edgeB[2] = _mm_sub_ps(sx1, x0);
+	edgeC[2] = _mm_sub_ps(_mm_mul_ps(x0, sy1), _mm_mul_ps(sx1, y0));
+
+	__m128 invArea = _mm_div_ps(_mm_set1_ps(1.0f), absArea);
+	__m128 zA = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], z0), _mm_mul_ps(edgeA[1], sz1)), _mm_mul_ps(edgeA[2], sz2)), invArea);
+	__m128 zB = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeB[0], z0), _mm_mul_ps(edgeB[1], sz1)), _mm_mul_ps(edgeB[2], sz2)), invArea);
+	__m128 zC = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(edgeC[0], z0), _mm_mul_ps(edgeC[1], sz1)), _mm_mul_ps(edgeC[2], sz2)), invArea);
+
+	__m128 minX = _mm_min_ps(x0, _mm_min_ps(x1, x2)), maxX = _mm_max_ps(x0, _mm_max_ps(x1, x2));
+	__m128 minY = _mm_min_ps(y0, _mm_min_ps(y1, y2)), maxY = _mm_max_ps(y0, _mm_max_ps(y1, y2));
+
+	float lanes[16][4];
+	_mm_storeu_ps(lanes[0], edgeA[0]);
+	_mm_storeu_ps(lanes[1], edgeA[1]);
+	_mm_storeu_ps(lanes[2], edgeA[2]);
+	_mm_storeu_ps(lanes[3], edgeB[0]);
+	_mm_storeu_ps(lanes[4], edgeB[1]);
+	_mm_storeu_ps(lanes[5], edgeB[2]);
+	_mm_storeu_ps(lanes[6], edgeC[0]);
+	_mm_storeu_ps(lanes[7], edgeC[1]);
+	_mm_storeu_ps(lanes[8], edgeC[2]);
+	_mm_storeu_ps(lanes[9], zA);
+	_mm_storeu_ps(lanes[10], zB);
+	_mm_storeu_ps(lanes[11], zC);
+	_mm_storeu_ps(lanes[12], minX);
+	_mm_storeu_ps(lanes[13], maxX);
+	_mm_storeu_ps(lanes[14], minY);
+	_mm_storeu_ps(lanes[15], maxY);
+
+	for (int t = 0; t < 4; t++)
+	{
+		ScreenTriangle& tri = tris[t];
+		tri.valid = false;
+		if (!(validMask & (1 << t)))
+			continue;
+
+		tri.minX = std::max(0, (int)std::floor(lanes[12][t]));
+		tri.maxX = std::min(mWidth - 1, (int)std::ceil(lanes[13][t]));
+		tri.minY = std::max(0, (int)std::floor(lanes[14][t]));
+		tri.maxY = std::min(mHeight - 1, (int)std::ceil(lanes[15][t]));
+		if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+			continue;
+
+		for (int e = 0; e < 3; e++)
+		{
+			tri.edgeA[e] = lanes[e][t];
+			tri.edgeB[e] = lanes[3 + e][t];
+			tri.edgeC[e] = lanes[6 + e][t];
+		}
+		tri.zA = lanes[9][t];
+		tri.zB = lanes[10][t];
+		tri.zC = lanes[11][t];
+		tri.valid = true;
+	}
+}
+#else
+void OcclusionCuller::setupTriangles4(int firstVertex, ScreenTriangle* tris) const
+{
+	for (int t = 0; t < 4; t++)
+		setupTriangle(firstVertex + t * 3, firstVertex + t * 3 + 1, firstVertex + t * 3 + 2, tris[t]);
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// Clears one screen tile, rasterizes every triangle touching it then updates
+// the 8x8 block maximums covered by the tile
+//-----------------------------------------------------------------------------
+void OcclusionCuller::rasterizeTile(int tileIndex)
+{
+	int tileX0 = (tileIndex % mTilesX) * TILE_WIDTH;
+	int tileY0 = (tileIndex / mTilesX) * TILE_HEIGHT;
+	int tileX1 = tileX0 + TILE_WIDTH - 1;
+	int tileY1 = tileY0 + TILE_HEIGHT - 1;
+
+	for (int y = tileY0; y <= tileY1; y++)
+		std::fill(&mDepth[y * mWidth + tileX0], &mDepth[y * mWidth + tileX0] + TILE_WIDTH, 1.0f);
+
+	for (size_t t = 0; t < mTriangles.size(); t++)
+	{
+		const ScreenTriangle& tri = mTriangles[t];
+		if (!tri.valid || tri.maxX < tileX0 || tri.minX > tileX1 || tri.maxY < tileY0 || tri.minY > tileY1)
+			continue;
+
+		int minX = std::max(tri.minX, tileX0);
+		int maxX = std::min(tri.maxX, tileX1);
+		int minY = std::max(tri.minY, tileY0);
+		int maxY = std::min(tri.maxY, tileY1);
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			// Sample at pixel centers, step the edge functions along x
+			float px = minX + 0.5f;
+			float py = y + 0.5f;
+			float e0 = tri.edgeA[0] * px + tri.edgeB[0] * py + tri.edgeC[0];
+			float e1 = tri.edgeA[1] * px + tri.edgeB[1] * py + tri.edgeC[1];
+			float e2 = tri.edgeA[2] * px + tri.edgeB[2] * py + tri.edgeC[2];
+			float z = tri.zA * px + tri.zB * py + tri.zC;
+
+			float* row = &mDepth[y * mWidth];
+			for (int x = minX; x <= maxX; x++)
+			{
+				if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+				{
+					float depth = std::max(z, 0.0f);
+					if (depth < row[x])
+						row[x] = depth;
+				}
+				e0 += tri.edgeA[0];
+				e1 += tri.edgeA[1];
+				e2 += tri.edgeA[2];
+				z += tri.zA;
+			}
+		}
+	}
+
+	// Hierarchical level - farthest depth of each block
+	for (int by = tileY0 / BLOCK_SIZE; by <= tileY1 / BLOCK_SIZE; by++)
+	{
+		for (int bx = tileX0 / BLOCK_SIZE; bx <= tileX1 / BLOCK_SIZE; bx++)
+		{
+			float farthest = 0.0f;
+			for (int y = by * BLOCK_SIZE; y < (by + 1) * BLOCK_SIZE; y++)
+				for (int x = bx * BLOCK_SIZE; x < (bx + 1) * BLOCK_SIZE; x++)
+					farthest = std::max(farthest, mDepth[y * mWidth + x]);
+
+			mHiZ[by * mBlocksX + bx] = farthest;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Projects the 8 corners of the box and compares its nearest depth with the
+// occluder depth under its screen rectangle, block level first.
+//-----------------------------------------------------------------------------
+bool OcclusionCuller::isVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model) const
+{
+	glm::mat4 mvp = mViewProjection * model;
+
+	float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+	float minZ = 1e30f;
+
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec4 corner((i & 1) ? boundsMax.x : boundsMin.x,
+		                 (i & 2) ? boundsMax.y : boundsMin.y,
+		                 (i & 4) ? boundsMax.z : boundsMin.z,
+		                 1.0f);
+		glm::vec4 clip = mvp * corner;
+
+		// Box crosses the near plane - assume visible
+		if (clip.w < NEAR_W)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		float sx = (clip.x * invW * 0.5f + 0.5f) * mWidth;
+		float sy = (clip.y * invW * 0.5f + 0.5f) * mHeight;
+		float sz = clip.z * invW * 0.5f + 0.5f;
+
+		minX = std::min(minX, sx);
+		maxX = std::max(maxX, sx);
+		minY = std::min(minY, sy);
+		maxY = std::max(maxY, sy);
+		minZ = std::min(minZ, sz);
+	}
+
+	int x0 = std::max(0, (int)std::floor(minX));
+	int x1 = std::min(mWidth - 1, (int)std::ceil(maxX));
+	int y0 = std::max(0, (int)std::floor(minY));
+	int y1 = std::min(mHeight - 1, (int)std::ceil(maxY));
+
+	// Entirely off screen
+	if (x0 > x1 || y0 > y1)
+		return false;
+
+	for (int by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++)
+	{
+		for (int bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++)
+		{
+			// Whole block is covered by nearer occluders
+			if (minZ > mHiZ[by * mBlocksX + bx])
+				continue;
+
+			int px0 = std::max(x0, bx * BLOCK_SIZE);
+			int px1 = std::min(x1, (bx + 1) * BLOCK_SIZE - 1);
+			int py0 = std::max(y0, by * BLOCK_SIZE);
+			int py1 = std::min(y1, (by + 1) * BLOCK_SIZE - 1);
+
+			for (int y = py0; y <= py1; y++)
+				for (int x = px0; x <= px1; x++)
+					if (minZ <= mDepth[y * mWidth + x])
+						return true;
+		}
+	}
+
+	return false;
+}
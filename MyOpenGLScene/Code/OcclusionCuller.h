@@ -0,0 +1,99 @@
+//-----------------------------------------------------------------------------
+// Software occlusion culler
+//
+// A handful of big occluders (ground, house, nearby trees) are rasterized on
+// the CPU into a small depth buffer.  A second, coarser level keeps the
+// farthest depth of every 8x8 block so most bounding box queries can be
+// answered without touching individual pixels.
+//-----------------------------------------------------------------------------
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+#include "JobSystem.h"
+
+
+class OcclusionCuller
+{
+public:
+
+	// width and height must be multiples of the tile size (64 x 32)
+	OcclusionCuller(int width = 256, int height = 128);
+
+	// Registers the triangles of a mesh as a potential occluder.  Returns an id
+	// to pass to addOccluder().
+	int addOccluderMesh(const std::vector<Vertex>& vertices);
+
+	// Replaces the triangles of a registered mesh, between two frames
+	void setOccluderMesh(int meshId, const std::vector<Vertex>& vertices);
+
+	// Per frame: set the camera, add the occluder instances then rasterize
+	void beginFrame(const glm::mat4& viewProjection);
+	void addOccluder(int meshId, const glm::mat4& model);
+	void rasterize(JobSystem& jobs);
+
+	// Tests an object space bounding box transformed by model against the depth
+	// buffer.  Returns false if the box is hidden (or entirely off screen).
+	bool isVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax, const glm::mat4& model) const;
+
+	int getWidth() const  { return mWidth; }
+	int getHeight() const { return mHeight; }
+	int getNumTriangles() const { return (int)mTriangles.size(); }
+	const std::vector<float>& getDepthBuffer() const { return mDepth; }
+
+private:
+
+	// Object space positions stored as separate x, y, z streams padded to a
+	// multiple of 4 so they can be transformed 4 at a time
+	struct OccluderMesh
+	{
+		std::vector<float> x, y, z;
+		int numVertices;
+	};
+
+	struct OccluderInstance
+	{
+		int meshId;
+		glm::mat4 mvp;
+		int firstVertex;	// into the transformed vertex streams
+		int firstTriangle;	// into mTriangles
+	};
+
+	// Edge functions (a*x + b*y + c >= 0 inside) and depth plane of a
+	// screen space triangle plus its clamped pixel bounds
+	struct ScreenTriangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		float zA, zB, zC;
+		int minX, maxX, minY, maxY;
+		bool valid;
+	};
+
+	void transformInstance(OccluderInstance& instance);
+	void setupTriangle(int v0, int v1, int v2, ScreenTriangle& tri) const;
+	void setupTriangles4(int firstVertex, ScreenTriangle* tris) const;
+	void rasterizeTile(int tileIndex);
+
+	static const int TILE_WIDTH = 64;
+	static const int TILE_HEIGHT = 32;
+	static const int BLOCK_SIZE = 8;
+
+	int mWidth, mHeight;
+	int mTilesX, mTilesY;
+	int mBlocksX, mBlocksY;
+
+	glm::mat4 mViewProjection;
+
+	std::vector<OccluderMesh> mMeshes;
+	std::vector<OccluderInstance> mInstances;
+
+	// Transformed vertices (screen x, y, depth and clip w)
+	std::vector<float> mScreenX, mScreenY, mScreenZ, mClipW;
+	std::vector<ScreenTriangle> mTriangles;
+
+	std::vector<float> mDepth;	// per pixel, nearest occluder depth in [0, 1]
+	std::vector<float> mHiZ;	// per 8x8 block, farthest depth of mDepth
+};
+#endif //OCCLUSION_CULLER_H
@@ -0,0 +1,337 @@
+//-----------------------------------------------------------------------------
+// CPU and GPU frame profiler
+//-----------------------------------------------------------------------------
+#include "Profiler.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include "GLStats.h"
+
+
+struct ProfileEvent
+{
+	const char* name;
+	long long begin, end;		// ns, profiler clock
+};
+
+//-----------------------------------------------------------------------------
+// CPU events of one thread.  Only that thread writes them.
+//-----------------------------------------------------------------------------
+struct ThreadEvents
+{
+	std::string name;
+	std::vector<ProfileEvent> events;	// ring of MAX_CPU_EVENTS
+	unsigned int count;					// recorded so far
+};
+
+//-----------------------------------------------------------------------------
+// GPU scopes of one frame: a begin and an end query each
+//-----------------------------------------------------------------------------
+struct GpuFrame
+{
+	GLuint queries[Profiler::MAX_GPU_SCOPES * 2];
+	const char* names[Profiler::MAX_GPU_SCOPES];
+	bool ended[Profiler::MAX_GPU_SCOPES];
+	int numScopes;
+	int lastQuery;			// issued last, the others are done when it is
+	long long cpuTime;		// the same instant on both clocks
+	GLint64 gpuTime;
+};
+
+static std::mutex gThreadsMutex;
+static std::vector<std::unique_ptr<ThreadEvents> > gThreads;
+static thread_local ThreadEvents* tThreadEvents = NULL;
+
+static GpuFrame gGpuFrames[Profiler::QUERY_FRAMES];
+static bool gGpuReady = false;
+static int gGpuFrame = 0;
+static int gScopeStack[Profiler::MAX_GPU_SCOPES];
+static int gStackDepth = 0;
+static int gStackOverflow = 0;		// scopes nested past MAX_GPU_SCOPES
+
+static std::vector<ProfileEvent> gGpuEvents;	// ring of MAX_GPU_EVENTS
+static unsigned int gNumGpuEvents = 0;
+static double gGpuFrameMs = 0.0;
+static unsigned int gNumGpuFrames = 0;
+
+//-----------------------------------------------------------------------------
+// Events of the calling thread, registered on first use
+//-----------------------------------------------------------------------------
+static ThreadEvents& getThreadEvents()
+{
+	if (tThreadEvents == NULL)
+	{
+		std::lock_guard<std::mutex> lock(gThreadsMutex);
+
+		ThreadEvents* events = new ThreadEvents;
+		std::ostringstream name;
+		name << "Thread " << gThreads.size();
+		events->name = name.str();
+		events->events.resize(Profiler::MAX_CPU_EVENTS);
+		events->count = 0;
+
+		gThreads.push_back(std::unique_ptr<ThreadEvents>(events));
+		tThreadEvents = events;
+	}
+	return *tThreadEvents;
+}
+
+//-----------------------------------------------------------------------------
+// Names the calling thread's track
+//-----------------------------------------------------------------------------
+void Profiler::setThreadName(const std::string& name)
+{
+	ThreadEvents& events = getThreadEvents();
+	std::lock_guard<std::mutex> lock(gThreadsMutex);
+	events.name = name;
+}
+
+//-----------------------------------------------------------------------------
+// Overwrites the oldest event of the thread's ring
+//-----------------------------------------------------------------------------
+void Profiler::recordCpu(const char* name, long long begin, long long end)
+{
+	ThreadEvents& events = getThreadEvents();
+	ProfileEvent& event = events.events[events.count % MAX_CPU_EVENTS];
+	event.name = name;
+	event.begin = begin;
+	event.end = end;
+	events.count++;
+}
+
+//-----------------------------------------------------------------------------
+// Creates the timestamp queries of every frame set
+//-----------------------------------------------------------------------------
+bool Profiler::initGpu()
+{
+	GLint bits = 0;
+	glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+	if (bits == 0)
+	{
+		std::cerr << "No GPU timestamps, the profiler only times the CPU" << std::endl;
+		return false;
+	}
+
+	for (int f = 0; f < QUERY_FRAMES; f++)
+	{
+		glGenQueries(MAX_GPU_SCOPES * 2, gGpuFrames[f].queries);
+		gGpuFrames[f].numScopes = 0;
+		gGpuFrames[f].lastQuery = -1;
+	}
+	gGpuEvents.resize(MAX_GPU_EVENTS);
+	gGpuReady = true;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Deletes the queries
+//-----------------------------------------------------------------------------
+void Profiler::shutdownGpu()
+{
+	if (!gGpuReady)
+		return;
+
+	for (int f = 0; f < QUERY_FRAMES; f++)
+		glDeleteQueries(MAX_GPU_SCOPES * 2, gGpuFrames[f].queries);
+	gGpuReady = false;
+}
+
+//-----------------------------------------------------------------------------
+// Reads back the set of QUERY_FRAMES frames ago if the GPU is done with it,
+// then starts recording into it again
+//-----------------------------------------------------------------------------
+void Profiler::beginFrame()
+{
+	if (!gGpuReady)
+		return;
+
+	gGpuFrame = (gGpuFrame + 1) % QUERY_FRAMES;
+	GpuFrame& frame = gGpuFrames[gGpuFrame];
+
+	GLint available = 0;
+	if (frame.lastQuery >= 0)
+		glGetQueryObjectiv(frame.queries[frame.lastQuery], GL_QUERY_RESULT_AVAILABLE, &available);
+
+	if (available)
+	{
+		long long offset = frame.cpuTime - (long long)frame.gpuTime;
+		long long first = 0, last = 0;
+		for (int s = 0; s < frame.numScopes; s++)
+		{
+			if (!frame.ended[s])
+				continue;
+
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(frame.queries[s * 2], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(frame.queries[s * 2 + 1], GL_QUERY_RESULT, &end);
+
+			ProfileEvent& event = gGpuEvents[gNumGpuEvents % MAX_GPU_EVENTS];
+			event.name = frame.names[s];
+			event.begin = (long long)begin + offset;
+			event.end = (long long)end + offset;
+			gNumGpuEvents++;
+
+			first = first == 0 ? event.begin : std::min(first, event.begin);
+			last = std::max(last, event.end);
+		}
+		gGpuFrameMs = (double)(last - first) * 1e-6;
+		gNumGpuFrames++;
+	}
+
+	frame.numScopes = 0;
+	frame.lastQuery = -1;
+	gStackDepth = 0;
+	gStackOverflow = 0;
+
+	frame.cpuTime = now();
+	glGetInteger64v(GL_TIMESTAMP, &frame.gpuTime);
+}
+
+//-----------------------------------------------------------------------------
+// Starts a GPU scope - past MAX_GPU_SCOPES a frame the scopes are skipped
+//-----------------------------------------------------------------------------
+void Profiler::beginGpu(const char* name)
+{
+	GLStats::pushScope(name);
+
+	if (!gGpuReady)
+		return;
+	if (gStackDepth >= MAX_GPU_SCOPES)
+	{
+		gStackOverflow++;
+		return;
+	}
+
+	GpuFrame& frame = gGpuFrames[gGpuFrame];
+	int scope = -1;
+	if (frame.numScopes < MAX_GPU_SCOPES)
+	{
+		scope = frame.numScopes++;
+		frame.names[scope] = name;
+		frame.ended[scope] = false;
+		frame.lastQuery = scope * 2;
+		glQueryCounter(frame.queries[scope * 2], GL_TIMESTAMP);
+	}
+	gScopeStack[gStackDepth++] = scope;
+}
+
+//-----------------------------------------------------------------------------
+// Ends the innermost GPU scope
+//-----------------------------------------------------------------------------
+void Profiler::endGpu()
+{
+	GLStats::popScope();
+
+	if (!gGpuReady || gStackDepth == 0)
+		return;
+	if (gStackOverflow > 0)
+	{
+		gStackOverflow--;
+		return;
+	}
+
+	int scope = gScopeStack[--gStackDepth];
+	if (scope < 0)
+		return;
+
+	GpuFrame& frame = gGpuFrames[gGpuFrame];
+	frame.ended[scope] = true;
+	frame.lastQuery = scope * 2 + 1;
+	glQueryCounter(frame.queries[scope * 2 + 1], GL_TIMESTAMP);
+}
+
+//-----------------------------------------------------------------------------
+// GPU time of the last frame read back
+//-----------------------------------------------------------------------------
+double Profiler::getGpuFrameMs()
+{
+	return gGpuFrameMs;
+}
+
+unsigned int Profiler::getNumGpuFrames()
+{
+	return gNumGpuFrames;
+}
+
+//-----------------------------------------------------------------------------
+// Complete events ("X") in microseconds from the oldest one, with a track
+// name ("M") per thread and one for the GPU
+//-----------------------------------------------------------------------------
+static void writeEvents(std::ostream& out, const std::vector<ProfileEvent>& events, unsigned int count, int track, long long base, bool& first)
+{
+	unsigned int size = (unsigned int)events.size();
+	unsigned int start = count > size ? count - size : 0;
+	for (unsigned int i = start; i < count; i++)
+	{
+		const ProfileEvent& event = events[i % size];
+		out << (first ? "\n" : ",\n")
+			<< "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << track
+			<< ",\"ts\":" << (double)(event.begin - base) * 1e-3
+			<< ",\"dur\":" << (double)(event.end - event.begin) * 1e-3 << "}";
+		first = false;
+	}
+}
+
+static void writeTrackName(std::ostream& out, int track, const std::string& name, bool& first)
+{
+	out << (first ? "\n" : ",\n")
+		<< "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track
+		<< ",\"args\":{\"name\":\"" << name << "\"}}";
+	first = false;
+}
+
+//-----------------------------------------------------------------------------
+// Writes the rings as a Chrome trace
+//-----------------------------------------------------------------------------
+bool Profiler::exportTrace(const std::string& filename)
+{
+	std::ofstream out(filename.c_str());
+	if (!out)
+	{
+		std::cerr << "Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(gThreadsMutex);
+
+	// Oldest event still held, so the trace starts at 0
+	long long base = now();
+	for (size_t t = 0; t < gThreads.size(); t++)
+	{
+		const ThreadEvents& events = *gThreads[t];
+		unsigned int start = events.count > (unsigned int)MAX_CPU_EVENTS ? events.count - MAX_CPU_EVENTS : 0;
+		for (unsigned int i = start; i < events.count; i++)
+			base = std::min(base, events.events[i % MAX_CPU_EVENTS].begin);
+	}
+	unsigned int gpuStart = gNumGpuEvents > (unsigned int)MAX_GPU_EVENTS ? gNumGpuEvents - MAX_GPU_EVENTS : 0;
+	for (unsigned int i = gpuStart; i < gNumGpuEvents; i++)
+		base = std::min(base, gGpuEvents[i % MAX_GPU_EVENTS].begin);
+
+	out.setf(std::ios::fixed);
+	out.precision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	bool first = true;
+	for (size_t t = 0; t < gThreads.size(); t++)
+	{
+		writeTrackName(out, (int)t, gThreads[t]->name, first);
+		writeEvents(out, gThreads[t]->events, gThreads[t]->count, (int)t, base, first);
+	}
+
+	int gpuTrack = (int)gThreads.size();
+	writeTrackName(out, gpuTrack, "GPU", first);
+	writeEvents(out, gGpuEvents, gNumGpuEvents, gpuTrack, base, first);
+
+	out << "\n]}\n";
+	if (!out)
+	{
+		std::cerr << "Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	std::cout << "Profile written to " << filename << std::endl;
+	return true;
+}
@@ -0,0 +1,104 @@
+//-----------------------------------------------------------------------------
+// CPU and GPU frame profiler
+//
+// CPU scopes (PROFILE_SCOPE) take two steady_clock reads and write one event
+// to a ring of MAX_CPU_EVENTS owned by the calling thread, so they cost the
+// same on the workers as on the main thread and never take a lock.  The
+// rings keep recording and always hold the last few frames.
+//
+// GPU scopes (PROFILE_GPU_SCOPE, GL thread only) put a GL_TIMESTAMP query at
+// both ends.  The queries of a frame are read QUERY_FRAMES frames later,
+// when beginFrame() is about to reuse them, and only if the GPU is done with
+// them: a late frame is dropped rather than waited for.  GPU times are moved
+// to the CPU clock with a pair of GL and CPU timestamps taken together.
+//
+// Every GPU scope is also a GLStats scope, the GL calls made in it are
+// counted under its name.
+//
+// exportTrace() writes everything the rings hold as Chrome trace events
+// (chrome://tracing, Perfetto): one track per thread plus one for the GPU.
+// Scope names must be string literals, or live as long as the profiler.
+//-----------------------------------------------------------------------------
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#define GLEW_STATIC
+#include "GL/glew.h"
+
+
+class Profiler
+{
+public:
+
+	static const int MAX_CPU_EVENTS = 16384;	// per thread
+	static const int MAX_GPU_EVENTS = 16384;
+	static const int MAX_GPU_SCOPES = 64;		// per frame
+	static const int QUERY_FRAMES = 2;
+
+	// Nanoseconds on the profiler's clock
+	static long long now()
+	{
+		return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Names the calling thread's track in the trace
+	static void setThreadName(const std::string& name);
+
+	static void recordCpu(const char* name, long long begin, long long end);
+
+	// GL thread.  initGpu() needs the GL context, beginFrame() reads the
+	// queries that are ready and starts this frame's set.
+	static bool initGpu();
+	static void shutdownGpu();
+	static void beginFrame();
+	static void beginGpu(const char* name);
+	static void endGpu();
+
+	// GPU time of the last frame read back, first query to last, and the
+	// number of frames read back so far (it changes with the time)
+	static double getGpuFrameMs();
+	static unsigned int getNumGpuFrames();
+
+	// Writes the CPU and GPU events of the last frames, false on failure.
+	// Call between frames, while no job runs.
+	static bool exportTrace(const std::string& filename);
+};
+
+//-----------------------------------------------------------------------------
+// Records the lifetime of the scope
+//-----------------------------------------------------------------------------
+class ProfileScope
+{
+public:
+	 ProfileScope(const char* name) : mName(name), mBegin(Profiler::now()) {}
+	~ProfileScope() { Profiler::recordCpu(mName, mBegin, Profiler::now()); }
+
+private:
+	ProfileScope(const ProfileScope& rhs);
+	ProfileScope& operator = (const ProfileScope& rhs);
+
+	const char* mName;
+	long long mBegin;
+};
+
+class GpuProfileScope
+{
+public:
+	 GpuProfileScope(const char* name) { Profiler::beginGpu(name); }
+	~GpuProfileScope() { Profiler::endGpu(); }
+
+private:
+	GpuProfileScope(const GpuProfileScope& rhs);
+	GpuProfileScope& operator = (const GpuProfileScope& rhs);
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+
+#endif //PROFILER_H
@@ -0,0 +1,109 @@
+//-----------------------------------------------------------------------------
+// Render queue
+//-----------------------------------------------------------------------------
+#include "RenderQueue.h"
+#include <algorithm>
+#include "Profiler.h"
+
+
+// Batches per job chunk
+const unsigned int BATCH_GRAIN = 8;
+
+// Batches are ordered by distance in steps of 1 / SORT_STEPS_PER_UNIT
+const float SORT_STEPS_PER_UNIT = 1.0f;
+
+//-----------------------------------------------------------------------------
+// Orders commands by key
+//-----------------------------------------------------------------------------
+struct CommandOrder
+{
+	bool operator()(const RenderQueue::Command& a, const RenderQueue::Command& b) const
+	{
+		return a.sortKey < b.sortKey;
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+RenderQueue::RenderQueue()
+{
+}
+
+//-----------------------------------------------------------------------------
+// Returns the id of the material with these parameters, adding it if it
+// does not exist yet
+//-----------------------------------------------------------------------------
+int RenderQueue::addMaterial(GLuint texture, const glm::vec3& specular, float shininess, const glm::vec2& lodFade)
+{
+	for (size_t i = 0; i < mMaterials.size(); i++)
+	{
+		if (mMaterials[i].texture == texture && mMaterials[i].specular == specular && mMaterials[i].shininess == shininess && mMaterials[i].lodFade == lodFade)
+			return (int)i;
+	}
+
+	Material material;
+	material.texture = texture;
+	material.specular = specular;
+	material.shininess = shininess;
+	material.lodFade = lodFade;
+	mMaterials.push_back(material);
+	return (int)mMaterials.size() - 1;
+}
+
+//-----------------------------------------------------------------------------
+// One command per batch with visible instances, in the list of the thread
+// that built it, then the lists are merged and sorted
+//-----------------------------------------------------------------------------
+void RenderQueue::build(const EntityStore& entities, int numMeshes, JobSystem& jobs, FrameArena& arena)
+{
+	PROFILE_SCOPE("RenderQueue::build");
+
+	unsigned int numThreads = jobs.getThreadCount();
+	FrameVector<FrameVector<Command> > threadCommands = makeThreadLists<Command>(arena, NUM_FAMILIES);	// thread * NUM_FAMILIES + family
+
+	const std::vector<EntityStore::Batch>& batches = entities.getBatches();
+	jobs.parallelFor((unsigned int)batches.size(), BATCH_GRAIN,
+		[&](unsigned int begin, unsigned int end, unsigned int threadIndex)
+		{
+			for (unsigned int b = begin; b < end; b++)
+			{
+				const EntityStore::Batch& batch = batches[b];
+				if (batch.numVisible == 0)
+					continue;
+
+				Family family = batch.mesh < numMeshes ? MESHES : IMPOSTORS;
+				unsigned long long step = (unsigned long long)glm::min(batch.nearestDistance * SORT_STEPS_PER_UNIT, 4294967295.0f);
+
+				Command command;
+				command.sortKey = (step << 32) | b;
+				command.object = family == MESHES ? batch.mesh : batch.mesh - numMeshes;
+				command.firstInstance = (GLuint)batch.firstInstance;
+				command.numInstances = (GLsizei)batch.numVisible;
+				command.materialId = batch.material;
+				command.material = mMaterials[batch.material];
+				threadCommands[threadIndex * NUM_FAMILIES + family].push_back(command);
+			}
+		});
+
+	// Every thread's list goes at the offset of the lists before it
+	for (int family = 0; family < NUM_FAMILIES; family++)
+	{
+		std::vector<Command>& commands = mCommands[family];
+
+		size_t count = 0;
+		for (unsigned int t = 0; t < numThreads; t++)
+			count += threadCommands[t * NUM_FAMILIES + family].size();
+		commands.resize(count);
+
+		size_t offset = 0;
+		for (unsigned int t = 0; t < numThreads; t++)
+		{
+			const FrameVector<Command>& list = threadCommands[t * NUM_FAMILIES + family];
+			std::copy(list.begin(), list.end(), commands.begin() + offset);
+			offset += list.size();
+		}
+
+		std::sort(commands.begin(), commands.end(), CommandOrder());
+	}
+}
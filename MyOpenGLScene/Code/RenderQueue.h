@@ -0,0 +1,84 @@
+//-----------------------------------------------------------------------------
+// Render queue
+//
+// The frame is built in three stages:
+//  - build (all cores): every object family is culled and gets its lods
+//    picked with the job system - entities, terrain nodes, grass patches,
+//    light clusters - without a single GL call.  build() then turns each
+//    entity batch with visible instances into a draw command, written to
+//    the list of the thread that ran it, with its sort key.  The lists are
+//    in that thread's part of the frame arena.
+//  - merge: the per-thread lists are copied one after the other at offsets
+//    taken from their sizes (no locks) and sorted by key, nearest batch
+//    first.
+//  - submit (GL thread): the uploads, then a replay of the flat command
+//    lists.  The commands carry their texture handle and material values so
+//    the replay does no lookup and only sets what changed.
+//-----------------------------------------------------------------------------
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <vector>
+#define GLEW_STATIC
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "EntityStore.h"
+
+
+class RenderQueue
+{
+public:
+
+	enum Family
+	{
+		MESHES,			// mesh batches
+		IMPOSTORS,		// impostor batches
+		NUM_FAMILIES
+	};
+
+	// Texture and lighting parameters shared by the entities of a batch
+	struct Material
+	{
+		GLuint texture;
+		glm::vec3 specular;
+		float shininess;
+		glm::vec2 lodFade;		// fade start distance, 1 / fade length
+	};
+
+	struct Command
+	{
+		unsigned long long sortKey;		// nearest distance << 32 | batch
+		int object;						// mesh, or impostor for IMPOSTORS
+		GLuint firstInstance;			// in the entity store's draw instances
+		GLsizei numInstances;
+		int materialId;					// to skip unchanged materials
+		Material material;
+	};
+
+	RenderQueue();
+
+	// Returns the id of the material with these parameters, adding it if it
+	// does not exist yet
+	int addMaterial(GLuint texture, const glm::vec3& specular, float shininess, const glm::vec2& lodFade);
+	const Material& getMaterial(int id) const { return mMaterials[id]; }
+
+	// Commands of the batches extracted this frame.  Entities with a mesh id
+	// of numMeshes or more are impostors (impostor id = mesh - numMeshes).
+	// The arena has a sub-arena per thread of jobs.
+	void build(const EntityStore& entities, int numMeshes, JobSystem& jobs, FrameArena& arena);
+
+	const std::vector<Command>& getCommands(Family family) const { return mCommands[family]; }
+
+private:
+	RenderQueue(const RenderQueue& rhs);
+	RenderQueue& operator = (const RenderQueue& rhs);
+
+	std::vector<Material> mMaterials;
+
+	// Merged lists of the build
+	std::vector<Command> mCommands[NUM_FAMILIES];
+};
+#endif //RENDER_QUEUE_H
@@ -0,0 +1,241 @@
+//-----------------------------------------------------------------------------
+// Seeded scatter placement for the scene's instance sets
+//-----------------------------------------------------------------------------
+#include "ScatterPlacer.h"
+#include <cfloat>
+#include <cmath>
+#include <algorithm>
+
+
+// Points per job chunk without a spacing
+const unsigned int RANDOM_GRAIN = 256;
+
+//-----------------------------------------------------------------------------
+// Seed of the generator of one tile or point.  Hashed, because generators
+// seeded with neighbouring values give correlated sequences.
+//-----------------------------------------------------------------------------
+static unsigned int mixSeed(unsigned int seed, unsigned int a, unsigned int b)
+{
+	unsigned int h = seed ^ (a * 0x9E3779B1u) ^ (b * 0x85EBCA77u);
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	h *= 0x846CA68Bu;
+	h ^= h >> 16;
+	return h;
+}
+
+//-----------------------------------------------------------------------------
+// Runs a range job on the job system, or on this thread without one
+//-----------------------------------------------------------------------------
+static void runJob(JobSystem* jobs, unsigned int count, unsigned int grain, const JobSystem::RangeJob& job)
+{
+	if (jobs != NULL)
+		jobs->parallelFor(count, grain, job);
+	else if (count > 0)
+		job(0, count, 0);
+}
+
+//-----------------------------------------------------------------------------
+// Lowest priority first
+//-----------------------------------------------------------------------------
+struct PriorityOrder
+{
+	template <typename T>
+	bool operator()(const T& a, const T& b) const
+	{
+		return a.priority != b.priority ? a.priority < b.priority : a.order < b.order;
+	}
+};
+
+struct KeptOrder
+{
+	template <typename T>
+	bool operator()(const T& a, const T& b) const
+	{
+		return a.order < b.order;
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+ScatterPlacer::ScatterPlacer()
+	: mArea(-100.0f, 100.0f, -100.0f, 100.0f)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Is the point inside one of the circles (x, z, radius) or rectangles
+// (x0, x1, z0, z1)
+//-----------------------------------------------------------------------------
+bool ScatterPlacer::isExcluded(float x, float z, const std::vector<glm::vec3>& circles, const std::vector<glm::vec4>& rects)
+{
+	for (size_t c = 0; c < circles.size(); c++)
+	{
+		if (glm::length(glm::vec2(x - circles[c].x, z - circles[c].y)) < circles[c].z)
+			return true;
+	}
+	for (size_t r = 0; r < rects.size(); r++)
+	{
+		if (x > rects[r].x && x < rects[r].y && z > rects[r].z && z < rects[r].w)
+			return true;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Places the points of one scatter rule
+//-----------------------------------------------------------------------------
+void ScatterPlacer::place(int count, float spacing, unsigned int seed, JobSystem* jobs, std::vector<glm::vec2>& points) const
+{
+	points.clear();
+	if (count <= 0 || mArea.y <= mArea.x || mArea.w <= mArea.z)
+		return;
+
+	if (spacing > 0.0f)
+		placePoissonDisk(count, spacing, seed, jobs, points);
+	else
+		placeRandom(count, seed, jobs, points);
+}
+
+//-----------------------------------------------------------------------------
+// One generator per point, redrawn while it is excluded
+//-----------------------------------------------------------------------------
+void ScatterPlacer::placeRandom(int count, unsigned int seed, JobSystem* jobs, std::vector<glm::vec2>& points) const
+{
+	std::vector<glm::vec2> drawn(count);
+	std::vector<unsigned char> placed(count, 0);
+
+	runJob(jobs, (unsigned int)count, RANDOM_GRAIN,
+		[&](unsigned int begin, unsigned int end, unsigned int)
+		{
+			for (unsigned int i = begin; i < end; i++)
+			{
+				PlacementRandom random(mixSeed(seed, i, 0));
+				for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++)
+				{
+					glm::vec2 p(random.range(mArea.x, mArea.y), random.range(mArea.z, mArea.w));
+					if (!isExcluded(p.x, p.y, mExcludeCircles, mExcludeRects))
+					{
+						drawn[i] = p;
+						placed[i] = 1;
+						break;
+					}
+				}
+			}
+		});
+
+	for (int i = 0; i < count; i++)
+	{
+		if (placed[i])
+			points.push_back(drawn[i]);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Dart throwing tile by tile on a background grid, four passes of tiles that
+// do not touch.  A tile only writes its own cells and reads the cells of its
+// neighbours, which were filled by an earlier pass or not at all.
+//-----------------------------------------------------------------------------
+void ScatterPlacer::placePoissonDisk(int count, float spacing, unsigned int seed, JobSystem* jobs, std::vector<glm::vec2>& points) const
+{
+	const glm::vec2 origin(mArea.x, mArea.z);
+	const glm::vec2 size(mArea.y - mArea.x, mArea.w - mArea.z);
+	const float cellSize = spacing / sqrtf(2.0f);
+	const float spacing2 = spacing * spacing;
+
+	const int cellsX = std::max((int)ceilf(size.x / cellSize), 1);
+	const int cellsZ = std::max((int)ceilf(size.y / cellSize), 1);
+	const int tilesX = (cellsX + TILE_CELLS - 1) / TILE_CELLS;
+	const int tilesZ = (cellsZ + TILE_CELLS - 1) / TILE_CELLS;
+
+	// x is FLT_MAX in the empty cells
+	std::vector<glm::vec2> grid((size_t)cellsX * cellsZ, glm::vec2(FLT_MAX));
+	std::vector<std::vector<Candidate> > tilePoints((size_t)tilesX * tilesZ);
+
+	std::vector<int> passTiles;
+	for (int pass = 0; pass < 4; pass++)
+	{
+		passTiles.clear();
+		for (int tz = pass / 2; tz < tilesZ; tz += 2)
+			for (int tx = pass % 2; tx < tilesX; tx += 2)
+				passTiles.push_back(tz * tilesX + tx);
+
+		runJob(jobs, (unsigned int)passTiles.size(), 1,
+			[&](unsigned int begin, unsigned int end, unsigned int)
+			{
+				for (unsigned int t = begin; t < end; t++)
+				{
+					int tile = passTiles[t];
+					int tx = tile % tilesX, tz = tile / tilesX;
+					int cx0 = tx * TILE_CELLS, cz0 = tz * TILE_CELLS;
+					int cx1 = std::min(cx0 + TILE_CELLS, cellsX), cz1 = std::min(cz0 + TILE_CELLS, cellsZ);
+
+					glm::vec2 tileMin = origin + glm::vec2((float)cx0, (float)cz0) * cellSize;
+					glm::vec2 tileMax = glm::min(origin + glm::vec2((float)cx1, (float)cz1) * cellSize, origin + size);
+
+					PlacementRandom random(mixSeed(seed, (unsigned int)tx, (unsigned int)tz));
+					std::vector<Candidate>& kept = tilePoints[tile];
+
+					int darts = CANDIDATES_PER_CELL * (cx1 - cx0) * (cz1 - cz0);
+					for (int d = 0; d < darts; d++)
+					{
+						glm::vec2 p(random.range(tileMin.x, tileMax.x), random.range(tileMin.y, tileMax.y));
+						unsigned int priority = mixSeed(random.state, 0, 0);	// not tied to the position
+						if (isExcluded(p.x, p.y, mExcludeCircles, mExcludeRects))
+							continue;
+
+						int cx = glm::clamp((int)((p.x - origin.x) / cellSize), cx0, cx1 - 1);
+						int cz = glm::clamp((int)((p.y - origin.y) / cellSize), cz0, cz1 - 1);
+						if (grid[(size_t)cz * cellsX + cx].x != FLT_MAX)
+							continue;
+
+						// Anything closer than the spacing is at most two cells away
+						bool free = true;
+						for (int z = std::max(cz - 2, 0); z <= std::min(cz + 2, cellsZ - 1) && free; z++)
+						{
+							for (int x = std::max(cx - 2, 0); x <= std::min(cx + 2, cellsX - 1); x++)
+							{
+								const glm::vec2& q = grid[(size_t)z * cellsX + x];
+								glm::vec2 offset = q - p;
+								if (q.x != FLT_MAX && glm::dot(offset, offset) < spacing2)
+								{
+									free = false;
+									break;
+								}
+							}
+						}
+						if (!free)
+							continue;
+
+						grid[(size_t)cz * cellsX + cx] = p;
+
+						Candidate candidate;
+						candidate.position = p;
+						candidate.priority = priority;
+						candidate.order = 0;
+						kept.push_back(candidate);
+					}
+				}
+			});
+	}
+
+	// Tile order, then the lowest priorities, given back in tile order
+	std::vector<Candidate> candidates;
+	for (size_t t = 0; t < tilePoints.size(); t++)
+		candidates.insert(candidates.end(), tilePoints[t].begin(), tilePoints[t].end());
+	for (size_t i = 0; i < candidates.size(); i++)
+		candidates[i].order = (unsigned int)i;
+
+	if ((size_t)count < candidates.size())
+	{
+		std::nth_element(candidates.begin(), candidates.begin() + count, candidates.end(), PriorityOrder());
+		candidates.resize(count);
+		std::sort(candidates.begin(), candidates.end(), KeptOrder());
+	}
+
+	points.resize(candidates.size());
+	for (size_t i = 0; i < candidates.size(); i++)
+		points[i] = candidates[i].position;
+}
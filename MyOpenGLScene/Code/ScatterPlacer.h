@@ -0,0 +1,87 @@
+//-----------------------------------------------------------------------------
+// Seeded scatter placement for the scene's instance sets
+//
+// With a spacing, the points are a Poisson disk set: no two closer than the
+// spacing.  The area is covered by a background grid of cells spacing / sqrt(2)
+// wide, so a cell holds at most one point and a candidate only has to be
+// checked against the 5x5 cells around it.  The grid is split in tiles of
+// TILE_CELLS cells processed in four passes, one per corner of a 2x2 pattern:
+// tiles of the same pass are a whole tile apart, so they are filled in
+// parallel without seeing each other's points.  Every tile throws darts from
+// its own generator, seeded from the scene seed and the tile, and gives each
+// kept point a random priority; the count points of lowest priority are
+// returned.  The result depends on the seed only, never on the thread count.
+//
+// Without a spacing, every point is drawn uniformly from its own generator
+// and redrawn while it falls in an exclusion zone.
+//-----------------------------------------------------------------------------
+#ifndef SCATTER_PLACER_H
+#define SCATTER_PLACER_H
+
+#include <vector>
+#include "glm/glm.hpp"
+
+#include "JobSystem.h"
+
+
+//-----------------------------------------------------------------------------
+// Small deterministic generator used by the placement rules so a given seed
+// produces the same scene with every compiler (unlike rand())
+//-----------------------------------------------------------------------------
+struct PlacementRandom
+{
+	PlacementRandom(unsigned int seed) : state(seed * 2654435761u + 1u) {}
+
+	// Uniform in [0, 1)
+	float next()
+	{
+		state = state * 1664525u + 1013904223u;
+		return (float)(state >> 8) * (1.0f / 16777216.0f);
+	}
+
+	float range(float a, float b) { return a + (b - a) * next(); }
+
+	unsigned int state;
+};
+
+
+class ScatterPlacer
+{
+public:
+
+	static const int TILE_CELLS = 16;			// grid cells per tile side (2 or more)
+	static const int CANDIDATES_PER_CELL = 4;	// darts thrown per grid cell
+	static const int MAX_ATTEMPTS = 100;		// draws per point without a spacing
+
+	ScatterPlacer();
+
+	// Rectangle the points are taken from (x0, x1, z0, z1)
+	void setArea(const glm::vec4& area) { mArea = area; }
+
+	// No point lands inside a circle (x, z, radius) or rectangle (x0, x1, z0, z1)
+	void addExcludedCircle(const glm::vec3& circle) { mExcludeCircles.push_back(circle); }
+	void addExcludedRect(const glm::vec4& rect)     { mExcludeRects.push_back(rect); }
+
+	static bool isExcluded(float x, float z, const std::vector<glm::vec3>& circles, const std::vector<glm::vec4>& rects);
+
+	// Up to count points (x, z) at least spacing apart (0 for no spacing).
+	// Fewer when the area is full.  jobs may be NULL to place on this thread.
+	void place(int count, float spacing, unsigned int seed, JobSystem* jobs, std::vector<glm::vec2>& points) const;
+
+private:
+
+	struct Candidate
+	{
+		glm::vec2 position;
+		unsigned int priority;
+		unsigned int order;		// tiebreak: tile order then kept order
+	};
+
+	void placeRandom(int count, unsigned int seed, JobSystem* jobs, std::vector<glm::vec2>& points) const;
+	void placePoissonDisk(int count, float spacing, unsigned int seed, JobSystem* jobs, std::vector<glm::vec2>& points) const;
+
+	glm::vec4 mArea;
+	std::vector<glm::vec3> mExcludeCircles;
+	std::vector<glm::vec4> mExcludeRects;
+};
+#endif //SCATTER_PLACER_H
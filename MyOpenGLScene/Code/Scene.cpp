@@ -6,6 +6,12 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <map>
+#include <cfloat>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #define GLEW_STATIC
 #include "GL/glew.h"	// Important - this header must come before glfw3 header
 #include "GLFW/glfw3.h"
@@ -16,15 +22,64 @@
 #include "Texture2D.h"
 #include "Camera.h"
 #include "Mesh.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "OcclusionCuller.h"
+#include "GpuDrivenRenderer.h"
+#include "SceneFile.h"
+#include "TransformSystem.h"
+#include "EntityStore.h"
+#include "Frustum.h"
+#include "LightClusterer.h"
+#include "DeferredRenderer.h"
+#include "ImpostorAtlas.h"
+#include "GrassRenderer.h"
+#include "Heightfield.h"
+#include "Terrain.h"
+#include "ShadowCascades.h"
+#include "RenderQueue.h"
+#include "GpuRingBuffer.h"
+#include "Profiler.h"
+#include "CameraPath.h"
+#include "CameraRecorder.h"
+#include "Benchmark.h"
+#include "GLStats.h"
+#include "LoadStats.h"
+#include "MemoryTracker.h"
+#include "GLContext.h"
 
 
 // Global Variables
 const char* APP_TITLE = "Introduction to Modern OpenGL - Multiple Lights";
 int gWindowWidth = 1600;
 int gWindowHeight = 900;
-GLFWwindow* gWindow = NULL;
+GLContext* gContext = NULL;
+GLContext::Backend gContextBackend = GLContext::GLFW_WINDOW;
+GLFWwindow* gWindow = NULL;		// NULL when headless
 bool gWireframe = false;
 bool gFlashlightOn = true;
+bool gOcclusionCulling = true;
+bool gGpuDriven = false;
+bool gGpuDrivenReady = false;
+bool gValidateGpuDriven = false;
+bool gGpuDrivenInvalid = false;		// a validation failed, the exit code says so
+bool gDeferred = false;
+bool gDeferredReady = false;
+bool gDepthPrepass = false;
+bool gShadows = true;
+bool gExportProfile = false;
+bool gPrintGLStats = false;
+bool gPrintMemory = false;
+bool gBenchmark = false;
+int gBenchmarkFrames = 600;
+std::string gBenchmarkPath = "scenes/benchmark.path";
+std::string gBenchmarkReport = "benchmark.json";
+bool gRecord = false;
+bool gToggleRecording = false;
+std::string gRecordFile = "camera.rec";
+std::string gReplayFile;
+int gMaxDrawCalls = 0;
+int gGpuBudgetMB = 0;
 glm::vec4 gClearColor(0.06f, 0.06f, 0.07f, 1.0f);
 
 FPSCamera fpsCamera(glm::vec3(-80.0f, 50.0f, 80.0f));
@@ -32,376 +87,447 @@ const double ZOOM_SENSITIVITY = -3.0;
 const float MOVE_SPEED = 15.0; // units per second
 const float MOUSE_SENSITIVITY = 0.1f;
 
+// Near and far planes, also used to slice the light clusters
+const float Z_NEAR = 0.1f;
+const float Z_FAR = 600.0f;
+
+// Sun shadows reach this far from the camera
+const float SHADOW_DISTANCE = 300.0f;
+
+// lodFade of the materials that never fade to an impostor
+const glm::vec2 NO_LOD_FADE(1e30f, 0.0f);
+
+// Wind of the grass: direction on the ground (x, z), strength
+const glm::vec3 GRASS_WIND(0.93f, 0.37f, 0.35f);
+
 
 // Function prototypes
 void glfw_onKey(GLFWwindow* window, int key, int scancode, int action, int mode);
 void glfw_onFramebufferSize(GLFWwindow* window, int width, int height);
 void glfw_onMouseScroll(GLFWwindow* window, double deltaX, double deltaY);
 void update(double elapsedTime);
-void showFPS(GLFWwindow* window);
+void showFPS();
+void setLightingUniforms(ShaderProgram& shader, const SceneFile& scene, const ShadowCascades& shadows);
 bool initOpenGL();
+void shutdownOpenGL();
+bool parseArguments(int argc, char* argv[]);
 
 //-----------------------------------------------------------------------------
 // Main Application Entry Point
 //-----------------------------------------------------------------------------
-int main()
+int main(int argc, char* argv[])
 {
+	if (!parseArguments(argc, argv))
+		return -1;
+
+	long long startupBegin = Profiler::now();
+
 	if (!initOpenGL())
 	{
 		// An error occured
-		std::cerr << "GLFW initialization failed" << std::endl;
+		std::cerr << "OpenGL initialization failed" << std::endl;
+		shutdownOpenGL();
 		return -1;
 	}
 
+	// Everything is drawn instanced, the model matrices come from a texture buffer
 	ShaderProgram lightingShader;
-	lightingShader.loadShaders("shaders/lighting_dir_point_spot.vert", "shaders/lighting_dir_point_spot.frag");
 
+	// Positions only, for the optional depth pre-pass
+	ShaderProgram depthShader;
 
-	fpsCamera.rotate(-100.0f, -20.0f);
-
-	// Load meshes and textures
-	const int numModels = 5;
-	Mesh mesh[numModels];
-	Texture2D texture[numModels];
-
-
-	mesh[0].loadOBJ("models/floor.obj");
-	mesh[1].loadOBJ("models/wooden_tower.obj");
-	mesh[2].loadOBJ("models/fox.obj");
-	mesh[3].loadOBJ("models/campfire.obj");
-	mesh[4].loadOBJ("models/cart.obj");
-
-	texture[0].loadTexture("textures/Green1.jpg", true);
-	texture[1].loadTexture("textures/wooden_tower.jpg", true);
-	texture[2].loadTexture("textures/fox.png", true);
-	texture[3].loadTexture("textures/campfire.png", true);
-	texture[4].loadTexture("textures/cart_wood.png", true);
-	// Model positions
-	glm::vec3 modelPos[] = {
-		glm::vec3(0.0f, 0.0f, 0.0f),	// floor
-		glm::vec3(-20.0f, 0.0f, 20.0f),	// tower
-		glm::vec3(10.0f, 0.0f, 35.0f),	// fox
-		glm::vec3(0.0f, 0.0f, 0.0f),
-		glm::vec3(-10.0f, 0.0f, -20.0f),
-	};
-
-	// Model scale
-	glm::vec3 modelScale[] = {
-		glm::vec3(200.0f, 1.0f, 200.0f),	// floor
-		glm::vec3(3.8f, 3.8f, 3.8f),		// tower
-		glm::vec3(0.05f, 0.05f, 0.05f)	,	// fox
-		glm::vec3(3.0f, 3.0f, 3.0f),
-		glm::vec3(2.0f, 2.0f, 2.0f)
-	};
-
-	float rotations[] = {
-		0.0f,	// floor
-		0.0f,		// tower
-		160.0f	,	// fox
-		0.0f,
-		0.0f
-	};
-
-
-
-
-
-	const int number_of_grass_object = 7;
-	Mesh grass[number_of_grass_object];
-	Texture2D grass_texture[number_of_grass_object];
-
-	grass[0].loadOBJ("models/grass_b1.obj");
-	grass[1].loadOBJ("models/grass_b2.obj");
-	grass[2].loadOBJ("models/grass_b3.obj");
-	grass[3].loadOBJ("models/grass_b4.obj");
-	grass[4].loadOBJ("models/grass_b5.obj");
-	grass[5].loadOBJ("models/grass_b6.obj");
-	grass[6].loadOBJ("models/grass_b7.obj");
-
-
-	grass_texture[0].loadTexture("textures/Green1.jpg");
-	grass_texture[1].loadTexture("textures/Green1.jpg");
-	grass_texture[2].loadTexture("textures/Green1.jpg");
-	grass_texture[3].loadTexture("textures/Green1.jpg");
-	grass_texture[4].loadTexture("textures/Green1.jpg");
-	grass_texture[5].loadTexture("textures/Green1.jpg");
-	grass_texture[6].loadTexture("textures/Green1.jpg");
-
-	glm::vec3 grassScale[] = {
-		glm::vec3(4.0f, 4.0f, 4.0f),		// 1
-		glm::vec3(4.0f, 4.0f, 4.0f),
-		glm::vec3(4.0f, 4.0f, 4.0f),
-		glm::vec3(4.0f, 4.0f, 4.0f),
-		glm::vec3(4.0f, 4.0f, 4.0f),
-		glm::vec3(4.0f, 4.0f, 4.0f),
-		glm::vec3(4.0f, 4.0f, 4.0f)
-	};
+	if (!lightingShader.loadShaders("shaders/lighting_instanced.vert", "shaders/lighting_clustered.frag") ||
+		!depthShader.loadShaders("shaders/depth_only.vert", "shaders/depth_only.frag"))
+	{
+		std::cerr << "Shader loading failed" << std::endl;
+		shutdownOpenGL();
+		return -1;
+	}
 
 
+	fpsCamera.rotate(-100.0f, -20.0f);
 
 	//-----------------------------------------------------------------------------
-	// Trees Models and Textures
+	// Scene description - compiled from the text file on first launch, then
+	// loaded from the binary file with every transform already baked
 	//-----------------------------------------------------------------------------
-	const int number_of_trees_object = 12;
-	Mesh trees[number_of_trees_object];
-	Texture2D treeTextures[number_of_trees_object];
-
-	trees[0].loadOBJ("models/tree1.obj");
-	trees[1].loadOBJ("models/tree2.obj");
-	trees[2].loadOBJ("models/tree3.obj");
-	trees[3].loadOBJ("models/tree4.obj");
-	trees[4].loadOBJ("models/tree5.obj");
-	trees[5].loadOBJ("models/tree6.obj");
-	trees[6].loadOBJ("models/tree7.obj");
-	trees[7].loadOBJ("models/tree8.obj");
-	trees[8].loadOBJ("models/tree9.obj");
-	trees[9].loadOBJ("models/tree10.obj");
-	trees[10].loadOBJ("models/tree11.obj");
-	trees[11].loadOBJ("models/tree12.obj");
-
-	treeTextures[0].loadTexture("textures/tree1.png", true);
-	treeTextures[1].loadTexture("textures/tree2.png", true);
-	treeTextures[2].loadTexture("textures/tree3.png", true);
-	treeTextures[3].loadTexture("textures/tree4.png", true);
-	treeTextures[4].loadTexture("textures/tree5.png", true);
-	treeTextures[5].loadTexture("textures/tree6.png", true);
-	treeTextures[6].loadTexture("textures/tree7.png", true);
-	treeTextures[7].loadTexture("textures/tree8.png", true);
-	treeTextures[8].loadTexture("textures/tree9.png", true);
-	treeTextures[9].loadTexture("textures/tree10.png", true);
-	treeTextures[10].loadTexture("textures/tree11.png", true);
-	treeTextures[11].loadTexture("textures/tree12.png", true);
-
-	glm::vec3 treeScale[] = {
-		glm::vec3(15.0f, 15.0f, 15.0f),		// 1
-		glm::vec3(15.0f, 15.0f, 15.0f),		// 2
-		glm::vec3(15.0f, 15.0f, 15.0f),		// 3
-		glm::vec3(15.0f, 15.0f, 15.0f),		// 4
-		glm::vec3(15.0f, 15.0f, 15.0f),		// 5
-		glm::vec3(15.0f, 15.0f, 15.0f),		// 6
-		glm::vec3(15.0f, 15.0f, 15.0f),		// 7
-		glm::vec3(15.0f, 15.0f, 15.0f),		// 8
-		glm::vec3(30.0f, 30.0f, 30.0f),		// 9
-		glm::vec3(15.0f, 15.0f, 15.0f),		// 10
-		glm::vec3(15.0f, 15.0f, 15.0f),		// 11
-		glm::vec3(15.0f, 15.0f, 15.0f)		// 12
-	};
-
-
+	JobSystem jobSystem;
+	jobSystem.init();
 
+	SceneFile scene;
+	if (!scene.load("scenes/forest.scene", "scenes/forest.sceneb", &jobSystem))
+	{
+		std::cerr << "Scene loading failed" << std::endl;
+		shutdownOpenGL();
+		return -1;
+	}
 
-	//-----------------------------------------------------------------------------
-	// Mushrooms Models and Textures
-	//-----------------------------------------------------------------------------
-	const int number_of_mushrooms_object = 6;
-	Mesh mushrooms[number_of_mushrooms_object];
-	Texture2D mushroomTextures[number_of_mushrooms_object];
+	const int numAssets = scene.getNumAssets();
+	const glm::mat4* instanceTransforms = scene.getInstanceTransforms();
+	const GLuint* instanceAssets = scene.getInstanceAssets();
 
-	mushrooms[0].loadOBJ("models/mushroom1.obj");
-	mushrooms[1].loadOBJ("models/mushroom2.obj");
-	mushrooms[2].loadOBJ("models/mushroom3.obj");
-	mushrooms[3].loadOBJ("models/mushroom5.obj");
-	mushrooms[4].loadOBJ("models/mushroom5.obj");
-	mushrooms[5].loadOBJ("models/mushroom8.obj");
+	// Load meshes and textures.  Assets using the same texture file share it.
+	std::vector<Mesh> meshes(numAssets);
+	std::vector<int> assetTextures(numAssets);
+	std::map<std::string, int> textureNames;
+	for (int i = 0; i < numAssets; i++)
+	{
+		std::string textureName = scene.getString(scene.getAsset(i).textureName);
+		if (textureNames.find(textureName) == textureNames.end())
+		{
+			int textureIndex = (int)textureNames.size();
+			textureNames[textureName] = textureIndex;
+		}
+		assetTextures[i] = textureNames[textureName];
 
-	mushroomTextures[0].loadTexture("textures/mushroom1.jpg", true);
-	mushroomTextures[1].loadTexture("textures/mushroom2.jpg", true);
-	mushroomTextures[2].loadTexture("textures/mushroom3.jpg", true);
-	mushroomTextures[3].loadTexture("textures/mushroom5.jpg", true);
-	mushroomTextures[4].loadTexture("textures/mushroom5.jpg", true);
-	mushroomTextures[5].loadTexture("textures/mushroom8.jpg", true);
+		meshes[i].loadOBJ(scene.getString(scene.getAsset(i).meshName));
+	}
 
-	glm::vec3 mushroomScale[] = {
-		glm::vec3(1.0f, 1.0f, 1.0f),		// 1
-		glm::vec3(1.0f, 1.0f, 1.0f),
-		glm::vec3(10.0f, 10.0f, 10.0f),
-		glm::vec3(10.0f, 10.0f, 10.0f),
-		glm::vec3(10.0f, 10.0f, 10.0f),
-		glm::vec3(10.0f, 10.0f, 10.0f)
-	};
+	std::vector<Texture2D> textures(textureNames.size());
+	for (std::map<std::string, int>::const_iterator it = textureNames.begin(); it != textureNames.end(); ++it)
+		textures[it->second].loadTexture(it->first, true);
 
 
+	fpsCamera.rotate(60.0f, 0.0f);
 
 
 	//-----------------------------------------------------------------------------
-	// Wood Models and Textures
+	// Transforms - nothing moves so they are built and uploaded once
 	//-----------------------------------------------------------------------------
-	const int number_of_wood_object = 1;
-	Mesh woods[number_of_wood_object];
-	Texture2D woodTextures[number_of_wood_object];
-
-	woods[0].loadOBJ("models/wood.obj");
+	TransformSystem transforms;
+	std::vector<int> objectTransforms(scene.getNumObjects());
+	for (int i = 0; i < scene.getNumObjects(); i++)
+		objectTransforms[i] = transforms.add(scene.getObject(i).model);
 
-	woodTextures[0].loadTexture("textures/wood.png", true);
-
-	glm::vec3 woodScale[] = {
-		glm::vec3(3.0f, 3.0f, 3.0f)
-	};
+	const int firstInstanceTransform = transforms.getNumTransforms();
+	for (int i = 0; i < scene.getNumInstances(); i++)
+		transforms.add(instanceTransforms[i]);
 
+	transforms.update();
+	transforms.upload();
 
 	//-----------------------------------------------------------------------------
-	// Axe Models and Textures
+	// Impostors of the meshes used by sets that switch to them in the distance
 	//-----------------------------------------------------------------------------
-	Mesh axe;
-	Texture2D axeTexture;
-
-	axe.loadOBJ("models/axe.obj");
-
-	axeTexture.loadTexture("textures/axe.png", true);
-
+	ImpostorAtlas impostors;
+	std::vector<int> assetImpostors(numAssets, -1);
+	for (int s = 0; s < scene.getNumInstanceSets(); s++)
+	{
+		const SceneFile::InstanceSet& set = scene.getInstanceSet(s);
+		if (set.impostorDistance <= 0.0f)
+			continue;
 
+		for (GLuint i = set.firstInstance; i < set.firstInstance + set.numInstances; i++)
+		{
+			if (assetImpostors[instanceAssets[i]] < 0)
+				assetImpostors[instanceAssets[i]] = impostors.add(meshes[instanceAssets[i]], textures[assetTextures[instanceAssets[i]]]);
+		}
+	}
+	bool impostorsReady = impostors.getNumImpostors() > 0 && impostors.bake();
 
 	//-----------------------------------------------------------------------------
-	// House Models and Textures
+	// Entities - one per static object and per instance, plus one per impostor.
+	// Impostor entities use the mesh ids after the assets.
 	//-----------------------------------------------------------------------------
-	Mesh house;
-	Texture2D houseTexture;
-
-	house.loadOBJ("models/house.obj");
-
-	houseTexture.loadTexture("textures/cart_wood.png", true);
-
-
-
-
-
-	fpsCamera.rotate(60.0f, 0.0f);
-
-
-	float angle = 0.0f;
-
-	const int number_of_trees = 800;
-
-	int treesNum[number_of_trees];
-	glm::vec3 treePos[number_of_trees];
-	float tree_rotation[number_of_trees];
-	for (int i = 0; i < number_of_trees; i++)
+	RenderQueue renderQueue;
+	EntityStore entities;
+	for (int i = 0; i < scene.getNumObjects(); i++)
 	{
-		int k = rand() % number_of_trees_object;
-		treesNum[i] = k;
-		float x, z;
-		do {
-			x = (rand() % 800) - 400;
-			z = (rand() % 800) - 400;
+		const SceneFile::Object& object = scene.getObject(i);
+		int material = renderQueue.addMaterial(textures[assetTextures[object.asset]].getHandle(), object.specular, object.shininess, NO_LOD_FADE);
+		unsigned int flags = (object.flags & SceneFile::OCCLUSION_CULLED) ? EntityStore::OCCLUSION_CULLED : 0;
 
-		} while (sqrt(x * x + z * z) < 75);
+		entities.add(object.asset, material, objectTransforms[i], meshes[object.asset].getBoundsMin(), meshes[object.asset].getBoundsMax(), FLT_MAX, flags);
+	}
+	for (int s = 0; s < scene.getNumInstanceSets(); s++)
+	{
+		const SceneFile::InstanceSet& set = scene.getInstanceSet(s);
+		unsigned int flags = EntityStore::GPU_DRIVEN | ((set.flags & SceneFile::OCCLUSION_CULLED) ? EntityStore::OCCLUSION_CULLED : 0);
 
-		tree_rotation[i] = rand() % 360;
+		// The mesh fades out over [impostorDistance, impostorDistance + impostorFade]
+		// while the impostor fades in
+		bool useImpostors = impostorsReady && set.impostorDistance > 0.0f;
+		float fadeEnd = set.impostorDistance + set.impostorFade;
+		glm::vec2 lodFade = useImpostors ? glm::vec2(set.impostorDistance, 1.0f / glm::max(set.impostorFade, 0.001f)) : NO_LOD_FADE;
 
-		treePos[i] = glm::vec3(x, 0.0f, z);
+		for (GLuint i = set.firstInstance; i < set.firstInstance + set.numInstances; i++)
+		{
+			int asset = instanceAssets[i];
+			int material = renderQueue.addMaterial(textures[assetTextures[asset]].getHandle(), set.specular, set.shininess, lodFade);
+
+			if (!useImpostors)
+			{
+				entities.add(asset, material, firstInstanceTransform + i, meshes[asset].getBoundsMin(), meshes[asset].getBoundsMax(), set.drawDistance, flags);
+				continue;
+			}
+
+			entities.add(asset, material, firstInstanceTransform + i, meshes[asset].getBoundsMin(), meshes[asset].getBoundsMax(), glm::min(fadeEnd, set.drawDistance), flags);
+			if (set.impostorDistance < set.drawDistance)
+				entities.add(numAssets + assetImpostors[asset], material, firstInstanceTransform + i, meshes[asset].getBoundsMin(), meshes[asset].getBoundsMax(), set.drawDistance, flags, set.impostorDistance);
+		}
 	}
+	entities.build();
 
+	// Transform ids of the visible entities, streamed every frame
+	GpuRingBuffer drawInstanceRing;
+	drawInstanceRing.init(entities.getNumEntities() * sizeof(GLuint));
 
 
+	//-----------------------------------------------------------------------------
+	// Occlusion culling - objects and sets flagged as occluders can hide others
+	//-----------------------------------------------------------------------------
+	OcclusionCuller occlusionCuller;
+	std::vector<int> assetOccluders(numAssets, -1);
+	for (int i = 0; i < scene.getNumObjects(); i++)
+	{
+		const SceneFile::Object& object = scene.getObject(i);
+		if ((object.flags & SceneFile::OCCLUDER) && assetOccluders[object.asset] < 0)
+			assetOccluders[object.asset] = occlusionCuller.addOccluderMesh(meshes[object.asset].getVertices());
+	}
+	for (int s = 0; s < scene.getNumInstanceSets(); s++)
+	{
+		const SceneFile::InstanceSet& set = scene.getInstanceSet(s);
+		if (!(set.flags & SceneFile::OCCLUDER))
+			continue;
 
+		for (GLuint i = set.firstInstance; i < set.firstInstance + set.numInstances; i++)
+		{
+			if (assetOccluders[instanceAssets[i]] < 0)
+				assetOccluders[instanceAssets[i]] = occlusionCuller.addOccluderMesh(meshes[instanceAssets[i]].getVertices());
+		}
+	}
 
 
-	const int number_of_grasses = 3000;
-
-	int grassNum[number_of_grasses];
-	glm::vec3 grassPos[number_of_grasses];
-	float grass_rotation[number_of_grasses];
-	for (int i = 0; i < number_of_grasses; i++)
+	//-----------------------------------------------------------------------------
+	// Point lights - binned in view space clusters every frame, the shaders only
+	// light a fragment with the lights of its cluster
+	//-----------------------------------------------------------------------------
+	LightClusterer lightClusterer;
+	std::vector<LightClusterer::PointLight> pointLights;
+	for (int i = 0; i < scene.getNumLights(); i++)
 	{
-		int k = rand() % number_of_grass_object;
-		grassNum[i] = k;
-		float x, z;
-		do {
-			x = (rand() % 800) - 400;
-			z = (rand() % 800) - 400;
-		} while (x > 30 && x < 70 && z >5 && z < 35);
+		const SceneFile::Light& light = scene.getLight(i);
+		if (light.type != SceneFile::POINT_LIGHT)
+			continue;
+
+		LightClusterer::PointLight pointLight;
+		pointLight.position = light.position;
+		pointLight.diffuse = light.diffuse;
+		pointLight.specular = light.specular;
+		pointLight.constant = light.constant;
+		pointLight.linear = light.linear;
+		pointLight.exponent = light.exponent;
+		pointLights.push_back(pointLight);
+	}
+	lightClusterer.setLights(pointLights);
 
-		grass_rotation[i] = rand() % 360;
 
-		grassPos[i] = glm::vec3(x, 0.0f, z);
+	// Terrain - the heights are generated again from the scene's terrain
+	// statement, the same way the object heights were when it was compiled
+	Heightfield heightfield;
+	bool terrainReady = false;
+	Terrain terrain;
+	if (scene.hasTerrain() && scene.buildHeightfield(heightfield))
+	{
+		const SceneFile::Terrain& terrainDesc = scene.getTerrain();
+		terrainReady = terrain.init(heightfield, scene.getString(terrainDesc.textureName), terrainDesc.textureTile);
 	}
 
+	// Hills hide what is behind them: a coarse copy of the terrain, lowered
+	// under the drawn ground, is rasterized with the other occluders.  The
+	// meshes are made for the lods the ground is drawn at, in the frame loop.
+	std::vector<int> terrainOccluders;
+	std::vector<int> terrainOccluderLods;
+	std::vector<Vertex> terrainOccluderVertices;
+	if (terrainReady)
+	{
+		for (int i = 0; i < terrain.getNumOccluders(); i++)
+			terrainOccluders.push_back(occlusionCuller.addOccluderMesh(terrainOccluderVertices));
+		terrainOccluderLods.assign(terrainOccluders.size(), -1);
+	}
 
 
+	// Grass fields - generated on the GPU from the patches of the scene file
+	GrassRenderer grass;
+	bool grassReady = grass.init(scene, heightfield);
 
 
-	const int number_of_mushrooms = 600;
-
-	int mushroomNum[number_of_mushrooms];
-	glm::vec3 mushroomPos[number_of_mushrooms];
-	float mushroom_rotation[number_of_mushrooms];
-	for (int i = 0; i < number_of_mushrooms; i++)
+	// Sun shadows - cascades around the camera, cached while it stays put
+	ShadowCascades shadows;
+	bool shadowsReady = false;
+	for (int i = 0; i < scene.getNumLights() && !shadowsReady; i++)
 	{
-		int k = rand() % number_of_mushrooms_object;
-		mushroomNum[i] = k;
-		float x, z;
-		x = (rand() % 800) - 400;
-		z = (rand() % 800) - 400;
-
-		mushroom_rotation[i] = rand() % 360;
-
-		mushroomPos[i] = glm::vec3(x, 0.0f, z);
+		if (scene.getLight(i).type == SceneFile::DIRECTIONAL_LIGHT)
+			shadowsReady = shadows.init(scene.getLight(i).direction, SHADOW_DISTANCE);
 	}
+	if (!shadowsReady)
+		std::cerr << "Shadows disabled" << std::endl;
 
 
+	// Deferred path - selected at runtime next to the forward one
+	DeferredRenderer deferredRenderer;
+	gDeferredReady = deferredRenderer.init();
+	if (!gDeferredReady)
+		std::cerr << "Deferred path disabled" << std::endl;
 
-	const int number_of_woods = 6;
 
-	int woodNum[number_of_woods];
-	glm::vec3 woodPos[number_of_woods];
-	float wood_rotation[number_of_woods];
-	for (int i = 0; i < number_of_woods; i += 2)
+	//-----------------------------------------------------------------------------
+	// GPU driven path (OpenGL 4.3+) for the instance sets
+	//-----------------------------------------------------------------------------
+	GpuDrivenRenderer gpuRenderer;
+	if (GpuDrivenRenderer::isSupported())
 	{
-		int k = rand() % number_of_wood_object;
-		woodNum[i] = k;
-		woodNum[i + 1] = k;
-		float x, z;
-
-		float r = 45.0 + (rand() % 10) - 5;
-		float angle = rand() % 360;
-
-		x = r * cosf(glm::radians(angle));
-		z = r * sinf(glm::radians(angle));
+		std::vector<int> assetMeshes(numAssets, -1);
+		for (int s = 0; s < scene.getNumInstanceSets(); s++)
+		{
+			const SceneFile::InstanceSet& set = scene.getInstanceSet(s);
+
+			// one model per asset used by the set, drawn up to the set's distance
+			std::vector<int> assetModels(numAssets, -1);
+			for (GLuint i = set.firstInstance; i < set.firstInstance + set.numInstances; i++)
+			{
+				int asset = instanceAssets[i];
+				if (assetModels[asset] < 0)
+				{
+					if (assetMeshes[asset] < 0)
+						assetMeshes[asset] = gpuRenderer.addMesh(meshes[asset], textures[assetTextures[asset]]);
+					assetModels[asset] = gpuRenderer.addModel(&assetMeshes[asset], &set.drawDistance, 1, set.specular, set.shininess);
+				}
+
+				gpuRenderer.addInstance(assetModels[asset], transforms.getWorld(firstInstanceTransform + i));
+			}
+		}
 
-		wood_rotation[i] = rand() % 360;
-		wood_rotation[i + 1] = wood_rotation[i] + 180.0f;
+		gGpuDrivenReady = gpuRenderer.build();
+		if (!gGpuDrivenReady)
+			std::cerr << "GPU driven path disabled" << std::endl;
+	}
 
-		woodPos[i] = glm::vec3(x, 0.0f, z);
-		woodPos[i + 1] = glm::vec3(x, 0.0f, z);
+	// Asked for on the command line: a run that can not use it has failed
+	if (gGpuDriven && !gGpuDrivenReady)
+	{
+		std::cerr << "--gpu-driven: the GPU driven path is not available" << std::endl;
+		shutdownOpenGL();
+		return -1;
 	}
 
 
+	// Where the startup time went, slowest assets first
+	LoadStats::report(std::cout);
+	std::cout << "Startup took " << (double)(Profiler::now() - startupBegin) * 1e-6 << " ms" << std::endl;
+	MemoryTracker::dump(std::cout);
+
 
+	// CPU scopes of this thread and the workers, GPU scopes if the driver
+	// has timestamps.  F2 writes the last frames to profile.json.
+	Profiler::setThreadName("Main");
+	Profiler::initGpu();
 
-	// Point Light positions
-	glm::vec3 pointLightPos[6] = {
-		glm::vec3(0.0f, 0.0f, 0.0f),
-		glm::vec3(-20.0f,  25.0f, 20.0f),
-		glm::vec3(50.0f,  5,  20.0f),
-		glm::vec3(50.0f,  5,  15.0f),
-		glm::vec3(50.0f,  5,  25.0f)
-	};
+	// Benchmark - the camera flies the path instead of following the input,
+	// one fixed step a frame so every run renders the same frames
+	CameraPath benchmarkPath;
+	Benchmark benchmark;
+	if (gBenchmark && !benchmarkPath.load(gBenchmarkPath))
+	{
+		std::cerr << "Benchmark path loading failed" << std::endl;
+		shutdownOpenGL();
+		return -1;
+	}
+	const int benchmarkEnd = Benchmark::WARMUP_FRAMES + gBenchmarkFrames;
+
+	// Recording of the camera, from the start with --record or toggled by
+	// F5, and replay of one in real time before the input takes over
+	CameraRecorder recorder;
+	if (gRecord && !gBenchmark)
+		recorder.start(fpsCamera);
+	CameraPath replayPath;
+	if (!gReplayFile.empty() && !gBenchmark && !replayPath.load(gReplayFile))
+	{
+		std::cerr << "Camera replay loading failed" << std::endl;
+		shutdownOpenGL();
+		return -1;
+	}
+	double replayStart = gContext->getTime();
+	int frameIndex = 0;
+	unsigned int gpuFramesRead = 0;
 
+	double lastTime = gContext->getTime();
 
-	double lastTime = glfwGetTime();
+	// Scratch memory of the frame's jobs, a part per thread, rewound after
+	// every swap
+	FrameArena frameArena;
+	frameArena.init(jobSystem.getThreadCount());
 
 	// Rendering loop
-	while (!glfwWindowShouldClose(gWindow))
+	while (!gContext->shouldClose() && !(gBenchmark && frameIndex == benchmarkEnd))
 	{
-		showFPS(gWindow);
+		long long frameStart = Profiler::now();
+		Profiler::beginFrame();
+		PROFILE_SCOPE("Frame");
+
+		// The GPU times read back now are QUERY_FRAMES frames old
+		if (gBenchmark && Profiler::getNumGpuFrames() != gpuFramesRead)
+		{
+			gpuFramesRead = Profiler::getNumGpuFrames();
+			if (frameIndex >= Benchmark::WARMUP_FRAMES + Profiler::QUERY_FRAMES)
+				benchmark.addGpuFrame(Profiler::getGpuFrameMs());
+		}
 
-		double currentTime = glfwGetTime();
+		showFPS();
+
+		double currentTime = gContext->getTime();
 		double deltaTime = currentTime - lastTime;
 
 		// Poll for and process events
-		glfwPollEvents();
-		update(deltaTime);
+		gContext->pollEvents();
 
-		// Clear the screen
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// Animation time: the clock, or the place on the path when benchmarking
+		double sceneTime = currentTime;
+		if (gBenchmark)
+		{
+			int measured = std::max(frameIndex - Benchmark::WARMUP_FRAMES, 0);
+			sceneTime = benchmarkPath.getDuration() * (double)measured / (double)std::max(gBenchmarkFrames - 1, 1);
+			benchmarkPath.apply((float)sceneTime, fpsCamera);
+		}
+		else if (!replayPath.isEmpty())
+		{
+			// By the clock, the frame rate of the replay does not matter
+			float replayTime = (float)(currentTime - replayStart);
+			replayPath.apply(replayTime, fpsCamera);
+			if (replayTime >= replayPath.getDuration())
+			{
+				// Headless, the replay is the whole run
+				replayPath.clear();
+				if (gWindow == NULL)
+					gContext->requestClose();
+			}
+		}
+		else if (gWindow != NULL)
+			update(deltaTime);
+
+		if (gToggleRecording)
+		{
+			if (recorder.isRecording())
+				recorder.stop(gRecordFile);
+			else
+				recorder.start(fpsCamera);
+			gToggleRecording = false;
+		}
+		else
+			recorder.update((float)deltaTime, fpsCamera);
+
+		// Only the transforms that moved are rebuilt and sent
+		transforms.update();
+		transforms.upload();
+		entities.update(transforms, jobSystem);
 
-		glm::mat4 model(1.0), view(1.0), projection(1.0);
+		glm::mat4 view(1.0), projection(1.0);
 
 		// Create the View matrix
 		view = fpsCamera.getViewMatrix();
 
 		// Create the projection matrix
-		projection = glm::perspective(glm::radians(fpsCamera.getFOV()), (float)gWindowWidth / (float)gWindowHeight, 0.1f, 600.0f);
+		projection = glm::perspective(glm::radians(fpsCamera.getFOV()), (float)gWindowWidth / (float)gWindowHeight, Z_NEAR, Z_FAR);
 
 		// update the view (camera) position
 		glm::vec3 viewPos;
@@ -410,289 +536,587 @@ int main()
 		viewPos.z = fpsCamera.getPosition().z;
 
 
-		// Must be called BEFORE setting uniforms because setting uniforms is done
-		// on the currently active shader program.
-		lightingShader.use();
-		lightingShader.setUniform("model", glm::mat4(1.0));  // do not need to translate the models so just send the identity matrix
-		lightingShader.setUniform("view", view);
-		lightingShader.setUniform("projection", projection);
-		lightingShader.setUniform("viewPos", viewPos);
-
-		// Directional light
-		lightingShader.setUniform("sunLight.direction", glm::vec3(0.0f, -0.9f, -0.17f));
-		lightingShader.setUniform("sunLight.ambient", glm::vec3(0.2f, 0.2f, 0.2f));
-		lightingShader.setUniform("sunLight.diffuse", glm::vec3(0.2f, 0.2f, 0.2f));		// dark
-		lightingShader.setUniform("sunLight.specular", glm::vec3(0.1f, 0.1f, 0.1f));
-
-		// Point Light 1
-		lightingShader.setUniform("pointLights[0].ambient", glm::vec3(0.2f, 0.2f, 0.2f));
-		lightingShader.setUniform("pointLights[0].diffuse", glm::vec3(1.0f, 0.0f, 0.0f));	// light  campfire
-		lightingShader.setUniform("pointLights[0].specular", glm::vec3(1.0f, 1.0f, 1.0f));
-		lightingShader.setUniform("pointLights[0].position", pointLightPos[0]);
-		lightingShader.setUniform("pointLights[0].constant", 1.0f);
-		lightingShader.setUniform("pointLights[0].linear", 0.05f);
-		lightingShader.setUniform("pointLights[0].exponent", 0.05f);
-
-		// Point Light 2
-		lightingShader.setUniform("pointLights[1].ambient", glm::vec3(0.8f, 0.8f, 0.8f));
-		lightingShader.setUniform("pointLights[1].diffuse", glm::vec3(1.0f, 0.1f, 0.0f));	// red-ish light  tower
-		lightingShader.setUniform("pointLights[1].specular", glm::vec3(1.0f, 1.0f, 1.0f));
-		lightingShader.setUniform("pointLights[1].position", pointLightPos[1]);
-		lightingShader.setUniform("pointLights[1].constant", 1.0f);
-		lightingShader.setUniform("pointLights[1].linear", 0.001f);
-		lightingShader.setUniform("pointLights[1].exponent", 0.002f);
-
-		// Point Light 3
-		lightingShader.setUniform("pointLights[2].ambient", glm::vec3(0.9f, 0.9f, 0.9f));
-		lightingShader.setUniform("pointLights[2].diffuse", glm::vec3(0.8f, 0.5f, 0.5f));	//  light  house
-		lightingShader.setUniform("pointLights[2].specular", glm::vec3(0.2f, 0.2f, 0.2f));
-		lightingShader.setUniform("pointLights[2].position", pointLightPos[2]);
-		lightingShader.setUniform("pointLights[2].constant", 1.0f);
-		lightingShader.setUniform("pointLights[2].linear", 0.001f);
-		lightingShader.setUniform("pointLights[2].exponent", 0.001f);
-
-		// Point Light 3
-		lightingShader.setUniform("pointLights[3].ambient", glm::vec3(0.9f, 0.9f, 0.9f));
-		lightingShader.setUniform("pointLights[3].diffuse", glm::vec3(0.8f, 0.5f, 0.5f));	//  light  house
-		lightingShader.setUniform("pointLights[3].specular", glm::vec3(0.2f, 0.2f, 0.2f));
-		lightingShader.setUniform("pointLights[3].position", pointLightPos[3]);
-		lightingShader.setUniform("pointLights[3].constant", 1.0f);
-		lightingShader.setUniform("pointLights[3].linear", 0.001f);
-		lightingShader.setUniform("pointLights[3].exponent", 0.001f);
-
-		// Point Light 3
-		lightingShader.setUniform("pointLights[4].ambient", glm::vec3(0.9f, 0.9f, 0.9f));
-		lightingShader.setUniform("pointLights[4].diffuse", glm::vec3(0.8f, 0.5f, 0.5f));	//  light  house
-		lightingShader.setUniform("pointLights[4].specular", glm::vec3(0.2f, 0.2f, 0.2f));
-		lightingShader.setUniform("pointLights[4].position", pointLightPos[4]);
-		lightingShader.setUniform("pointLights[4].constant", 1.0f);
-		lightingShader.setUniform("pointLights[4].linear", 0.001f);
-		lightingShader.setUniform("pointLights[4].exponent", 0.001f);
-
-		// Spot light
-		glm::vec3 spotlightPos = fpsCamera.getPosition();
-
-		// offset the flash light down a little
-		spotlightPos.y -= 0.5f;
-
-		lightingShader.setUniform("spotLight.ambient", glm::vec3(0.8f, 0.8f, 0.8f));
-		lightingShader.setUniform("spotLight.diffuse", glm::vec3(0.8f, 0.8f, 0.8f));
-		lightingShader.setUniform("spotLight.specular", glm::vec3(1.0f, 1.0f, 1.0f));
-		lightingShader.setUniform("spotLight.position", spotlightPos);
-		lightingShader.setUniform("spotLight.direction", fpsCamera.getLook());
-		lightingShader.setUniform("spotLight.cosInnerCone", glm::cos(glm::radians(15.0f)));
-		lightingShader.setUniform("spotLight.cosOuterCone", glm::cos(glm::radians(20.0f)));
-		lightingShader.setUniform("spotLight.constant", 1.0f);
-		lightingShader.setUniform("spotLight.linear", 0.01f);
-		lightingShader.setUniform("spotLight.exponent", 0.001f);
-		lightingShader.setUniform("spotLight.on", gFlashlightOn);
-
-		// Render the scene
-		for (int i = 0; i < numModels; i++)
-		{
-			model = glm::translate(glm::mat4(1.0), modelPos[i]) * glm::scale(glm::mat4(1.0), modelScale[i]) * glm::rotate(glm::mat4(), glm::radians(rotations[i]), glm::vec3(0.0f, 1.0f, 0.0f));
-			lightingShader.setUniform("model", model);
+		//-----------------------------------------------------------------------------
+		// Build: culling, lod selection and draw lists for every object family,
+		// on all cores and without GL calls
+		//-----------------------------------------------------------------------------
+
+		long long buildStart = Profiler::now();
 
-			// Set material properties
-			lightingShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
-			lightingShader.setUniformSampler("material.diffuseMap", 0);
-			lightingShader.setUniform("material.specular", glm::vec3(0.8f, 0.8f, 0.8f));
-			lightingShader.setUniform("material.shininess", 32.0f);
+		Frustum frustum;
+		frustum.update(projection * view);
 
-			texture[i].bind(0);		// set the texture before drawing.  Our simple OBJ mesh loader does not do materials yet.
-			mesh[i].draw();			// Render the OBJ mesh
-			texture[i].unbind(0);
+		// Rasterize the occluders on the CPU before submitting anything
+		if (gOcclusionCulling)
+		{
+			occlusionCuller.beginFrame(projection * view);
+			for (int i = 0; i < scene.getNumObjects(); i++)
+			{
+				const SceneFile::Object& object = scene.getObject(i);
+				if (object.flags & SceneFile::OCCLUDER)
+					occlusionCuller.addOccluder(assetOccluders[object.asset], transforms.getWorld(objectTransforms[i]));
+			}
+			for (size_t i = 0; i < terrainOccluders.size(); i++)
+			{
+				glm::vec3 boundsMin, boundsMax;
+				terrain.getOccluderBounds((int)i, boundsMin, boundsMax);
+				if (!frustum.intersectsBox(boundsMin, boundsMax))
+					continue;
+
+				int lod = terrain.getOccluderLod((int)i, viewPos);
+				if (lod != terrainOccluderLods[i])
+				{
+					terrain.buildOccluder((int)i, lod, terrainOccluderVertices);
+					occlusionCuller.setOccluderMesh(terrainOccluders[i], terrainOccluderVertices);
+					terrainOccluderLods[i] = lod;
+				}
+				occlusionCuller.addOccluder(terrainOccluders[i], glm::mat4(1.0f));
+			}
+
+			// Only the instances close to the camera are worth rasterizing: the
+			// maxOccluders nearest within occluderDistance
+			for (int s = 0; s < scene.getNumInstanceSets(); s++)
+			{
+				const SceneFile::InstanceSet& set = scene.getInstanceSet(s);
+				if (!(set.flags & SceneFile::OCCLUDER) || set.maxOccluders == 0)
+					continue;
+
+				FrameVector<std::pair<float, GLuint> > candidates(FrameAllocator<std::pair<float, GLuint> >(frameArena, 0));
+				candidates.reserve(set.numInstances);
+				for (GLuint i = set.firstInstance; i < set.firstInstance + set.numInstances; i++)
+				{
+					float distance = glm::length(glm::vec3(transforms.getWorld(firstInstanceTransform + i)[3]) - viewPos);
+					if (distance <= set.occluderDistance)
+						candidates.push_back(std::make_pair(distance, i));
+				}
+
+				if (candidates.size() > set.maxOccluders)
+				{
+					std::nth_element(candidates.begin(), candidates.begin() + set.maxOccluders, candidates.end());
+					candidates.resize(set.maxOccluders);
+				}
+
+				for (size_t c = 0; c < candidates.size(); c++)
+				{
+					GLuint i = candidates[c].second;
+					occlusionCuller.addOccluder(assetOccluders[instanceAssets[i]], transforms.getWorld(firstInstanceTransform + i));
+				}
+			}
+
+			occlusionCuller.rasterize(jobSystem);
 		}
 
+		// Cull and gather the visible entities of every batch (all cores)
+		entities.cull(transforms, frustum, viewPos, gOcclusionCulling ? &occlusionCuller : NULL, gGpuDriven ? EntityStore::GPU_DRIVEN : 0, jobSystem);
+		entities.extract(viewPos, jobSystem);
+		if (terrainReady)
+			terrain.select(frustum, viewPos);
+		if (grassReady)
+			grass.cull(frustum, viewPos, jobSystem, frameArena);
+
+		// Bin the point lights for this view
+		int framebufferWidth, framebufferHeight;
+		gContext->getFramebufferSize(framebufferWidth, framebufferHeight);
+		lightClusterer.update(view, projection, Z_NEAR, Z_FAR, framebufferWidth, framebufferHeight, jobSystem);
 
-		// render the log
-		model = glm::translate(glm::mat4(1.0), glm::vec3(20.0f, 0.0f, 10.0f)) * glm::scale(glm::mat4(1.0), glm::vec3(10.0f, 10.0f, 10.0f));
-		lightingShader.setUniform("model", model);
+		// Sorted draw commands of the extracted batches
+		renderQueue.build(entities, numAssets, jobSystem, frameArena);
+		long long buildEnd = Profiler::now();
+		Profiler::recordCpu("Build", buildStart, buildEnd);
 
-		// Set material properties
-		lightingShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
-		lightingShader.setUniformSampler("material.diffuseMap", 0);
-		lightingShader.setUniform("material.specular", glm::vec3(0.4f, 0.4f, 0.4f));
-		lightingShader.setUniform("material.shininess", 32.0f);
+		//-----------------------------------------------------------------------------
+		// Submit: uploads, then the draw lists are replayed on this thread
+		//-----------------------------------------------------------------------------
 
-		treeTextures[11].bind(0);		// set the texture before drawing.  Our simple OBJ mesh loader does not do materials yet.
-		trees[11].draw();			// Render the OBJ mesh
-		treeTextures[11].unbind(0);
+		long long submitStart = Profiler::now();
+		Profiler::beginGpu("GPU frame");
 
+		// Clear the screen
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		// The commands' first instances are relative to this frame's region
+		const std::vector<GLuint>& drawInstances = entities.getDrawInstances();
+		drawInstanceRing.beginFrame();
+		GLintptr drawInstanceOffset = drawInstanceRing.write(drawInstances.empty() ? NULL : &drawInstances[0], drawInstances.size() * sizeof(GLuint));
+		GLuint drawInstanceBuffer = drawInstanceRing.getBuffer();
+		GLuint instanceBase = (GLuint)(drawInstanceOffset / sizeof(GLuint));
 
-		// render the axe
-		model = glm::translate(glm::mat4(1.0), glm::vec3(18.0f, 4.1f, 10.0f)) * glm::scale(glm::mat4(1.0), glm::vec3(6.0f, 6.0f, 6.0f)) * glm::rotate(glm::mat4(), glm::radians(100.0f), glm::vec3(0.0f, 0.0f, -1.0f)) * glm::rotate(glm::mat4(), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		lightingShader.setUniform("model", model);
+		if (terrainReady)
+			terrain.upload();
+		if (grassReady)
+			grass.upload();
+		lightClusterer.upload();
 
-		// Set material properties
-		lightingShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
-		lightingShader.setUniformSampler("material.diffuseMap", 0);
-		lightingShader.setUniform("material.specular", glm::vec3(0.8f, 0.8f, 0.8f));
-		lightingShader.setUniform("material.shininess", 32.0f);
+		if (gGpuDriven)
+		{
+			PROFILE_GPU_SCOPE("GPU culling");
+			if (gValidateGpuDriven)
+			{
+				if (!gpuRenderer.validate(view, projection, viewPos))
+					gGpuDrivenInvalid = true;
+				gValidateGpuDriven = false;
+			}
+
+			gpuRenderer.cull(view, projection, viewPos);
+		}
 
-		axeTexture.bind(0);		// set the texture before drawing.  Our simple OBJ mesh loader does not do materials yet.
-		axe.draw();			// Render the OBJ mesh
-		axeTexture.unbind(0);
+		// Only the cascades the camera moved out of, or with moving casters
+		if (gShadows && shadowsReady)
+		{
+			PROFILE_GPU_SCOPE("Shadows");
+			shadows.update(viewPos, entities, transforms, meshes);
+		}
 
+		// Deferred: the geometry is written to the G-buffer and lit afterwards
+		if (gDeferred)
+			deferredRenderer.beginGeometryPass(framebufferWidth, framebufferHeight);
 
+		// Batches are drawn nearest first, their instances too
+		const std::vector<RenderQueue::Command>& meshCommands = renderQueue.getCommands(RenderQueue::MESHES);
+		const std::vector<RenderQueue::Command>& impostorCommands = renderQueue.getCommands(RenderQueue::IMPOSTORS);
 
-		// render the house
-		model = glm::translate(glm::mat4(1.0), glm::vec3(50.0f, 0.0f, 20.0f)) * glm::scale(glm::mat4(1.0), glm::vec3(1.0f, 1.0f, 1.0f)) * glm::rotate(glm::mat4(), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		lightingShader.setUniform("model", model);
+		// Depth pre-pass: the lighting shaders then run once per pixel (GL_EQUAL)
+		if (gDepthPrepass)
+		{
+			PROFILE_GPU_SCOPE("Depth pre-pass");
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+			depthShader.use();
+			depthShader.setUniform("view", view);
+			depthShader.setUniform("projection", projection);
+			depthShader.setUniform("viewPos", viewPos);
+			transforms.bindTexture(1);
+			depthShader.setUniformSampler("transforms", 1);
+
+			// Impostors are alpha tested, they are drawn after the main pass
+			for (size_t i = 0; i < meshCommands.size(); i++)
+			{
+				const RenderQueue::Command& command = meshCommands[i];
+				depthShader.setUniform("lodFade", command.material.lodFade);
+				meshes[command.object].drawDepthInstanced(drawInstanceBuffer, instanceBase + command.firstInstance, command.numInstances);
+			}
+
+			if (gGpuDriven)
+				gpuRenderer.draw(view, projection, GpuDrivenRenderer::DEPTH_PASS);
+
+			if (terrainReady)
+			{
+				ShaderProgram& terrainDepthShader = terrain.getDepthShader();
+				terrainDepthShader.use();
+				terrainDepthShader.setUniform("view", view);
+				terrainDepthShader.setUniform("projection", projection);
+				terrainDepthShader.setUniform("viewPos", viewPos);
+				terrain.draw(terrainDepthShader);
+			}
+
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			glDepthFunc(GL_EQUAL);
+			glDepthMask(GL_FALSE);
+		}
 
-		// Set material properties
-		lightingShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
-		lightingShader.setUniformSampler("material.diffuseMap", 0);
-		lightingShader.setUniform("material.specular", glm::vec3(0.8f, 0.8f, 0.8f));
-		lightingShader.setUniform("material.shininess", 32.0f);
+		ShaderProgram& sceneShader = gDeferred ? deferredRenderer.getGeometryShader() : lightingShader;
 
-		houseTexture.bind(0);		// set the texture before drawing.  Our simple OBJ mesh loader does not do materials yet.
-		house.draw();			// Render the OBJ mesh
-		houseTexture.unbind(0);
+		// Must be called BEFORE setting uniforms because setting uniforms is done
+		// on the currently active shader program.
+		sceneShader.use();
+		sceneShader.setUniform("view", view);
+		sceneShader.setUniform("projection", projection);
+		sceneShader.setUniform("viewPos", viewPos);
+		if (!gDeferred)
+		{
+			setLightingUniforms(sceneShader, scene, shadows);
+			lightClusterer.setUniforms(sceneShader, 2);
+		}
 
+		transforms.bindTexture(1);
+		sceneShader.setUniformSampler("transforms", 1);
 
-		// render the trees
-		for (int i = 0; i < number_of_trees; i++)
+		// Render the scene, one instanced draw per mesh/material
+		Profiler::beginGpu("Meshes");
+		sceneShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
+		sceneShader.setUniformSampler("material.diffuseMap", 0);
+		int currentMaterial = -1;
+		for (size_t i = 0; i < meshCommands.size(); i++)
 		{
-			model = glm::translate(glm::mat4(1.0), treePos[i]) * glm::scale(glm::mat4(1.0), treeScale[treesNum[i]]) * glm::rotate(glm::mat4(), glm::radians(tree_rotation[i]), glm::vec3(0.0f, 1.0f, 0.0f));
-			lightingShader.setUniform("model", model);
+			const RenderQueue::Command& command = meshCommands[i];
 
-			// Set material properties
-			lightingShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
-			lightingShader.setUniformSampler("material.diffuseMap", 0);
-			lightingShader.setUniform("material.specular", glm::vec3(0.8f, 0.8f, 0.8f));
-			lightingShader.setUniform("material.shininess", 32.0f);
+			// Set material properties, only when they change
+			if (command.materialId != currentMaterial)
+			{
+				sceneShader.setUniform("material.specular", command.material.specular);
+				sceneShader.setUniform("material.shininess", command.material.shininess);
+				sceneShader.setUniform("lodFade", command.material.lodFade);
 
-			treeTextures[treesNum[i]].bind(0);		// set the texture before drawing.  Our simple OBJ mesh loader does not do materials yet.
-			trees[treesNum[i]].draw();			// Render the OBJ mesh
-			treeTextures[treesNum[i]].unbind(0);
-		}
+				glActiveTexture(GL_TEXTURE0);
+				glBindTexture(GL_TEXTURE_2D, command.material.texture);
+				currentMaterial = command.materialId;
+			}
 
+			meshes[command.object].drawInstanced(drawInstanceBuffer, instanceBase + command.firstInstance, command.numInstances);
+		}
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		Profiler::endGpu();
 
 
+		if (gGpuDriven)
+		{
+			// Every instance set in one indirect draw
+			PROFILE_GPU_SCOPE("GPU driven draw");
+			if (!gDeferred)
+			{
+				ShaderProgram& gpuShader = gpuRenderer.getShader();
+				gpuShader.use();
+				gpuShader.setUniform("viewPos", viewPos);
+				setLightingUniforms(gpuShader, scene, shadows);
+				lightClusterer.setUniforms(gpuShader, 2);
+				gpuShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
+			}
+
+			gpuRenderer.draw(view, projection, gDeferred ? GpuDrivenRenderer::GBUFFER_PASS : GpuDrivenRenderer::LIT_PASS);
+		}
 
-		// render the grass
-		for (int i = 0; i < number_of_grasses; i++)
+		// Terrain after the meshes, most of it is hidden by them
+		if (terrainReady)
 		{
-			model = glm::translate(glm::mat4(1.0), grassPos[i]) * glm::scale(glm::mat4(1.0), grassScale[grassNum[i]]) * glm::rotate(glm::mat4(), glm::radians(grass_rotation[i]), glm::vec3(0.0f, 1.0f, 0.0f));
-			lightingShader.setUniform("model", model);
+			PROFILE_GPU_SCOPE("Terrain");
+			ShaderProgram& terrainShader = gDeferred ? terrain.getGBufferShader() : terrain.getShader();
+			terrainShader.use();
+			terrainShader.setUniform("view", view);
+			terrainShader.setUniform("projection", projection);
+			terrainShader.setUniform("viewPos", viewPos);
+			if (!gDeferred)
+			{
+				setLightingUniforms(terrainShader, scene, shadows);
+				lightClusterer.setUniforms(terrainShader, 2);
+				terrainShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
+			}
+			terrainShader.setUniform("material.specular", glm::vec3(0.1f, 0.1f, 0.1f));
+			terrainShader.setUniform("material.shininess", 8.0f);
+
+			terrain.draw(terrainShader);
+		}
 
-			// Set material properties
-			lightingShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
-			lightingShader.setUniformSampler("material.diffuseMap", 0);
-			lightingShader.setUniform("material.specular", glm::vec3(0.8f, 0.8f, 0.8f));
-			lightingShader.setUniform("material.shininess", 32.0f);
+		if (gDepthPrepass)
+		{
+			glDepthFunc(GL_LESS);
+			glDepthMask(GL_TRUE);
+		}
 
-			grass_texture[grassNum[i]].bind(0);		// set the texture before drawing.  Our simple OBJ mesh loader does not do materials yet.
-			grass[grassNum[i]].draw();			// Render the OBJ mesh
-			grass_texture[grassNum[i]].unbind(0);
+		// Grass fields, nearest (densest) level first - not part of the pre-pass
+		if (grassReady)
+		{
+			PROFILE_GPU_SCOPE("Grass");
+			ShaderProgram& grassShader = gDeferred ? grass.getGBufferShader() : grass.getShader();
+			grassShader.use();
+			grassShader.setUniform("view", view);
+			grassShader.setUniform("projection", projection);
+			grassShader.setUniform("viewPos", viewPos);
+			grassShader.setUniform("time", (float)sceneTime);
+			grassShader.setUniform("wind", GRASS_WIND);
+			if (terrainReady)
+				terrain.setHeightUniforms(grassShader);
+			if (!gDeferred)
+			{
+				setLightingUniforms(grassShader, scene, shadows);
+				lightClusterer.setUniforms(grassShader, 2);
+				grassShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
+			}
+
+			grass.draw(grassShader);
 		}
 
+		// Distant instances as impostors, fading in where the meshes fade out
+		if (impostorsReady)
+		{
+			PROFILE_GPU_SCOPE("Impostors");
+			ShaderProgram& impostorShader = gDeferred ? impostors.getGBufferShader() : impostors.getShader();
+			impostorShader.use();
+			impostorShader.setUniform("view", view);
+			impostorShader.setUniform("projection", projection);
+			impostorShader.setUniform("viewPos", viewPos);
+			if (!gDeferred)
+			{
+				setLightingUniforms(impostorShader, scene, shadows);
+				lightClusterer.setUniforms(impostorShader, 2);
+				impostorShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
+			}
+
+			transforms.bindTexture(1);
+			impostorShader.setUniformSampler("transforms", 1);
+
+			for (size_t i = 0; i < impostorCommands.size(); i++)
+			{
+				const RenderQueue::Command& command = impostorCommands[i];
+				impostorShader.setUniform("lodFade", command.material.lodFade);
+				impostors.draw(impostorShader, command.object, drawInstanceBuffer, instanceBase + command.firstInstance, command.numInstances);
+			}
+		}
 
+		if (gDeferred)
+		{
+			// Light every pixel of the G-buffer once
+			PROFILE_GPU_SCOPE("Deferred lighting");
+			deferredRenderer.endGeometryPass();
+
+			ShaderProgram& deferredShader = deferredRenderer.getLightingShader();
+			deferredShader.use();
+			deferredShader.setUniform("viewPos", viewPos);
+			deferredShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
+			setLightingUniforms(deferredShader, scene, shadows);
+			lightClusterer.setUniforms(deferredShader, DeferredRenderer::FIRST_FREE_TEX_UNIT);
+
+			deferredRenderer.drawLighting(view, projection);
+		}
 
 
-		// render the mushrooms
-		for (int i = 0; i < number_of_mushrooms; i++)
-		{
-			model = glm::translate(glm::mat4(1.0), mushroomPos[i]) * glm::scale(glm::mat4(1.0), mushroomScale[mushroomNum[i]]) * glm::rotate(glm::mat4(), glm::radians(mushroom_rotation[i]), glm::vec3(0.0f, 1.0f, 0.0f));
-			lightingShader.setUniform("model", model);
+		Profiler::endGpu();
+		long long submitEnd = Profiler::now();
+		Profiler::recordCpu("Submit", submitStart, submitEnd);
 
-			// Set material properties
-			lightingShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
-			lightingShader.setUniformSampler("material.diffuseMap", 0);
-			lightingShader.setUniform("material.specular", glm::vec3(0.8f, 0.8f, 0.8f));
-			lightingShader.setUniform("material.shininess", 32.0f);
+		// Swap front and back buffers
+		gContext->swapBuffers();
+		long long swapEnd = Profiler::now();
+		Profiler::recordCpu("Swap", submitEnd, swapEnd);
+		GLStats::endFrame();
+		frameArena.reset();
 
-			mushroomTextures[mushroomNum[i]].bind(0);		// set the texture before drawing.  Our simple OBJ mesh loader does not do materials yet.
-			mushrooms[mushroomNum[i]].draw();			// Render the OBJ mesh
-			mushroomTextures[mushroomNum[i]].unbind(0);
+		if (gBenchmark && frameIndex >= Benchmark::WARMUP_FRAMES)
+		{
+			benchmark.addFrame((double)(swapEnd - frameStart) * 1e-6, (double)(buildEnd - buildStart) * 1e-6, (double)(submitEnd - submitStart) * 1e-6);
+			if (GLStats::isEnabled())
+				benchmark.addGLFrame(GLStats::getFrame());
+			benchmark.addArenaFrame((double)frameArena.getLastFrameBytes() / 1024.0);
 		}
+		frameIndex++;
 
-
-		// render the woods
-		for (int i = 0; i < number_of_woods; i++)
+		if (gPrintGLStats)
 		{
-			model = glm::translate(glm::mat4(1.0), woodPos[i]) * glm::scale(glm::mat4(1.0), woodScale[woodNum[i]]) * glm::rotate(glm::mat4(), glm::radians(wood_rotation[i]), glm::vec3(0.0f, 1.0f, 0.0f));
-			lightingShader.setUniform("model", model);
+			GLStats::print(std::cout);
+			gPrintGLStats = false;
+		}
 
-			// Set material properties
-			lightingShader.setUniform("material.ambient", glm::vec3(0.1f, 0.1f, 0.1f));
-			lightingShader.setUniformSampler("material.diffuseMap", 0);
-			lightingShader.setUniform("material.specular", glm::vec3(0.8f, 0.8f, 0.8f));
-			lightingShader.setUniform("material.shininess", 32.0f);
+		if (gPrintMemory)
+		{
+			MemoryTracker::dump(std::cout);
+			frameArena.dump(std::cout);
+			gPrintMemory = false;
+		}
 
-			woodTextures[woodNum[i]].bind(0);		// set the texture before drawing.  Our simple OBJ mesh loader does not do materials yet.
-			woods[woodNum[i]].draw();			// Render the OBJ mesh
-			woodTextures[woodNum[i]].unbind(0);
+		// Between frames: no job is running
+		if (gExportProfile)
+		{
+			Profiler::exportTrace("profile.json");
+			gExportProfile = false;
 		}
 
+		lastTime = currentTime;
+	}
 
-		// Swap front and back buffers
-		glfwSwapBuffers(gWindow);
+	bool reportWritten = true;
+	if (gBenchmark)
+	{
+		int framebufferWidth, framebufferHeight;
+		gContext->getFramebufferSize(framebufferWidth, framebufferHeight);
+		reportWritten = benchmark.getNumFrames() > 0 && benchmark.writeReport(gBenchmarkReport,
+			(const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION), framebufferWidth, framebufferHeight);
+		frameArena.dump(std::cout);
+
+		// Draw call budget, checked on the worst frame
+		if (reportWritten && gMaxDrawCalls > 0)
+		{
+			if (!GLStats::isEnabled())
+			{
+				std::cerr << "GL stats are not compiled in, the draw call budget can not be checked" << std::endl;
+				reportWritten = false;
+			}
+			else if (benchmark.getMaxCount(GLStats::DRAW_CALLS) > (unsigned long long)gMaxDrawCalls)
+			{
+				std::cerr << "Draw call budget exceeded: " << benchmark.getMaxCount(GLStats::DRAW_CALLS) << " > " << gMaxDrawCalls << std::endl;
+				reportWritten = false;
+			}
+		}
 
-		lastTime = currentTime;
+		// Memory budget, checked on what the scene holds at the end
+		if (reportWritten && gGpuBudgetMB > 0)
+			reportWritten = MemoryTracker::checkBudget((long long)gGpuBudgetMB * 1024 * 1024);
 	}
 
-	glfwTerminate();
+	if (recorder.isRecording())
+		recorder.stop(gRecordFile);
 
-	return 0;
+	Profiler::shutdownGpu();
+	shutdownOpenGL();
+
+	return reportWritten && !gGpuDrivenInvalid ? 0 : -1;
 }
 
 //-----------------------------------------------------------------------------
-// Initialize GLFW and OpenGL
+// Command line.  Without arguments the scene runs interactively.
+//
+//   --benchmark [frames]    hidden window, flies the benchmark path over the
+//                           frames (600) and writes the report
+//   --path <file>           camera path of the benchmark, or a recording
+//   --report <file>         benchmark report (benchmark.json)
+//   --size <w> <h>          window size
+//   --max-draw-calls <n>    fails the benchmark if a frame makes more draw
+//                           calls (needs GL stats, in debug or GL_STATS builds)
+//   --gpu-budget <MB>       fails the benchmark if the buffers and textures
+//                           take more
+//   --record <file>         records the camera from the start, F5 toggles
+//                           the recording to this file (camera.rec)
+//   --replay <file>         replays a recording or a path, then gives the
+//                           camera back to the input
+//   --context <backend>     glfw (window), egl (surfaceless) or osmesa
+//                           (software).  The headless ones have no input and
+//                           need --benchmark or --replay.
+//   --gpu-driven            starts on the GPU driven path (G), fails if the
+//                           driver has no GL 4.3
+//   --validate              with --gpu-driven, compares the GPU culling with
+//                           the CPU on the first frame (V).  A mismatch makes
+//                           the exit code non-zero.
 //-----------------------------------------------------------------------------
-bool initOpenGL()
+bool parseArguments(int argc, char* argv[])
 {
-	// Intialize GLFW 
-	// GLFW is configured.  Must be called before calling any GLFW functions
-	if (!glfwInit())
+	for (int i = 1; i < argc; i++)
 	{
-		// An error occured
-		std::cerr << "GLFW initialization failed" << std::endl;
-		return false;
-	}
+		bool hasValue = i + 1 < argc;
 
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);	// forward compatible with newer versions of OpenGL as they become available but not backward compatible (it will not run on devices that do not support OpenGL 3.3
+		if (strcmp(argv[i], "--benchmark") == 0)
+		{
+			gBenchmark = true;
+			if (hasValue && atoi(argv[i + 1]) > 0)
+				gBenchmarkFrames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--path") == 0 && hasValue)
+			gBenchmarkPath = argv[++i];
+		else if (strcmp(argv[i], "--report") == 0 && hasValue)
+			gBenchmarkReport = argv[++i];
+		else if (strcmp(argv[i], "--record") == 0 && hasValue)
+		{
+			gRecord = true;
+			gRecordFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--replay") == 0 && hasValue)
+			gReplayFile = argv[++i];
+		else if (strcmp(argv[i], "--context") == 0 && hasValue && GLContext::findBackend(argv[i + 1], gContextBackend))
+			i++;
+		else if (strcmp(argv[i], "--max-draw-calls") == 0 && hasValue && atoi(argv[i + 1]) > 0)
+			gMaxDrawCalls = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--gpu-budget") == 0 && hasValue && atoi(argv[i + 1]) > 0)
+			gGpuBudgetMB = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--gpu-driven") == 0)
+			gGpuDriven = true;
+		else if (strcmp(argv[i], "--validate") == 0)
+			gValidateGpuDriven = true;
+		else if (strcmp(argv[i], "--size") == 0 && i + 2 < argc && atoi(argv[i + 1]) > 0 && atoi(argv[i + 2]) > 0)
+		{
+			gWindowWidth = atoi(argv[++i]);
+			gWindowHeight = atoi(argv[++i]);
+		}
+		else
+		{
+			std::cerr << "Unknown argument " << argv[i] << std::endl
+				<< "Usage: " << argv[0] << " [--benchmark [frames]] [--path file] [--report file] [--size w h] [--max-draw-calls n] [--gpu-budget MB] [--record file] [--replay file] [--context glfw|egl|osmesa] [--gpu-driven [--validate]]" << std::endl;
+			return false;
+		}
+	}
 
+	if (gValidateGpuDriven && !gGpuDriven)
+	{
+		std::cerr << "--validate checks the GPU driven path, it needs --gpu-driven" << std::endl;
+		return false;
+	}
 
-	// Create an OpenGL 3.3 core, forward compatible context window
-	gWindow = glfwCreateWindow(gWindowWidth, gWindowHeight, APP_TITLE, NULL, NULL);
-	if (gWindow == NULL)
+	if (gContextBackend != GLContext::GLFW_WINDOW && !gBenchmark && gReplayFile.empty())
 	{
-		std::cerr << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
+		std::cerr << "The " << GLContext::getBackendName(gContextBackend) << " context has no input, run it with --benchmark or --replay" << std::endl;
 		return false;
 	}
+	return true;
+}
 
-	// Make the window's context the current one
-	glfwMakeContextCurrent(gWindow);
+//-----------------------------------------------------------------------------
+// Sets the sun, sun shadow and flashlight uniforms of the scene on the active
+// shader.  The point lights come from the LightClusterer.
+//-----------------------------------------------------------------------------
+void setLightingUniforms(ShaderProgram& shader, const SceneFile& scene, const ShadowCascades& shadows)
+{
+	shadows.setUniforms(shader, gShadows);
 
-	// Initialize GLEW
-	glewExperimental = GL_TRUE;
-	if (glewInit() != GLEW_OK)
+	for (int i = 0; i < scene.getNumLights(); i++)
 	{
-		std::cerr << "Failed to initialize GLEW" << std::endl;
+		const SceneFile::Light& light = scene.getLight(i);
+
+		if (light.type == SceneFile::DIRECTIONAL_LIGHT)
+		{
+			shader.setUniform("sunLight.direction", light.direction);
+			shader.setUniform("sunLight.ambient", light.ambient);
+			shader.setUniform("sunLight.diffuse", light.diffuse);
+			shader.setUniform("sunLight.specular", light.specular);
+		}
+		else if (light.type == SceneFile::SPOT_LIGHT)
+		{
+			// Spot light - follows the camera, offset a little
+			glm::vec3 spotlightPos = fpsCamera.getPosition() + light.position;
+
+			shader.setUniform("spotLight.ambient", light.ambient);
+			shader.setUniform("spotLight.diffuse", light.diffuse);
+			shader.setUniform("spotLight.specular", light.specular);
+			shader.setUniform("spotLight.position", spotlightPos);
+			shader.setUniform("spotLight.direction", fpsCamera.getLook());
+			shader.setUniform("spotLight.cosInnerCone", light.cosInnerCone);
+			shader.setUniform("spotLight.cosOuterCone", light.cosOuterCone);
+			shader.setUniform("spotLight.constant", light.constant);
+			shader.setUniform("spotLight.linear", light.linear);
+			shader.setUniform("spotLight.exponent", light.exponent);
+			shader.setUniform("spotLight.on", gFlashlightOn);
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Creates the context of the chosen backend and sets up OpenGL
+//-----------------------------------------------------------------------------
+bool initOpenGL()
+{
+	gContext = GLContext::create(gContextBackend);
+	if (gContext == NULL)
+	{
+		std::cerr << "The " << GLContext::getBackendName(gContextBackend) << " context is not compiled in" << std::endl;
 		return false;
 	}
 
-	// Set the required callback functions
-	glfwSetKeyCallback(gWindow, glfw_onKey);
-	glfwSetFramebufferSizeCallback(gWindow, glfw_onFramebufferSize);
-	glfwSetScrollCallback(gWindow, glfw_onMouseScroll);
+	// The benchmark renders to a window nobody sees
+	if (!gContext->init(gWindowWidth, gWindowHeight, APP_TITLE, !gBenchmark))
+		return false;
+	gWindow = gContext->getWindow();
 
-	// Hides and grabs cursor, unlimited movement
-	glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-	glfwSetCursorPos(gWindow, gWindowWidth / 2.0, gWindowHeight / 2.0);
+	if (gWindow != NULL)
+	{
+		// Set the required callback functions
+		glfwSetKeyCallback(gWindow, glfw_onKey);
+		glfwSetFramebufferSizeCallback(gWindow, glfw_onFramebufferSize);
+		glfwSetScrollCallback(gWindow, glfw_onMouseScroll);
+
+		if (gBenchmark)
+		{
+			// Frames as fast as they come, not at the display rate
+			gContext->setSwapInterval(0);
+		}
+		else
+		{
+			// Hides and grabs cursor, unlimited movement
+			glfwSetInputMode(gWindow, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+			glfwSetCursorPos(gWindow, gWindowWidth / 2.0, gWindowHeight / 2.0);
+		}
+	}
 
 	glClearColor(gClearColor.r, gClearColor.g, gClearColor.b, gClearColor.a);
 
 	// Define the viewport dimensions
 	int w, h;
-	glfwGetFramebufferSize(gWindow, &w, &h); // For retina display
+	gContext->getFramebufferSize(w, h); // For retina display
 	glViewport(0, 0, w, h);
 
 	//    glViewport(0, 0, gWindowWidth, gWindowHeight);
@@ -702,6 +1126,16 @@ bool initOpenGL()
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Destroys the context and the window
+//-----------------------------------------------------------------------------
+void shutdownOpenGL()
+{
+	delete gContext;
+	gContext = NULL;
+	gWindow = NULL;
+}
+
 //-----------------------------------------------------------------------------
 // Is called whenever a key is pressed/released via GLFW
 //-----------------------------------------------------------------------------
@@ -724,6 +1158,66 @@ void glfw_onKey(GLFWwindow* window, int key, int scancode, int action, int mode)
 		// toggle the flashlight
 		gFlashlightOn = !gFlashlightOn;
 	}
+
+	if (key == GLFW_KEY_G && action == GLFW_PRESS && gGpuDrivenReady)
+	{
+		// toggle the GPU driven path
+		gGpuDriven = !gGpuDriven;
+	}
+
+	if (key == GLFW_KEY_R && action == GLFW_PRESS && gDeferredReady)
+	{
+		// toggle between forward and deferred shading
+		gDeferred = !gDeferred;
+	}
+
+	if (key == GLFW_KEY_P && action == GLFW_PRESS)
+	{
+		// toggle the depth pre-pass
+		gDepthPrepass = !gDepthPrepass;
+	}
+
+	if (key == GLFW_KEY_V && action == GLFW_PRESS)
+	{
+		// compare the GPU culling results with the CPU on the next frame
+		gValidateGpuDriven = true;
+	}
+
+	if (key == GLFW_KEY_H && action == GLFW_PRESS)
+	{
+		// toggle the sun shadows
+		gShadows = !gShadows;
+	}
+
+	if (key == GLFW_KEY_O && action == GLFW_PRESS)
+	{
+		// toggle software occlusion culling
+		gOcclusionCulling = !gOcclusionCulling;
+	}
+
+	if (key == GLFW_KEY_F2 && action == GLFW_PRESS)
+	{
+		// write the profile of the last frames as a Chrome trace
+		gExportProfile = true;
+	}
+
+	if (key == GLFW_KEY_F3 && action == GLFW_PRESS)
+	{
+		// print the GL calls of the next frame, per pass
+		gPrintGLStats = true;
+	}
+
+	if (key == GLFW_KEY_F4 && action == GLFW_PRESS)
+	{
+		// print the CPU and GPU memory per category
+		gPrintMemory = true;
+	}
+
+	if (key == GLFW_KEY_F5 && action == GLFW_PRESS && !gBenchmark)
+	{
+		// start or stop recording the camera
+		gToggleRecording = true;
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -797,12 +1291,12 @@ void update(double elapsedTime)
 // Code computes the average frames per second, and also the average time it takes
 // to render one frame.  These stats are appended to the window caption bar.
 //-----------------------------------------------------------------------------
-void showFPS(GLFWwindow* window)
+void showFPS()
 {
 	static double previousSeconds = 0.0;
 	static int frameCount = 0;
 	double elapsedSeconds;
-	double currentSeconds = glfwGetTime(); // returns number of seconds since GLFW started, as double float
+	double currentSeconds = gContext->getTime(); // seconds since the context was created
 
 	elapsedSeconds = currentSeconds - previousSeconds;
 
@@ -819,8 +1313,11 @@ void showFPS(GLFWwindow* window)
 		outs << std::fixed
 			<< APP_TITLE << "    "
 			<< "FPS: " << fps << "    "
-			<< "Frame Time: " << msPerFrame << " (ms)";
-		glfwSetWindowTitle(window, outs.str().c_str());
+			<< "Frame Time: " << msPerFrame << " (ms)    "
+			<< "GPU: " << Profiler::getGpuFrameMs() << " (ms)";
+		if (GLStats::isEnabled())
+			outs << "    Draws: " << GLStats::getFrame().values[GLStats::DRAW_CALLS];
+		gContext->setTitle(outs.str());
 
 		// Reset for next average.
 		frameCount = 0;
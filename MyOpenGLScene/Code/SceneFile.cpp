@@ -0,0 +1,943 @@
+//-----------------------------------------------------------------------------
+// Scene description file
+//-----------------------------------------------------------------------------
+#include "SceneFile.h"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <map>
+#include "glm/gtc/matrix_transform.hpp"
+#include "ScatterPlacer.h"
+#include "MatrixBatch.h"
+#include "MemoryTracker.h"
+
+
+// Bump whenever the binary layout or the placement rules change so stale
+// binary files are recompiled
+const GLuint SCENE_FILE_VERSION = 7;
+const size_t SECTION_ALIGNMENT = 16;
+const GLuint MAX_BLADES_PER_PATCH = 1024;
+const GLuint MAX_TERRAIN_CELLS = 8192;
+const int GRASS_COVERAGE_SAMPLES = 4;	// per side of a patch
+
+struct PlacementVariant
+{
+	GLuint asset;
+	glm::vec3 scale;
+};
+
+//-----------------------------------------------------------------------------
+// FNV-1a hash of the text a binary file was compiled from
+//-----------------------------------------------------------------------------
+static GLuint hashSource(const std::string& source)
+{
+	GLuint hash = 2166136261u;
+	for (size_t i = 0; i < source.size(); i++)
+		hash = (hash ^ (unsigned char)source[i]) * 16777619u;
+	return hash;
+}
+
+//-----------------------------------------------------------------------------
+// Parsing helpers.  Options are a keyword followed by numbers; vectors accept
+// either one number (used for all three components) or three.
+//-----------------------------------------------------------------------------
+static bool isNumber(const std::string& token)
+{
+	char* end = NULL;
+	strtod(token.c_str(), &end);
+	return !token.empty() && *end == '\0';
+}
+
+static bool readFloats(const std::vector<std::string>& tokens, size_t& i, float* out, int count)
+{
+	for (int n = 0; n < count; n++)
+	{
+		if (i >= tokens.size() || !isNumber(tokens[i]))
+			return false;
+		out[n] = (float)atof(tokens[i++].c_str());
+	}
+	return true;
+}
+
+static bool readVector(const std::vector<std::string>& tokens, size_t& i, glm::vec3& out)
+{
+	if (!readFloats(tokens, i, &out.x, 1))
+		return false;
+
+	if (i < tokens.size() && isNumber(tokens[i]))
+		return readFloats(tokens, i, &out.y, 2);
+
+	out.y = out.z = out.x;
+	return true;
+}
+
+static bool parseError(const std::string& filename, int line, const std::string& message)
+{
+	std::cerr << filename << "(" << line << "): " << message << std::endl;
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// Terrain heights: noise, then the heightmap, then the flat zones
+//-----------------------------------------------------------------------------
+static bool buildHeights(const SceneFile::Terrain& terrain, const char* heightmap, Heightfield& heightfield)
+{
+	heightfield.create(terrain.size, (int)terrain.cells);
+	if (terrain.noiseAmplitude != 0.0f)
+		heightfield.addNoise(terrain.noiseAmplitude, terrain.noiseWavelength, (int)terrain.noiseOctaves, (int)terrain.seed);
+	if (heightmap != NULL && !heightfield.addImage(heightmap, terrain.heightmapAmplitude))
+		return false;
+
+	for (GLuint i = 0; i < terrain.numFlatZones; i++)
+	{
+		const glm::vec4& zone = terrain.flatZones[i];
+		heightfield.flatten(glm::vec2(zone.x, zone.y), zone.z, zone.w, 0.0f);
+	}
+	return true;
+}
+
+static GLuint addString(std::string& strings, const std::string& s)
+{
+	GLuint offset = (GLuint)strings.size();
+	strings += s;
+	strings += '\0';
+	return offset;
+}
+
+//-----------------------------------------------------------------------------
+// Appends an array to the binary image, aligned so records can be used in
+// place once the file is read back
+//-----------------------------------------------------------------------------
+static void appendSection(std::vector<char>& data, const void* src, size_t bytes, GLuint& offset)
+{
+	data.resize((data.size() + SECTION_ALIGNMENT - 1) & ~(SECTION_ALIGNMENT - 1));
+	offset = (GLuint)data.size();
+	if (bytes > 0)
+	{
+		data.resize(data.size() + bytes);
+		memcpy(&data[offset], src, bytes);
+	}
+}
+
+static bool readTextFile(const std::string& filename, std::string& out)
+{
+	std::ifstream fin(filename, std::ios::in | std::ios::binary);
+	if (!fin)
+		return false;
+
+	std::stringstream ss;
+	ss << fin.rdbuf();
+	out = ss.str();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Hash of the heightmap image the instance heights were baked from, 0 if the
+// scene has none or the file is missing
+//-----------------------------------------------------------------------------
+static GLuint hashHeightmap(const char* heightmap)
+{
+	std::string bytes;
+	if (heightmap == NULL || !readTextFile(heightmap, bytes))
+		return 0;
+	return hashSource(bytes);
+}
+
+//-----------------------------------------------------------------------------
+// Constructor - starts with an empty scene
+//-----------------------------------------------------------------------------
+SceneFile::SceneFile()
+	: mTrackedBytes(0),
+	  mHeader(NULL)
+{
+	parse("", "", NULL);
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+SceneFile::~SceneFile()
+{
+	MemoryTracker::addCpu(MemoryTracker::SCENE, -mTrackedBytes);
+}
+
+//-----------------------------------------------------------------------------
+// Loads the binary form when it is up to date, recompiles it otherwise
+//-----------------------------------------------------------------------------
+bool SceneFile::load(const std::string& textFilename, const std::string& binaryFilename, JobSystem* jobs)
+{
+	std::string source;
+	bool haveText = readTextFile(textFilename, source);
+
+	if (std::ifstream(binaryFilename, std::ios::in | std::ios::binary) && loadBinary(binaryFilename))
+	{
+		// The placed instances sit on the heightmap too, so an edited image
+		// makes the binary stale just like an edited text
+		const char* heightmap = hasTerrain() && getTerrain().heightmapName != NO_STRING ? getString(getTerrain().heightmapName) : NULL;
+		if (!haveText || (mHeader->sourceHash == hashSource(source) && mHeader->heightmapHash == hashHeightmap(heightmap)))
+			return true;
+	}
+
+	if (!haveText)
+	{
+		std::cerr << "Cannot open " << textFilename << " or " << binaryFilename << std::endl;
+		return false;
+	}
+
+	if (!parse(source, textFilename, jobs))
+		return false;
+
+	if (!saveBinary(binaryFilename))
+		std::cerr << "Scene will be compiled again on next launch" << std::endl;
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Compiles a text scene
+//-----------------------------------------------------------------------------
+bool SceneFile::compileText(const std::string& filename, JobSystem* jobs)
+{
+	std::string source;
+	if (!readTextFile(filename, source))
+	{
+		std::cerr << "Cannot open " << filename << std::endl;
+		return false;
+	}
+
+	return parse(source, filename, jobs);
+}
+
+//-----------------------------------------------------------------------------
+// Loads a binary scene - one read of the whole file, then the arrays are used
+// where they are.  The file is written in the byte order of the machine that
+// compiled it (little endian on every platform we build for).
+//-----------------------------------------------------------------------------
+bool SceneFile::loadBinary(const std::string& filename)
+{
+	std::ifstream fin(filename, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!fin)
+	{
+		std::cerr << "Cannot open " << filename << std::endl;
+		return false;
+	}
+
+	std::streamoff size = fin.tellg();
+	fin.seekg(0, std::ios::beg);
+
+	std::vector<char> data((size_t)size);
+	if (size <= 0 || !fin.read(&data[0], size))
+	{
+		std::cerr << "Cannot read " << filename << std::endl;
+		return false;
+	}
+
+	mData.swap(data);
+	if (!bind())
+	{
+		std::cerr << filename << " is not a valid scene file" << std::endl;
+		mData.swap(data);
+		bind();
+		return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Writes the binary image
+//-----------------------------------------------------------------------------
+bool SceneFile::saveBinary(const std::string& filename) const
+{
+	std::ofstream fout(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!fout || !fout.write(&mData[0], mData.size()))
+	{
+		std::cerr << "Cannot write " << filename << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Parses the text form, runs the placement rules and builds the binary image.
+// The current scene is kept if there is an error.
+//-----------------------------------------------------------------------------
+bool SceneFile::parse(const std::string& source, const std::string& filename, JobSystem* jobs)
+{
+	std::vector<Asset> assets;
+	std::vector<Object> objects;
+	std::vector<InstanceSet> sets;
+	std::vector<glm::mat4> transforms;
+	std::vector<GLuint> instanceAssets;
+	std::vector<Light> lights;
+	std::vector<Terrain> terrains;
+	std::vector<GrassField> grassFields;
+	std::vector<glm::vec4> grassPatches;
+	std::string strings;
+
+	std::map<std::string, GLuint> assetNames;
+	std::vector<PlacementVariant> variants;
+	Heightfield ground;		// empty (flat at 0) until the terrain statement
+
+	std::istringstream lines(source);
+	std::string lineBuffer;
+	int lineNumber = 0;
+
+	while (std::getline(lines, lineBuffer))
+	{
+		lineNumber++;
+
+		// strip comments and split in tokens
+		size_t comment = lineBuffer.find('#');
+		if (comment != std::string::npos)
+			lineBuffer.erase(comment);
+
+		std::istringstream ss(lineBuffer);
+		std::vector<std::string> tokens;
+		std::string token;
+		while (ss >> token)
+			tokens.push_back(token);
+
+		if (tokens.empty())
+			continue;
+
+		const std::string& cmd = tokens[0];
+		size_t i = 1;
+
+		if (cmd == "asset")
+		{
+			// asset <name> <mesh> <texture>
+			if (tokens.size() != 4)
+				return parseError(filename, lineNumber, "expected: asset <name> <mesh> <texture>");
+			if (assetNames.count(tokens[1]))
+				return parseError(filename, lineNumber, "asset " + tokens[1] + " is already defined");
+
+			Asset asset;
+			asset.meshName = addString(strings, tokens[2]);
+			asset.textureName = addString(strings, tokens[3]);
+			assetNames[tokens[1]] = (GLuint)assets.size();
+			assets.push_back(asset);
+		}
+		else if (cmd == "object")
+		{
+			// object <asset> [pos x y z] [scale s] [rotate deg [ax ay az]]... [specular s] [shininess s] [occluder] [culled]
+			if (tokens.size() < 2 || !assetNames.count(tokens[1]))
+				return parseError(filename, lineNumber, "unknown asset");
+
+			Object object;
+			object.asset = assetNames[tokens[1]];
+			object.specular = glm::vec3(0.8f);
+			object.shininess = 32.0f;
+			object.flags = 0;
+
+			glm::vec3 pos(0.0f), scale(1.0f);
+			glm::mat4 rotation(1.0f);
+			for (i = 2; i < tokens.size(); )
+			{
+				const std::string& option = tokens[i++];
+				bool ok = true;
+				if (option == "pos")
+					ok = readFloats(tokens, i, &pos.x, 3);
+				else if (option == "scale")
+					ok = readVector(tokens, i, scale);
+				else if (option == "rotate")
+				{
+					float angle = 0.0f;
+					glm::vec3 axis(0.0f, 1.0f, 0.0f);
+					ok = readFloats(tokens, i, &angle, 1);
+					if (ok && i < tokens.size() && isNumber(tokens[i]))
+						ok = readFloats(tokens, i, &axis.x, 3);
+					if (ok)
+						rotation = rotation * glm::rotate(glm::mat4(1.0f), glm::radians(angle), axis);
+				}
+				else if (option == "specular")
+					ok = readVector(tokens, i, object.specular);
+				else if (option == "shininess")
+					ok = readFloats(tokens, i, &object.shininess, 1);
+				else if (option == "occluder")
+					object.flags |= OCCLUDER;
+				else if (option == "culled")
+					object.flags |= OCCLUSION_CULLED;
+				else
+					return parseError(filename, lineNumber, "unknown option " + option);
+
+				if (!ok)
+					return parseError(filename, lineNumber, "bad values for " + option);
+			}
+
+			pos.y += ground.getHeight(pos.x, pos.z);
+			object.model = glm::translate(glm::mat4(1.0f), pos) * glm::scale(glm::mat4(1.0f), scale) * rotation;
+			objects.push_back(object);
+		}
+		else if (cmd == "set")
+		{
+			// set <name> [distance d] [occluders distance max] [culled] [impostors distance fade] [specular s] [shininess s]
+			if (tokens.size() < 2)
+				return parseError(filename, lineNumber, "expected: set <name>");
+
+			InstanceSet set;
+			set.name = addString(strings, tokens[1]);
+			set.firstInstance = (GLuint)transforms.size();
+			set.numInstances = 0;
+			set.flags = 0;
+			set.specular = glm::vec3(0.8f);
+			set.shininess = 32.0f;
+			set.drawDistance = 1000.0f;
+			set.occluderDistance = 0.0f;
+			set.maxOccluders = 0;
+			set.impostorDistance = 0.0f;
+			set.impostorFade = 0.0f;
+
+			for (i = 2; i < tokens.size(); )
+			{
+				const std::string& option = tokens[i++];
+				bool ok = true;
+				if (option == "distance")
+					ok = readFloats(tokens, i, &set.drawDistance, 1);
+				else if (option == "occluders")
+				{
+					float maxOccluders = 0.0f;
+					ok = readFloats(tokens, i, &set.occluderDistance, 1) && readFloats(tokens, i, &maxOccluders, 1);
+					set.maxOccluders = (GLuint)maxOccluders;
+					set.flags |= OCCLUDER;
+				}
+				else if (option == "culled")
+					set.flags |= OCCLUSION_CULLED;
+				else if (option == "impostors")
+					ok = readFloats(tokens, i, &set.impostorDistance, 1) && readFloats(tokens, i, &set.impostorFade, 1);
+				else if (option == "specular")
+					ok = readVector(tokens, i, set.specular);
+				else if (option == "shininess")
+					ok = readFloats(tokens, i, &set.shininess, 1);
+				else
+					return parseError(filename, lineNumber, "unknown option " + option);
+
+				if (!ok)
+					return parseError(filename, lineNumber, "bad values for " + option);
+			}
+
+			sets.push_back(set);
+			variants.clear();
+		}
+		else if (cmd == "variant")
+		{
+			// variant <asset> [scale s]
+			if (sets.empty())
+				return parseError(filename, lineNumber, "variant outside of a set");
+			if (tokens.size() < 2 || !assetNames.count(tokens[1]))
+				return parseError(filename, lineNumber, "unknown asset");
+
+			PlacementVariant variant;
+			variant.asset = assetNames[tokens[1]];
+			variant.scale = glm::vec3(1.0f);
+
+			for (i = 2; i < tokens.size(); )
+			{
+				const std::string& option = tokens[i++];
+				if (option != "scale")
+					return parseError(filename, lineNumber, "unknown option " + option);
+				if (!readVector(tokens, i, variant.scale))
+					return parseError(filename, lineNumber, "bad values for scale");
+			}
+
+			variants.push_back(variant);
+		}
+		else if (cmd == "scatter" || cmd == "ring")
+		{
+			// scatter <count> [seed n] [height y] [area x0 x1 z0 z1] [spacing d] [exclude_circle x z r]... [exclude_rect x0 x1 z0 z1]...
+			// ring <count> [seed n] [height y] [center x z] [radius r0 r1] [mirror]
+			if (variants.empty())
+				return parseError(filename, lineNumber, cmd + " needs a set with at least one variant");
+
+			float count = 0.0f, seed = 1.0f, height = 0.0f, spacing = 0.0f;
+			float area[4] = { -100.0f, 100.0f, -100.0f, 100.0f };
+			float center[2] = { 0.0f, 0.0f };
+			float radius[2] = { 10.0f, 10.0f };
+			bool mirror = false;
+			std::vector<glm::vec3> excludeCircles;
+			std::vector<glm::vec4> excludeRects;
+
+			if (!readFloats(tokens, i, &count, 1))
+				return parseError(filename, lineNumber, "expected an instance count");
+
+			while (i < tokens.size())
+			{
+				const std::string& option = tokens[i++];
+				bool ok = true;
+				if (option == "seed")
+					ok = readFloats(tokens, i, &seed, 1);
+				else if (option == "height")
+					ok = readFloats(tokens, i, &height, 1);
+				else if (option == "area" && cmd == "scatter")
+					ok = readFloats(tokens, i, area, 4);
+				else if (option == "spacing" && cmd == "scatter")
+					ok = readFloats(tokens, i, &spacing, 1);
+				else if (option == "exclude_circle" && cmd == "scatter")
+				{
+					glm::vec3 circle;
+					ok = readFloats(tokens, i, &circle.x, 3);
+					excludeCircles.push_back(circle);
+				}
+				else if (option == "exclude_rect" && cmd == "scatter")
+				{
+					glm::vec4 rect;
+					ok = readFloats(tokens, i, &rect.x, 4);
+					excludeRects.push_back(rect);
+				}
+				else if (option == "center" && cmd == "ring")
+					ok = readFloats(tokens, i, center, 2);
+				else if (option == "radius" && cmd == "ring")
+					ok = readFloats(tokens, i, radius, 2);
+				else if (option == "mirror" && cmd == "ring")
+					mirror = true;
+				else
+					return parseError(filename, lineNumber, "unknown option " + option);
+
+				if (!ok)
+					return parseError(filename, lineNumber, "bad values for " + option);
+			}
+
+			// Positions first (all cores for scatter), then the variant and
+			// rotation of every instance in order
+			PlacementRandom random((GLuint)seed);
+			std::vector<glm::vec2> points;
+			if (cmd == "ring")
+			{
+				for (int n = 0; n < (int)count; n++)
+				{
+					float r = random.range(radius[0], radius[1]);
+					float angle = glm::radians(random.range(0.0f, 360.0f));
+					points.push_back(glm::vec2(center[0] + r * cosf(angle), center[1] + r * sinf(angle)));
+				}
+			}
+			else
+			{
+				ScatterPlacer placer;
+				placer.setArea(glm::vec4(area[0], area[1], area[2], area[3]));
+				for (size_t c = 0; c < excludeCircles.size(); c++)
+					placer.addExcludedCircle(excludeCircles[c]);
+				for (size_t r = 0; r < excludeRects.size(); r++)
+					placer.addExcludedRect(excludeRects[r]);
+				placer.place((int)count, spacing, (GLuint)seed, jobs, points);
+			}
+			int skipped = (int)count - (int)points.size();
+
+			// Gathered into arrays, the matrices are built in one batch
+			int copies = mirror ? 2 : 1;
+			int numPlaced = (int)points.size() * copies;
+			std::vector<float> posX(numPlaced), posY(numPlaced), posZ(numPlaced), yaw(numPlaced);
+			std::vector<float> scaleX(numPlaced), scaleY(numPlaced), scaleZ(numPlaced);
+
+			for (size_t n = 0; n < points.size(); n++)
+			{
+				const PlacementVariant& variant = variants[glm::min((int)(random.next() * variants.size()), (int)variants.size() - 1)];
+				float rotation = random.range(0.0f, 360.0f);
+
+				glm::vec3 pos(points[n].x, height, points[n].y);
+				pos.y += ground.getHeight(pos.x, pos.z);
+
+				for (int copy = 0; copy < copies; copy++)
+				{
+					int i = (int)n * copies + copy;
+					posX[i] = pos.x;
+					posY[i] = pos.y;
+					posZ[i] = pos.z;
+					yaw[i] = rotation + copy * 180.0f;
+					scaleX[i] = variant.scale.x;
+					scaleY[i] = variant.scale.y;
+					scaleZ[i] = variant.scale.z;
+					instanceAssets.push_back(variant.asset);
+				}
+			}
+
+			if (numPlaced > 0)
+			{
+				MatrixBatch::TRSArrays instances =
+				{
+					&posX[0], &posY[0], &posZ[0], &yaw[0],
+					&scaleX[0], &scaleY[0], &scaleZ[0]
+				};
+				size_t first = transforms.size();
+				transforms.resize(first + numPlaced);
+				MatrixBatch::buildTRS(instances, numPlaced, &transforms[first], jobs);
+			}
+
+			if (skipped > 0)
+				std::cerr << filename << "(" << lineNumber << "): could not place " << skipped << " instances" << std::endl;
+
+			sets.back().numInstances = (GLuint)transforms.size() - sets.back().firstInstance;
+		}
+		else if (cmd == "terrain")
+		{
+			// terrain [size s] [cells n] [noise amplitude wavelength octaves] [seed n] [heightmap file height]
+			//         [texture file] [tile t] [flat x z r0 r1]...
+			if (!terrains.empty())
+				return parseError(filename, lineNumber, "the scene already has a terrain");
+			if (!objects.empty() || !sets.empty() || !grassFields.empty())
+				return parseError(filename, lineNumber, "the terrain must come before the objects, sets and grass it carries");
+
+			Terrain terrain;
+			terrain.size = 800.0f;
+			terrain.cells = 512;
+			terrain.noiseAmplitude = 0.0f;
+			terrain.noiseWavelength = 100.0f;
+			terrain.noiseOctaves = 4;
+			terrain.seed = 1;
+			terrain.heightmapName = NO_STRING;
+			terrain.heightmapAmplitude = 0.0f;
+			terrain.textureTile = 8.0f;
+			terrain.numFlatZones = 0;
+			for (int z = 0; z < MAX_FLAT_ZONES; z++)
+				terrain.flatZones[z] = glm::vec4(0.0f);
+
+			std::string textureName = "textures/Green1.jpg";
+			while (i < tokens.size())
+			{
+				const std::string& option = tokens[i++];
+				bool ok = true;
+				float value = 0.0f;
+				if (option == "size")
+					ok = readFloats(tokens, i, &terrain.size, 1) && terrain.size > 0.0f;
+				else if (option == "cells")
+				{
+					ok = readFloats(tokens, i, &value, 1) && value >= 1.0f && value <= (float)MAX_TERRAIN_CELLS;
+					terrain.cells = (GLuint)value;
+				}
+				else if (option == "noise")
+				{
+					ok = readFloats(tokens, i, &terrain.noiseAmplitude, 1) && readFloats(tokens, i, &terrain.noiseWavelength, 1) && readFloats(tokens, i, &value, 1);
+					terrain.noiseOctaves = (GLuint)value;
+				}
+				else if (option == "seed")
+				{
+					ok = readFloats(tokens, i, &value, 1);
+					terrain.seed = (GLuint)value;
+				}
+				else if (option == "heightmap" && i < tokens.size())
+				{
+					terrain.heightmapName = addString(strings, tokens[i++]);
+					ok = readFloats(tokens, i, &terrain.heightmapAmplitude, 1);
+				}
+				else if (option == "texture" && i < tokens.size())
+					textureName = tokens[i++];
+				else if (option == "tile")
+					ok = readFloats(tokens, i, &terrain.textureTile, 1) && terrain.textureTile > 0.0f;
+				else if (option == "flat")
+				{
+					if (terrain.numFlatZones == (GLuint)MAX_FLAT_ZONES)
+						return parseError(filename, lineNumber, "too many flat zones");
+					ok = readFloats(tokens, i, &terrain.flatZones[terrain.numFlatZones++].x, 4);
+				}
+				else
+					return parseError(filename, lineNumber, "unknown option " + option);
+
+				if (!ok)
+					return parseError(filename, lineNumber, "bad values for " + option);
+			}
+			terrain.textureName = addString(strings, textureName);
+
+			// Everything placed from now on sits on these heights
+			if (!buildHeights(terrain, terrain.heightmapName != NO_STRING ? strings.c_str() + terrain.heightmapName : NULL, ground))
+				return parseError(filename, lineNumber, "cannot build the terrain");
+
+			terrains.push_back(terrain);
+		}
+		else if (cmd == "grass")
+		{
+			// grass [seed n] [height y] [area x0 x1 z0 z1] [patch size] [density d] [blade h0 h1 width]
+			//       [lod d] [distance d] [base c] [tip c] [exclude_circle x z r]... [exclude_rect x0 x1 z0 z1]...
+			GrassField field;
+			field.firstPatch = (GLuint)grassPatches.size();
+			field.numPatches = 0;
+			field.patchSize = 4.0f;
+			field.height = 0.0f;
+			field.minBladeHeight = 0.5f;
+			field.maxBladeHeight = 1.0f;
+			field.bladeWidth = 0.1f;
+			field.lodDistance = 20.0f;
+			field.drawDistance = 100.0f;
+			field.baseColor = glm::vec3(0.05f, 0.15f, 0.02f);
+			field.tipColor = glm::vec3(0.35f, 0.55f, 0.15f);
+
+			float seed = 1.0f, density = 4.0f;
+			float area[4] = { -100.0f, 100.0f, -100.0f, 100.0f };
+			std::vector<glm::vec3> excludeCircles;
+			std::vector<glm::vec4> excludeRects;
+
+			while (i < tokens.size())
+			{
+				const std::string& option = tokens[i++];
+				bool ok = true;
+				if (option == "seed")
+					ok = readFloats(tokens, i, &seed, 1);
+				else if (option == "height")
+					ok = readFloats(tokens, i, &field.height, 1);
+				else if (option == "area")
+					ok = readFloats(tokens, i, area, 4);
+				else if (option == "patch")
+					ok = readFloats(tokens, i, &field.patchSize, 1) && field.patchSize > 0.0f;
+				else if (option == "density")
+					ok = readFloats(tokens, i, &density, 1) && density >= 0.0f;
+				else if (option == "blade")
+					ok = readFloats(tokens, i, &field.minBladeHeight, 1) && readFloats(tokens, i, &field.maxBladeHeight, 1) && readFloats(tokens, i, &field.bladeWidth, 1);
+				else if (option == "lod")
+					ok = readFloats(tokens, i, &field.lodDistance, 1) && field.lodDistance > 0.0f;
+				else if (option == "distance")
+					ok = readFloats(tokens, i, &field.drawDistance, 1);
+				else if (option == "base")
+					ok = readVector(tokens, i, field.baseColor);
+				else if (option == "tip")
+					ok = readVector(tokens, i, field.tipColor);
+				else if (option == "exclude_circle")
+				{
+					glm::vec3 circle;
+					ok = readFloats(tokens, i, &circle.x, 3);
+					excludeCircles.push_back(circle);
+				}
+				else if (option == "exclude_rect")
+				{
+					glm::vec4 rect;
+					ok = readFloats(tokens, i, &rect.x, 4);
+					excludeRects.push_back(rect);
+				}
+				else
+					return parseError(filename, lineNumber, "unknown option " + option);
+
+				if (!ok)
+					return parseError(filename, lineNumber, "bad values for " + option);
+			}
+
+			float blades = density * field.patchSize * field.patchSize + 0.5f;
+			field.bladesPerPatch = (GLuint)glm::min(blades, (float)MAX_BLADES_PER_PATCH);
+			if (blades > (float)MAX_BLADES_PER_PATCH)
+				std::cerr << filename << "(" << lineNumber << "): grass density limited to " << MAX_BLADES_PER_PATCH << " blades per patch" << std::endl;
+
+			// One record per patch.  The density is the part of the patch outside
+			// of the exclusion zones, the blades themselves are placed on the GPU.
+			PlacementRandom random((GLuint)seed);
+			int patchesX = (int)ceilf((area[1] - area[0]) / field.patchSize);
+			int patchesZ = (int)ceilf((area[3] - area[2]) / field.patchSize);
+			for (int pz = 0; pz < patchesZ; pz++)
+			{
+				for (int px = 0; px < patchesX; px++)
+				{
+					float x = area[0] + px * field.patchSize;
+					float z = area[2] + pz * field.patchSize;
+					GLuint patchSeed = (GLuint)(random.next() * 16777216.0f);
+
+					int covered = 0;
+					for (int s = 0; s < GRASS_COVERAGE_SAMPLES * GRASS_COVERAGE_SAMPLES; s++)
+					{
+						float u = ((s % GRASS_COVERAGE_SAMPLES) + 0.5f) / GRASS_COVERAGE_SAMPLES;
+						float v = ((s / GRASS_COVERAGE_SAMPLES) + 0.5f) / GRASS_COVERAGE_SAMPLES;
+						if (!ScatterPlacer::isExcluded(x + u * field.patchSize, z + v * field.patchSize, excludeCircles, excludeRects))
+							covered++;
+					}
+
+					if (covered > 0)
+						grassPatches.push_back(glm::vec4(x, z, (float)patchSeed, (float)covered / (GRASS_COVERAGE_SAMPLES * GRASS_COVERAGE_SAMPLES)));
+				}
+			}
+
+			field.numPatches = (GLuint)grassPatches.size() - field.firstPatch;
+			grassFields.push_back(field);
+		}
+		else if (cmd == "sun" || cmd == "point" || cmd == "spot")
+		{
+			// sun [dir x y z] / point [pos x y z] / spot [offset x y z] [cone inner outer]
+			// all: [ambient c] [diffuse c] [specular c] [attenuation constant linear exponent]
+			Light light;
+			light.type = cmd == "sun" ? DIRECTIONAL_LIGHT : (cmd == "point" ? POINT_LIGHT : SPOT_LIGHT);
+			light.position = glm::vec3(0.0f);
+			light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+			light.ambient = light.diffuse = light.specular = glm::vec3(0.0f);
+			light.constant = 1.0f;
+			light.linear = light.exponent = 0.0f;
+			light.cosInnerCone = glm::cos(glm::radians(15.0f));
+			light.cosOuterCone = glm::cos(glm::radians(20.0f));
+
+			while (i < tokens.size())
+			{
+				const std::string& option = tokens[i++];
+				bool ok = true;
+				if (option == "dir" && light.type == DIRECTIONAL_LIGHT)
+					ok = readFloats(tokens, i, &light.direction.x, 3);
+				else if ((option == "pos" && light.type == POINT_LIGHT) || (option == "offset" && light.type == SPOT_LIGHT))
+					ok = readFloats(tokens, i, &light.position.x, 3);
+				else if (option == "ambient")
+					ok = readVector(tokens, i, light.ambient);
+				else if (option == "diffuse")
+					ok = readVector(tokens, i, light.diffuse);
+				else if (option == "specular")
+					ok = readVector(tokens, i, light.specular);
+				else if (option == "attenuation")
+					ok = readFloats(tokens, i, &light.constant, 1) && readFloats(tokens, i, &light.linear, 1) && readFloats(tokens, i, &light.exponent, 1);
+				else if (option == "cone" && light.type == SPOT_LIGHT)
+				{
+					float cone[2];
+					ok = readFloats(tokens, i, cone, 2);
+					light.cosInnerCone = glm::cos(glm::radians(cone[0]));
+					light.cosOuterCone = glm::cos(glm::radians(cone[1]));
+				}
+				else
+					return parseError(filename, lineNumber, "unknown option " + option);
+
+				if (!ok)
+					return parseError(filename, lineNumber, "bad values for " + option);
+			}
+
+			lights.push_back(light);
+		}
+		else
+			return parseError(filename, lineNumber, "unknown command " + cmd);
+	}
+
+	// Build the binary image
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "SCNB", 4);
+	header.version = SCENE_FILE_VERSION;
+	header.sourceHash = hashSource(source);
+	header.heightmapHash = hashHeightmap(!terrains.empty() && terrains[0].heightmapName != NO_STRING ? strings.c_str() + terrains[0].heightmapName : NULL);
+	header.numAssets = (GLuint)assets.size();
+	header.numObjects = (GLuint)objects.size();
+	header.numSets = (GLuint)sets.size();
+	header.numInstances = (GLuint)transforms.size();
+	header.numLights = (GLuint)lights.size();
+	header.numTerrains = (GLuint)terrains.size();
+	header.numGrassFields = (GLuint)grassFields.size();
+	header.numGrassPatches = (GLuint)grassPatches.size();
+	header.stringsSize = (GLuint)strings.size();
+
+	std::vector<char> data(sizeof(Header));
+	appendSection(data, assets.data(), assets.size() * sizeof(Asset), header.assetsOffset);
+	appendSection(data, objects.data(), objects.size() * sizeof(Object), header.objectsOffset);
+	appendSection(data, sets.data(), sets.size() * sizeof(InstanceSet), header.setsOffset);
+	appendSection(data, transforms.data(), transforms.size() * sizeof(glm::mat4), header.transformsOffset);
+	appendSection(data, instanceAssets.data(), instanceAssets.size() * sizeof(GLuint), header.instanceAssetsOffset);
+	appendSection(data, lights.data(), lights.size() * sizeof(Light), header.lightsOffset);
+	appendSection(data, terrains.data(), terrains.size() * sizeof(Terrain), header.terrainOffset);
+	appendSection(data, grassFields.data(), grassFields.size() * sizeof(GrassField), header.grassFieldsOffset);
+	appendSection(data, grassPatches.data(), grassPatches.size() * sizeof(glm::vec4), header.grassPatchesOffset);
+	appendSection(data, strings.data(), strings.size(), header.stringsOffset);
+	header.size = (GLuint)data.size();
+	memcpy(&data[0], &header, sizeof(header));
+
+	mData.swap(data);
+	return bind();
+}
+
+//-----------------------------------------------------------------------------
+// Checks the image in mData and points the accessors into it
+//-----------------------------------------------------------------------------
+bool SceneFile::bind()
+{
+	long long bytes = (long long)mData.capacity();
+	MemoryTracker::addCpu(MemoryTracker::SCENE, bytes - mTrackedBytes);
+	mTrackedBytes = bytes;
+
+	if (mData.size() < sizeof(Header))
+		return false;
+
+	const Header* header = (const Header*)&mData[0];
+	if (memcmp(header->magic, "SCNB", 4) != 0 || header->version != SCENE_FILE_VERSION || header->size != mData.size())
+		return false;
+
+	struct Section { GLuint offset; GLuint count; size_t recordSize; };
+	const Section sections[] = {
+		{ header->assetsOffset, header->numAssets, sizeof(Asset) },
+		{ header->objectsOffset, header->numObjects, sizeof(Object) },
+		{ header->setsOffset, header->numSets, sizeof(InstanceSet) },
+		{ header->transformsOffset, header->numInstances, sizeof(glm::mat4) },
+		{ header->instanceAssetsOffset, header->numInstances, sizeof(GLuint) },
+		{ header->lightsOffset, header->numLights, sizeof(Light) },
+		{ header->terrainOffset, header->numTerrains, sizeof(Terrain) },
+		{ header->grassFieldsOffset, header->numGrassFields, sizeof(GrassField) },
+		{ header->grassPatchesOffset, header->numGrassPatches, sizeof(glm::vec4) },
+		{ header->stringsOffset, header->stringsSize, 1 }
+	};
+	for (size_t s = 0; s < sizeof(sections) / sizeof(sections[0]); s++)
+	{
+		if (sections[s].offset % SECTION_ALIGNMENT != 0 || (size_t)sections[s].offset + (size_t)sections[s].count * sections[s].recordSize > mData.size())
+			return false;
+	}
+
+	const char* base = &mData[0];
+	const Asset* assets = (const Asset*)(base + header->assetsOffset);
+	const Object* objects = (const Object*)(base + header->objectsOffset);
+	const InstanceSet* sets = (const InstanceSet*)(base + header->setsOffset);
+	const GLuint* instanceAssets = (const GLuint*)(base + header->instanceAssetsOffset);
+	const Terrain* terrain = (const Terrain*)(base + header->terrainOffset);
+	const GrassField* grassFields = (const GrassField*)(base + header->grassFieldsOffset);
+	const char* strings = base + header->stringsOffset;
+
+	// Indices must stay in range so the renderer can trust them
+	if (header->stringsSize > 0 && strings[header->stringsSize - 1] != '\0')
+		return false;
+	for (GLuint i = 0; i < header->numAssets; i++)
+	{
+		if (assets[i].meshName >= header->stringsSize || assets[i].textureName >= header->stringsSize)
+			return false;
+	}
+	for (GLuint i = 0; i < header->numObjects; i++)
+	{
+		if (objects[i].asset >= header->numAssets)
+			return false;
+	}
+	for (GLuint i = 0; i < header->numSets; i++)
+	{
+		if (sets[i].name >= header->stringsSize || (size_t)sets[i].firstInstance + sets[i].numInstances > header->numInstances)
+			return false;
+	}
+	for (GLuint i = 0; i < header->numInstances; i++)
+	{
+		if (instanceAssets[i] >= header->numAssets)
+			return false;
+	}
+	if (header->numTerrains > 1)
+		return false;
+	for (GLuint i = 0; i < header->numTerrains; i++)
+	{
+		if (terrain[i].cells < 1 || terrain[i].cells > MAX_TERRAIN_CELLS || terrain[i].numFlatZones > (GLuint)MAX_FLAT_ZONES || terrain[i].textureName >= header->stringsSize)
+			return false;
+		if (terrain[i].heightmapName != NO_STRING && terrain[i].heightmapName >= header->stringsSize)
+			return false;
+	}
+	for (GLuint i = 0; i < header->numGrassFields; i++)
+	{
+		if ((size_t)grassFields[i].firstPatch + grassFields[i].numPatches > header->numGrassPatches || grassFields[i].bladesPerPatch > MAX_BLADES_PER_PATCH)
+			return false;
+	}
+
+	mHeader = header;
+	mAssets = assets;
+	mObjects = objects;
+	mSets = sets;
+	mTransforms = (const glm::mat4*)(base + header->transformsOffset);
+	mInstanceAssets = instanceAssets;
+	mLights = (const Light*)(base + header->lightsOffset);
+	mTerrain = terrain;
+	mGrassFields = grassFields;
+	mGrassPatches = (const glm::vec4*)(base + header->grassPatchesOffset);
+	mStrings = strings;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Terrain heights at load time
+//-----------------------------------------------------------------------------
+bool SceneFile::buildHeightfield(Heightfield& heightfield) const
+{
+	if (!hasTerrain())
+	{
+		heightfield.clear();
+		return true;
+	}
+
+	const Terrain& terrain = getTerrain();
+	return buildHeights(terrain, terrain.heightmapName != NO_STRING ? getString(terrain.heightmapName) : NULL, heightfield);
+}
@@ -0,0 +1,196 @@
+//-----------------------------------------------------------------------------
+// Scene description file
+//
+// A scene is authored as a text file (.scene) listing the assets, the static
+// objects, the instance sets with their placement rules, the terrain, the
+// grass fields and the lights (see scenes/forest.scene for the syntax).  The
+// text is compiled into a binary form (.sceneb) where every transform is
+// already baked: a header followed by contiguous arrays.  The binary file is
+// loaded back with a single read and the arrays are used in place.
+//-----------------------------------------------------------------------------
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <string>
+#include <vector>
+#define GLEW_STATIC
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "Heightfield.h"
+#include "JobSystem.h"
+
+class SceneFile
+{
+public:
+
+	enum Flags
+	{
+		OCCLUDER = 1,			// rasterized by the software occlusion culler
+		OCCLUSION_CULLED = 2	// tested against the occlusion buffer before drawing
+	};
+
+	static const int MAX_FLAT_ZONES = 8;
+	static const GLuint NO_STRING = 0xFFFFFFFFu;
+
+	enum LightType
+	{
+		DIRECTIONAL_LIGHT,
+		POINT_LIGHT,
+		SPOT_LIGHT
+	};
+
+	// Binary records - stored as is in the .sceneb file
+	struct Asset
+	{
+		GLuint meshName;		// offsets in the string table
+		GLuint textureName;
+	};
+
+	struct Object
+	{
+		glm::mat4 model;
+		glm::vec3 specular;
+		float shininess;
+		GLuint asset;
+		GLuint flags;
+	};
+
+	struct InstanceSet
+	{
+		GLuint name;
+		GLuint firstInstance;
+		GLuint numInstances;
+		GLuint flags;
+		glm::vec3 specular;
+		float shininess;
+		float drawDistance;		// GPU driven path culls instances further away
+		float occluderDistance;	// instances closer to the camera are used as occluders
+		GLuint maxOccluders;
+		float impostorDistance;	// instances further away are drawn as impostors (0: never)
+		float impostorFade;		// length of the cross-fade band
+	};
+
+	// Heightfield parameters - the heights themselves are generated again at
+	// load time (see buildHeightfield)
+	struct Terrain
+	{
+		float size;				// world units per side, centered on the origin
+		GLuint cells;			// per side
+		float noiseAmplitude;
+		float noiseWavelength;
+		GLuint noiseOctaves;
+		GLuint seed;
+		GLuint heightmapName;	// offset in the string table, NO_STRING if none
+		float heightmapAmplitude;
+		GLuint textureName;
+		float textureTile;		// world units per texture repeat
+		GLuint numFlatZones;
+		glm::vec4 flatZones[MAX_FLAT_ZONES];	// x, z, inner radius, outer radius - flattened to 0
+	};
+
+	// Grass is not made of instances: a field is cut in square patches and
+	// the blades are generated on the GPU from each patch record
+	struct GrassField
+	{
+		GLuint firstPatch;
+		GLuint numPatches;
+		float patchSize;
+		GLuint bladesPerPatch;	// at full density
+		float height;			// ground level
+		float minBladeHeight, maxBladeHeight;
+		float bladeWidth;
+		float lodDistance;		// full density closer than this, then it falls off
+		float drawDistance;
+		glm::vec3 baseColor;
+		glm::vec3 tipColor;
+	};
+
+	struct Light
+	{
+		GLuint type;
+		glm::vec3 position;		// spot lights: offset from the camera
+		glm::vec3 direction;
+		glm::vec3 ambient;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+		float constant, linear, exponent;
+		float cosInnerCone, cosOuterCone;
+	};
+
+	 SceneFile();
+	~SceneFile();
+
+	// Loads the binary file if it was compiled from the current text file,
+	// otherwise compiles the text and writes the binary file for next time.
+	// Either file may be missing as long as the other one is usable.
+	// The placement rules run on the job system if there is one, with the
+	// same result.
+	bool load(const std::string& textFilename, const std::string& binaryFilename, JobSystem* jobs = NULL);
+
+	bool compileText(const std::string& filename, JobSystem* jobs = NULL);
+	bool loadBinary(const std::string& filename);
+	bool saveBinary(const std::string& filename) const;
+
+	int getNumAssets() const       { return (int)mHeader->numAssets; }
+	int getNumObjects() const      { return (int)mHeader->numObjects; }
+	int getNumInstanceSets() const { return (int)mHeader->numSets; }
+	int getNumInstances() const    { return (int)mHeader->numInstances; }
+	int getNumLights() const       { return (int)mHeader->numLights; }
+	int getNumGrassFields() const  { return (int)mHeader->numGrassFields; }
+	bool hasTerrain() const        { return mHeader->numTerrains > 0; }
+
+	const Asset& getAsset(int i) const            { return mAssets[i]; }
+	const Object& getObject(int i) const          { return mObjects[i]; }
+	const InstanceSet& getInstanceSet(int i) const { return mSets[i]; }
+	const Light& getLight(int i) const            { return mLights[i]; }
+	const GrassField& getGrassField(int i) const  { return mGrassFields[i]; }
+	const Terrain& getTerrain() const             { return *mTerrain; }
+	const char* getString(GLuint offset) const    { return mStrings + offset; }
+
+	// Instances of all the sets, ready to be uploaded as they are
+	const glm::mat4* getInstanceTransforms() const { return mTransforms; }
+	const GLuint* getInstanceAssets() const       { return mInstanceAssets; }
+
+	// Generates the terrain's heights, the same ones the placement rules used.
+	// Leaves the heightfield empty (flat ground at 0) if there is no terrain.
+	bool buildHeightfield(Heightfield& heightfield) const;
+
+	// Patches of all the grass fields: x, z of the corner, seed, density (0..1)
+	const glm::vec4* getGrassPatches() const { return mGrassPatches; }
+
+private:
+	SceneFile(const SceneFile& rhs);
+	SceneFile& operator = (const SceneFile& rhs);
+
+	struct Header
+	{
+		char magic[4];
+		GLuint version;
+		GLuint sourceHash;		// hash of the text the file was compiled from
+		GLuint heightmapHash;	// hash of the terrain's heightmap image, 0 without one
+		GLuint size;
+		GLuint numAssets, numObjects, numSets, numInstances, numLights, numTerrains, numGrassFields, numGrassPatches, stringsSize;
+		GLuint assetsOffset, objectsOffset, setsOffset, transformsOffset, instanceAssetsOffset, lightsOffset, terrainOffset, grassFieldsOffset, grassPatchesOffset, stringsOffset;
+	};
+
+	bool parse(const std::string& source, const std::string& filename, JobSystem* jobs);
+	bool bind();
+
+	// Whole file, header first.  All the accessors point inside it.
+	std::vector<char> mData;
+	long long mTrackedBytes;		// of mData, as counted by the memory tracker
+
+	const Header* mHeader;
+	const Asset* mAssets;
+	const Object* mObjects;
+	const InstanceSet* mSets;
+	const glm::mat4* mTransforms;
+	const GLuint* mInstanceAssets;
+	const Light* mLights;
+	const Terrain* mTerrain;
+	const GrassField* mGrassFields;
+	const glm::vec4* mGrassPatches;
+	const char* mStrings;
+};
+#endif //SCENE_FILE_H
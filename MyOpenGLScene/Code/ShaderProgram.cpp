@@ -5,9 +5,33 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include "GLStats.h"
+#include "LoadStats.h"
 
 #include "glm/gtc/type_ptr.hpp"
 
+// Functions every fragment shader may call, next to the shader files
+static const char* FRAGMENT_PRELUDE = "dither.glsl";
+
+//-----------------------------------------------------------------------------
+// source with prelude inserted after its #version line.  A #line directive
+// puts the line numbers of the compiler messages back on the shader file.
+//-----------------------------------------------------------------------------
+static string insertPrelude(const string& source, const string& prelude)
+{
+	size_t version = source.find("#version");
+	if (version == string::npos)
+		return prelude + "#line 1\n" + source;
+
+	size_t end = source.find('\n', version);
+	if (end == string::npos)
+		return source + "\n" + prelude;
+
+	int nextLine = 2 + (int)std::count(source.begin(), source.begin() + end, '\n');
+	return source.substr(0, end + 1) + prelude + "#line " + std::to_string(nextLine) + "\n" + source.substr(end + 1);
+}
+
 //-----------------------------------------------------------------------------
 // Constructor
 //-----------------------------------------------------------------------------
@@ -22,16 +46,25 @@ ShaderProgram::ShaderProgram()
 ShaderProgram::~ShaderProgram()
 {
 	// Delete the program
-	glDeleteProgram(mHandle);
+	if (mHandle != 0)
+		glDeleteProgram(mHandle);
 }
 
 //-----------------------------------------------------------------------------
-// Loads vertex and fragment shaders
+// Loads vertex and fragment shaders.  The fragment shader gets
+// FRAGMENT_PRELUDE from its own directory.
 //-----------------------------------------------------------------------------
 bool ShaderProgram::loadShaders(const char* vsFilename, const char* fsFilename)
 {
+	LoadTimer timer("shader", string(vsFilename) + " " + fsFilename);
+
+	string fsPath(fsFilename);
+	string prelude = fileToString(fsPath.substr(0, fsPath.find_last_of("/\\") + 1) + FRAGMENT_PRELUDE);
 	string vsString = fileToString(vsFilename);
-	string fsString = fileToString(fsFilename);
+	string fsString = insertPrelude(fileToString(fsFilename), prelude);
+	timer.addBytesIn(vsString.size() + fsString.size());
+	timer.endStage(LoadStats::READ);
+
 	const GLchar* vsSourcePtr = vsString.c_str();
 	const GLchar* fsSourcePtr = fsString.c_str();
 
@@ -42,15 +75,25 @@ bool ShaderProgram::loadShaders(const char* vsFilename, const char* fsFilename)
 	glShaderSource(fs, 1, &fsSourcePtr, NULL);
 
 	glCompileShader(vs);
-	checkCompileErrors(vs, VERTEX);
+	bool compiled = checkCompileErrors(vs, VERTEX);
 
 	glCompileShader(fs);
-	checkCompileErrors(fs, FRAGMENT);
+	compiled = checkCompileErrors(fs, FRAGMENT) && compiled;
+	timer.endStage(LoadStats::PARSE);
+
+	if (!compiled)
+	{
+		glDeleteShader(vs);
+		glDeleteShader(fs);
+		return false;
+	}
 
 	mHandle = glCreateProgram();
 	if (mHandle == 0)
 	{
 		std::cerr << "Unable to create shader program!" << std::endl;
+		glDeleteShader(vs);
+		glDeleteShader(fs);
 		return false;
 	}
 
@@ -58,7 +101,8 @@ bool ShaderProgram::loadShaders(const char* vsFilename, const char* fsFilename)
 	glAttachShader(mHandle, fs);
 
 	glLinkProgram(mHandle);
-	checkCompileErrors(mHandle, PROGRAM);
+	bool linked = checkCompileErrors(mHandle, PROGRAM);
+	timer.endStage(LoadStats::UPLOAD);
 
 
 	glDeleteShader(vs);
@@ -66,6 +110,69 @@ bool ShaderProgram::loadShaders(const char* vsFilename, const char* fsFilename)
 
 	mUniformLocations.clear();
 
+	if (!linked)
+	{
+		glDeleteProgram(mHandle);
+		mHandle = 0;
+		return false;
+	}
+
+	timer.setSucceeded();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Loads a compute shader into its own program
+//-----------------------------------------------------------------------------
+bool ShaderProgram::loadComputeShader(const char* csFilename)
+{
+	LoadTimer timer("shader", csFilename);
+
+	string csString = fileToString(csFilename);
+	timer.addBytesIn(csString.size());
+	timer.endStage(LoadStats::READ);
+
+	const GLchar* csSourcePtr = csString.c_str();
+
+	GLuint cs = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(cs, 1, &csSourcePtr, NULL);
+
+	glCompileShader(cs);
+	bool compiled = checkCompileErrors(cs, COMPUTE);
+	timer.endStage(LoadStats::PARSE);
+
+	if (!compiled)
+	{
+		glDeleteShader(cs);
+		return false;
+	}
+
+	mHandle = glCreateProgram();
+	if (mHandle == 0)
+	{
+		std::cerr << "Unable to create shader program!" << std::endl;
+		glDeleteShader(cs);
+		return false;
+	}
+
+	glAttachShader(mHandle, cs);
+
+	glLinkProgram(mHandle);
+	bool linked = checkCompileErrors(mHandle, PROGRAM);
+	timer.endStage(LoadStats::UPLOAD);
+
+	glDeleteShader(cs);
+
+	mUniformLocations.clear();
+
+	if (!linked)
+	{
+		glDeleteProgram(mHandle);
+		mHandle = 0;
+		return false;
+	}
+
+	timer.setSucceeded();
 	return true;
 }
 
@@ -110,9 +217,10 @@ void ShaderProgram::use()
 }
 
 //-----------------------------------------------------------------------------
-// Checks for shader compiler errors
+// Checks for shader compiler errors, false with the log printed if the
+// shader did not compile or the program did not link
 //-----------------------------------------------------------------------------
-void  ShaderProgram::checkCompileErrors(GLuint shader, ShaderType type)
+bool ShaderProgram::checkCompileErrors(GLuint shader, ShaderType type)
 {
 	int status = 0;
 
@@ -145,6 +253,7 @@ void  ShaderProgram::checkCompileErrors(GLuint shader, ShaderType type)
 		}
 	}
 
+	return status != GL_FALSE;
 }
 
 //-----------------------------------------------------------------------------
@@ -234,12 +343,14 @@ GLint ShaderProgram::getUniformLocation(const GLchar* name)
 	std::map<string, GLint>::iterator it = mUniformLocations.find(name);
 
 	// Only need to query the shader program IF it doesn't already exist.
+	// Without a program every name is -1, as GL would answer.
 	if (it == mUniformLocations.end())
 	{
 		// Find it and add it to the map
-		mUniformLocations[name] = glGetUniformLocation(mHandle, name);
+		GLint location = mHandle != 0 ? glGetUniformLocation(mHandle, name) : -1;
+		it = mUniformLocations.insert(std::make_pair(string(name), location)).first;
 	}
 
 	// Return it
-	return mUniformLocations[name];
+	return it->second;
 }
@@ -22,11 +22,15 @@ public:
 	{
 		VERTEX,
 		FRAGMENT,
+		COMPUTE,
 		PROGRAM
 	};
 
 	// Only supports vertex and fragment (this series will only have those two)
 	bool loadShaders(const char* vsFilename, const char* fsFilename);
+
+	// Compute only program (requires OpenGL 4.3)
+	bool loadComputeShader(const char* csFilename);
 	void use();
 
 	GLuint getProgram() const;
@@ -45,7 +49,7 @@ public:
 private:
 
 	string fileToString(const string& filename);
-	void  checkCompileErrors(GLuint shader, ShaderType type);
+	bool checkCompileErrors(GLuint shader, ShaderType type);
 
 	
 	GLuint mHandle;
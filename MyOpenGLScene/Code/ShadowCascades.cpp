@@ -0,0 +1,356 @@
+//-----------------------------------------------------------------------------
+// Cached cascaded shadow maps for the sun
+//-----------------------------------------------------------------------------
+#include "ShadowCascades.h"
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include "glm/gtc/matrix_transform.hpp"
+#include "Profiler.h"
+#include "GLContext.h"
+#include "GLStats.h"
+#include "MemoryTracker.h"
+
+
+// Cascade ends between a logarithmic split (0) and a uniform one (1)
+const float SPLIT_LAMBDA = 0.3f;
+const float SPLIT_NEAR = 1.0f;
+
+// Slope scaled depth bias of the casters, in polygon offset units
+const float POLYGON_OFFSET_FACTOR = 2.0f;
+const float POLYGON_OFFSET_UNITS = 4.0f;
+
+// The depth shader never fades to an impostor
+const glm::vec2 NO_LOD_FADE(1e30f, 0.0f);
+
+// Caster instances the ring has room for at first, it grows if needed
+const int RING_CASTERS = 16384;
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+ShadowCascades::ShadowCascades()
+	: mLightView(1.0f),
+	  mTexture(0),
+	  mNumBakes(0)
+{
+	for (int i = 0; i < 2 * NUM_CASCADES; i++)
+		mFBOs[i] = 0;
+
+	for (int c = 0; c < NUM_CASCADES; c++)
+	{
+		Cascade& cascade = mCascades[c];
+		cascade.distance = cascade.halfSize = cascade.snap = 0.0f;
+		cascade.center = glm::vec3(0.0f);
+		cascade.projection = glm::mat4(1.0f);
+		cascade.baked = cascade.staticDirty = cascade.hadDynamic = false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+ShadowCascades::~ShadowCascades()
+{
+	if (mFBOs[0] != 0)
+		glDeleteFramebuffers(2 * NUM_CASCADES, mFBOs);
+	MemoryTracker::releaseTextures(1, &mTexture);
+	if (mTexture != 0)
+		glDeleteTextures(1, &mTexture);
+}
+
+//-----------------------------------------------------------------------------
+// Creates the depth texture array, one framebuffer per layer
+//-----------------------------------------------------------------------------
+bool ShadowCascades::init(const glm::vec3& lightDirection, float distance)
+{
+	if (!mDepthShader.loadShaders("shaders/depth_only.vert", "shaders/depth_only.frag"))
+		return false;
+
+	glm::vec3 dir = glm::normalize(lightDirection);
+	glm::vec3 up = fabsf(dir.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	mLightView = glm::lookAt(glm::vec3(0.0f), dir, up);
+
+	// The square is one snap step larger than the sphere it must cover:
+	// halfSize = distance + halfSize * 2 * SNAP_TEXELS / RESOLUTION
+	float snapPart = 2.0f * SNAP_TEXELS / RESOLUTION;
+	for (int c = 0; c < NUM_CASCADES; c++)
+	{
+		float t = (float)(c + 1) / NUM_CASCADES;
+		float logSplit = SPLIT_NEAR * powf(distance / SPLIT_NEAR, t);
+		float uniformSplit = distance * t;
+
+		Cascade& cascade = mCascades[c];
+		cascade.distance = logSplit + SPLIT_LAMBDA * (uniformSplit - logSplit);
+		cascade.halfSize = cascade.distance / (1.0f - snapPart);
+		cascade.snap = cascade.halfSize * snapPart;
+	}
+
+	// 16 bit depth: the ortho depth range is linear, a few cm at worst
+	glGenTextures(1, &mTexture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT16, RESOLUTION, RESOLUTION, 2 * NUM_CASCADES, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, NULL);
+	MemoryTracker::setTexture(MemoryTracker::SHADOWS, mTexture, MemoryTracker::getTextureBytes(GL_DEPTH_COMPONENT16, RESOLUTION, RESOLUTION, 2 * NUM_CASCADES, 1));
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glGenFramebuffers(2 * NUM_CASCADES, mFBOs);
+	bool ok = true;
+	for (int layer = 0; layer < 2 * NUM_CASCADES && ok; layer++)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, mFBOs[layer]);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, mTexture, 0, layer);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		if (status != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cerr << "Shadow map framebuffer incomplete (0x" << std::hex << status << std::dec << ")" << std::endl;
+			ok = false;
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, GLContext::getDefaultFramebuffer());
+
+	if (!ok)
+	{
+		glDeleteFramebuffers(2 * NUM_CASCADES, mFBOs);
+		MemoryTracker::releaseTextures(1, &mTexture);
+		glDeleteTextures(1, &mTexture);
+		for (int i = 0; i < 2 * NUM_CASCADES; i++)
+			mFBOs[i] = 0;
+		mTexture = 0;
+		return false;
+	}
+
+	return mInstanceRing.init(RING_CASTERS * sizeof(GLuint));
+}
+
+//-----------------------------------------------------------------------------
+// Can the sphere cast a shadow in the cascade - inside the square, not past
+// the far plane (anything closer to the sun is clamped to the near plane) and
+// large enough to show
+//-----------------------------------------------------------------------------
+bool ShadowCascades::overlaps(const Cascade& cascade, const glm::vec4& sphere) const
+{
+	float texelSize = 2.0f * cascade.halfSize / RESOLUTION;
+	if (sphere.w < MIN_CASTER_TEXELS * texelSize)
+		return false;
+
+	glm::vec4 p = mLightView * glm::vec4(glm::vec3(sphere), 1.0f);
+	float reach = cascade.halfSize + sphere.w;
+	return fabsf(p.x - cascade.center.x) <= reach &&
+		fabsf(p.y - cascade.center.y) <= reach &&
+		-p.z - sphere.w <= cascade.center.z + cascade.halfSize;
+}
+
+//-----------------------------------------------------------------------------
+// Instanced depth draws of mCasterKeys, one per mesh
+//-----------------------------------------------------------------------------
+void ShadowCascades::drawCasters(std::vector<Mesh>& meshes)
+{
+	if (mCasterKeys.empty())
+		return;
+
+	std::sort(mCasterKeys.begin(), mCasterKeys.end());
+
+	mInstances.resize(mCasterKeys.size());
+	for (size_t i = 0; i < mCasterKeys.size(); i++)
+		mInstances[i] = (GLuint)mCasterKeys[i];
+
+	GLintptr offset = mInstanceRing.write(&mInstances[0], mInstances.size() * sizeof(GLuint));
+	GLuint base = (GLuint)(offset / sizeof(GLuint));
+
+	size_t first = 0;
+	while (first < mCasterKeys.size())
+	{
+		size_t last = first + 1;
+		while (last < mCasterKeys.size() && (mCasterKeys[last] >> 32) == (mCasterKeys[first] >> 32))
+			last++;
+
+		meshes[(size_t)(mCasterKeys[first] >> 32)].drawDepthInstanced(mInstanceRing.getBuffer(), base + (GLuint)first, (GLsizei)(last - first));
+		first = last;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Re-centers a cascade and renders its static casters into its cache
+//-----------------------------------------------------------------------------
+void ShadowCascades::bake(int c, const glm::vec3& center, const EntityStore& entities, std::vector<Mesh>& meshes)
+{
+	Cascade& cascade = mCascades[c];
+	float h = cascade.halfSize;
+	cascade.center = center;
+	cascade.projection = glm::ortho(center.x - h, center.x + h, center.y - h, center.y + h, center.z - h, center.z + h);
+	cascade.baked = true;
+	cascade.staticDirty = false;
+
+	mCasterKeys.clear();
+	for (int i = 0; i < entities.getNumEntities(); i++)
+	{
+		int mesh = entities.getMesh(i);
+		if (mesh < (int)meshes.size() && !mDynamic[i] && overlaps(cascade, entities.getWorldSphere(i)))
+			mCasterKeys.push_back(((unsigned long long)mesh << 32) | (GLuint)entities.getTransform(i));
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, mFBOs[NUM_CASCADES + c]);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	mDepthShader.setUniform("projection", cascade.projection);
+	drawCasters(meshes);
+}
+
+//-----------------------------------------------------------------------------
+// Finds the entities that moved, re-renders the caches that need it, nearest
+// cascade first, and refreshes the sampled layers that hold dynamic casters
+//-----------------------------------------------------------------------------
+void ShadowCascades::update(const glm::vec3& viewPos, const EntityStore& entities, const TransformSystem& transforms, std::vector<Mesh>& meshes)
+{
+	PROFILE_SCOPE("ShadowCascades::update");
+
+	mNumBakes = 0;
+	if (mTexture == 0)
+		return;
+
+	mInstanceRing.beginFrame();
+
+	// The first move of an entity makes it dynamic and dirties the caches it
+	// was rendered into
+	int numEntities = entities.getNumEntities();
+	if ((int)mStamps.size() != numEntities)
+	{
+		mStamps.resize(numEntities);
+		mSpheres.resize(numEntities);
+		mDynamic.assign(numEntities, 0);
+		for (int i = 0; i < numEntities; i++)
+		{
+			mStamps[i] = transforms.getStamp(entities.getTransform(i));
+			mSpheres[i] = entities.getWorldSphere(i);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < numEntities; i++)
+		{
+			unsigned int stamp = transforms.getStamp(entities.getTransform(i));
+			if (stamp == mStamps[i])
+				continue;
+
+			if (!mDynamic[i] && entities.getMesh(i) < (int)meshes.size())
+			{
+				for (int c = 0; c < NUM_CASCADES; c++)
+				{
+					if (mCascades[c].baked && overlaps(mCascades[c], mSpheres[i]))
+						mCascades[c].staticDirty = true;
+				}
+			}
+
+			mDynamic[i] = 1;
+			mStamps[i] = stamp;
+			mSpheres[i] = entities.getWorldSphere(i);
+		}
+	}
+
+	glm::vec4 lightPos = mLightView * glm::vec4(viewPos, 1.0f);
+	glm::vec3 camera(lightPos.x, lightPos.y, -lightPos.z);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glViewport(0, 0, RESOLUTION, RESOLUTION);
+	glEnable(GL_DEPTH_CLAMP);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(POLYGON_OFFSET_FACTOR, POLYGON_OFFSET_UNITS);
+
+	mDepthShader.use();
+	mDepthShader.setUniform("view", mLightView);
+	mDepthShader.setUniform("viewPos", viewPos);
+	mDepthShader.setUniform("lodFade", NO_LOD_FADE);
+	transforms.bindTexture(1);
+	mDepthShader.setUniformSampler("transforms", 1);
+
+	for (int c = 0; c < NUM_CASCADES; c++)
+	{
+		Cascade& cascade = mCascades[c];
+
+		glm::vec3 snapped = glm::floor(camera / cascade.snap + 0.5f) * cascade.snap;
+		bool moved = !cascade.baked || snapped != cascade.center;
+		bool uncovered = !cascade.baked || glm::any(glm::greaterThan(glm::abs(camera - cascade.center), glm::vec3(cascade.snap)));
+
+		bool baked = false;
+		if ((moved || cascade.staticDirty) && (uncovered || mNumBakes < MAX_BAKES_PER_FRAME))
+		{
+			bake(c, moved ? snapped : cascade.center, entities, meshes);
+			mNumBakes++;
+			baked = true;
+		}
+
+		mCasterKeys.clear();
+		for (int i = 0; i < numEntities; i++)
+		{
+			int mesh = entities.getMesh(i);
+			if (mDynamic[i] && mesh < (int)meshes.size() && overlaps(cascade, entities.getWorldSphere(i)))
+				mCasterKeys.push_back(((unsigned long long)mesh << 32) | (GLuint)entities.getTransform(i));
+		}
+		bool dynamic = !mCasterKeys.empty();
+
+		// Fresh copy of the cache, the dynamic casters over it
+		if (baked || dynamic || cascade.hadDynamic)
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, mFBOs[NUM_CASCADES + c]);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mFBOs[c]);
+			glBlitFramebuffer(0, 0, RESOLUTION, RESOLUTION, 0, 0, RESOLUTION, RESOLUTION, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+			if (dynamic)
+			{
+				glBindFramebuffer(GL_FRAMEBUFFER, mFBOs[c]);
+				mDepthShader.setUniform("projection", cascade.projection);
+				drawCasters(meshes);
+			}
+		}
+		cascade.hadDynamic = dynamic;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, GLContext::getDefaultFramebuffer());
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_DEPTH_CLAMP);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+//-----------------------------------------------------------------------------
+// Shadow map uniforms - the matrices go from world space to [0, 1]
+//-----------------------------------------------------------------------------
+void ShadowCascades::setUniforms(ShaderProgram& shader, bool enabled) const
+{
+	glActiveTexture(GL_TEXTURE0 + SHADOW_TEX_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, mTexture);
+	glActiveTexture(GL_TEXTURE0);
+	shader.setUniformSampler("shadowMap", SHADOW_TEX_UNIT);
+
+	const glm::mat4 bias(0.5f, 0.0f, 0.0f, 0.0f,
+	                     0.0f, 0.5f, 0.0f, 0.0f,
+	                     0.0f, 0.0f, 0.5f, 0.0f,
+	                     0.5f, 0.5f, 0.5f, 1.0f);
+
+	glm::vec4 distances(0.0f), texelSizes(0.0f);
+	for (int c = 0; c < NUM_CASCADES; c++)
+	{
+		const Cascade& cascade = mCascades[c];
+		if (!enabled || !cascade.baked)
+			continue;
+
+		char name[32];
+		snprintf(name, sizeof(name), "shadowMatrices[%d]", c);
+		shader.setUniform(name, bias * cascade.projection * mLightView);
+
+		distances[c] = cascade.distance;
+		texelSizes[c] = 2.0f * cascade.halfSize / RESOLUTION;
+	}
+
+	shader.setUniform("shadowDistances", distances);
+	shader.setUniform("shadowTexelSizes", texelSizes);
+}
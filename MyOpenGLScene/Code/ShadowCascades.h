@@ -0,0 +1,109 @@
+//-----------------------------------------------------------------------------
+// Cached cascaded shadow maps for the sun
+//
+// Each cascade covers a sphere of growing radius around the camera, so
+// turning the camera never invalidates it.  The cascade square is snapped
+// to SNAP_TEXELS texels in light space and made one snap step larger than
+// the sphere: its depth stays valid until the camera crosses a snap
+// boundary, and for one more step after that.
+//
+// The depth of the static casters is rendered once into a cache layer per
+// cascade and copied to the layer the shaders sample.  A cascade's cache is
+// re-rendered only when the camera crosses a snap boundary or a caster that
+// was cached in it moves - at most MAX_BAKES_PER_FRAME a frame, nearest
+// cascade first, unless the camera already left the area it covers.  An
+// entity becomes dynamic the first time its transform changes: from then on
+// it is drawn every frame over a fresh copy of the caches it overlaps.
+//
+// Only meshes cast shadows (the terrain and the grass receive them).
+// Casters smaller than MIN_CASTER_TEXELS in a cascade are skipped there.
+//-----------------------------------------------------------------------------
+#ifndef SHADOW_CASCADES_H
+#define SHADOW_CASCADES_H
+
+#include <vector>
+#define GLEW_STATIC
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "ShaderProgram.h"
+#include "Mesh.h"
+#include "EntityStore.h"
+#include "TransformSystem.h"
+#include "GpuRingBuffer.h"
+
+
+class ShadowCascades
+{
+public:
+
+	// Must match the lighting shaders
+	static const int NUM_CASCADES = 4;
+
+	static const int RESOLUTION = 2048;
+	static const int SNAP_TEXELS = 128;			// light space snap step
+	static const int MAX_BAKES_PER_FRAME = 1;
+	static const int MIN_CASTER_TEXELS = 2;		// of bounding sphere radius
+
+	// Texture unit of the shadow map while drawing the lit geometry
+	static const GLuint SHADOW_TEX_UNIT = 7;
+
+	 ShadowCascades();
+	~ShadowCascades();
+
+	// Creates the shadow map and splits [0, distance] between the cascades
+	bool init(const glm::vec3& lightDirection, float distance);
+
+	// Re-renders the out of date caches, then draws the dynamic casters.
+	// Entities with a mesh id past meshes.size() (impostors) cast nothing.
+	void update(const glm::vec3& viewPos, const EntityStore& entities, const TransformSystem& transforms, std::vector<Mesh>& meshes);
+
+	// Binds the shadow map and sets the shadowMap, shadowMatrices,
+	// shadowDistances and shadowTexelSizes uniforms.  Disabled shadows keep
+	// the sampler bound (no two sampler types on one unit) but no cascade.
+	void setUniforms(ShaderProgram& shader, bool enabled) const;
+
+	// Cascades whose cache was re-rendered by the last update()
+	int getNumBakes() const { return mNumBakes; }
+
+private:
+	ShadowCascades(const ShadowCascades& rhs);
+	ShadowCascades& operator = (const ShadowCascades& rhs);
+
+	struct Cascade
+	{
+		float distance;			// end of the cascade from the camera
+		float halfSize;			// of the square, distance + snap
+		float snap;
+		glm::vec3 center;		// snapped light space x, y and depth
+		glm::mat4 projection;	// after mLightView
+		bool baked;				// the cache matches center
+		bool staticDirty;		// a cached caster moved
+		bool hadDynamic;		// the copy holds dynamic casters
+	};
+
+	bool overlaps(const Cascade& cascade, const glm::vec4& sphere) const;
+	void bake(int c, const glm::vec3& center, const EntityStore& entities, std::vector<Mesh>& meshes);
+	void drawCasters(std::vector<Mesh>& meshes);
+
+	Cascade mCascades[NUM_CASCADES];
+	glm::mat4 mLightView;
+
+	// Per entity: transform stamp and bounds seen last, dynamic flag
+	std::vector<unsigned int> mStamps;
+	std::vector<glm::vec4> mSpheres;
+	std::vector<unsigned char> mDynamic;
+
+	// Casters of the draw in progress: mesh << 32 | transform
+	std::vector<unsigned long long> mCasterKeys;
+	std::vector<GLuint> mInstances;
+	GpuRingBuffer mInstanceRing;		// every draw of a frame appends to it
+
+	// Layers 0..NUM_CASCADES-1 are sampled, the next ones are the caches
+	GLuint mTexture;
+	GLuint mFBOs[2 * NUM_CASCADES];
+	int mNumBakes;
+
+	ShaderProgram mDepthShader;
+};
+#endif //SHADOW_CASCADES_H
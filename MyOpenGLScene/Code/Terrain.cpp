@@ -0,0 +1,483 @@
+//-----------------------------------------------------------------------------
+// Heightmap terrain with continuous LOD (CDLOD)
+//-----------------------------------------------------------------------------
+#include "Terrain.h"
+#include <iostream>
+#include <cstdio>
+#include <algorithm>
+#include "Profiler.h"
+#include "GLStats.h"
+#include "MemoryTracker.h"
+
+
+// Lod 0 is drawn up to this many leaf sizes away, every next lod twice as far
+const float LEAF_RANGE_SCALE = 3.0f;
+
+// Vertices start morphing to the next lod after this part of their range
+const float MORPH_START = 0.66f;
+
+const int QUADRANT_INDICES = (Terrain::NODE_QUADS / 2) * (Terrain::NODE_QUADS / 2) * 6;
+
+// Selected nodes the instance ring has room for at first, it grows if needed
+const int RING_NODES = 256;
+
+// Occluders are nodes of this lod (or the top one), OCCLUDER_QUADS quads a side
+const int OCCLUDER_LOD = 2;
+const int OCCLUDER_QUADS = 16;
+
+//-----------------------------------------------------------------------------
+// Distance from a point to a box, 0 inside
+//-----------------------------------------------------------------------------
+static float distanceToBox(const glm::vec3& p, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	return glm::length(p - glm::clamp(p, boundsMin, boundsMax));
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+Terrain::Terrain()
+	: mHeightfield(NULL),
+	  mNumLods(0),
+	  mLeafSize(0.0f),
+	  mOccluderNodeLod(0),
+	  mOccluderQuadCells(1),
+	  mOccluderQuadsPerSide(0),
+	  mVAO(0), mVBO(0), mIBO(0),
+	  mInstanceOffset(0),
+	  mHeightTexture(0),
+	  mTextureTile(1.0f)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+Terrain::~Terrain()
+{
+	if (mVAO != 0)
+	{
+		GLuint buffers[2] = { mVBO, mIBO };
+		MemoryTracker::releaseBuffers(2, buffers);
+		glDeleteBuffers(2, buffers);
+		glDeleteVertexArrays(1, &mVAO);
+	}
+	MemoryTracker::addCpu(MemoryTracker::TERRAIN, -(long long)(mOccluderQuadHeights.capacity() * sizeof(float)));
+	MemoryTracker::releaseTextures(1, &mHeightTexture);
+	if (mHeightTexture != 0)
+		glDeleteTextures(1, &mHeightTexture);
+}
+
+//-----------------------------------------------------------------------------
+// Uploads the heights, builds the node bounds and the shared grid
+//-----------------------------------------------------------------------------
+bool Terrain::init(const Heightfield& heightfield, const std::string& textureName, float textureTile)
+{
+	if (heightfield.isEmpty())
+		return false;
+
+	if (!mShader.loadShaders("shaders/terrain.vert", "shaders/lighting_clustered.frag"))
+		return false;
+	if (!mGBufferShader.loadShaders("shaders/terrain.vert", "shaders/gbuffer.frag"))
+		return false;
+	if (!mDepthShader.loadShaders("shaders/terrain.vert", "shaders/depth_only.frag"))
+		return false;
+
+	if (!mTexture.loadTexture(textureName, true))
+		return false;
+
+	mHeightfield = &heightfield;
+	mTextureTile = textureTile;
+
+	// Lod 0 nodes have one vertex per height sample
+	int cells = heightfield.getCells();
+	mLeafSize = heightfield.getCellSize() * NODE_QUADS;
+
+	mNumLods = 0;
+	int nodeCells = NODE_QUADS;
+	do
+	{
+		mNodesPerSide[mNumLods] = (cells + nodeCells - 1) / nodeCells;
+		mLodRanges[mNumLods] = LEAF_RANGE_SCALE * mLeafSize * (float)(1 << mNumLods);
+		mNumLods++;
+		nodeCells *= 2;
+	} while (mNodesPerSide[mNumLods - 1] > 1 && mNumLods < MAX_LODS);
+
+	// The top lod is drawn however far it is
+	mLodRanges[mNumLods - 1] = 1e30f;
+
+	// Height bounds, from the samples for the leaves and from the children above
+	for (int lod = 0; lod < mNumLods; lod++)
+	{
+		int n = mNodesPerSide[lod];
+		mNodeHeights[lod].resize(n * n);
+		for (int z = 0; z < n; z++)
+		{
+			for (int x = 0; x < n; x++)
+			{
+				glm::vec2& range = mNodeHeights[lod][z * n + x];
+				if (lod == 0)
+				{
+					heightfield.getRange(x * NODE_QUADS, z * NODE_QUADS, (x + 1) * NODE_QUADS, (z + 1) * NODE_QUADS, range.x, range.y);
+					continue;
+				}
+
+				range = glm::vec2(1e30f, -1e30f);
+				int childN = mNodesPerSide[lod - 1];
+				for (int c = 0; c < 4; c++)
+				{
+					int cx = x * 2 + (c & 1), cz = z * 2 + (c >> 1);
+					if (cx < childN && cz < childN)
+					{
+						const glm::vec2& child = mNodeHeights[lod - 1][cz * childN + cx];
+						range = glm::vec2(glm::min(range.x, child.x), glm::max(range.y, child.y));
+					}
+				}
+			}
+		}
+	}
+
+	initOccluders();
+	MemoryTracker::addCpu(MemoryTracker::TERRAIN, (long long)(mOccluderQuadHeights.capacity() * sizeof(float)));
+
+	glGenTextures(1, &mHeightTexture);
+	glBindTexture(GL_TEXTURE_2D, mHeightTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, cells + 1, cells + 1, 0, GL_RED, GL_FLOAT, heightfield.getData());
+	MemoryTracker::setTexture(MemoryTracker::TERRAIN, mHeightTexture, MemoryTracker::getTextureBytes(GL_R32F, cells + 1, cells + 1, 1, 1));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Grid vertices are integer grid positions.  The indices are sorted by
+	// quadrant so a quadrant is one contiguous range.
+	std::vector<glm::vec2> vertices;
+	for (int z = 0; z <= NODE_QUADS; z++)
+		for (int x = 0; x <= NODE_QUADS; x++)
+			vertices.push_back(glm::vec2((float)x, (float)z));
+
+	std::vector<GLushort> indices;
+	const int half = NODE_QUADS / 2;
+	for (int q = 0; q < 4; q++)
+	{
+		for (int z = (q >> 1) * half; z < ((q >> 1) + 1) * half; z++)
+		{
+			for (int x = (q & 1) * half; x < ((q & 1) + 1) * half; x++)
+			{
+				GLushort i0 = (GLushort)(z * (NODE_QUADS + 1) + x);
+				GLushort i1 = (GLushort)(i0 + 1);
+				GLushort i2 = (GLushort)(i0 + NODE_QUADS + 1);
+				GLushort i3 = (GLushort)(i2 + 1);
+				GLushort quad[6] = { i0, i2, i1, i1, i2, i3 };
+				indices.insert(indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	GLuint buffers[2];
+	glGenBuffers(2, buffers);
+	mVBO = buffers[0];
+	mIBO = buffers[1];
+
+	glGenVertexArrays(1, &mVAO);
+	glBindVertexArray(mVAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
+	MemoryTracker::setBuffer(MemoryTracker::TERRAIN, mVBO, vertices.size() * sizeof(glm::vec2));
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), NULL);
+	glEnableVertexAttribArray(0);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), &indices[0], GL_STATIC_DRAW);
+	MemoryTracker::setBuffer(MemoryTracker::TERRAIN, mIBO, indices.size() * sizeof(GLushort));
+
+	// Per node: origin x, z, size, lod
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(1);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	mInstanceRing.init(RING_NODES * sizeof(glm::vec4));
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Occluder quads and the lowest height of each of them (corners included)
+//-----------------------------------------------------------------------------
+void Terrain::initOccluders()
+{
+	mOccluderNodeLod = std::min(OCCLUDER_LOD, mNumLods - 1);
+	mOccluderQuadCells = std::max((NODE_QUADS << mOccluderNodeLod) / OCCLUDER_QUADS, 1);
+	mOccluderQuadsPerSide = mNodesPerSide[mOccluderNodeLod] * ((NODE_QUADS << mOccluderNodeLod) / mOccluderQuadCells);
+
+	int n = mOccluderQuadsPerSide;
+	mOccluderQuadHeights.resize(n * n);
+	for (int z = 0; z < n; z++)
+	{
+		for (int x = 0; x < n; x++)
+		{
+			float maxHeight;
+			mHeightfield->getRange(x * mOccluderQuadCells, z * mOccluderQuadCells, (x + 1) * mOccluderQuadCells, (z + 1) * mOccluderQuadCells,
+				mOccluderQuadHeights[z * n + x], maxHeight);
+		}
+	}
+}
+
+int Terrain::getNumOccluders() const
+{
+	if (mHeightfield == NULL)
+		return 0;
+
+	int n = mNodesPerSide[mOccluderNodeLod];
+	return n * n;
+}
+
+void Terrain::getOccluderBounds(int index, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+	int n = mNodesPerSide[mOccluderNodeLod];
+	getNodeBounds(mOccluderNodeLod, index % n, index / n, boundsMin, boundsMax);
+}
+
+//-----------------------------------------------------------------------------
+// A point is drawn at most at the first lod whose range reaches it (the
+// nodes of the lods below are out of range), or morphing to the next one
+//-----------------------------------------------------------------------------
+int Terrain::getOccluderLod(int index, const glm::vec3& viewPos) const
+{
+	glm::vec3 boundsMin, boundsMax;
+	getOccluderBounds(index, boundsMin, boundsMax);
+
+	// Farthest corner of the node
+	glm::vec3 farthest = glm::max(glm::abs(viewPos - boundsMin), glm::abs(viewPos - boundsMax));
+	float distance = glm::length(farthest);
+
+	int lod = 0;
+	while (lod < mNumLods - 1 && mLodRanges[lod] < distance)
+		lod++;
+	return std::min(lod + 1, mNumLods - 1);
+}
+
+//-----------------------------------------------------------------------------
+// A node as a grid of OCCLUDER_QUADS x OCCLUDER_QUADS quads.  A point of a
+// drawn triangle is interpolated from samples less than one drawn quad away,
+// a point of an occluder quad from its corners: every corner takes the
+// lowest height of the occluder quads that reach one occluder quad plus one
+// drawn quad of lod around it, so the occluder stays under the ground.
+//-----------------------------------------------------------------------------
+void Terrain::buildOccluder(int index, int lod, std::vector<Vertex>& vertices) const
+{
+	vertices.clear();
+	if (index < 0 || index >= getNumOccluders())
+		return;
+
+	int nodes = mNodesPerSide[mOccluderNodeLod];
+	int quads = (NODE_QUADS << mOccluderNodeLod) / mOccluderQuadCells;
+	int firstX = (index % nodes) * quads;
+	int firstZ = (index / nodes) * quads;
+	int reach = 1 + ((1 << lod) + mOccluderQuadCells - 1) / mOccluderQuadCells;
+	int n = mOccluderQuadsPerSide;
+	int cells = mHeightfield->getCells();
+
+	// Corner heights, then two triangles per quad
+	std::vector<glm::vec3> corners((quads + 1) * (quads + 1));
+	for (int z = 0; z <= quads; z++)
+	{
+		for (int x = 0; x <= quads; x++)
+		{
+			int gx = firstX + x, gz = firstZ + z;
+			float height = 1e30f;
+			for (int qz = std::max(gz - reach, 0); qz < std::min(gz + reach, n); qz++)
+				for (int qx = std::max(gx - reach, 0); qx < std::min(gx + reach, n); qx++)
+					height = std::min(height, mOccluderQuadHeights[qz * n + qx]);
+
+			glm::vec2 cell((float)std::min(gx * mOccluderQuadCells, cells), (float)std::min(gz * mOccluderQuadCells, cells));
+			glm::vec2 position = mHeightfield->getOrigin() + cell * mHeightfield->getCellSize();
+			corners[z * (quads + 1) + x] = glm::vec3(position.x, height, position.y);
+		}
+	}
+
+	Vertex vertex;
+	vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+	vertex.texCoords = glm::vec2(0.0f);
+	vertices.reserve(quads * quads * 6);
+	for (int z = 0; z < quads; z++)
+	{
+		for (int x = 0; x < quads; x++)
+		{
+			int i0 = z * (quads + 1) + x;
+			int quad[6] = { i0, i0 + quads + 1, i0 + 1, i0 + 1, i0 + quads + 1, i0 + quads + 2 };
+			for (int v = 0; v < 6; v++)
+			{
+				vertex.position = corners[quad[v]];
+				vertices.push_back(vertex);
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// World bounds of a node
+//-----------------------------------------------------------------------------
+void Terrain::getNodeBounds(int lod, int x, int z, glm::vec3& boundsMin, glm::vec3& boundsMax) const
+{
+	float size = mLeafSize * (float)(1 << lod);
+	glm::vec2 origin = mHeightfield->getOrigin() + glm::vec2((float)x, (float)z) * size;
+	const glm::vec2& heights = mNodeHeights[lod][z * mNodesPerSide[lod] + x];
+
+	boundsMin = glm::vec3(origin.x, heights.x, origin.y);
+	boundsMax = glm::vec3(origin.x + size, heights.y, origin.y + size);
+}
+
+//-----------------------------------------------------------------------------
+// CDLOD selection.  Returns false if the node is beyond its lod range, the
+// parent then covers that area itself.
+//-----------------------------------------------------------------------------
+bool Terrain::selectNode(int lod, int x, int z, const Frustum& frustum, const glm::vec3& viewPos)
+{
+	// Past the edge of the terrain - nothing to draw, nothing for the parent to do
+	if (x >= mNodesPerSide[lod] || z >= mNodesPerSide[lod])
+		return true;
+
+	glm::vec3 boundsMin, boundsMax;
+	getNodeBounds(lod, x, z, boundsMin, boundsMax);
+
+	float distance = distanceToBox(viewPos, boundsMin, boundsMax);
+	if (distance > mLodRanges[lod])
+		return false;
+
+	if (!frustum.intersectsBox(boundsMin, boundsMax))
+		return true;
+
+	glm::vec4 node(boundsMin.x, boundsMin.z, boundsMax.x - boundsMin.x, (float)lod);
+	if (lod == 0 || distance > mLodRanges[lod - 1])
+	{
+		mSelected[WHOLE_NODE].push_back(node);
+		return true;
+	}
+
+	for (int q = 0; q < 4; q++)
+	{
+		if (!selectNode(lod - 1, x * 2 + (q & 1), z * 2 + (q >> 1), frustum, viewPos))
+			mSelected[QUADRANT_0 + q].push_back(node);
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Walks the quadtree from the top lod
+//-----------------------------------------------------------------------------
+void Terrain::select(const Frustum& frustum, const glm::vec3& viewPos)
+{
+	PROFILE_SCOPE("Terrain::select");
+
+	if (mHeightfield == NULL)
+		return;
+
+	for (int part = 0; part < NUM_DRAW_PARTS; part++)
+		mSelected[part].clear();
+
+	int top = mNumLods - 1;
+	for (int z = 0; z < mNodesPerSide[top]; z++)
+		for (int x = 0; x < mNodesPerSide[top]; x++)
+			selectNode(top, x, z, frustum, viewPos);
+
+	mInstances.clear();
+	for (int part = 0; part < NUM_DRAW_PARTS; part++)
+		mInstances.insert(mInstances.end(), mSelected[part].begin(), mSelected[part].end());
+}
+
+//-----------------------------------------------------------------------------
+// Streams the selected nodes to this frame's region of the ring
+//-----------------------------------------------------------------------------
+void Terrain::upload()
+{
+	mInstanceRing.beginFrame();
+	mInstanceOffset = mInstanceRing.write(mInstances.empty() ? NULL : &mInstances[0], mInstances.size() * sizeof(glm::vec4));
+}
+
+//-----------------------------------------------------------------------------
+// Number of grids drawn (whole nodes and quadrants)
+//-----------------------------------------------------------------------------
+int Terrain::getNumSelectedNodes() const
+{
+	return (int)mInstances.size();
+}
+
+//-----------------------------------------------------------------------------
+// Sets the height texture and its mapping on a shader
+//-----------------------------------------------------------------------------
+void Terrain::setHeightUniforms(ShaderProgram& shader)
+{
+	if (mHeightfield == NULL)
+		return;
+
+	glActiveTexture(GL_TEXTURE0 + HEIGHT_TEX_UNIT);
+	glBindTexture(GL_TEXTURE_2D, mHeightTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	shader.setUniformSampler("terrainHeights", HEIGHT_TEX_UNIT);
+	shader.setUniform("terrainOrigin", mHeightfield->getOrigin());
+	shader.setUniform("terrainSize", mHeightfield->getSize());
+	shader.setUniform("terrainCells", (float)mHeightfield->getCells());
+}
+
+//-----------------------------------------------------------------------------
+// One instanced draw for the whole nodes, one per quadrant
+//-----------------------------------------------------------------------------
+void Terrain::draw(ShaderProgram& shader)
+{
+	if (mInstances.empty())
+		return;
+
+	setHeightUniforms(shader);
+	shader.setUniform("textureTile", mTextureTile);
+	shader.setUniformSampler("material.diffuseMap", 0);
+
+	// Morph window of every lod: start, 1 / length
+	for (int lod = 0; lod < mNumLods; lod++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "morphConsts[%d]", lod);
+
+		glm::vec2 morph(1e30f, 0.0f);
+		if (lod < mNumLods - 1)
+		{
+			float previous = lod > 0 ? mLodRanges[lod - 1] : 0.0f;
+			float start = previous + (mLodRanges[lod] - previous) * MORPH_START;
+			morph = glm::vec2(start, 1.0f / (mLodRanges[lod] - start));
+		}
+		shader.setUniform(name, morph);
+	}
+
+	mTexture.bind(0);
+	glBindVertexArray(mVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, mInstanceRing.getBuffer());
+
+	GLuint first = 0;
+	for (int part = 0; part < NUM_DRAW_PARTS; part++)
+	{
+		GLsizei count = (GLsizei)mSelected[part].size();
+		if (count > 0)
+		{
+			GLsizei numIndices = part == WHOLE_NODE ? 4 * QUADRANT_INDICES : QUADRANT_INDICES;
+			size_t firstIndex = part == WHOLE_NODE ? 0 : (size_t)(part - QUADRANT_0) * QUADRANT_INDICES;
+
+			glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (GLvoid*)(mInstanceOffset + first * sizeof(glm::vec4)));
+			glDrawElementsInstanced(GL_TRIANGLES, numIndices, GL_UNSIGNED_SHORT, (GLvoid*)(firstIndex * sizeof(GLushort)), count);
+		}
+		first += (GLuint)count;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	mTexture.unbind(0);
+
+	glActiveTexture(GL_TEXTURE0 + HEIGHT_TEX_UNIT);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,134 @@
+//-----------------------------------------------------------------------------
+// Heightmap terrain with continuous LOD (CDLOD)
+//
+// The heights live in a float texture and every piece of terrain is the same
+// NODE_QUADS x NODE_QUADS grid, displaced in the vertex shader.  The grid is
+// laid over a quadtree: a node at lod n covers 2^n leaves and is drawn while
+// the camera is within its lod range, otherwise its children are.  Vertices
+// morph towards the next lod's grid over the last third of every range, so
+// neighbours of different lods meet without cracks and nothing pops.
+//
+// Nodes are culled against the view frustum with bounds that come from the
+// heights.  The number of nodes, hence of triangles, follows the view
+// distance and not the size of the terrain.
+//
+// For the software occlusion culler the terrain also gives a coarse copy of
+// itself, one mesh per node of a middle lod.  Every vertex is lowered to the
+// lowest height the drawn ground can have around it, which depends on the
+// lod it is drawn at: hills hide what is behind them, never what is in front.
+//-----------------------------------------------------------------------------
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <string>
+#include <vector>
+#define GLEW_STATIC
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+
+#include "Heightfield.h"
+#include "Mesh.h"
+#include "Texture2D.h"
+#include "ShaderProgram.h"
+#include "Frustum.h"
+#include "GpuRingBuffer.h"
+
+
+class Terrain
+{
+public:
+
+	// Must match terrain.vert
+	static const int NODE_QUADS = 32;	// grid quads per node side (even, for the morph)
+	static const int MAX_LODS = 8;
+
+	// Texture unit of the heights while drawing the terrain or the grass
+	static const GLuint HEIGHT_TEX_UNIT = 6;
+
+	 Terrain();
+	~Terrain();
+
+	// Uploads the heights and builds the quadtree.  The heightfield must live
+	// as long as the terrain.
+	bool init(const Heightfield& heightfield, const std::string& textureName, float textureTile);
+
+	// Picks the nodes and lods to draw this frame - no GL call
+	void select(const Frustum& frustum, const glm::vec3& viewPos);
+
+	// Streams the nodes picked by select() to the GPU
+	void upload();
+
+	// Draws the selected nodes.  The caller sets view, projection, viewPos and
+	// the lighting and material uniforms on getShader() (or getGBufferShader(),
+	// getDepthShader()) first.
+	void draw(ShaderProgram& shader);
+
+	// Binds the height texture and sets the terrainHeights, terrainOrigin,
+	// terrainSize and terrainCells uniforms for another shader (grass)
+	void setHeightUniforms(ShaderProgram& shader);
+
+	float getHeight(float x, float z) const { return mHeightfield->getHeight(x, z); }
+
+	// Occluder meshes, after init().  getOccluderLod() is the coarsest lod
+	// the ground under an occluder may be drawn at from viewPos, build the
+	// occluder again for it when it changes.  World space, non-indexed
+	// triangles.
+	int getNumOccluders() const;
+	void getOccluderBounds(int index, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+	int getOccluderLod(int index, const glm::vec3& viewPos) const;
+	void buildOccluder(int index, int lod, std::vector<Vertex>& vertices) const;
+
+	ShaderProgram& getShader()        { return mShader; }
+	ShaderProgram& getGBufferShader() { return mGBufferShader; }
+	ShaderProgram& getDepthShader()   { return mDepthShader; }
+
+	int getNumLods() const          { return mNumLods; }
+	int getNumSelectedNodes() const;
+
+private:
+	Terrain(const Terrain& rhs);
+	Terrain& operator = (const Terrain& rhs);
+
+	// A node covering its whole area, or one of its quadrants drawn at its lod
+	// because the child there is out of range
+	enum DrawPart
+	{
+		WHOLE_NODE,
+		QUADRANT_0, QUADRANT_1, QUADRANT_2, QUADRANT_3,
+		NUM_DRAW_PARTS
+	};
+
+	bool selectNode(int lod, int x, int z, const Frustum& frustum, const glm::vec3& viewPos);
+	void initOccluders();
+	void getNodeBounds(int lod, int x, int z, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+
+	const Heightfield* mHeightfield;
+	int mNumLods;
+	float mLeafSize;
+	float mLodRanges[MAX_LODS];
+	int mNodesPerSide[MAX_LODS];
+	std::vector<glm::vec2> mNodeHeights[MAX_LODS];	// min, max per node
+
+	// Occluders are the nodes of mOccluderNodeLod, in quads of
+	// mOccluderQuadCells cells.  Lowest height of every quad of the terrain.
+	int mOccluderNodeLod;
+	int mOccluderQuadCells;
+	int mOccluderQuadsPerSide;
+	std::vector<float> mOccluderQuadHeights;
+
+	// Selected this frame: origin x, z, size, lod
+	std::vector<glm::vec4> mSelected[NUM_DRAW_PARTS];
+	std::vector<glm::vec4> mInstances;
+
+	GLuint mVAO, mVBO, mIBO;
+	GpuRingBuffer mInstanceRing;
+	GLintptr mInstanceOffset;		// of this frame's nodes in the ring
+	GLuint mHeightTexture;
+	Texture2D mTexture;
+	float mTextureTile;
+
+	ShaderProgram mShader;
+	ShaderProgram mGBufferShader;
+	ShaderProgram mDepthShader;
+};
+#endif //TERRAIN_H
@@ -4,6 +4,17 @@
 #include "Texture2D.h"
 #include <iostream>
 #include <cassert>
+#include <fstream>
+#include <vector>
+#include "GLStats.h"
+#include "LoadStats.h"
+#include "MemoryTracker.h"
+
+// Decoded images, the heightfields' too, are counted with the textures
+// while they live
+#define STBI_MALLOC(bytes)			MemoryTracker::allocate(MemoryTracker::TEXTURES, bytes)
+#define STBI_REALLOC(block, bytes)	MemoryTracker::reallocate(MemoryTracker::TEXTURES, block, bytes)
+#define STBI_FREE(block)			MemoryTracker::release(MemoryTracker::TEXTURES, block)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
@@ -11,7 +22,9 @@
 // Constructor
 //-----------------------------------------------------------------------------
 Texture2D::Texture2D()
-	: mTexture(0)
+	: mTexture(0),
+	  mWidth(0),
+	  mHeight(0)
 {
 }
 
@@ -20,6 +33,7 @@ Texture2D::Texture2D()
 //-----------------------------------------------------------------------------
 Texture2D::~Texture2D()
 {
+	MemoryTracker::releaseTextures(1, &mTexture);
 	glDeleteTextures(1, &mTexture);
 }
 
@@ -31,35 +45,41 @@ Texture2D::~Texture2D()
 bool Texture2D::loadTexture(const string& fileName, bool generateMipMaps)
 {
 	int width, height, components;
+	LoadTimer timer("texture", fileName);
+
+	// The whole file first, so reading and decoding are timed apart
+	std::ifstream file(fileName, std::ios::in | std::ios::binary | std::ios::ate);
+	std::streamoff fileSize = file ? (std::streamoff)file.tellg() : 0;
+	std::vector<unsigned char> fileData;
+	if (fileSize > 0)
+	{
+		fileData.resize((size_t)fileSize);
+		file.seekg(0, std::ios::beg);
+		file.read((char*)&fileData[0], fileSize);
+	}
+	if (fileSize <= 0 || !file)
+	{
+		std::cerr << "Error loading texture '" << fileName << "'" << std::endl;
+		return false;
+	}
+	timer.addBytesIn((unsigned long long)fileSize);
+	timer.endStage(LoadStats::READ);
 
 	// Use stbi image library to load our image
-	unsigned char* imageData = stbi_load(fileName.c_str(), &width, &height, &components, STBI_rgb_alpha);
+	MemoryTracker::addCpu(MemoryTracker::TEXTURES, (long long)fileSize);
+	unsigned char* imageData = stbi_load_from_memory(&fileData[0], (int)fileSize, &width, &height, &components, STBI_rgb_alpha);
+	MemoryTracker::addCpu(MemoryTracker::TEXTURES, -(long long)fileSize);
 
 	if (imageData == NULL)
 	{
 		std::cerr << "Error loading texture '" << fileName << "'" << std::endl;
 		return false;
 	}
+	timer.endStage(LoadStats::PARSE);
 
 	// Invert image
-	int widthInBytes = width * 4;
-	unsigned char *top = NULL;
-	unsigned char *bottom = NULL;
-	unsigned char temp = 0;
-	int halfHeight = height / 2;
-	for (int row = 0; row < halfHeight; row++)
-	{
-		top = imageData + row * widthInBytes;
-		bottom = imageData + (height - row - 1) * widthInBytes;
-		for (int col = 0; col < widthInBytes; col++)
-		{ 
-			temp = *top;
-			*top = *bottom;
-			*bottom = temp;
-			top++;
-			bottom++;
-		}
-	}
+	flipRows(imageData, width * 4, height);
+	timer.endStage(LoadStats::POST_PROCESS);
 
 	glGenTextures(1, &mTexture);
 	glBindTexture(GL_TEXTURE_2D, mTexture); // all upcoming GL_TEXTURE_2D operations will affect our texture object (mTexture)
@@ -77,6 +97,9 @@ bool Texture2D::loadTexture(const string& fileName, bool generateMipMaps)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, imageData);
+	mWidth = width;
+	mHeight = height;
+	MemoryTracker::setTexture(MemoryTracker::TEXTURES, mTexture, MemoryTracker::getTextureBytes(GL_RGBA8, width, height, 1, generateMipMaps ? 0 : 1), fileName.c_str());
 
 	if (generateMipMaps)
 		glGenerateMipmap(GL_TEXTURE_2D);
@@ -84,9 +107,39 @@ bool Texture2D::loadTexture(const string& fileName, bool generateMipMaps)
 	stbi_image_free(imageData);
 	glBindTexture(GL_TEXTURE_2D, 0); // unbind texture when done so we don't accidentally mess up our mTexture
 
+	// The mip chain adds a third
+	unsigned long long levelBytes = (unsigned long long)width * height * 4;
+	timer.addBytesOut(generateMipMaps ? levelBytes * 4 / 3 : levelBytes);
+	timer.endStage(LoadStats::UPLOAD);
+
+	timer.setSucceeded();
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// Turns an image upside down, GL wants the bottom row first
+//-----------------------------------------------------------------------------
+void Texture2D::flipRows(unsigned char* data, int widthInBytes, int height)
+{
+	unsigned char *top = NULL;
+	unsigned char *bottom = NULL;
+	unsigned char temp = 0;
+	int halfHeight = height / 2;
+	for (int row = 0; row < halfHeight; row++)
+	{
+		top = data + row * widthInBytes;
+		bottom = data + (height - row - 1) * widthInBytes;
+		for (int col = 0; col < widthInBytes; col++)
+		{ 
+			temp = *top;
+			*top = *bottom;
+			*bottom = temp;
+			top++;
+			bottom++;
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Bind the texture unit passed in as the active texture in the shader
 //-----------------------------------------------------------------------------
@@ -19,10 +19,18 @@ public:
 	void bind(GLuint texUnit = 0);
 	void unbind(GLuint texUnit = 0);
 
+	GLuint getHandle() const { return mTexture; }
+	int getWidth() const     { return mWidth; }
+	int getHeight() const    { return mHeight; }
+
+	// Swaps the rows of an image in place, top to bottom
+	static void flipRows(unsigned char* data, int widthInBytes, int height);
+
 private:
 	Texture2D(const Texture2D& rhs) {}
 	Texture2D& operator = (const Texture2D& rhs) {}
 
 	GLuint mTexture;
+	int mWidth, mHeight;
 };
 #endif //TEXTURE2D_H
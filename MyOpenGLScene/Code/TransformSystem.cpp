@@ -0,0 +1,200 @@
+//-----------------------------------------------------------------------------
+// Transform system
+//-----------------------------------------------------------------------------
+#include "TransformSystem.h"
+#include <iostream>
+#include <algorithm>
+#include "Profiler.h"
+#include "GLStats.h"
+#include "MemoryTracker.h"
+
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+TransformSystem::TransformSystem()
+	: mUpdateCount(0),
+	  mFirstDirty(0),
+	  mUploadBegin(0),
+	  mUploadEnd(0),
+	  mBuffer(0),
+	  mTexture(0),
+	  mBufferCapacity(0)
+{
+}
+
+//-----------------------------------------------------------------------------
+// Destructor
+//-----------------------------------------------------------------------------
+TransformSystem::~TransformSystem()
+{
+	if (mTexture != 0)
+		glDeleteTextures(1, &mTexture);
+	MemoryTracker::releaseBuffers(1, &mBuffer);
+	if (mBuffer != 0)
+		glDeleteBuffers(1, &mBuffer);
+}
+
+//-----------------------------------------------------------------------------
+// Adds a transform from its parts
+//-----------------------------------------------------------------------------
+int TransformSystem::add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, int parent)
+{
+	int id = (int)mWorld.size();
+	if (parent >= id)
+	{
+		std::cerr << "Transform parent " << parent << " must be added before its children" << std::endl;
+		parent = -1;
+	}
+
+	mPositions.push_back(position);
+	mRotations.push_back(rotation);
+	mScales.push_back(scale);
+	mParents.push_back(parent);
+	mWorld.push_back(glm::mat4(1.0f));
+	mDirty.push_back(0);
+	mStamps.push_back(0);
+
+	markDirty(id);
+	return id;
+}
+
+//-----------------------------------------------------------------------------
+// Adds a transform from a translate * scale * rotate matrix.  The scale
+// multiplies the rows of the rotation so it is the length of each row.
+//-----------------------------------------------------------------------------
+int TransformSystem::add(const glm::mat4& local, int parent)
+{
+	glm::vec3 scale;
+	glm::mat3 rotation;
+	for (int r = 0; r < 3; r++)
+	{
+		scale[r] = glm::length(glm::vec3(local[0][r], local[1][r], local[2][r]));
+		for (int c = 0; c < 3; c++)
+			rotation[c][r] = scale[r] > 0.0f ? local[c][r] / scale[r] : (c == r ? 1.0f : 0.0f);
+	}
+
+	return add(glm::vec3(local[3]), glm::quat_cast(rotation), scale, parent);
+}
+
+//-----------------------------------------------------------------------------
+// Setters - the world matrix is rebuilt by the next update()
+//-----------------------------------------------------------------------------
+void TransformSystem::setPosition(int id, const glm::vec3& position)
+{
+	mPositions[id] = position;
+	markDirty(id);
+}
+
+void TransformSystem::setRotation(int id, const glm::quat& rotation)
+{
+	mRotations[id] = rotation;
+	markDirty(id);
+}
+
+void TransformSystem::setScale(int id, const glm::vec3& scale)
+{
+	mScales[id] = scale;
+	markDirty(id);
+}
+
+void TransformSystem::markDirty(int id)
+{
+	mDirty[id] = 1;
+	mFirstDirty = std::min(mFirstDirty, id);
+}
+
+//-----------------------------------------------------------------------------
+// Rebuilds the dirty world matrices.  Parents come before their children so a
+// single pass from the first dirty entry is enough; an entry whose parent was
+// rebuilt is rebuilt too.  Nothing is done when nothing moved.
+//-----------------------------------------------------------------------------
+void TransformSystem::update()
+{
+	PROFILE_SCOPE("TransformSystem::update");
+
+	int count = (int)mWorld.size();
+	if (mFirstDirty >= count)
+		return;
+
+	int lastChanged = -1;
+	mUpdateCount++;
+	for (int i = mFirstDirty; i < count; i++)
+	{
+		int parent = mParents[i];
+		if (!mDirty[i] && (parent < 0 || !mDirty[parent]))
+			continue;
+
+		// translate * scale * rotate without the matrix products
+		glm::mat3 rotation = glm::mat3_cast(mRotations[i]);
+		glm::mat4 local(1.0f);
+		for (int c = 0; c < 3; c++)
+			local[c] = glm::vec4(rotation[c] * mScales[i], 0.0f);
+		local[3] = glm::vec4(mPositions[i], 1.0f);
+
+		mWorld[i] = parent >= 0 ? mWorld[parent] * local : local;
+		mDirty[i] = 1;		// children of this entry must follow
+		mStamps[i] = mUpdateCount;
+		lastChanged = i;
+	}
+
+	std::fill(mDirty.begin() + mFirstDirty, mDirty.end(), 0);
+
+	if (mUploadBegin == mUploadEnd)
+		mUploadBegin = mFirstDirty;
+	mUploadBegin = std::min(mUploadBegin, mFirstDirty);
+	mUploadEnd = std::max(mUploadEnd, lastChanged + 1);
+	mFirstDirty = count;
+}
+
+//-----------------------------------------------------------------------------
+// Sends the changed range of world matrices to the texture buffer
+//-----------------------------------------------------------------------------
+void TransformSystem::upload()
+{
+	PROFILE_SCOPE("TransformSystem::upload");
+
+	int count = (int)mWorld.size();
+	if (count == 0)
+		return;
+
+	if (mBuffer == 0)
+	{
+		glGenBuffers(1, &mBuffer);
+		glGenTextures(1, &mTexture);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, mBuffer);
+	if (mBufferCapacity < count)
+	{
+		GLint maxTexels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+		if (count * 4 > maxTexels)
+			std::cerr << "Too many transforms for a texture buffer (" << count << ", max " << maxTexels / 4 << ")" << std::endl;
+
+		// Reallocate and send everything
+		mBufferCapacity = count;
+		glBufferData(GL_TEXTURE_BUFFER, count * sizeof(glm::mat4), &mWorld[0], GL_DYNAMIC_DRAW);
+		MemoryTracker::setBuffer(MemoryTracker::SCENE, mBuffer, count * sizeof(glm::mat4));
+
+		glBindTexture(GL_TEXTURE_BUFFER, mTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mBuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+	else if (mUploadBegin < mUploadEnd)
+	{
+		glBufferSubData(GL_TEXTURE_BUFFER, mUploadBegin * sizeof(glm::mat4), (mUploadEnd - mUploadBegin) * sizeof(glm::mat4), &mWorld[mUploadBegin]);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	mUploadBegin = mUploadEnd = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Binds the world matrices for the shaders (samplerBuffer)
+//-----------------------------------------------------------------------------
+void TransformSystem::bindTexture(GLuint texUnit) const
+{
+	glActiveTexture(GL_TEXTURE0 + texUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, mTexture);
+}
@@ -0,0 +1,86 @@
+//-----------------------------------------------------------------------------
+// Transform system
+//
+// Local position/rotation/scale and the cached world matrices are kept in
+// contiguous arrays.  Only the transforms marked dirty (and their children)
+// are recomputed by update(), and only the world matrices that changed are
+// copied to the GPU by upload().  Static objects therefore cost nothing per
+// frame: their matrices are built once and stay in a texture buffer that the
+// instanced shaders read from.
+//
+// Matrices follow the convention used everywhere else in the scene:
+// world = parent * translate * scale * rotate
+//-----------------------------------------------------------------------------
+#ifndef TRANSFORM_SYSTEM_H
+#define TRANSFORM_SYSTEM_H
+
+#include <vector>
+#define GLEW_STATIC
+#include "GL/glew.h"
+#include "glm/glm.hpp"
+#include "glm/gtc/quaternion.hpp"
+
+
+class TransformSystem
+{
+public:
+
+	 TransformSystem();
+	~TransformSystem();
+
+	// Parents must be added before their children
+	int add(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, int parent = -1);
+
+	// Splits a translate * scale * rotate matrix into its parts
+	int add(const glm::mat4& local, int parent = -1);
+
+	void setPosition(int id, const glm::vec3& position);
+	void setRotation(int id, const glm::quat& rotation);
+	void setScale(int id, const glm::vec3& scale);
+
+	const glm::vec3& getPosition(int id) const { return mPositions[id]; }
+	const glm::quat& getRotation(int id) const { return mRotations[id]; }
+	const glm::vec3& getScale(int id) const    { return mScales[id]; }
+
+	// Recomputes the world matrices of the dirty transforms and their children
+	void update();
+
+	// Copies the world matrices changed since the last upload to the GPU
+	void upload();
+
+	const glm::mat4& getWorld(int id) const   { return mWorld[id]; }
+	const glm::mat4* getWorldMatrices() const { return mWorld.empty() ? NULL : &mWorld[0]; }
+	int getNumTransforms() const              { return (int)mWorld.size(); }
+
+	// Changes every time update() rebuilds the world matrix of this transform
+	unsigned int getStamp(int id) const       { return mStamps[id]; }
+
+	// Texture buffer of the world matrices - 4 RGBA32F texels (columns) each
+	void bindTexture(GLuint texUnit) const;
+
+private:
+	TransformSystem(const TransformSystem& rhs);
+	TransformSystem& operator = (const TransformSystem& rhs);
+
+	void markDirty(int id);
+
+	// Local transforms
+	std::vector<glm::vec3> mPositions;
+	std::vector<glm::quat> mRotations;
+	std::vector<glm::vec3> mScales;
+	std::vector<int> mParents;
+
+	// Cached world matrices
+	std::vector<glm::mat4> mWorld;
+	std::vector<unsigned char> mDirty;
+	std::vector<unsigned int> mStamps;
+	unsigned int mUpdateCount;
+	int mFirstDirty;
+
+	// World matrices not uploaded yet [mUploadBegin, mUploadEnd)
+	int mUploadBegin, mUploadEnd;
+
+	GLuint mBuffer, mTexture;
+	int mBufferCapacity;	// in matrices
+};
+#endif //TRANSFORM_SYSTEM_H
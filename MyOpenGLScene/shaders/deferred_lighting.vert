@@ -0,0 +1,12 @@
+//-----------------------------------------------------------------------------
+// Vertex shader for full screen passes
+//
+// Draw 3 vertices without attributes: one triangle covering the screen.
+//-----------------------------------------------------------------------------
+#version 330 core
+
+void main()
+{
+	vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(pos * 2.0f - 1.0f, 0.0f, 1.0f);
+}
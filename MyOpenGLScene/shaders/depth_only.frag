@@ -0,0 +1,13 @@
+//-----------------------------------------------------------------------------
+// Fragment shader for the depth pre-pass - only the depth is written, minus
+// the pixels dithered out while the mesh fades to its impostor
+//-----------------------------------------------------------------------------
+#version 330 core
+
+flat in float Fade;
+
+void main()
+{
+	if (ditherThreshold() < Fade)
+		discard;
+}
@@ -0,0 +1,35 @@
+//-----------------------------------------------------------------------------
+// Vertex shader for the depth pre-pass
+//
+// Positions only.  gl_Position is computed exactly like in
+// lighting_instanced.vert and declared invariant in both, so the main pass
+// can test its depth with GL_EQUAL.
+//-----------------------------------------------------------------------------
+#version 330 core
+
+layout (location = 0) in vec3 pos;
+layout (location = 3) in uint transformIndex;
+
+uniform samplerBuffer transforms;	// world matrices
+uniform mat4 view;			// view matrix
+uniform mat4 projection;	// projection matrix
+uniform vec3 viewPos;
+uniform vec2 lodFade;		// fade start distance, 1 / fade length
+
+flat out float Fade;
+
+invariant gl_Position;
+
+void main()
+{
+	int texel = int(transformIndex) * 4;
+	mat4 model = mat4(texelFetch(transforms, texel),
+	                  texelFetch(transforms, texel + 1),
+	                  texelFetch(transforms, texel + 2),
+	                  texelFetch(transforms, texel + 3));
+
+	vec3 worldPos = vec3(model * vec4(pos, 1.0f));
+	Fade = clamp((length(model[3].xyz - viewPos) - lodFade.x) * lodFade.y, 0.0f, 1.0f);
+
+	gl_Position = projection * view * vec4(worldPos, 1.0f);
+}
@@ -0,0 +1,15 @@
+//-----------------------------------------------------------------------------
+// Shared by every fragment shader - ShaderProgram inserts it right after the
+// #version line, the shaders call the functions without declaring them
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------------------------
+// Ordered 4x4 dither threshold of this pixel, in (0, 1): the pixels under Fade
+// are dropped while a mesh and its impostor cross fade
+//-----------------------------------------------------------------------------------------------
+float ditherThreshold()
+{
+	const float bayer[16] = float[16](0.0f, 8.0f, 2.0f, 10.0f, 12.0f, 4.0f, 14.0f, 6.0f, 3.0f, 11.0f, 1.0f, 9.0f, 15.0f, 7.0f, 13.0f, 5.0f);
+	ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+	return (bayer[p.y * 4 + p.x] + 0.5f) / 16.0f;
+}
@@ -0,0 +1,61 @@
+//-----------------------------------------------------------------------------
+// Fragment shader for the deferred geometry pass
+//
+// Writes the surface to the G-buffer instead of lighting it:
+//   target 0  albedo, specular intensity
+//   target 1  octahedral normal, shininess / MAX_SHININESS
+// The specular color is reduced to one intensity, the scene's materials are
+// all grey anyway.  See deferred_lighting.frag for the decoding.
+//-----------------------------------------------------------------------------
+#version 330 core
+
+struct Material 
+{
+    vec3 ambient;
+    sampler2D diffuseMap;
+    vec3 specular;
+    float shininess;
+};
+
+in vec2 TexCoord;
+in vec3 FragPos;
+in vec3 Normal;
+flat in float Fade;
+
+// Must match deferred_lighting.frag
+#define MAX_SHININESS 256.0f
+
+uniform Material material;
+
+layout (location = 0) out vec4 albedoSpecular;
+layout (location = 1) out vec4 normalShininess;
+
+vec2 encodeNormal(vec3 n);
+
+//-----------------------------------------------------------------------------------------------
+// Main Shader Entry
+//-----------------------------------------------------------------------------------------------
+void main()
+{
+	// Fading out to the impostor
+	if (ditherThreshold() < Fade)
+		discard;
+
+	vec3 albedo = vec3(texture(material.diffuseMap, TexCoord));
+	float specular = max(material.specular.r, max(material.specular.g, material.specular.b));
+
+	albedoSpecular = vec4(albedo, specular);
+	normalShininess = vec4(encodeNormal(normalize(Normal)) * 0.5f + 0.5f, material.shininess / MAX_SHININESS, 0.0f);
+}
+
+//-----------------------------------------------------------------------------------------------
+// Octahedral normal encoding - the unit sphere folded on a square in [-1, 1]
+//-----------------------------------------------------------------------------------------------
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.xy;
+	if (n.z < 0.0f)
+		e = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return e;
+}
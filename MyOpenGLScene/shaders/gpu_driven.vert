@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// Vertex shader for GPU driven rendering
+//
+// The per-instance attribute holds the instance index written by the culling
+// compute shader (and the texture layer of the mesh), the model matrix is
+// fetched from the instance storage buffer and the specular material from the
+// model storage buffer.
+//-----------------------------------------------------------------------------
+#version 430 core
+
+layout (location = 0) in vec3 pos;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texCoord;
+layout (location = 3) in uvec2 visibleInstance;	// instance index, texture layer
+
+struct Instance
+{
+	mat4 model;
+	vec4 sphere;
+	uint modelId;
+	uint pad0, pad1, pad2;
+};
+
+struct Model
+{
+	uint lodMeshes[4];
+	float lodDistances[4];
+	uint numLods;
+	uint pad0, pad1, pad2;
+	vec4 material;
+};
+
+layout (std430, binding = 0) readonly buffer Instances { Instance instances[]; };
+layout (std430, binding = 1) readonly buffer Models { Model models[]; };
+
+uniform mat4 view;			// view matrix
+uniform mat4 projection;	// projection matrix
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+flat out uint TexLayer;
+flat out vec4 SpecularShininess;	// of the instance's model
+flat out float Fade;	// never fades, for depth_only.frag
+
+// Same depth as the depth pre-pass (GL_EQUAL test)
+invariant gl_Position;
+
+void main()
+{
+	Instance instance = instances[visibleInstance.x];
+	mat4 model = instance.model;
+
+	FragPos = vec3(model * vec4(pos, 1.0f));			// vertex position in world space
+	Normal = mat3(transpose(inverse(model))) * normal;	// normal direction in world space
+
+	TexCoord = texCoord;
+	TexLayer = visibleInstance.y;
+	SpecularShininess = models[instance.modelId].material;
+	Fade = 0.0f;
+
+	gl_Position = projection * view * vec4(FragPos, 1.0f);
+}
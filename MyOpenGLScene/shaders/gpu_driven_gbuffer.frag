@@ -0,0 +1,53 @@
+//-----------------------------------------------------------------------------
+// Fragment shader for the deferred geometry pass of the GPU driven path
+//
+// Same output as gbuffer.frag, the diffuse map is a texture array layer
+// chosen per instance.
+//-----------------------------------------------------------------------------
+#version 430 core
+
+struct Material 
+{
+    vec3 ambient;
+    sampler2DArray diffuseMap;
+};
+
+in vec2 TexCoord;
+in vec3 FragPos;
+in vec3 Normal;
+flat in uint TexLayer;
+flat in vec4 SpecularShininess;	// per model, the rest of the material is shared
+
+// Must match gbuffer.frag and deferred_lighting.frag
+#define MAX_SHININESS 256.0f
+
+uniform Material material;
+
+layout (location = 0) out vec4 albedoSpecular;
+layout (location = 1) out vec4 normalShininess;
+
+vec2 encodeNormal(vec3 n);
+
+//-----------------------------------------------------------------------------------------------
+// Main Shader Entry
+//-----------------------------------------------------------------------------------------------
+void main()
+{
+	vec3 albedo = vec3(texture(material.diffuseMap, vec3(TexCoord, TexLayer)));
+	float specular = max(SpecularShininess.r, max(SpecularShininess.g, SpecularShininess.b));
+
+	albedoSpecular = vec4(albedo, specular);
+	normalShininess = vec4(encodeNormal(normalize(Normal)) * 0.5f + 0.5f, SpecularShininess.a / MAX_SHININESS, 0.0f);
+}
+
+//-----------------------------------------------------------------------------------------------
+// Octahedral normal encoding - the unit sphere folded on a square in [-1, 1]
+//-----------------------------------------------------------------------------------------------
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.xy;
+	if (n.z < 0.0f)
+		e = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return e;
+}
@@ -0,0 +1,129 @@
+//-----------------------------------------------------------------------------
+// Vertex shader for procedural grass
+//
+// One instance per patch, VERTICES_PER_BLADE vertices per blade.  Nothing
+// but the patch is read from memory: the blade is placed, turned and sized
+// from a hash of the patch seed and its index, then bent by its lean and the
+// wind, on the terrain's heights if there is one.  Blades beyond the count the distance needs are faded out and
+// collapsed (see GrassRenderer::density).
+//-----------------------------------------------------------------------------
+#version 330 core
+
+layout (location = 0) in vec4 grassPatch;	// x, z of the corner, seed, density
+
+// Must match GrassRenderer
+#define VERTICES_PER_BLADE 15
+#define SEGMENTS 3
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+
+uniform float patchSize;
+uniform float groundHeight;
+uniform int bladesPerPatch;
+uniform vec3 bladeShape;		// min height, max height, width
+uniform vec3 densityDistances;	// lod distance, draw distance, fade out length
+uniform vec3 baseColor;
+uniform vec3 tipColor;
+
+uniform sampler2D terrainHeights;	// see Terrain::setHeightUniforms
+uniform vec2 terrainOrigin;
+uniform float terrainSize;			// 0 without a terrain
+uniform float terrainCells;
+
+uniform float time;
+uniform vec3 wind;				// direction (xy, on the ground plane), strength
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 Color;
+
+// Triangles of the blade strip: SEGMENTS quads then the tip
+const int stripVertex[VERTICES_PER_BLADE] = int[VERTICES_PER_BLADE](0, 1, 2,  2, 1, 3,  2, 3, 4,  4, 3, 5,  4, 5, 6);
+
+//-----------------------------------------------------------------------------
+// Integer hash, uniform in [0, 1)
+//-----------------------------------------------------------------------------
+float random(inout uint state)
+{
+	state ^= state >> 16;
+	state *= 0x7feb352du;
+	state ^= state >> 15;
+	state *= 0x846ca68bu;
+	state ^= state >> 16;
+	return float(state >> 8) * (1.0f / 16777216.0f);
+}
+
+//-----------------------------------------------------------------------------
+// Bilinear terrain height, same as terrain.vert
+//-----------------------------------------------------------------------------
+float terrainHeight(vec2 p)
+{
+	vec2 uv = ((p - terrainOrigin) / terrainSize * terrainCells + 0.5f) / (terrainCells + 1.0f);
+	return texture(terrainHeights, uv).r;
+}
+
+//-----------------------------------------------------------------------------
+// Part of the blades kept at this distance
+//-----------------------------------------------------------------------------
+float grassDensity(float d)
+{
+	float lod = densityDistances.x;
+	float falloff = d > lod ? (lod * lod) / (d * d) : 1.0f;
+	return falloff * clamp((densityDistances.y - d) / densityDistances.z, 0.0f, 1.0f);
+}
+
+void main()
+{
+	int blade = gl_VertexID / VERTICES_PER_BLADE;
+	int v = stripVertex[gl_VertexID % VERTICES_PER_BLADE];
+
+	uint state = uint(grassPatch.z) * 2654435761u + uint(blade) * 0x9e3779b9u;
+	vec3 root = vec3(grassPatch.x, groundHeight, grassPatch.y);
+	root.x += random(state) * patchSize;
+	root.z += random(state) * patchSize;
+	if (terrainSize > 0.0f)
+		root.y += terrainHeight(root.xz);
+	float angle = random(state) * 6.2831853f;
+	float height = mix(bladeShape.x, bladeShape.y, random(state));
+	float lean = random(state) * 0.4f;
+	float phase = random(state) * 6.2831853f;
+	float shade = random(state);
+
+	// The first blades of the patch are kept, the last one grows in or out
+	float density = grassDensity(length(root - viewPos));
+	float grow = clamp(float(bladesPerPatch) * grassPatch.w * density - float(blade), 0.0f, 1.0f);
+	if (grow <= 0.0f)
+	{
+		// Outside of the clip volume - the whole blade is dropped
+		FragPos = vec3(0.0f);
+		Normal = vec3(0.0f, 1.0f, 0.0f);
+		Color = vec3(0.0f);
+		gl_Position = vec4(2.0f, 2.0f, 2.0f, 1.0f);
+		return;
+	}
+
+	// Fewer blades far away, wider ones to keep the coverage
+	height *= grow;
+	float width = bladeShape.z * grow * inversesqrt(max(density, 1.0f / 16.0f));
+
+	vec3 across = vec3(cos(angle), 0.0f, sin(angle));
+	vec3 facing = vec3(-across.z, 0.0f, across.x);
+
+	float sway = wind.z * (0.6f + 0.4f * sin(time * 1.7f + dot(root.xz, wind.xy) * 0.12f + phase));
+	vec3 bend = (facing * lean + vec3(wind.x, 0.0f, wind.y) * sway) * height;
+
+	// Strip vertex: pairs along the blade, tapering to the tip
+	float t = float(v / 2) / float(SEGMENTS);
+	float side = (v & 1) == 0 ? -0.5f : 0.5f;
+	vec3 pos = root + across * (side * width * (1.0f - t)) + vec3(0.0f, height * t, 0.0f) + bend * (t * t);
+
+	vec3 tangent = vec3(0.0f, height, 0.0f) + bend * (2.0f * t);
+	Normal = normalize(cross(across, tangent));
+
+	FragPos = pos;
+	Color = mix(baseColor, tipColor, t) * (0.8f + 0.4f * shade);
+
+	gl_Position = projection * view * vec4(pos, 1.0f);
+}
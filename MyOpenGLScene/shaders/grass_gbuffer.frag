@@ -0,0 +1,39 @@
+//-----------------------------------------------------------------------------
+// Fragment shader for procedural grass in the deferred geometry pass
+//
+// Writes the blade color and the normal facing the camera side (leaning up
+// like grass.frag) to the G-buffer, with no specular.
+//-----------------------------------------------------------------------------
+#version 330 core
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec3 Color;
+
+layout (location = 0) out vec4 albedoSpecular;
+layout (location = 1) out vec4 normalShininess;
+
+vec2 encodeNormal(vec3 n);
+
+//-----------------------------------------------------------------------------------------------
+// Main Shader Entry
+//-----------------------------------------------------------------------------------------------
+void main()
+{
+	vec3 normal = normalize((gl_FrontFacing ? Normal : -Normal) + vec3(0.0f, 0.5f, 0.0f));
+
+	albedoSpecular = vec4(Color, 0.0f);
+	normalShininess = vec4(encodeNormal(normal) * 0.5f + 0.5f, 1.0f / 256.0f, 0.0f);	// shininess 1, keeps pow() defined
+}
+
+//-----------------------------------------------------------------------------------------------
+// Octahedral normal encoding, same as gbuffer.frag
+//-----------------------------------------------------------------------------------------------
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.xy;
+	if (n.z < 0.0f)
+		e = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return e;
+}
@@ -0,0 +1,144 @@
+//-----------------------------------------------------------------------------
+// Fragment shader for octahedral impostors
+//
+// Lights the baked albedo and normal with the sun and the clustered point
+// lights, diffuse only - impostors are far away.  Fades in with the dither
+// pattern the mesh fades out with (lighting_clustered.frag).
+//-----------------------------------------------------------------------------
+#version 330 core
+
+struct Material 
+{
+    vec3 ambient;
+};
+
+struct DirectionalLight
+{
+	vec3 direction;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+struct SpotLight
+{
+	vec3 ambient;
+};
+
+in vec3 FragPos;
+in vec2 TexCoord;
+flat in mat3 NormalMatrix;
+flat in float Fade;
+
+// Must match LightClusterer
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+
+uniform sampler2DArray albedoAtlas;
+uniform sampler2DArray normalAtlas;
+uniform int impostorLayer;
+
+uniform DirectionalLight sunLight;
+uniform SpotLight spotLight;
+uniform Material material;
+
+// Clustered point lights
+uniform samplerBuffer pointLightData;		// (position, constant) (diffuse, linear) (specular, exponent)
+uniform usamplerBuffer clusterGrid;			// offset, count per cluster
+uniform usamplerBuffer clusterLightIndices;
+uniform vec2 clusterDepth;					// near, far planes
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
+uniform vec2 clusterTileSize;
+
+// Sun shadows - must match ShadowCascades
+#define NUM_CASCADES 4
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[NUM_CASCADES];	// world to shadow map [0, 1]
+uniform vec4 shadowDistances;				// end of each cascade from viewPos, 0 when off
+uniform vec4 shadowTexelSizes;				// world size of a texel of each cascade
+uniform vec3 viewPos;
+
+out vec4 frag_color;
+
+int findCluster();
+float calcShadow(vec3 fragPos, vec3 normal);
+
+//-----------------------------------------------------------------------------------------------
+// Main Shader Entry
+//-----------------------------------------------------------------------------------------------
+void main()
+{
+	vec4 albedo = texture(albedoAtlas, vec3(TexCoord, impostorLayer));
+	if (albedo.a < 0.5f || ditherThreshold() >= Fade)
+		discard;
+
+	vec3 normal = normalize(NormalMatrix * (vec3(texture(normalAtlas, vec3(TexCoord, impostorLayer))) * 2.0f - 1.0f));
+
+	vec3 color = spotLight.ambient * material.ambient * albedo.rgb;
+	color += calcShadow(FragPos, normal) * sunLight.diffuse * max(dot(normal, normalize(-sunLight.direction)), 0.0f) * albedo.rgb;
+
+	uvec2 lights = texelFetch(clusterGrid, findCluster()).xy;
+	for (uint i = 0u; i < lights.y; i++)
+	{
+		int index = int(texelFetch(clusterLightIndices, int(lights.x + i)).r) * 3;
+		vec4 positionConstant = texelFetch(pointLightData, index);
+		vec4 diffuseLinear = texelFetch(pointLightData, index + 1);
+		float exponent = texelFetch(pointLightData, index + 2).w;
+
+		vec3 toLight = positionConstant.xyz - FragPos;
+		float d = length(toLight);
+		float attenuation = 1.0f / (positionConstant.w + diffuseLinear.w * d + exponent * (d * d));
+		color += diffuseLinear.rgb * max(dot(normal, toLight / d), 0.0f) * attenuation * albedo.rgb;
+	}
+
+	frag_color = vec4(color, 1.0f);
+}
+
+//-----------------------------------------------------------------------------------------------
+// Sun visibility from the first cascade that covers the fragment: 3x3 PCF,
+// the position pushed along the normal by a texel or so against acne, faded
+// out at the end of the last cascade
+//-----------------------------------------------------------------------------------------------
+float calcShadow(vec3 fragPos, vec3 normal)
+{
+	float distance = length(fragPos - viewPos);
+	int cascade = 0;
+	while (cascade < NUM_CASCADES && distance > shadowDistances[cascade])
+		cascade++;
+	if (cascade == NUM_CASCADES)
+		return 1.0f;
+
+	vec3 p = fragPos + normal * (1.5f * shadowTexelSizes[cascade]);
+	vec4 s = shadowMatrices[cascade] * vec4(p, 1.0f);
+	if (s.z >= 1.0f)
+		return 1.0f;
+
+	float texel = 1.0f / float(textureSize(shadowMap, 0).x);
+	float lit = 0.0f;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+			lit += texture(shadowMap, vec4(s.xy + vec2(x, y) * texel, float(cascade), s.z));
+	}
+
+	float last = shadowDistances[NUM_CASCADES - 1];
+	float fade = clamp((last - distance) / (0.1f * last), 0.0f, 1.0f);
+	return mix(1.0f, lit / 9.0f, fade);
+}
+
+//-----------------------------------------------------------------------------------------------
+// Cluster of this fragment - the depth slices are exponential in the view depth
+//-----------------------------------------------------------------------------------------------
+int findCluster()
+{
+	float n = clusterDepth.x;
+	float f = clusterDepth.y;
+	float viewDepth = 2.0f * n * f / (f + n - (2.0f * gl_FragCoord.z - 1.0f) * (f - n));
+
+	int slice = clamp(int(log(viewDepth) * clusterSliceScale + clusterSliceBias), 0, CLUSTERS_Z - 1);
+	ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterTileSize), ivec2(0), ivec2(CLUSTERS_X - 1, CLUSTERS_Y - 1));
+
+	return tile.x + CLUSTERS_X * (tile.y + CLUSTERS_Y * slice);
+}
@@ -0,0 +1,76 @@
+//-----------------------------------------------------------------------------
+// Vertex shader for octahedral impostors
+//
+// One instanced quad (4 vertex strip) per impostor.  The view direction is
+// brought into the mesh's object space, the nearest baked view is chosen and
+// the quad is placed where that view was captured from, facing its direction.
+//-----------------------------------------------------------------------------
+#version 330 core
+
+layout (location = 3) in uint transformIndex;
+
+// Must match ImpostorAtlas
+#define GRID 8
+
+uniform samplerBuffer transforms;	// world matrices
+uniform mat4 view;					// view matrix
+uniform mat4 projection;			// projection matrix
+uniform vec3 viewPos;
+uniform vec2 lodFade;				// fade start distance, 1 / fade length
+
+uniform vec3 impostorCenter;		// object space bounding sphere
+uniform float impostorRadius;
+
+out vec3 FragPos;
+out vec2 TexCoord;
+flat out mat3 NormalMatrix;			// object to world, for the baked normals
+flat out float Fade;
+
+//-----------------------------------------------------------------------------
+// Hemi-octahedral mapping, same as ImpostorAtlas::tileDirection
+//-----------------------------------------------------------------------------
+vec3 decodeDirection(vec2 e)
+{
+	vec3 d;
+	d.x = (e.x + e.y) * 0.5f;
+	d.z = (e.x - e.y) * 0.5f;
+	d.y = 1.0f - abs(d.x) - abs(d.z);
+	return normalize(d);
+}
+
+vec2 encodeDirection(vec3 d)
+{
+	d.y = max(d.y, 0.0f);		// views from below use the horizon
+	d /= abs(d.x) + abs(d.y) + abs(d.z);
+	return vec2(d.x + d.z, d.x - d.z);
+}
+
+void main()
+{
+	int texel = int(transformIndex) * 4;
+	mat4 model = mat4(texelFetch(transforms, texel),
+	                  texelFetch(transforms, texel + 1),
+	                  texelFetch(transforms, texel + 2),
+	                  texelFetch(transforms, texel + 3));
+
+	// Nearest baked view of the direction towards the camera
+	vec3 worldCenter = vec3(model * vec4(impostorCenter, 1.0f));
+	vec3 dir = normalize(inverse(mat3(model)) * (viewPos - worldCenter));
+	ivec2 tile = clamp(ivec2((encodeDirection(dir) * 0.5f + 0.5f) * GRID), ivec2(0), ivec2(GRID - 1));
+
+	vec3 tileDir = decodeDirection((vec2(tile) + 0.5f) / GRID * 2.0f - 1.0f);
+	vec3 up = abs(tileDir.y) > 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+	vec3 right = normalize(cross(up, tileDir));
+	up = cross(tileDir, right);
+
+	// Strip corners (-1,-1) (1,-1) (-1,1) (1,1)
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0f - 1.0f;
+	vec3 objectPos = impostorCenter + (right * corner.x + up * corner.y) * impostorRadius;
+
+	FragPos = vec3(model * vec4(objectPos, 1.0f));
+	TexCoord = (vec2(tile) + corner * 0.5f + 0.5f) / GRID;
+	NormalMatrix = mat3(normalize(model[0].xyz), normalize(model[1].xyz), normalize(model[2].xyz));
+	Fade = clamp((length(model[3].xyz - viewPos) - lodFade.x) * lodFade.y, 0.0f, 1.0f);
+
+	gl_Position = projection * view * vec4(FragPos, 1.0f);
+}
@@ -0,0 +1,21 @@
+//-----------------------------------------------------------------------------
+// Fragment shader for baking impostor views
+//
+// Writes the unlit albedo and the object space normal, the impostor shaders
+// light them at draw time.  The background stays at alpha 0.
+//-----------------------------------------------------------------------------
+#version 330 core
+
+in vec3 Normal;
+in vec2 TexCoord;
+
+uniform sampler2D diffuseMap;
+
+layout (location = 0) out vec4 albedo;
+layout (location = 1) out vec4 normal;
+
+void main()
+{
+	albedo = vec4(vec3(texture(diffuseMap, TexCoord)), 1.0f);
+	normal = vec4(normalize(Normal) * 0.5f + 0.5f, 1.0f);
+}
@@ -0,0 +1,21 @@
+//-----------------------------------------------------------------------------
+// Vertex shader for baking impostor views - object space, orthographic
+//-----------------------------------------------------------------------------
+#version 330 core
+
+layout (location = 0) in vec3 pos;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texCoord;
+
+uniform mat4 viewProjection;
+
+out vec3 Normal;
+out vec2 TexCoord;
+
+void main()
+{
+	Normal = normal;
+	TexCoord = texCoord;
+
+	gl_Position = viewProjection * vec4(pos, 1.0f);
+}
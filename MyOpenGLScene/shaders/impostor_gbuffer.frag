@@ -0,0 +1,48 @@
+//-----------------------------------------------------------------------------
+// Fragment shader for octahedral impostors in the deferred geometry pass
+//
+// Writes the baked albedo and normal to the G-buffer like gbuffer.frag, with
+// no specular.  Fades in like impostor.frag.
+//-----------------------------------------------------------------------------
+#version 330 core
+
+in vec3 FragPos;
+in vec2 TexCoord;
+flat in mat3 NormalMatrix;
+flat in float Fade;
+
+uniform sampler2DArray albedoAtlas;
+uniform sampler2DArray normalAtlas;
+uniform int impostorLayer;
+
+layout (location = 0) out vec4 albedoSpecular;
+layout (location = 1) out vec4 normalShininess;
+
+vec2 encodeNormal(vec3 n);
+
+//-----------------------------------------------------------------------------------------------
+// Main Shader Entry
+//-----------------------------------------------------------------------------------------------
+void main()
+{
+	vec4 albedo = texture(albedoAtlas, vec3(TexCoord, impostorLayer));
+	if (albedo.a < 0.5f || ditherThreshold() >= Fade)
+		discard;
+
+	vec3 normal = normalize(NormalMatrix * (vec3(texture(normalAtlas, vec3(TexCoord, impostorLayer))) * 2.0f - 1.0f));
+
+	albedoSpecular = vec4(albedo.rgb, 0.0f);
+	normalShininess = vec4(encodeNormal(normal) * 0.5f + 0.5f, 1.0f / 256.0f, 0.0f);	// shininess 1, keeps pow() defined
+}
+
+//-----------------------------------------------------------------------------------------------
+// Octahedral normal encoding, same as gbuffer.frag
+//-----------------------------------------------------------------------------------------------
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.xy;
+	if (n.z < 0.0f)
+		e = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return e;
+}
@@ -0,0 +1,269 @@
+//-----------------------------------------------------------------------------
+// Fragment shader for clustered lighting
+//
+// Same lighting as lighting_dir_point_spot.frag, but instead of a fixed array
+// of point lights each fragment looks up its cluster (screen tile and depth
+// slice) and only evaluates the lights the CPU binned there (LightClusterer).
+//-----------------------------------------------------------------------------
+#version 330 core
+
+struct Material 
+{
+    vec3 ambient;
+    sampler2D diffuseMap;
+    vec3 specular;
+    float shininess;
+};
+
+struct DirectionalLight
+{
+	vec3 direction;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+struct PointLight
+{
+	vec3 position;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+
+	float constant;
+	float linear;
+	float exponent;
+};
+
+struct SpotLight
+{
+	vec3 position;
+	vec3 direction;
+	float cosInnerCone;
+	float cosOuterCone;
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+	int on;
+
+	float constant;
+	float linear;
+	float exponent;
+};
+
+  
+in vec2 TexCoord;
+in vec3 FragPos;
+in vec3 Normal;
+flat in float Fade;
+
+// Must match LightClusterer
+#define CLUSTERS_X 16
+#define CLUSTERS_Y 9
+#define CLUSTERS_Z 24
+
+uniform DirectionalLight sunLight;
+uniform SpotLight spotLight;
+uniform Material material;
+uniform vec3 viewPos;
+
+// Clustered point lights
+uniform samplerBuffer pointLightData;		// (position, constant) (diffuse, linear) (specular, exponent)
+uniform usamplerBuffer clusterGrid;			// offset, count per cluster
+uniform usamplerBuffer clusterLightIndices;
+uniform vec2 clusterDepth;					// near, far planes
+uniform float clusterSliceScale;
+uniform float clusterSliceBias;
+uniform vec2 clusterTileSize;
+
+// Sun shadows - must match ShadowCascades
+#define NUM_CASCADES 4
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[NUM_CASCADES];	// world to shadow map [0, 1]
+uniform vec4 shadowDistances;				// end of each cascade from viewPos, 0 when off
+uniform vec4 shadowTexelSizes;				// world size of a texel of each cascade
+
+out vec4 frag_color;
+
+int findCluster();
+float calcShadow(vec3 fragPos, vec3 normal);
+PointLight fetchPointLight(int index);
+vec3 calcDirectionalLightColor(DirectionalLight light, vec3 normal, vec3 viewDir);
+vec3 calcPointLightColor(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 calcSpotLightColor(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+
+//-----------------------------------------------------------------------------------------------
+// Main Shader Entry
+//-----------------------------------------------------------------------------------------------
+void main()
+{ 
+	// Fading out to the impostor
+	if (ditherThreshold() < Fade)
+		discard;
+
+	vec3 normal = normalize(Normal);  
+	vec3 viewDir = normalize(viewPos - FragPos);
+
+    // Ambient ----------------------------------------------------------------------------------
+	vec3 ambient = spotLight.ambient * material.ambient * vec3(texture(material.diffuseMap, TexCoord));
+	vec3 outColor = vec3(0.0f);	
+
+	outColor += calcShadow(FragPos, normal) * calcDirectionalLightColor(sunLight, normal, viewDir);
+
+	// Only the lights binned in this fragment's cluster
+	uvec2 lights = texelFetch(clusterGrid, findCluster()).xy;
+	for (uint i = 0u; i < lights.y; i++)
+	{
+		int index = int(texelFetch(clusterLightIndices, int(lights.x + i)).r);
+		outColor += calcPointLightColor(fetchPointLight(index), normal, FragPos, viewDir);
+	}
+
+	// If the light isn't on then just return 0 for diffuse and specular colors
+	if (spotLight.on == 1)
+		outColor += calcSpotLightColor(spotLight, normal, FragPos, viewDir);
+
+	frag_color = vec4(ambient + outColor, 1.0f);
+}
+
+//-----------------------------------------------------------------------------------------------
+// Sun visibility from the first cascade that covers the fragment: 3x3 PCF,
+// the position pushed along the normal by a texel or so against acne, faded
+// out at the end of the last cascade
+//-----------------------------------------------------------------------------------------------
+float calcShadow(vec3 fragPos, vec3 normal)
+{
+	float distance = length(fragPos - viewPos);
+	int cascade = 0;
+	while (cascade < NUM_CASCADES && distance > shadowDistances[cascade])
+		cascade++;
+	if (cascade == NUM_CASCADES)
+		return 1.0f;
+
+	vec3 p = fragPos + normal * (1.5f * shadowTexelSizes[cascade]);
+	vec4 s = shadowMatrices[cascade] * vec4(p, 1.0f);
+	if (s.z >= 1.0f)
+		return 1.0f;
+
+	float texel = 1.0f / float(textureSize(shadowMap, 0).x);
+	float lit = 0.0f;
+	for (int y = -1; y <= 1; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+			lit += texture(shadowMap, vec4(s.xy + vec2(x, y) * texel, float(cascade), s.z));
+	}
+
+	float last = shadowDistances[NUM_CASCADES - 1];
+	float fade = clamp((last - distance) / (0.1f * last), 0.0f, 1.0f);
+	return mix(1.0f, lit / 9.0f, fade);
+}
+
+//-----------------------------------------------------------------------------------------------
+// Cluster of this fragment - the depth slices are exponential in the view depth
+//-----------------------------------------------------------------------------------------------
+int findCluster()
+{
+	float n = clusterDepth.x;
+	float f = clusterDepth.y;
+	float viewDepth = 2.0f * n * f / (f + n - (2.0f * gl_FragCoord.z - 1.0f) * (f - n));
+
+	int slice = clamp(int(log(viewDepth) * clusterSliceScale + clusterSliceBias), 0, CLUSTERS_Z - 1);
+	ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterTileSize), ivec2(0), ivec2(CLUSTERS_X - 1, CLUSTERS_Y - 1));
+
+	return tile.x + CLUSTERS_X * (tile.y + CLUSTERS_Y * slice);
+}
+
+//-----------------------------------------------------------------------------------------------
+// Reads a point light from the light texture buffer
+//-----------------------------------------------------------------------------------------------
+PointLight fetchPointLight(int index)
+{
+	vec4 t0 = texelFetch(pointLightData, index * 3 + 0);
+	vec4 t1 = texelFetch(pointLightData, index * 3 + 1);
+	vec4 t2 = texelFetch(pointLightData, index * 3 + 2);
+
+	PointLight light;
+	light.position = t0.xyz;
+	light.ambient  = vec3(0.0f);
+	light.diffuse  = t1.xyz;
+	light.specular = t2.xyz;
+	light.constant = t0.w;
+	light.linear   = t1.w;
+	light.exponent = t2.w;
+	return light;
+}
+
+//-----------------------------------------------------------------------------------------------
+// Calculate the direction light effect and return the resulting 
+// diffuse and specular color summation
+//-----------------------------------------------------------------------------------------------
+vec3 calcDirectionalLightColor(DirectionalLight light, vec3 normal, vec3 viewDir)
+{
+	vec3 lightDir = normalize(-light.direction);  // negate => Must be a direction from fragment towards the light
+
+	// Diffuse ------------------------------------------------------------------------- --------
+    float NdotL = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * NdotL * vec3(texture(material.diffuseMap, TexCoord));
+    
+     // Specular - Blinn-Phong ------------------------------------------------------------------
+	vec3 halfDir = normalize(lightDir + viewDir);
+	float NDotH = max(dot(normal, halfDir), 0.0f);
+	vec3 specular = light.specular * material.specular * pow(NDotH, material.shininess);
+
+	return (diffuse + specular);
+}
+
+//-----------------------------------------------------------------------------------------------
+// Calculate the point light effect and return the resulting diffuse and specular color summation
+//-----------------------------------------------------------------------------------------------
+vec3 calcPointLightColor(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+	vec3 lightDir = normalize(light.position - fragPos);
+
+	// Diffuse ----------------------------------------------------------------------------------
+    float NdotL = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = light.diffuse * NdotL * vec3(texture(material.diffuseMap, TexCoord));
+    
+     // Specular - Blinn-Phong ------------------------------------------------------------------
+	vec3 halfDir = normalize(lightDir + viewDir);
+	float NDotH = max(dot(normal, halfDir), 0.0f);
+	vec3 specular = light.specular * material.specular * pow(NDotH, material.shininess);
+
+	// Attenuation using Kc, Kl, Kq -------------------------------------------------------------
+	float d = length(light.position - FragPos);
+	float attenuation = 1.0f / (light.constant + light.linear * d + light.exponent * (d * d));
+
+	diffuse *= attenuation;
+	specular *= attenuation;
+	
+	return (diffuse + specular);
+}
+
+//------------------------------------------------------------------------------------------------
+// Calculate the spotlight effect and return the resulting // diffuse and specular color summation
+//------------------------------------------------------------------------------------------------
+vec3 calcSpotLightColor(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+	vec3 lightDir = normalize(light.position - fragPos);
+	vec3 spotDir  = normalize(light.direction);
+
+	float cosDir = dot(-lightDir, spotDir);  // angle between the lights direction vector and spotlights direction vector
+	float spotIntensity = smoothstep(light.cosOuterCone, light.cosInnerCone, cosDir);
+
+	// Diffuse ----------------------------------------------------------------------------------
+    float NdotL = max(dot(normal, lightDir), 0.0);
+    vec3 diffuse = spotLight.diffuse * NdotL * vec3(texture(material.diffuseMap, TexCoord));
+    
+     // Specular - Blinn-Phong ------------------------------------------------------------------
+	vec3 halfDir = normalize(lightDir + viewDir);
+	float NDotH = max(dot(normal, halfDir), 0.0f);
+	vec3 specular = light.specular * material.specular * pow(NDotH, material.shininess);
+
+	// Attenuation using Kc, Kl, Kq -------------------------------------------------------------
+	float d = length(light.position - FragPos);
+	float attenuation = 1.0f / (light.constant + light.linear * d + light.exponent * (d * d));
+
+	diffuse *= attenuation * spotIntensity;
+	specular *= attenuation * spotIntensity;
+	
+	return (diffuse + specular);
+}
@@ -0,0 +1,43 @@
+//-----------------------------------------------------------------------------
+// Vertex shader for instanced draws of static objects
+//
+// The per-instance attribute is the index of the instance's world matrix in
+// the transform texture buffer (4 texels - the matrix columns - each).
+//-----------------------------------------------------------------------------
+#version 330 core
+
+layout (location = 0) in vec3 pos;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texCoord;
+layout (location = 3) in uint transformIndex;
+
+uniform samplerBuffer transforms;	// world matrices
+uniform mat4 view;			// view matrix
+uniform mat4 projection;	// projection matrix
+uniform vec3 viewPos;
+uniform vec2 lodFade;		// fade start distance, 1 / fade length
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+flat out float Fade;	// 1 once replaced by the impostor
+
+// Same depth as the depth pre-pass (GL_EQUAL test)
+invariant gl_Position;
+
+void main()
+{
+	int texel = int(transformIndex) * 4;
+	mat4 model = mat4(texelFetch(transforms, texel),
+	                  texelFetch(transforms, texel + 1),
+	                  texelFetch(transforms, texel + 2),
+	                  texelFetch(transforms, texel + 3));
+
+	FragPos = vec3(model * vec4(pos, 1.0f));			// vertex position in world space
+	Normal = mat3(transpose(inverse(model))) * normal;	// normal direction in world space
+
+	TexCoord = texCoord;
+	Fade = clamp((length(model[3].xyz - viewPos) - lodFade.x) * lodFade.y, 0.0f, 1.0f);
+
+	gl_Position = projection * view * vec4(FragPos, 1.0f);
+}
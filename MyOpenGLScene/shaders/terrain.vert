@@ -0,0 +1,70 @@
+//-----------------------------------------------------------------------------
+// Vertex shader for the CDLOD terrain
+//
+// Every node is the same grid.  The vertex is placed in the node, morphed
+// towards the grid of the next lod (every other vertex slides onto its even
+// neighbour) as the camera gets to the end of the node's lod range, then
+// displaced with the height texture.  Outputs what the instanced shaders
+// output so the terrain is lit by lighting_clustered.frag / gbuffer.frag.
+//-----------------------------------------------------------------------------
+#version 330 core
+
+layout (location = 0) in vec2 gridPos;	// 0..NODE_QUADS
+layout (location = 1) in vec4 node;		// origin x, z, size, lod
+
+// Must match Terrain
+#define NODE_QUADS 32.0f
+#define MAX_LODS 8
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+
+uniform sampler2D terrainHeights;
+uniform vec2 terrainOrigin;
+uniform float terrainSize;
+uniform float terrainCells;
+uniform vec2 morphConsts[MAX_LODS];		// morph start distance, 1 / morph length
+uniform float textureTile;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+flat out float Fade;	// never fades, for the shared fragment shaders
+
+// Same depth in the pre-pass and the main pass (GL_EQUAL test)
+invariant gl_Position;
+
+//-----------------------------------------------------------------------------
+// Bilinear height, like Heightfield::getHeight
+//-----------------------------------------------------------------------------
+float terrainHeight(vec2 p)
+{
+	vec2 uv = ((p - terrainOrigin) / terrainSize * terrainCells + 0.5f) / (terrainCells + 1.0f);
+	return texture(terrainHeights, uv).r;
+}
+
+void main()
+{
+	float quadSize = node.z / NODE_QUADS;
+	vec2 world = node.xy + gridPos * quadSize;
+
+	// Morph factor from the distance to the unmorphed vertex
+	float distance = length(vec3(world.x, terrainHeight(world), world.y) - viewPos);
+	vec2 morph = morphConsts[int(node.w)];
+	float k = clamp((distance - morph.x) * morph.y, 0.0f, 1.0f);
+
+	vec2 odd = fract(gridPos * 0.5f) * 2.0f;
+	world = node.xy + (gridPos - odd * k) * quadSize;
+
+	float h = terrainHeight(world);
+	float dx = terrainHeight(world + vec2(quadSize, 0.0f)) - terrainHeight(world - vec2(quadSize, 0.0f));
+	float dz = terrainHeight(world + vec2(0.0f, quadSize)) - terrainHeight(world - vec2(0.0f, quadSize));
+
+	FragPos = vec3(world.x, h, world.y);
+	Normal = normalize(vec3(-dx, 2.0f * quadSize, -dz));
+	TexCoord = world / textureTile;
+	Fade = 0.0f;
+
+	gl_Position = projection * view * vec4(FragPos, 1.0f);
+}